@@ -0,0 +1,192 @@
+// benchmarks the binding against the stand-in library in bench/refprop-stub.cpp, so it runs anywhere:
+//
+//     REFPROP_BENCH=1 node-gyp rebuild && node bench/index.js [--states 2000] [--engines 8] [--json]
+//
+// every flash pair, in one phase and in two, through statePoint and through statePointBatch.  for each
+// it reports the time per state, how much of that was spent inside the library (solver) and how much
+// was ours (binding), and how many native allocations the addon made per state.  the pairs that can be
+// warm started also walk a short single-phase path, cold (ramp), warm (trajectory: true) and with a phase hint
+// (hinted, phase: 'vapor').  the stand-in solver
+// is far cheaper than refprop, so the binding's share here is an upper bound; REFPROP_STUB_LATENCY_NS
+// slows it down to see how the split moves.
+//
+// then one statePointBatch of the same rows over 1, 2, ... up to --engines engines (the core count by
+// default), for the throughput and speedup of each pool size.  every flash busy-waits for
+// REFPROP_STUB_LATENCY_NS there, 20us if it isn't set, so the solver dominates the way refprop's does
+var path = require('path');
+var fs = require('fs');
+var os = require('os');
+
+var args = process.argv.slice(2);
+var states = 2000, maxEngines = os.cpus().length, json = false;
+for (var i = 0; i < args.length; i++) {
+	if (args[i] == '--states')
+		states = parseInt(args[++i], 10);
+	else if (args[i] == '--engines')
+		maxEngines = parseInt(args[++i], 10);
+	else if (args[i] == '--json')
+		json = true;
+}
+
+var release = path.join(__dirname, '..', 'build', 'Release');
+var refprop = require(path.join(release, 'node-refprop.node'));
+if (!refprop.getBenchStats) {
+	console.error('node-refprop was built without the benchmark counters; rebuild with REFPROP_BENCH=1 node-gyp rebuild');
+	process.exit(1);
+}
+
+var stub = ['refprop-stub.so', 'refprop-stub.dll', 'refprop-stub.dylib', 'librefprop-stub.dylib'].map(function(name) {
+	return path.join(release, name);
+}).filter(fs.existsSync)[0];
+if (!stub) {
+	console.error('no stand-in library in ' + release);
+	process.exit(1);
+}
+
+refprop.setPaths({library: stub, fluids: ''});
+refprop.setFluid('nitrogen');
+refprop.setEngines(1);  // so solver time adds up to wall time
+refprop.setCacheSize(0);
+
+// every pair in the flash table.  the Q pairs only mean anything in two phases
+var pairs = ['TP', 'TD', 'TH', 'TS', 'TE', 'TQ', 'PD', 'PH', 'PS', 'PE', 'PQ', 'DH', 'DS', 'DE', 'HS', 'ES'];
+var phases = {
+	single: refprop.statePoint({T: 300, P: 101.325e3}),
+	two: refprop.statePoint({T: 100, Q: .5})
+};
+
+function measure(run) {
+	run(Math.min(states, 100));  // warm up
+	refprop.resetBenchStats();
+	var start = process.hrtime();
+	run(states);
+	var elapsed = process.hrtime(start), stats = refprop.getBenchStats();
+
+	var ns = (elapsed[0] * 1e9 + elapsed[1]) / states, solver = stats.libraryNs / states;
+	return {
+		nsPerState: ns,
+		solverNs: solver,
+		bindingNs: Math.max(ns - solver, 0),
+		libraryCalls: stats.libraryCalls / states,
+		allocations: stats.allocations / states,
+		allocatedBytes: stats.allocatedBytes / states
+	};
+}
+
+function scalar(pair, state) {
+	var input = {};
+	input[pair[0]] = state[pair[0]];
+	input[pair[1]] = state[pair[1]];
+	return function(n) {
+		for (var i = 0; i < n; i++)
+			refprop.statePoint(input);
+	};
+}
+
+function batch(pair, state) {
+	var a = new Float64Array(states).fill(state[pair[0]]), b = new Float64Array(states).fill(state[pair[1]]);
+	var out = {T: new Float64Array(states), P: new Float64Array(states), D: new Float64Array(states), H: new Float64Array(states)};
+	return function(n) {
+		refprop.statePointBatch(pair, a.subarray(0, n), b.subarray(0, n), {
+			T: out.T.subarray(0, n), P: out.P.subarray(0, n), D: out.D.subarray(0, n), H: out.H.subarray(0, n)
+		});
+	};
+}
+
+// the second input creeps up by a tenth over the run, which keeps the single-phase state in its phase
+function ramp(options) {
+	return function(pair, state) {
+		var a = new Float64Array(states).fill(state[pair[0]]), b = new Float64Array(states);
+		for (var i = 0; i < states; i++)
+			b[i] = state[pair[1]] * (1 + .1 * i / states);
+		var out = {T: new Float64Array(states), D: new Float64Array(states)};
+		return function(n) {
+			refprop.statePointBatch(pair, a.subarray(0, n), b.subarray(0, n), {
+				T: out.T.subarray(0, n), D: out.D.subarray(0, n)
+			}, options);
+		};
+	};
+}
+var warmPairs = ['TP', 'PD', 'PH', 'PS'];
+
+var results = [];
+Object.keys(phases).forEach(function(phase) {
+	pairs.forEach(function(pair) {
+		if (phase == 'single' && pair.indexOf('Q') >= 0)
+			return;
+		var routes = [['scalar', scalar], ['batch', batch]];
+		if (phase == 'single' && warmPairs.indexOf(pair) >= 0)
+			routes.push(['ramp', ramp({})], ['warm', ramp({trajectory: true})], ['hinted', ramp({phase: 'vapor'})]);
+		routes.forEach(function(route) {
+			var result = {pair: pair, phase: phase, path: route[0]};
+			try {
+				var run = route[1](pair, phases[phase]);
+				run(1);
+				Object.assign(result, measure(run));
+			}
+			catch (err) {
+				result.error = err.message;
+			}
+			results.push(result);
+		});
+	});
+});
+
+var latencyNs = +(process.env.REFPROP_STUB_LATENCY_NS || 0);
+
+// the stand-in reads its latency at setup, so the sweep switches fluid to make every engine set up again
+// with it.  the inputs creep like ramp's, so no two rows are the same state
+function sweep() {
+	if (!process.env.REFPROP_STUB_LATENCY_NS)
+		process.env.REFPROP_STUB_LATENCY_NS = '20000';
+	refprop.setFluid('methane');
+	var state = refprop.statePoint({T: 300, P: 101.325e3});
+	var a = new Float64Array(states), b = new Float64Array(states), D = new Float64Array(states);
+	for (var i = 0; i < states; i++) {
+		a[i] = state.T * (1 + .1 * i / states);
+		b[i] = state.P;
+	}
+
+	var scaling = [];
+	for (var n = 1; n <= maxEngines; n++) {
+		refprop.setEngines(n);
+		refprop.statePointBatch('TP', a, b, {D: D});  // every engine loads the fluid
+		var start = process.hrtime();
+		refprop.statePointBatch('TP', a, b, {D: D});
+		var elapsed = process.hrtime(start), seconds = elapsed[0] + elapsed[1] / 1e9;
+		scaling.push({engines: refprop.getEngines(), statesPerSecond: states / seconds});
+	}
+	scaling.forEach(function(s) {
+		s.speedup = s.statesPerSecond / scaling[0].statesPerSecond;
+	});
+	return {latencyNs: +process.env.REFPROP_STUB_LATENCY_NS, scaling: scaling};
+}
+var scaling = sweep();
+
+if (json) {
+	console.log(JSON.stringify({states: states, latencyNs: latencyNs, results: results, engines: scaling}, null, 2));
+	process.exit(0);
+}
+
+function pad(s, n) {
+	s = String(s);
+	return s.length >= n ? s : new Array(n - s.length + 1).join(' ') + s;
+}
+
+console.log(pad('pair', 4) + pad('phase', 8) + pad('path', 8) + pad('ns/state', 11) + pad('solver', 11) + pad('binding', 11)
+	+ pad('calls', 7) + pad('allocs', 8) + pad('bytes', 8));
+results.forEach(function(r) {
+	var line = pad(r.pair, 4) + pad(r.phase, 8) + pad(r.path, 8);
+	if (r.error)
+		line += '  ' + r.error;
+	else
+		line += pad(r.nsPerState.toFixed(0), 11) + pad(r.solverNs.toFixed(0), 11) + pad(r.bindingNs.toFixed(0), 11)
+			+ pad(r.libraryCalls.toFixed(1), 7) + pad(r.allocations.toFixed(2), 8) + pad(r.allocatedBytes.toFixed(0), 8);
+	console.log(line);
+});
+
+console.log('\nstatePointBatch over the pool, ' + scaling.latencyNs + 'ns a flash');
+console.log(pad('engines', 8) + pad('states/s', 12) + pad('speedup', 9));
+scaling.scaling.forEach(function(s) {
+	console.log(pad(s.engines, 8) + pad(s.statesPerSecond.toFixed(0), 12) + pad(s.speedup.toFixed(2), 9));
+});
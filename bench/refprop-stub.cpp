@@ -0,0 +1,1007 @@
+// a stand-in for the refprop library, for measuring the addon on machines that don't have refprop.
+// it exports the routines the addon loads, with the signatures in REFPROP1.H, and answers them with
+// cheap analytic physics: a virial gas, an almost incompressible liquid, and a clausius-clapeyron
+// dome between them.  the numbers are deterministic and self-consistent enough for every flash pair
+// to round trip through vapor, supercritical and two-phase states (the liquid is cruder), but they're
+// not any real fluid's properties.  a mixture is a pseudo-pure fluid whose parameters are the
+// mole-weighted averages of its components', so both phases always share the overall composition.
+//
+// REFPROP_STUB_LATENCY_NS and REFPROP_STUB_PROPERTY_LATENCY_NS (read at every SETUPdll) add that
+// much busy waiting to each flash and each property routine, to stand in for a heavier solver
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <algorithm>
+#include <chrono>
+#include <type_traits>
+
+#ifdef _WIN32
+#define EXPORT extern "C" __declspec(dllexport)
+#define STDCALL __stdcall
+#else
+#define EXPORT extern "C" __attribute__((visibility("default")))
+#define STDCALL
+#define __stdcall
+#endif
+
+// only here to check our signatures against
+namespace refprop1 {
+#include "../src/REFPROP1.H"
+}
+
+#define SIGNATURE(name) static_assert(std::is_same<decltype(&name), refprop1::fp_##name##TYPE>::value, #name " doesn't match REFPROP1.H")
+
+#define R 8.314462618
+#define T0 273.15     // reference state: ideal gas at T0 and P0 has e = s = 0
+#define P0 101.325
+#define kappaL 1e-6   // liquid compressibility, 1/kPa
+#define Tmax 5000.0
+#define Dmin 1e-12
+
+struct Fluid {
+	const char* name;
+	double M, Tc, Pc, Dc, Ttrp, Tnbp, acf, cp0R;
+};
+
+// critical and triple points roughly where the real fluids have them
+static const Fluid fluids[] = {
+	{ "NITROGEN", 28.0134, 126.192, 3395.8, 11.1839, 63.151, 77.355, 0.0372, 3.5 },
+	{ "ISOBUTAN", 58.1222, 407.81, 3629.0, 3.879, 113.73, 261.401, 0.184, 11.7 },
+	{ "R134A", 102.032, 374.21, 4059.28, 5.017053, 169.85, 247.076, 0.32684, 10.5 },
+	{ "WATER", 18.015268, 647.096, 22064.0, 17.8737, 273.16, 373.124, 0.3443, 4.0 },
+	{ "METHANE", 16.0428, 190.564, 4599.2, 10.139, 90.6941, 111.667, 0.01142, 4.3 },
+	{ "PROPANE", 44.09562, 369.89, 4251.2, 5.0, 85.525, 231.036, 0.1521, 8.9 },
+	{ "CO2", 44.0098, 304.1282, 7377.3, 10.6249, 216.592, 216.592, 0.22394, 4.5 },
+};
+
+#define ncmax 20
+
+static const Fluid* fluid = NULL;
+static double L, a, b, cp0, cv0;  // latent heat, virial coefficients B = b - a/RT, ideal gas heat capacities
+
+// what SETUPdll or SETMIXdll loaded.  for mixtures, fluid points at blended, worked out for the composition
+// of the latest call
+static const Fluid* components[ncmax];
+static long numComponents = 0;
+static Fluid blended;
+static double blendedZ[ncmax];
+static long flashLatency = 0, propertyLatency = 0;
+
+static void spin(long ns) {
+	if (ns <= 0)
+		return;
+	std::chrono::steady_clock::time_point until = std::chrono::steady_clock::now() + std::chrono::nanoseconds(ns);
+	while (std::chrono::steady_clock::now() < until)
+		;
+}
+
+static void setError(long& ierr, char* herr, long length, long code, const char* msg) {
+	ierr = code;
+	if (length > 0) {
+		strncpy(herr, msg, length - 1);
+		herr[length - 1] = '\0';
+	}
+}
+
+static void fitParameters() {
+	L = R * log(fluid->Pc / P0) / (1 / fluid->Tnbp - 1 / fluid->Tc);
+	b = 0.1 / fluid->Dc;
+	a = b * R * fluid->Tc;
+	cp0 = fluid->cp0R * R;
+	cv0 = cp0 - R;
+}
+
+// makes fluid the mixture at composition z.  pure fluids don't need anything
+static void blend(const double* z) {
+	if (numComponents < 2 || (fluid == &blended && memcmp(z, blendedZ, numComponents * sizeof(double)) == 0))
+		return;
+
+	memcpy(blendedZ, z, numComponents * sizeof(double));
+	blended.name = "MIXTURE";
+	blended.M = blended.Tc = blended.Pc = blended.Dc = blended.Ttrp = blended.Tnbp = blended.acf = blended.cp0R = 0;
+	for (long i = 0; i < numComponents; i++) {
+		const Fluid* c = components[i];
+		blended.M += z[i] * c->M;
+		blended.Tc += z[i] * c->Tc;
+		blended.Pc += z[i] * c->Pc;
+		blended.Dc += z[i] * c->Dc;
+		blended.Ttrp += z[i] * c->Ttrp;
+		blended.Tnbp += z[i] * c->Tnbp;
+		blended.acf += z[i] * c->acf;
+		blended.cp0R += z[i] * c->cp0R;
+	}
+	fluid = &blended;
+	fitParameters();
+}
+
+// both phases come out at the overall composition
+static void phaseCompositions(const double* z, double* x, double* y) {
+	for (long i = 0; i < numComponents; i++)
+		x[i] = y[i] = numComponents > 1 ? z[i] : 1;
+}
+
+struct State {
+	double T, P, D, Dl, Dv, q;
+	double e, h, s, cv, cp, w;
+	double dPdD, dPdT;
+};
+
+static double psat(double T) {
+	return P0 * exp(L / R * (1 / fluid->Tnbp - 1 / T));
+}
+
+static double tsat(double P) {
+	return 1 / (1 / fluid->Tnbp - R * log(P / P0) / L);
+}
+
+static double dlsat(double T) {
+	double tau = T < fluid->Tc ? 1 - T / fluid->Tc : 0;
+	return fluid->Dc * (1 + 1.75 * cbrt(tau) + 0.75 * tau);
+}
+
+// the gas density at T and P, from P = DRT + D^2 (bRT - a); NaN where there isn't one
+static double gasD(double T, double P) {
+	double disc = R*R*T*T + 4 * (b*R*T - a) * P;
+	return disc < 0 ? NAN : 2 * P / (R*T + sqrt(disc));
+}
+
+static void gasState(double T, double D, State& st) {
+	double c = b*R*T - a;
+	st.T = T;
+	st.D = st.Dl = st.Dv = D;
+	st.P = D*R*T + D*D*c;
+	st.e = cv0 * (T - T0) - a*D;
+	st.h = cv0 * (T - T0) + R*T + D * (c - a);
+	st.s = cv0 * log(T / T0) - R * log(D * R * T0 / P0) - R*b*D;
+	st.dPdD = R*T + 2*D*c;
+	st.dPdT = D*R + D*D*b*R;
+	st.cv = cv0;
+	st.cp = cv0 + T * st.dPdT * st.dPdT / (D * D * st.dPdD);
+	st.w = sqrt(st.cp / st.cv * st.dPdD / (fluid->M * 1e-3));
+	st.q = T < fluid->Tc ? 998 : 999;
+}
+
+// the liquid at T and D, given the saturated vapor at T
+static void liquidState(double T, double D, const State& vapor, State& st) {
+	double Ps = psat(T), DLs = dlsat(T);
+	st.T = T;
+	st.D = st.Dl = st.Dv = D;
+	st.P = Ps + (D / DLs - 1) / kappaL;
+	// compressing the liquid lowers both its energy and its entropy a little, so every pair still has one answer
+	st.e = vapor.h - L - Ps / DLs - 0.1 * (st.P - Ps) / DLs;
+	st.h = st.e + st.P / D;
+	st.s = vapor.s - L / T - 0.2 * (st.P - Ps) / (DLs * T);
+	st.dPdD = 1 / (kappaL * DLs);
+	st.dPdT = Ps * L / (R*T*T);
+	st.cv = 1.2 * cp0;
+	st.cp = 1.4 * cp0;
+	st.w = sqrt(st.cp / st.cv * st.dPdD / (fluid->M * 1e-3));
+	st.q = -998;
+}
+
+// everything at T and D, the way TDFLSH works it out
+static bool state(double T, double D, State& st) {
+	if (!(T > 0) || !(D > 0))
+		return false;
+	if (T >= fluid->Tc) {
+		gasState(T, D, st);
+		return true;
+	}
+
+	double DVs = gasD(T, psat(T)), DLs = dlsat(T);
+	if (D <= DVs) {
+		gasState(T, D, st);
+		return true;
+	}
+
+	State vapor, liquid;
+	gasState(T, DVs, vapor);
+	liquidState(T, D > DLs ? D : DLs, vapor, liquid);
+	if (D >= DLs) {
+		st = liquid;
+		return true;
+	}
+
+	double q = (1/D - 1/DLs) / (1/DVs - 1/DLs);
+	st = liquid;
+	st.D = D;
+	st.Dl = DLs;
+	st.Dv = DVs;
+	st.q = q;
+	st.P = psat(T);
+	st.e = liquid.e + q * (vapor.e - liquid.e);
+	st.h = liquid.h + q * (vapor.h - liquid.h);
+	st.s = liquid.s + q * (vapor.s - liquid.s);
+	st.cv = liquid.cv + q * (vapor.cv - liquid.cv);
+	st.cp = st.w = -9.99999e6;  // what refprop reports where they don't mean anything
+	st.dPdD = 0;
+	st.dPdT = psat(T) * L / (R*T*T);
+	return true;
+}
+
+static bool saturated(double T, double q, State& st) {
+	if (T >= fluid->Tc || q < 0 || q > 1)
+		return false;
+	double DVs = gasD(T, psat(T)), DLs = dlsat(T);
+	if (!state(T, 1 / (1/DLs + q * (1/DVs - 1/DLs)), st))
+		return false;
+	st.q = q;
+	return true;
+}
+
+static bool tpState(double T, double P, State& st) {
+	if (T < fluid->Tc && P > psat(T))
+		return state(T, dlsat(T) * (1 + kappaL * (P - psat(T))), st);
+	double D = gasD(T, P);
+	return D > 0 && state(T, D, st);
+}
+
+enum Prop { pT, pP, pD, pE, pH, pS };
+
+static double value(const State& st, Prop prop) {
+	switch (prop) {
+		case pT: return st.T;
+		case pP: return st.P;
+		case pD: return st.D;
+		case pE: return st.e;
+		case pH: return st.h;
+		case pS: return st.s;
+	}
+	return NAN;
+}
+
+// solves f(x) = target on [lo, hi] by regula falsi (the illinois variant), falling back on bisection
+// wherever f isn't defined.  f returns false outside its domain
+template <typename F>
+static bool solve(F f, double lo, double hi, double target, double& x) {
+	double flo, fhi, fx;
+	if (!f(lo, flo) || !f(hi, fhi))
+		return false;
+	flo -= target;
+	fhi -= target;
+	if (flo == 0) { x = lo; return true; }
+	if (fhi == 0) { x = hi; return true; }
+	if ((flo > 0) == (fhi > 0))
+		return false;
+
+	int side = 0;
+	for (int i = 0; i < 200; i++) {
+		x = (lo * fhi - hi * flo) / (fhi - flo);
+		if (!(x > lo && x < hi))
+			x = (lo + hi) / 2;
+		if (!f(x, fx)) {
+			x = (lo + hi) / 2;
+			if (!f(x, fx))
+				return false;
+		}
+		fx -= target;
+		if (fx == 0 || hi - lo <= 1e-13 * fabs(x) || fabs(fx) <= 1e-12 * (fabs(target) + 1))
+			return true;
+
+		if ((fx > 0) == (flo > 0)) {
+			lo = x; flo = fx;
+			if (side == -1) fhi /= 2;
+			side = -1;
+		}
+		else {
+			hi = x; fhi = fx;
+			if (side == 1) flo /= 2;
+			side = 1;
+		}
+	}
+	return true;
+}
+
+// T held, solving for D
+static bool flashT(double T, Prop prop, double target, State& st) {
+	auto f = [T, prop](double D, double& v) { State s; if (!state(T, D, s)) return false; v = value(s, prop); return true; };
+	double D;
+
+	if (T < fluid->Tc) {
+		State liquid, vapor;
+		saturated(T, 0, liquid);
+		saturated(T, 1, vapor);
+		double vl = value(liquid, prop), vv = value(vapor, prop);
+		if ((target - vl) * (target - vv) <= 0 && vv != vl)
+			return saturated(T, (target - vl) / (vv - vl), st);
+		if ((target - vv) * (vv - vl) > 0)
+			return solve(f, Dmin, vapor.D, target, D) && state(T, D, st);
+		return solve(f, liquid.D, liquid.D * 2, target, D) && state(T, D, st);
+	}
+	return solve(f, Dmin, 10 * dlsat(0), target, D) && state(T, D, st);
+}
+
+// P held, solving along the isobar for T
+static bool flashP(double P, Prop prop, double target, State& st) {
+	auto f = [P, prop](double T, double& v) { State s; if (!tpState(T, P, s)) return false; v = value(s, prop); return true; };
+	double T;
+
+	if (P < fluid->Pc) {
+		double Ts = tsat(P);
+		State liquid, vapor;
+		saturated(Ts, 0, liquid);
+		saturated(Ts, 1, vapor);
+		double vl = value(liquid, prop), vv = value(vapor, prop);
+		if (prop == pD) {
+			vl = 1 / vl; vv = 1 / vv; target = 1 / target;
+			if ((target - vl) * (target - vv) <= 0)
+				return saturated(Ts, (target - vl) / (vv - vl), st);
+			target = 1 / target;
+		}
+		else if ((target - vl) * (target - vv) <= 0 && vv != vl)
+			return saturated(Ts, (target - vl) / (vv - vl), st);
+
+		if (solve(f, Ts * (1 + 1e-12), Tmax, target, T) || solve(f, fluid->Ttrp, Ts * (1 - 1e-12), target, T))
+			return tpState(T, P, st);
+		return false;
+	}
+	return solve(f, fluid->Ttrp, Tmax, target, T) && tpState(T, P, st);
+}
+
+// D held, solving for T
+static bool flashD(double D, Prop prop, double target, State& st) {
+	auto f = [D, prop](double T, double& v) { State s; if (!state(T, D, s)) return false; v = value(s, prop); return true; };
+	double T;
+	return solve(f, fluid->Ttrp, Tmax, target, T) && state(T, D, st);
+}
+
+// s held along with e or h: the outer search is over T, with each T's state on the isentrope
+static bool flashS(double s, Prop prop, double target, State& st) {
+	auto f = [s, prop](double T, double& v) {
+		State isentrope;
+		if (!flashT(T, pS, s, isentrope)) {
+			// no state at this T has that entropy: tell the search which way to go
+			State dilute;
+			state(T, Dmin, dilute);
+			v = s > dilute.s ? -HUGE_VAL : HUGE_VAL;
+			return true;
+		}
+		v = value(isentrope, prop);
+		return true;
+	};
+	double T;
+	return solve(f, fluid->Ttrp, Tmax, target, T) && flashT(T, pS, s, st);
+}
+
+static bool flashFailed(bool ok, long& ierr, char* herr, long length, const char* routine) {
+	spin(flashLatency);
+	if (!fluid) {
+		setError(ierr, herr, length, 101, "[SETUP error 101] no fluid loaded");
+		return true;
+	}
+	if (!ok) {
+		char msg[128];
+		strcpy(msg, "[");
+		strcat(msg, routine);
+		strcat(msg, " error 248] no solution for these inputs");
+		setError(ierr, herr, length, 248, msg);
+		return true;
+	}
+	setError(ierr, herr, length, 0, "");
+	return false;
+}
+
+#define loaded (fluid != NULL)
+
+// the table entry for a fluid file's name, without its directory or extension
+static const Fluid* findFluid(const char* file, long length) {
+	char name[256];
+	long n = 0;
+	for (long i = 0; i < length && file[i]; i++) {
+		if (file[i] == '/' || file[i] == '\\')
+			n = 0;
+		else if (n < 255)
+			name[n++] = (char)toupper((unsigned char)file[i]);
+	}
+	while (n > 0 && (name[n-1] == ' ' || name[n-1] == '\n' || name[n-1] == '\r'))
+		n--;
+	name[n] = '\0';
+	char* dot = strrchr(name, '.');
+	if (dot)
+		*dot = '\0';
+
+	for (size_t i = 0; i < sizeof(fluids) / sizeof(fluids[0]); i++)
+		if (strcmp(name, fluids[i].name) == 0)
+			return &fluids[i];
+	return NULL;
+}
+
+// loads nc components from hfiles, separated by '|' like refprop's
+static bool loadComponents(long nc, const char* hfiles, long lfiles) {
+	const char* env = getenv("REFPROP_STUB_LATENCY_NS");
+	flashLatency = env ? atol(env) : 0;
+	env = getenv("REFPROP_STUB_PROPERTY_LATENCY_NS");
+	propertyLatency = env ? atol(env) : 0;
+
+	fluid = NULL;
+	numComponents = 0;
+	if (nc < 1 || nc > ncmax)
+		return false;
+
+	long start = 0;
+	for (long c = 0; c < nc; c++) {
+		long end = start;
+		while (end < lfiles && hfiles[end] && hfiles[end] != '|')
+			end++;
+		if (!(components[c] = findFluid(hfiles + start, end - start)))
+			return false;
+		start = end + 1;
+	}
+
+	numComponents = nc;
+	if (nc == 1) {
+		fluid = components[0];
+		fitParameters();
+	}
+	else {
+		double z[ncmax];
+		for (long c = 0; c < nc; c++)
+			z[c] = 1.0 / nc;
+		fluid = NULL;
+		blend(z);
+	}
+	return true;
+}
+
+EXPORT void STDCALL SETUPdll(long& nc, char* hfiles, char* hfmix, char* hrf, long& ierr, char* herr, long lfiles, long lmix, long lrf, long lerr) {
+	if (!loadComponents(nc, hfiles, lfiles)) {
+		setError(ierr, herr, lerr, 101, "[SETUP error 101] error in opening file");
+		return;
+	}
+	setError(ierr, herr, lerr, 0, "");
+}
+SIGNATURE(SETUPdll);
+
+EXPORT void STDCALL WMOLdll(double* x, double& wm) {
+	wm = 0;
+	for (long i = 0; i < numComponents; i++)
+		wm += (numComponents > 1 ? x[i] : 1) * components[i]->M;
+}
+SIGNATURE(WMOLdll);
+
+EXPORT void STDCALL XMOLEdll(double* xkg, double* xmol, double& wmix) {
+	double moles = 0;
+	for (long i = 0; i < numComponents; i++)
+		moles += xkg[i] / components[i]->M;
+	for (long i = 0; i < numComponents; i++)
+		xmol[i] = xkg[i] / components[i]->M / moles;
+	wmix = 1 / moles;
+}
+SIGNATURE(XMOLEdll);
+
+EXPORT void STDCALL XMASSdll(double* xmol, double* xkg, double& wmix) {
+	WMOLdll(xmol, wmix);
+	for (long i = 0; i < numComponents; i++)
+		xkg[i] = xmol[i] * components[i]->M / wmix;
+}
+SIGNATURE(XMASSdll);
+
+// refprop's .MIX format: a description, the molar mass, Tc, Pc and Dc (which we work out ourselves), the
+// number of components, a fluid file per line and then a mole fraction per line
+EXPORT void STDCALL SETMIXdll(char* hmxnme, char* hfmix, char* hrf, long& ncc, char* hfiles, double* x, long& ierr, char* herr,
+		long lmxnme, long lmix, long lrf, long lfiles, long lerr) {
+	char path[256], line[256];
+	long n = 0;
+	while (n < lmxnme && n < 255 && hmxnme[n] && hmxnme[n] != ' ')
+		n++;
+	memcpy(path, hmxnme, n);
+	path[n] = '\0';
+
+	FILE* f = fopen(path, "r");
+	bool ok = f != NULL;
+	for (int i = 0; ok && i < 5; i++)
+		ok = fgets(line, sizeof(line), f) != NULL;
+	ok = ok && fgets(line, sizeof(line), f) && (ncc = atol(line)) >= 1 && ncc <= ncmax;
+
+	long used = 0;
+	for (long c = 0; ok && c < ncc; c++) {
+		ok = fgets(line, sizeof(line), f) != NULL;
+		line[strcspn(line, "\r\n")] = '\0';
+		long length = (long)strlen(line);
+		if (ok && used + length + 1 < lfiles) {
+			if (c > 0)
+				hfiles[used++] = '|';
+			memcpy(hfiles + used, line, length);
+			used += length;
+		}
+		else
+			ok = false;
+	}
+	for (long c = 0; ok && c < ncc; c++)
+		ok = fgets(line, sizeof(line), f) != NULL && (x[c] = atof(line)) >= 0;
+	if (f)
+		fclose(f);
+	if (ok)
+		hfiles[used] = '\0';
+
+	if (!ok || !loadComponents(ncc, hfiles, lfiles)) {
+		setError(ierr, herr, lerr, 101, "[SETMIX error 101] error in opening mixture file");
+		return;
+	}
+	setError(ierr, herr, lerr, 0, "");
+}
+SIGNATURE(SETMIXdll);
+
+EXPORT void STDCALL TPFLSHdll(double& T, double& P, double* z, double& D, double& Dl, double& Dv, double* x, double* y,
+		double& q, double& e, double& h, double& s, double& cv, double& cp, double& w, long& ierr, char* herr, long l) {
+	blend(z);
+	State st;
+	if (flashFailed(loaded && tpState(T, P, st), ierr, herr, l, "TPFLSH"))
+		return;
+	phaseCompositions(z, x, y);
+	D = st.D; Dl = st.Dl; Dv = st.Dv; q = st.q;
+	e = st.e; h = st.h; s = st.s; cv = st.cv; cp = st.cp; w = st.w;
+}
+SIGNATURE(TPFLSHdll);
+
+EXPORT void STDCALL TDFLSHdll(double& T, double& D, double* z, double& P, double& Dl, double& Dv, double* x, double* y,
+		double& q, double& e, double& h, double& s, double& cv, double& cp, double& w, long& ierr, char* herr, long l) {
+	blend(z);
+	State st;
+	if (flashFailed(loaded && state(T, D, st), ierr, herr, l, "TDFLSH"))
+		return;
+	phaseCompositions(z, x, y);
+	P = st.P; Dl = st.Dl; Dv = st.Dv; q = st.q;
+	e = st.e; h = st.h; s = st.s; cv = st.cv; cp = st.cp; w = st.w;
+}
+SIGNATURE(TDFLSHdll);
+
+EXPORT void STDCALL THFLSHdll(double& T, double& h, double* z, long& kr, double& P, double& D, double& Dl, double& Dv,
+		double* x, double* y, double& q, double& e, double& s, double& cv, double& cp, double& w, long& ierr, char* herr, long l) {
+	blend(z);
+	State st;
+	if (flashFailed(loaded && flashT(T, pH, h, st), ierr, herr, l, "THFLSH"))
+		return;
+	phaseCompositions(z, x, y);
+	P = st.P; D = st.D; Dl = st.Dl; Dv = st.Dv; q = st.q;
+	e = st.e; s = st.s; cv = st.cv; cp = st.cp; w = st.w;
+}
+SIGNATURE(THFLSHdll);
+
+EXPORT void STDCALL TSFLSHdll(double& T, double& s, double* z, long& kr, double& P, double& D, double& Dl, double& Dv,
+		double* x, double* y, double& q, double& e, double& h, double& cv, double& cp, double& w, long& ierr, char* herr, long l) {
+	blend(z);
+	State st;
+	if (flashFailed(loaded && flashT(T, pS, s, st), ierr, herr, l, "TSFLSH"))
+		return;
+	phaseCompositions(z, x, y);
+	P = st.P; D = st.D; Dl = st.Dl; Dv = st.Dv; q = st.q;
+	e = st.e; h = st.h; cv = st.cv; cp = st.cp; w = st.w;
+}
+SIGNATURE(TSFLSHdll);
+
+EXPORT void STDCALL TEFLSHdll(double& T, double& e, double* z, long& kr, double& P, double& D, double& Dl, double& Dv,
+		double* x, double* y, double& q, double& h, double& s, double& cv, double& cp, double& w, long& ierr, char* herr, long l) {
+	blend(z);
+	State st;
+	if (flashFailed(loaded && flashT(T, pE, e, st), ierr, herr, l, "TEFLSH"))
+		return;
+	phaseCompositions(z, x, y);
+	P = st.P; D = st.D; Dl = st.Dl; Dv = st.Dv; q = st.q;
+	h = st.h; s = st.s; cv = st.cv; cp = st.cp; w = st.w;
+}
+SIGNATURE(TEFLSHdll);
+
+EXPORT void STDCALL TQFLSHdll(double& T, double& q, double* z, long& kq, double& P, double& D, double& Dl, double& Dv,
+		double* x, double* y, double& e, double& h, double& s, double& cv, double& cp, double& w, long& ierr, char* herr, long l) {
+	blend(z);
+	State st;
+	if (flashFailed(loaded && saturated(T, q, st), ierr, herr, l, "TQFLSH"))
+		return;
+	phaseCompositions(z, x, y);
+	P = st.P; D = st.D; Dl = st.Dl; Dv = st.Dv;
+	e = st.e; h = st.h; s = st.s; cv = st.cv; cp = st.cp; w = st.w;
+}
+SIGNATURE(TQFLSHdll);
+
+EXPORT void STDCALL PDFLSHdll(double& P, double& D, double* z, double& T, double& Dl, double& Dv, double* x, double* y,
+		double& q, double& e, double& h, double& s, double& cv, double& cp, double& w, long& ierr, char* herr, long l) {
+	blend(z);
+	State st;
+	if (flashFailed(loaded && flashP(P, pD, D, st), ierr, herr, l, "PDFLSH"))
+		return;
+	phaseCompositions(z, x, y);
+	T = st.T; Dl = st.Dl; Dv = st.Dv; q = st.q;
+	e = st.e; h = st.h; s = st.s; cv = st.cv; cp = st.cp; w = st.w;
+}
+SIGNATURE(PDFLSHdll);
+
+EXPORT void STDCALL PHFLSHdll(double& P, double& h, double* z, double& T, double& D, double& Dl, double& Dv, double* x, double* y,
+		double& q, double& e, double& s, double& cv, double& cp, double& w, long& ierr, char* herr, long l) {
+	blend(z);
+	State st;
+	if (flashFailed(loaded && flashP(P, pH, h, st), ierr, herr, l, "PHFLSH"))
+		return;
+	phaseCompositions(z, x, y);
+	T = st.T; D = st.D; Dl = st.Dl; Dv = st.Dv; q = st.q;
+	e = st.e; s = st.s; cv = st.cv; cp = st.cp; w = st.w;
+}
+SIGNATURE(PHFLSHdll);
+
+EXPORT void STDCALL PSFLSHdll(double& P, double& s, double* z, double& T, double& D, double& Dl, double& Dv, double* x, double* y,
+		double& q, double& e, double& h, double& cv, double& cp, double& w, long& ierr, char* herr, long l) {
+	blend(z);
+	State st;
+	if (flashFailed(loaded && flashP(P, pS, s, st), ierr, herr, l, "PSFLSH"))
+		return;
+	phaseCompositions(z, x, y);
+	T = st.T; D = st.D; Dl = st.Dl; Dv = st.Dv; q = st.q;
+	e = st.e; h = st.h; cv = st.cv; cp = st.cp; w = st.w;
+}
+SIGNATURE(PSFLSHdll);
+
+EXPORT void STDCALL PEFLSHdll(double& P, double& e, double* z, double& T, double& D, double& Dl, double& Dv, double* x, double* y,
+		double& q, double& h, double& s, double& cv, double& cp, double& w, long& ierr, char* herr, long l) {
+	blend(z);
+	State st;
+	if (flashFailed(loaded && flashP(P, pE, e, st), ierr, herr, l, "PEFLSH"))
+		return;
+	phaseCompositions(z, x, y);
+	T = st.T; D = st.D; Dl = st.Dl; Dv = st.Dv; q = st.q;
+	h = st.h; s = st.s; cv = st.cv; cp = st.cp; w = st.w;
+}
+SIGNATURE(PEFLSHdll);
+
+EXPORT void STDCALL PQFLSHdll(double& P, double& q, double* z, long& kq, double& T, double& D, double& Dl, double& Dv,
+		double* x, double* y, double& e, double& h, double& s, double& cv, double& cp, double& w, long& ierr, char* herr, long l) {
+	blend(z);
+	State st;
+	if (flashFailed(loaded && P > 0 && P < fluid->Pc && saturated(tsat(P), q, st), ierr, herr, l, "PQFLSH"))
+		return;
+	phaseCompositions(z, x, y);
+	T = st.T; D = st.D; Dl = st.Dl; Dv = st.Dv;
+	e = st.e; h = st.h; s = st.s; cv = st.cv; cp = st.cp; w = st.w;
+}
+SIGNATURE(PQFLSHdll);
+
+EXPORT void STDCALL DHFLSHdll(double& D, double& h, double* z, double& T, double& P, double& Dl, double& Dv, double* x, double* y,
+		double& q, double& e, double& s, double& cv, double& cp, double& w, long& ierr, char* herr, long l) {
+	blend(z);
+	State st;
+	if (flashFailed(loaded && flashD(D, pH, h, st), ierr, herr, l, "DHFLSH"))
+		return;
+	phaseCompositions(z, x, y);
+	T = st.T; P = st.P; Dl = st.Dl; Dv = st.Dv; q = st.q;
+	e = st.e; s = st.s; cv = st.cv; cp = st.cp; w = st.w;
+}
+SIGNATURE(DHFLSHdll);
+
+EXPORT void STDCALL DSFLSHdll(double& D, double& s, double* z, double& T, double& P, double& Dl, double& Dv, double* x, double* y,
+		double& q, double& e, double& h, double& cv, double& cp, double& w, long& ierr, char* herr, long l) {
+	blend(z);
+	State st;
+	if (flashFailed(loaded && flashD(D, pS, s, st), ierr, herr, l, "DSFLSH"))
+		return;
+	phaseCompositions(z, x, y);
+	T = st.T; P = st.P; Dl = st.Dl; Dv = st.Dv; q = st.q;
+	e = st.e; h = st.h; cv = st.cv; cp = st.cp; w = st.w;
+}
+SIGNATURE(DSFLSHdll);
+
+EXPORT void STDCALL DEFLSHdll(double& D, double& e, double* z, double& T, double& P, double& Dl, double& Dv, double* x, double* y,
+		double& q, double& h, double& s, double& cv, double& cp, double& w, long& ierr, char* herr, long l) {
+	blend(z);
+	State st;
+	if (flashFailed(loaded && flashD(D, pE, e, st), ierr, herr, l, "DEFLSH"))
+		return;
+	phaseCompositions(z, x, y);
+	T = st.T; P = st.P; Dl = st.Dl; Dv = st.Dv; q = st.q;
+	h = st.h; s = st.s; cv = st.cv; cp = st.cp; w = st.w;
+}
+SIGNATURE(DEFLSHdll);
+
+EXPORT void STDCALL HSFLSHdll(double& h, double& s, double* z, double& T, double& P, double& D, double& Dl, double& Dv,
+		double* x, double* y, double& q, double& e, double& cv, double& cp, double& w, long& ierr, char* herr, long l) {
+	blend(z);
+	State st;
+	if (flashFailed(loaded && flashS(s, pH, h, st), ierr, herr, l, "HSFLSH"))
+		return;
+	phaseCompositions(z, x, y);
+	T = st.T; P = st.P; D = st.D; Dl = st.Dl; Dv = st.Dv; q = st.q;
+	e = st.e; cv = st.cv; cp = st.cp; w = st.w;
+}
+SIGNATURE(HSFLSHdll);
+
+EXPORT void STDCALL ESFLSHdll(double& e, double& s, double* z, double& T, double& P, double& D, double& Dl, double& Dv,
+		double* x, double* y, double& q, double& h, double& cv, double& cp, double& w, long& ierr, char* herr, long l) {
+	blend(z);
+	State st;
+	if (flashFailed(loaded && flashS(s, pE, e, st), ierr, herr, l, "ESFLSH"))
+		return;
+	phaseCompositions(z, x, y);
+	T = st.T; P = st.P; D = st.D; Dl = st.Dl; Dv = st.Dv; q = st.q;
+	h = st.h; cv = st.cv; cp = st.cp; w = st.w;
+}
+SIGNATURE(ESFLSHdll);
+
+// the single-phase routines start from the caller's guess.  a search that stays within a couple of
+// percent of it stands in for a solver that converges in a few iterations from a good starting point,
+// and only costs a quarter of a flash's latency
+template <typename F>
+static bool solveNear(F f, double lo, double hi, double guess, double target, double& x) {
+	if (guess > lo && guess < hi && solve(f, std::max(lo, guess * 0.98), std::min(hi, guess * 1.02), target, x)) {
+		spin(flashLatency / 4);
+		return true;
+	}
+	spin(flashLatency);
+	return solve(f, lo, hi, target, x);
+}
+
+// the range of T along an isobar that's in phase kph (1 liquid, 2 vapor)
+static void isobarRange(double P, long kph, double& lo, double& hi) {
+	lo = fluid->Ttrp;
+	hi = Tmax;
+	if (P < fluid->Pc) {
+		if (kph == 1)
+			hi = tsat(P) * (1 - 1e-12);
+		else
+			lo = tsat(P) * (1 + 1e-12);
+	}
+}
+
+static void singlePhaseFailed(bool ok, long& ierr, char* herr, long length, const char* routine) {
+	if (!ok) {
+		char msg[128];
+		strcpy(msg, "[");
+		strcat(msg, routine);
+		strcat(msg, " error 248] no solution in that phase");
+		setError(ierr, herr, length, 248, msg);
+	}
+	else
+		setError(ierr, herr, length, 0, "");
+}
+
+static bool isobarFlash(double P, Prop prop, double target, long kph, double& T, double& D) {
+	if (!loaded || !(P > 0) || (kph != 1 && kph != 2))
+		return false;
+	auto f = [P, prop](double T, double& v) { State s; if (!tpState(T, P, s)) return false; v = value(s, prop); return true; };
+	double lo, hi, t;
+	isobarRange(P, kph, lo, hi);
+	State st;
+	if (!solveNear(f, lo, hi, T, target, t) || !tpState(t, P, st))
+		return false;
+	T = t;
+	D = st.D;
+	return true;
+}
+
+EXPORT void STDCALL PHFL1dll(double& P, double& h, double* z, long& kph, double& T, double& D, long& ierr, char* herr, long l) {
+	blend(z);
+	singlePhaseFailed(isobarFlash(P, pH, h, kph, T, D), ierr, herr, l, "PHFL1");
+}
+SIGNATURE(PHFL1dll);
+
+EXPORT void STDCALL PSFL1dll(double& P, double& s, double* z, long& kph, double& T, double& D, long& ierr, char* herr, long l) {
+	blend(z);
+	singlePhaseFailed(isobarFlash(P, pS, s, kph, T, D), ierr, herr, l, "PSFL1");
+}
+SIGNATURE(PSFL1dll);
+
+EXPORT void STDCALL PDFL1dll(double& P, double& D, double* z, double& T, long& ierr, char* herr, long l) {
+	blend(z);
+	double d = D, t = 0;
+	auto f = [d](double T, double& v) { State s; if (!state(T, d, s)) return false; v = s.P; return true; };
+	bool ok = loaded && solveNear(f, fluid->Ttrp, Tmax, T, P, t);
+	if (ok)
+		T = t;
+	singlePhaseFailed(ok, ierr, herr, l, "PDFL1");
+}
+SIGNATURE(PDFL1dll);
+
+// kguess only decides whether the density we're handed is worth anything; ours is closed form anyway
+EXPORT void STDCALL TPRHOdll(double& T, double& P, double* z, long& kph, long& kguess, double& D, long& ierr, char* herr, long l) {
+	blend(z);
+	spin(kguess == 1 ? flashLatency / 4 : flashLatency);
+	bool ok = loaded && T > 0 && P > 0 && (kph == 1 || kph == 2);
+	if (ok && kph == 1 && T < fluid->Tc)
+		D = dlsat(T) * (1 + kappaL * (P - psat(T)));
+	else if (ok)
+		ok = (D = gasD(T, P)) > 0;
+	singlePhaseFailed(ok, ierr, herr, l, "TPRHO");
+}
+SIGNATURE(TPRHOdll);
+
+// the property routines all work at a known T and D
+static bool propertyState(double T, double D, State& st) {
+	spin(propertyLatency);
+	return loaded && state(T, D, st);
+}
+
+EXPORT void STDCALL TRNPRPdll(double& T, double& D, double* x, double& eta, double& tcx, long& ierr, char* herr, long l) {
+	blend(x);
+	State st;
+	if (!propertyState(T, D, st)) {
+		setError(ierr, herr, l, 1, "[TRNPRP error 1] temperature or density out of range");
+		return;
+	}
+	// dilute gas viscosity growing with density, and eucken's conductivity
+	eta = 0.15 * sqrt(fluid->M * T) * (1 + D * D / (fluid->Dc * fluid->Dc));
+	tcx = eta * 1e-6 * (st.cv + 2.25 * R) / (fluid->M * 1e-3);
+	setError(ierr, herr, l, 0, "");
+}
+SIGNATURE(TRNPRPdll);
+
+EXPORT void STDCALL SURTENdll(double& T, double& Dl, double& Dv, double* xl, double* xv, double& sigma, long& ierr, char* herr, long l) {
+	blend(xl);
+	spin(propertyLatency);
+	sigma = loaded && T < fluid->Tc ? 0.06 * pow(1 - T / fluid->Tc, 1.26) : 0;
+	setError(ierr, herr, l, 0, "");
+}
+SIGNATURE(SURTENdll);
+
+EXPORT void STDCALL CVCPdll(double& T, double& D, double* x, double& cv, double& cp) {
+	blend(x);
+	State st;
+	if (propertyState(T, D, st)) {
+		cv = st.cv;
+		cp = st.cp;
+	}
+}
+SIGNATURE(CVCPdll);
+
+EXPORT void STDCALL ENTHALdll(double& T, double& D, double* x, double& h) {
+	blend(x);
+	State st;
+	h = propertyState(T, D, st) ? st.h : NAN;
+}
+SIGNATURE(ENTHALdll);
+
+EXPORT void STDCALL ENTROdll(double& T, double& D, double* x, double& s) {
+	blend(x);
+	State st;
+	s = propertyState(T, D, st) ? st.s : NAN;
+}
+SIGNATURE(ENTROdll);
+
+EXPORT void STDCALL DPDDdll(double& T, double& D, double* x, double& dPdD) {
+	blend(x);
+	State st;
+	dPdD = propertyState(T, D, st) ? st.dPdD : NAN;
+}
+SIGNATURE(DPDDdll);
+
+EXPORT void STDCALL DPDTdll(double& T, double& D, double* x, double& dPdT) {
+	blend(x);
+	State st;
+	dPdT = propertyState(T, D, st) ? st.dPdT : NAN;
+}
+SIGNATURE(DPDTdll);
+
+EXPORT void STDCALL DDDTdll(double& T, double& D, double* x, double& dDdT) {
+	blend(x);
+	State st;
+	dDdT = propertyState(T, D, st) && st.dPdD != 0 ? -st.dPdT / st.dPdD : NAN;
+}
+SIGNATURE(DDDTdll);
+
+EXPORT void STDCALL THERMdll(double& T, double& D, double* x, double& P, double& e, double& h, double& s, double& cv, double& cp,
+		double& w, double& hjt) {
+	blend(x);
+	State st;
+	if (!propertyState(T, D, st))
+		return;
+	P = st.P; e = st.e; h = st.h; s = st.s; cv = st.cv; cp = st.cp; w = st.w;
+	hjt = (T * st.dPdT / (D * st.dPdD) - 1) / (D * cp);
+}
+SIGNATURE(THERMdll);
+
+// second derivatives of P by central differences; it's a stand-in, nobody's fitting to these
+EXPORT void STDCALL THERM2dll(double& T, double& D, double* x, double& P, double& e, double& h, double& s, double& cv, double& cp,
+		double& w, double* Z, double& hjt, double& A, double& G, double& xkappa, double& beta, double& dPdD, double& d2PdD2,
+		double& dPdT, double& dDdT, double& dDdP, double& d2PdT2, double& d2PdTdD, double& spare3, double& spare4) {
+	blend(x);
+	State st, dp, dm, tp, tm;
+	if (!propertyState(T, D, st))
+		return;
+	double dD = D * 1e-6, dT = T * 1e-6;
+	state(T, D + dD, dp); state(T, D - dD, dm);
+	state(T + dT, D, tp); state(T - dT, D, tm);
+
+	P = st.P; e = st.e; h = st.h; s = st.s; cv = st.cv; cp = st.cp; w = st.w;
+	Z[0] = P / (D * R * T);
+	A = e - T * s;
+	G = h - T * s;
+	dPdD = st.dPdD;
+	dPdT = st.dPdT;
+	dDdT = dPdD != 0 ? -dPdT / dPdD : NAN;
+	dDdP = dPdD != 0 ? 1 / dPdD : NAN;
+	d2PdD2 = (dp.dPdD - dm.dPdD) / (2 * dD);
+	d2PdT2 = (tp.dPdT - tm.dPdT) / (2 * dT);
+	d2PdTdD = (dp.dPdT - dm.dPdT) / (2 * dD);
+	xkappa = 1 / (D * dPdD);
+	beta = -dDdT / D;
+	hjt = (T * beta / D - 1 / D) / cp;
+	spare3 = spare4 = 0;
+}
+SIGNATURE(THERM2dll);
+
+EXPORT void STDCALL THERM3dll(double& T, double& D, double* x, double& xkappa, double& beta, double& xisenk, double& xkt,
+		double& betas, double& bs, double& xkkt, double& thrott, double& pint, double& spht) {
+	blend(x);
+	State st;
+	if (!propertyState(T, D, st))
+		return;
+	xkappa = 1 / (D * st.dPdD);
+	beta = st.dPdT / (D * st.dPdD);
+	xisenk = D / st.P * st.cp / st.cv * st.dPdD;
+	xkt = D / st.P * st.dPdD;
+	betas = xkappa * st.cv / st.cp;
+	bs = 0;
+	xkkt = 0;
+	thrott = 0;
+	pint = T * st.dPdT - st.P;
+	spht = 0;
+}
+SIGNATURE(THERM3dll);
+
+EXPORT void STDCALL CRITPdll(double* x, double& Tc, double& Pc, double& Dc, long& ierr, char* herr, long l) {
+	blend(x);
+	if (!loaded) {
+		setError(ierr, herr, l, 101, "[SETUP error 101] no fluid loaded");
+		return;
+	}
+	Tc = fluid->Tc;
+	Pc = fluid->Pc;
+	Dc = fluid->Dc;
+	setError(ierr, herr, l, 0, "");
+}
+SIGNATURE(CRITPdll);
+
+EXPORT void STDCALL INFOdll(long& icomp, double& wmm, double& ttrp, double& tnbpt, double& tc, double& pc, double& dc,
+		double& zc, double& acf, double& dip, double& rgas) {
+	if (icomp < 1 || icomp > numComponents)
+		return;
+	const Fluid* c = components[icomp - 1];
+	wmm = c->M; ttrp = c->Ttrp; tnbpt = c->Tnbp;
+	tc = c->Tc; pc = c->Pc; dc = c->Dc;
+	zc = pc / (R * tc * dc);
+	acf = c->acf;
+	dip = 0;
+	rgas = R;
+}
+SIGNATURE(INFOdll);
+
+// the liquid never gets much denser than 3.5 Dc, so 4 Dc leaves it some room to compress
+EXPORT void STDCALL LIMITSdll(char* htyp, double* x, double& tmin, double& tmax, double& Dmax, double& pmax, long l) {
+	blend(x);
+	if (!loaded)
+		return;
+	tmin = fluid->Ttrp;
+	tmax = Tmax;
+	Dmax = 4 * fluid->Dc;
+	pmax = 100 * fluid->Pc;
+}
+SIGNATURE(LIMITSdll);
+
+EXPORT void STDCALL SATTdll(double& T, double* x, long& kph, double& P, double& Dl, double& Dv, double* xl, double* xv,
+		long& ierr, char* herr, long l) {
+	blend(x);
+	State liquid, vapor;
+	spin(propertyLatency);
+	if (!loaded || !saturated(T, 0, liquid) || !saturated(T, 1, vapor)) {
+		setError(ierr, herr, l, 121, "[SATT error 121] temperature out of range");
+		return;
+	}
+	P = liquid.P; Dl = liquid.D; Dv = vapor.D;
+	phaseCompositions(x, xl, xv);
+	setError(ierr, herr, l, 0, "");
+}
+SIGNATURE(SATTdll);
+
+EXPORT void STDCALL SATPdll(double& P, double* x, long& kph, double& T, double& Dl, double& Dv, double* xl, double* xv,
+		long& ierr, char* herr, long l) {
+	blend(x);
+	State liquid, vapor;
+	spin(propertyLatency);
+	if (!loaded || !(P > 0 && P < fluid->Pc) || !saturated(tsat(P), 0, liquid) || !saturated(tsat(P), 1, vapor)) {
+		setError(ierr, herr, l, 141, "[SATP error 141] pressure out of range");
+		return;
+	}
+	T = liquid.T; Dl = liquid.D; Dv = vapor.D;
+	phaseCompositions(x, xl, xv);
+	setError(ierr, herr, l, 0, "");
+}
+SIGNATURE(SATPdll);
@@ -1,8 +1,22 @@
 {
+  "variables": {
+    # REFPROP_BENCH=1 node-gyp rebuild adds the counters bench/index.js reads, and builds the stand-in library
+    "bench%": "<!(node -p \"process.env.REFPROP_BENCH || '0'\")"
+  },
   "targets": [
     {
       "target_name": "node-refprop",
-      "sources": [ "src/node-refprop.cpp", "src/thermostate.cpp" ]
+      "sources": [ "src/node-refprop.cpp", "src/thermostate.cpp", "src/executor.cpp", "src/engine-pool.cpp", "src/flash-cache.cpp", "src/property-table.cpp", "src/fluids.cpp", "src/diagram.cpp", "src/stats.cpp", "src/state-graph.cpp", "src/grid-file.cpp", "src/mapped-file.cpp", "src/disk-cache.cpp", "src/inverse-solver.cpp", "src/flash-plan.cpp", "src/broker.cpp", "src/flash-server.cpp" ],
+      "conditions": [
+        [ "OS!='win'", { "libraries": [ "-ldl" ] } ],
+        [ "bench==1", {
+          "defines": [ "REFPROP_BENCH" ],
+          "sources": [ "src/bench.cpp" ],
+          "conditions": [
+            [ "OS!='win'", { "ldflags": [ "-Wl,-Bsymbolic" ] } ]
+          ]
+        } ]
+      ]
     },
 	{
       "target_name": "action_after_build",
@@ -15,5 +29,17 @@
         }
       ]
     }
+  ],
+  "conditions": [
+    [ "bench==1", {
+      "targets": [
+        {
+          "target_name": "refprop-stub",
+          "type": "shared_library",
+          "product_dir": "<(PRODUCT_DIR)",
+          "sources": [ "bench/refprop-stub.cpp" ]
+        }
+      ]
+    } ]
   ]
-}
\ No newline at end of file
+}
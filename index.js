@@ -0,0 +1,226 @@
+// the native module, plus FlashStream for pushing large sets of rows through it
+var stream = require('stream');
+var util = require('util');
+var StringDecoder = require('string_decoder').StringDecoder;
+
+var refprop = require('./node-refprop.node');
+
+// the input pairs statePointBatch can flash, either way round
+var pairs = ['TP', 'TD', 'TH', 'TS', 'TE', 'TQ', 'PD', 'PH', 'PS', 'PE', 'PQ', 'DH', 'DS', 'DE', 'HS', 'ES'];
+
+// a Transform that takes rows and gives them back with their states filled in.  rows go to the native
+// side a chunk at a time through statePointBatchAsync, so the flashes run off the event loop and there's
+// one crossing per chunk rather than one per row.  options:
+//  - inputs: the input pair, like statePointBatch's ('PH', 'TP', ...)
+//  - outputs: the properties to add to each row, ['T', 'P', 'D', 'H', 'S', 'Q'] if not given
+//  - fluid: a fluid name or a handle from refprop.fluid(); the fluid setFluid picked if not given
+//  - chunkRows: rows per native call, 4096 by default
+//  - columns: the CSV column names, when the text has no header line
+//  - composition, basis, phase, checkPhase and trajectory go along to statePointBatchAsync
+// rows can be objects keyed by property name, [a, b] arrays in the order of inputs, or text: NDJSON or
+// CSV lines, split up here.  they come out in order, as objects with the outputs added.  a row that
+// can't be parsed or flashed gets an error property (the message) instead and the stream carries on.
+// no more than two chunks are in flight at once; past that, writes wait
+function FlashStream(options) {
+	if (!(this instanceof FlashStream))
+		return new FlashStream(options);
+	options = options || {};
+	stream.Transform.call(this, {objectMode: true});
+
+	// a bad pair would otherwise only turn up as every row failing
+	if (typeof options.inputs != 'string' || options.inputs.length != 2 ||
+			(pairs.indexOf(options.inputs) < 0 && pairs.indexOf(options.inputs[1] + options.inputs[0]) < 0))
+		throw new TypeError('FlashStream needs an input pair statePointBatch can flash, like PH or TP');
+	this.inputs = options.inputs;
+	this.outputs = options.outputs || ['T', 'P', 'D', 'H', 'S', 'Q'];
+	this.target = typeof options.fluid == 'string' ? refprop.fluid(options.fluid) : options.fluid || refprop;
+	this.chunkRows = options.chunkRows || 4096;
+	this.columns = options.columns || null;
+
+	this.batchOptions = {};
+	var self = this;
+	['composition', 'basis', 'phase', 'checkPhase', 'trajectory'].forEach(function(key) {
+		if (options[key] !== undefined)
+			self.batchOptions[key] = options[key];
+	});
+
+	this.decoder = new StringDecoder('utf8');
+	this.partial = '';  // text after the last newline
+	this.chunk = null;
+	this.ready = [];  // full chunks waiting for room in flight, in order
+	this.inFlight = 0;
+	this.waiting = null;  // the write callback, held back until ready has all gone and there's room in flight
+	this.flushing = null;  // the flush callback, likewise
+	this.tail = Promise.resolve();
+}
+util.inherits(FlashStream, stream.Transform);
+
+FlashStream.maxInFlight = 2;
+
+FlashStream.prototype._transform = function(data, encoding, done) {
+	if (typeof data == 'string' || Buffer.isBuffer(data)) {
+		var lines = (this.partial + (typeof data == 'string' ? data : this.decoder.write(data))).split('\n');
+		this.partial = lines.pop();
+		for (var i = 0; i < lines.length; i++)
+			this.line(lines[i]);
+	}
+	else if (Array.isArray(data)) {
+		var row = {};
+		row[this.inputs[0]] = data[0];
+		row[this.inputs[1]] = data[1];
+		this.add(row);
+	}
+	else
+		this.add(data);
+
+	// one write of text can fill any number of chunks, so they queue up in ready rather than all going at once
+	this.waiting = done;
+	this.pump();
+};
+
+FlashStream.prototype._flush = function(done) {
+	this.line(this.partial + this.decoder.end());
+	this.partial = '';
+	if (this.chunk) {
+		this.ready.push(this.chunk);
+		this.chunk = null;
+	}
+	this.flushing = done;
+	this.pump();
+};
+
+// sends ready chunks off while there's room in flight, then lets a held-back write or flush carry on once
+// they've all gone.  runs again every time a chunk comes back
+FlashStream.prototype.pump = function() {
+	while (this.ready.length && this.inFlight < FlashStream.maxInFlight)
+		this.dispatch(this.ready.shift());
+	if (this.ready.length)
+		return;
+
+	if (this.waiting && this.inFlight < FlashStream.maxInFlight) {
+		var waiting = this.waiting;
+		this.waiting = null;
+		waiting();
+	}
+	if (this.flushing) {
+		var flushing = this.flushing, self = this;
+		this.flushing = null;
+		this.tail.then(function() {
+			flushing();
+		}, function(err) {
+			self.emit('error', err);
+		});
+	}
+};
+
+// one line of NDJSON or CSV.  the first CSV line is the header, unless columns were given
+FlashStream.prototype.line = function(text) {
+	text = text.trim();
+	if (!text)
+		return;
+
+	if (text[0] == '{') {
+		try {
+			this.add(JSON.parse(text));
+		}
+		catch (err) {
+			this.add({error: err.message, line: text});
+		}
+		return;
+	}
+
+	var fields = text.split(',');
+	if (!this.columns) {
+		this.columns = fields.map(function(field) {
+			return field.trim();
+		});
+		return;
+	}
+
+	var row = {};
+	for (var i = 0; i < this.columns.length; i++)
+		row[this.columns[i]] = fields[i] === undefined ? undefined : fields[i].trim();
+	this.add(row);
+};
+
+FlashStream.prototype.add = function(row) {
+	if (!this.chunk)
+		this.chunk = {rows: [], slots: [], n: 0, a: new Float64Array(this.chunkRows), b: new Float64Array(this.chunkRows)};
+	var chunk = this.chunk;
+
+	var a = +row[this.inputs[0]], b = +row[this.inputs[1]];
+	if (row.error === undefined && (isNaN(a) || isNaN(b)))
+		row.error = 'Row needs numbers for ' + this.inputs[0] + ' and ' + this.inputs[1];
+
+	// rows that are already in error keep their place in the output, but don't get flashed
+	chunk.rows.push(row);
+	if (row.error !== undefined)
+		chunk.slots.push(-1);
+	else {
+		chunk.slots.push(chunk.n);
+		chunk.a[chunk.n] = a;
+		chunk.b[chunk.n] = b;
+		chunk.n++;
+	}
+
+	if (chunk.rows.length >= this.chunkRows) {
+		this.ready.push(chunk);
+		this.chunk = null;
+	}
+};
+
+FlashStream.prototype.dispatch = function(chunk) {
+	var self = this;
+	this.inFlight++;
+
+	var n = chunk.n, out = {}, errors = [];
+	this.outputs.forEach(function(key) {
+		out[key] = new Float64Array(n);
+	});
+	var options = {errors: errors};
+	for (var key in this.batchOptions)
+		options[key] = this.batchOptions[key];
+
+	// chunks flash in the order they're queued anyway, but results wait their turn in tail regardless.
+	// anything the call throws (a bad composition, say) fails the chunk like a rejection would
+	var flashed;
+	try {
+		flashed = n == 0 ? Promise.resolve() : this.target.statePointBatchAsync(this.inputs, chunk.a.subarray(0, n), chunk.b.subarray(0, n), out, options);
+	}
+	catch (err) {
+		flashed = Promise.reject(err);
+	}
+	flashed = flashed.then(function() {
+		return null;
+	}, function(err) {
+		return err;  // the whole chunk failed, most likely on the fluid
+	});
+
+	this.tail = this.tail.then(function() {
+		return flashed;
+	}).then(function(err) {
+		for (var i = 0; i < chunk.rows.length; i++) {
+			var row = chunk.rows[i], slot = chunk.slots[i];
+			if (slot >= 0) {
+				if (err)
+					row.error = err.message;
+				else if (errors[slot] !== undefined)
+					row.error = errors[slot];
+				else
+					for (var j = 0; j < self.outputs.length; j++)
+						row[self.outputs[j]] = out[self.outputs[j]][slot];
+			}
+			self.push(row);
+		}
+
+		self.inFlight--;
+		self.pump();
+	});
+};
+
+refprop.FlashStream = FlashStream;
+refprop.createFlashStream = function(options) {
+	return new FlashStream(options);
+};
+
+module.exports = refprop;
@@ -0,0 +1,77 @@
+#include <stdlib.h>
+#include <new>
+
+#include "bench.h"
+
+using namespace v8;
+using namespace node;
+
+std::atomic<unsigned long long> BenchStats::libraryCalls(0);
+std::atomic<unsigned long long> BenchStats::libraryNs(0);
+std::atomic<unsigned long long> BenchStats::allocations(0);
+std::atomic<unsigned long long> BenchStats::allocatedBytes(0);
+
+void BenchStats::reset() {
+	libraryCalls = 0;
+	libraryNs = 0;
+	allocations = 0;
+	allocatedBytes = 0;
+}
+
+// counting replacements for the global allocator.  they only see the addon's own allocations (binding.gyp
+// links bench builds with -Bsymbolic so ours win over the ones node exports); v8's heap isn't in here
+void* operator new(size_t size) {
+	BenchStats::allocations++;
+	BenchStats::allocatedBytes += size;
+	void* p = malloc(size ? size : 1);
+	if (!p)
+		abort();  // node-gyp builds without exceptions, so there's no bad_alloc to throw
+	return p;
+}
+
+void* operator new[](size_t size) {
+	return operator new(size);
+}
+
+void* operator new(size_t size, const std::nothrow_t&) noexcept {
+	BenchStats::allocations++;
+	BenchStats::allocatedBytes += size;
+	return malloc(size ? size : 1);
+}
+
+void* operator new[](size_t size, const std::nothrow_t& tag) noexcept {
+	return operator new(size, tag);
+}
+
+void operator delete(void* p) noexcept {
+	free(p);
+}
+
+void operator delete[](void* p) noexcept {
+	free(p);
+}
+
+void operator delete(void* p, size_t) noexcept {
+	free(p);
+}
+
+void operator delete[](void* p, size_t) noexcept {
+	free(p);
+}
+
+void getBenchStats(const FunctionCallbackInfo<Value>& args) {
+	Isolate* iso = args.GetIsolate();
+	// counters since the last resetBenchStats, for bench/index.js
+
+	Local<Object> obj = Object::New(iso);
+	obj->Set(String::NewFromUtf8(iso, "libraryCalls"), Number::New(iso, (double)BenchStats::libraryCalls));
+	obj->Set(String::NewFromUtf8(iso, "libraryNs"), Number::New(iso, (double)BenchStats::libraryNs));
+	obj->Set(String::NewFromUtf8(iso, "allocations"), Number::New(iso, (double)BenchStats::allocations));
+	obj->Set(String::NewFromUtf8(iso, "allocatedBytes"), Number::New(iso, (double)BenchStats::allocatedBytes));
+	args.GetReturnValue().Set(obj);
+}
+
+void resetBenchStats(const FunctionCallbackInfo<Value>& args) {
+	BenchStats::reset();
+	args.GetReturnValue().Set(Undefined(args.GetIsolate()));
+}
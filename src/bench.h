@@ -0,0 +1,36 @@
+#ifndef NODE_REFPROP_BENCH_H
+#define NODE_REFPROP_BENCH_H
+
+#include <node.h>
+#include <atomic>
+#include <chrono>
+
+// instrumentation for benchmark builds (REFPROP_BENCH=1 node-gyp rebuild): how long we spend inside the
+// library, and how many allocations we make on the way.  normal builds don't compile any of this
+class BenchStats {
+public:
+	static std::atomic<unsigned long long> libraryCalls;
+	static std::atomic<unsigned long long> libraryNs;    // summed over every engine's thread
+	static std::atomic<unsigned long long> allocations;  // operator new, from anywhere in the addon
+	static std::atomic<unsigned long long> allocatedBytes;
+
+	static void reset();
+};
+
+// times one library call
+class BenchTimer {
+public:
+	BenchTimer() : start(std::chrono::steady_clock::now()) {}
+	~BenchTimer() {
+		BenchStats::libraryNs += (unsigned long long)std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - this->start).count();
+		BenchStats::libraryCalls++;
+	}
+
+private:
+	std::chrono::steady_clock::time_point start;
+};
+
+void getBenchStats(const v8::FunctionCallbackInfo<v8::Value>& args);
+void resetBenchStats(const v8::FunctionCallbackInfo<v8::Value>& args);
+
+#endif
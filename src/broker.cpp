@@ -0,0 +1,72 @@
+#include "broker.h"
+
+#include "executor.h"
+#include "flash-plan.h"
+#include "flash-server.h"
+#include "fluids.h"
+
+using namespace v8;
+using namespace node;
+
+std::mutex Broker::mutex;
+std::condition_variable Broker::changed;
+int Broker::sessions = 0;
+int Broker::waiting = 0;
+bool Broker::exclusive = false;
+
+// a call that's already inside a session (a getter read while marshalling, say) doesn't take another,
+// or it could queue up behind an exclusive caller that's waiting on it
+static thread_local int sessionDepth = 0;
+
+Broker::Session::Session() {
+	if (sessionDepth++ > 0)
+		return;
+
+	std::unique_lock<std::mutex> lock(Broker::mutex);
+	Broker::changed.wait(lock, [] { return !Broker::exclusive && Broker::waiting == 0; });
+	Broker::sessions++;
+}
+
+Broker::Session::~Session() {
+	if (--sessionDepth > 0)
+		return;
+
+	std::lock_guard<std::mutex> lock(Broker::mutex);
+	if (--Broker::sessions == 0)
+		Broker::changed.notify_all();
+}
+
+Broker::Exclusive::Exclusive() {
+	std::unique_lock<std::mutex> lock(Broker::mutex);
+	Broker::waiting++;
+	Broker::changed.wait(lock, [] { return !Broker::exclusive && Broker::sessions == 0; });
+	Broker::waiting--;
+	Broker::exclusive = true;
+}
+
+Broker::Exclusive::~Exclusive() {
+	std::lock_guard<std::mutex> lock(Broker::mutex);
+	Broker::exclusive = false;
+	Broker::changed.notify_all();
+}
+
+bool Broker::inSession() {
+	return sessionDepth > 0;
+}
+
+void Broker::attach(Isolate* iso) {
+	AddEnvironmentCleanupHook(iso, detach, iso);
+}
+
+// runs on the environment's own thread as it shuts down, while the isolate is still there.  the
+// library, the pool and the caches stay loaded for whoever's left
+void Broker::detach(void* arg) {
+	Isolate* iso = (Isolate*) arg;
+	HandleScope scope(iso);
+
+	FlashExecutor::release();
+	releasePlans();
+	releaseClients();
+	releaseFluidTemplate();
+	releaseResultTemplates();
+}
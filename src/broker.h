@@ -0,0 +1,67 @@
+#ifndef NODE_REFPROP_BROKER_H
+#define NODE_REFPROP_BROKER_H
+
+#include <condition_variable>
+#include <mutex>
+
+#include "node-refprop.h"
+
+// the main thread and every worker_thread load the addon into isolates of their own, but they share
+// one process: one copy of the library per engine, one engine pool, one set of caches.  what belongs
+// to a js thread (its handles, its selected fluid and error mode, its async executor) is thread_local,
+// since node gives every environment a thread to itself.  what's shared goes through the broker.
+//
+// every call in from js holds a session while it's inside the addon.  sessions run side by side and
+// lock whichever engines they flash on as they always have, so workers on different engines flash in
+// parallel and ones on the same engine take turns.  changing what the sessions share (setPaths,
+// setEngines, setDiskCache) takes the broker exclusively, which waits for every session to end and
+// holds off new ones meanwhile
+class Broker {
+public:
+	class Session {
+	public:
+		Session();
+		~Session();
+	};
+
+	class Exclusive {
+	public:
+		Exclusive();
+		~Exclusive();
+	};
+
+	// called as the addon loads into an environment; its cleanup hook lets go of the environment's
+	// handles and executor before the isolate goes away
+	static void attach(v8::Isolate* iso);
+	static bool inSession();  // whether the calling thread holds a session
+
+private:
+	static std::mutex mutex;
+	static std::condition_variable changed;
+	static int sessions;
+	static int waiting;  // exclusive callers waiting for the sessions to end
+	static bool exclusive;
+
+	static void detach(void* arg);
+};
+
+// the usual way in from js: registered as brokered<fn> rather than fn
+template <v8::FunctionCallback fn>
+void brokered(const v8::FunctionCallbackInfo<v8::Value>& args) {
+	Broker::Session session;
+	fn(args);
+}
+
+// a callback run from inside another call would wait on its own session forever, so that throws instead
+template <v8::FunctionCallback fn>
+void exclusive(const v8::FunctionCallbackInfo<v8::Value>& args) {
+	v8::Isolate* iso = args.GetIsolate();
+	if (Broker::inSession()) {
+		iso->ThrowException(v8::Exception::Error(v8::String::NewFromUtf8(iso, "Can't reconfigure refprop from inside another refprop call")));
+		return;
+	}
+	Broker::Exclusive lock;
+	fn(args);
+}
+
+#endif
@@ -0,0 +1,495 @@
+#include <math.h>
+#include <stdio.h>
+#include <algorithm>
+#include <functional>
+
+#include "diagram.h"
+#include "engine-pool.h"
+#include "fluids.h"
+
+using namespace v8;
+using namespace node;
+
+DiagramCache::LruList DiagramCache::lru;
+std::map<std::string, DiagramCache::LruList::iterator> DiagramCache::index;
+std::mutex DiagramCache::mutex;
+
+static const char* domeNames[DiagramCurve::DOME_COLUMNS] = { "T", "P", "DL", "DV", "HL", "HV", "SL", "SV" };
+static const char* isolineNames[DiagramCurve::ISOLINE_COLUMNS] = { "T", "P", "D", "H", "S", "Q" };
+
+// how far an interval's midpoint can sit from the chord before it gets split, and how often
+#define defaultTolerance 1e-3
+#define maxRefinements 8
+
+long RefpropContext::criticalPoint(double* T, double* P, double* D) {
+	double mm;
+	this->WMOLdll(this->composition, mm);
+	this->CRITPdll(this->composition, *T, *P, *D, this->ierr, this->herr, errormessagelength);
+
+	*P *= 1e3;
+	*D *= mm;
+	return this->ierr;
+}
+
+double RefpropContext::tripleTemperature() {
+	long icomp = 1;
+	double wmm, ttrp, tnbpt, tc, pc, dc, zc, acf, dip, rgas;
+	this->INFOdll(icomp, wmm, ttrp, tnbpt, tc, pc, dc, zc, acf, dip, rgas);
+	return ttrp;
+}
+
+long RefpropContext::saturation(char prop, double value, SaturationState* sat) {
+	// a mixture's bubble and dew points don't share a temperature and pressure, which SaturationState assumes
+	if (this->nc > 1) {
+		this->ierr = 1;
+		strcpy(this->herr, "Saturation states are only worked out for pure fluids");
+		return this->ierr;
+	}
+
+	double z[ncmax] = { 1 }, xliq[ncmax], xvap[ncmax], mm;
+	long kph = 1;  // bubble point, though for a pure fluid we get both sides either way
+	this->WMOLdll(z, mm);
+
+	if (prop == 'T') {
+		sat->T = value;
+		this->SATTdll(sat->T, z, kph, sat->P, sat->DL, sat->DV, xliq, xvap, this->ierr, this->herr, errormessagelength);
+	}
+	else {
+		sat->P = value / 1e3;
+		this->SATPdll(sat->P, z, kph, sat->T, sat->DL, sat->DV, xliq, xvap, this->ierr, this->herr, errormessagelength);
+	}
+	if (this->ierr != 0)
+		return this->ierr;
+
+	this->ENTHALdll(sat->T, sat->DL, z, sat->HL);
+	this->ENTHALdll(sat->T, sat->DV, z, sat->HV);
+	this->ENTROdll(sat->T, sat->DL, z, sat->SL);
+	this->ENTROdll(sat->T, sat->DV, z, sat->SV);
+
+	// same conversions as toSpecific
+	sat->P *= 1e3;
+	sat->DL *= mm;
+	sat->DV *= mm;
+	sat->HL /= mm * 1e-3;
+	sat->HV /= mm * 1e-3;
+	sat->SL /= mm * 1e-3;
+	sat->SV /= mm * 1e-3;
+	return 0;
+}
+
+typedef std::vector<double> CurvePoint;
+typedef std::function<bool(double s, CurvePoint& point)> CurveFcn;  // false where refprop can't say
+
+// samples fcn at s = a..b, n points evenly spaced, then bisects every interval whose midpoint is more
+// than tol away from the chord, relative to the column's span (pressure on a log scale, the way
+// diagrams draw it).  given endpoints are used as is.  points that fail are left out
+class CurveSampler {
+public:
+	CurveSampler(const CurveFcn& fcn, int logColumn, double tol) : fcn(fcn), logColumn(logColumn), tol(tol) {}
+
+	void sample(double a, double b, int n, const CurvePoint* first, const CurvePoint* last, std::vector<CurvePoint>& out) {
+		std::vector<double> s;
+		std::vector<CurvePoint> coarse;
+		std::vector<bool> ok;
+
+		for (int i = 0; i < n; i++) {
+			s.push_back(i == n-1 ? b : a + (b - a) * i / (n - 1));
+			coarse.push_back(CurvePoint());
+			if (i == 0 && first)
+				coarse.back() = *first;
+			else if (i == n-1 && last)
+				coarse.back() = *last;
+			else if (!this->fcn(s.back(), coarse.back()))
+				coarse.back().clear();
+			ok.push_back(!coarse.back().empty());
+		}
+
+		// spans come from the coarse points, so the tolerance means the same thing however far we refine
+		this->span.clear();
+		for (int i = 0; i < n; i++) {
+			if (!ok[i])
+				continue;
+			if (this->span.empty())
+				this->span.assign(coarse[i].size() * 2, 0), this->setSpan(coarse[i], true);
+			else
+				this->setSpan(coarse[i], false);
+		}
+
+		bool have = false;
+		for (int i = 0; i < n; i++) {
+			if (!ok[i])
+				continue;
+			if (have && ok[i-1])
+				this->refine(s[i-1], coarse[i-1], s[i], coarse[i], 0, out);
+			out.push_back(coarse[i]);
+			have = true;
+		}
+	}
+
+private:
+	const CurveFcn& fcn;
+	int logColumn;
+	double tol;
+	std::vector<double> span;  // min and max of each column
+
+	double scaled(const CurvePoint& p, size_t c) {
+		return (int)c == this->logColumn && p[c] > 0 ? log(p[c]) : p[c];
+	}
+
+	void setSpan(const CurvePoint& p, bool first) {
+		for (size_t c = 0; c < p.size(); c++) {
+			double v = this->scaled(p, c);
+			if (first || v < this->span[2*c])
+				this->span[2*c] = v;
+			if (first || v > this->span[2*c+1])
+				this->span[2*c+1] = v;
+		}
+	}
+
+	void refine(double sl, const CurvePoint& l, double sr, const CurvePoint& r, int depth, std::vector<CurvePoint>& out) {
+		if (depth >= maxRefinements)
+			return;
+
+		double sm = (sl + sr) / 2;
+		CurvePoint m;
+		if (!this->fcn(sm, m))
+			return;
+
+		double err = 0;
+		for (size_t c = 0; c < m.size(); c++) {
+			double range = this->span[2*c+1] - this->span[2*c];
+			double mid = (this->scaled(l, c) + this->scaled(r, c)) / 2;
+			if (range > 0 && !isnan(this->scaled(m, c)))
+				err = std::max(err, fabs(this->scaled(m, c) - mid) / range);
+		}
+		if (!(err > this->tol))
+			return;
+
+		this->refine(sl, l, sm, m, depth+1, out);
+		out.push_back(m);
+		this->refine(sm, m, sr, r, depth+1, out);
+	}
+};
+
+bool DiagramCurve::buildDome(RefpropContext* rp, int points, double tolerance, char* err) {
+	this->dome = true;
+
+	if (rp->components() > 1) {
+		strcpy(err, "Saturation domes are only traced for pure fluids");
+		return false;
+	}
+
+	if (rp->criticalPoint(&this->Tc, &this->Pc, &this->Dc) != 0) {
+		strcpy(err, rp->errorMessage());
+		return false;
+	}
+	double Tmin = rp->tripleTemperature();
+	double Tc = this->Tc;
+
+	// s runs 0..1 from the triple point; T = Tc - (Tc - Tmin)(1 - s)^2 bunches the even points up toward
+	// the critical point before refinement even starts.  SATT gets unreliable right at Tc, so the last
+	// point is the critical point itself
+	CurvePoint critical(DOME_COLUMNS);
+	SaturationState sat;
+	if (rp->saturation('T', Tc * (1 - 1e-9), &sat) == 0) {
+		critical[0] = Tc; critical[1] = this->Pc;
+		critical[2] = critical[3] = this->Dc;
+		critical[4] = critical[5] = (sat.HL + sat.HV) / 2;
+		critical[6] = critical[7] = (sat.SL + sat.SV) / 2;
+	}
+	else
+		critical.clear();
+
+	CurveFcn fcn = [rp, Tc, Tmin](double s, CurvePoint& p) {
+		SaturationState sat;
+		if (rp->saturation('T', Tc - (Tc - Tmin) * (1 - s) * (1 - s), &sat) != 0)
+			return false;
+		p.assign({ sat.T, sat.P, sat.DL, sat.DV, sat.HL, sat.HV, sat.SL, sat.SV });
+		return true;
+	};
+
+	std::vector<CurvePoint> out;
+	CurveSampler sampler(fcn, 1, tolerance);
+	sampler.sample(0, 1, points, NULL, critical.empty() ? NULL : &critical, out);
+	if (out.empty()) {
+		strcpy(err, "Couldn't find any saturation states");
+		return false;
+	}
+
+	this->columns.assign(DOME_COLUMNS, std::vector<double>());
+	for (size_t i = 0; i < out.size(); i++)
+		for (int c = 0; c < DOME_COLUMNS; c++)
+			this->columns[c].push_back(out[i][c]);
+	return true;
+}
+
+// where along runs on an isoline's saturated states
+static double alongValue(char along, const CurvePoint& p) {
+	switch (along) {
+		case 'T': return p[0];
+		case 'P': return p[1];
+		case 'D': return p[2];
+		case 'H': return p[3];
+		case 'S': return p[4];
+	}
+	return NAN;
+}
+
+bool DiagramCurve::buildIsoline(RefpropContext* rp, char hold, double value, char along, double min, double max, int points, double tolerance, char* err) {
+	this->dome = false;
+
+	char props[2] = { hold, along };
+	RefpropContext::FlashFcn flashFcn = rp->findFlashFcn(props);
+	if (!flashFcn || strchr("TPDHS", hold) == NULL || strchr("TPDHS", along) == NULL) {
+		strcpy(err, "Isolines hold one of T, P, D, H, S and run along another");
+		return false;
+	}
+
+	// pressure gets log spacing, like the axis it's usually drawn on
+	bool logAlong = along == 'P' && min > 0;
+	double a = logAlong ? log(min) : min, b = logAlong ? log(max) : max;
+
+	CurveFcn fcn = [rp, flashFcn, props, value, logAlong](double s, CurvePoint& p) {
+		double vals[2] = { value, logAlong ? exp(s) : s };
+		ThermoState state;
+		rp->initState(&state);
+		if (rp->flash(flashFcn, props, vals, &state, allProperties & ~transportMask) != 0)
+			return false;
+		p.assign({ state.T, state.P, state.D, state.H, state.S, state.Q });
+		return true;
+	};
+
+	// isotherms and isobars below the critical point have corners where they meet the dome.  put the
+	// saturated states in exactly and sample either side of them separately, so nothing gets smeared
+	// across a corner.  where both sides sit at the same value of along (an isotherm running along P),
+	// the one we meet first coming up from below goes first
+	std::vector<std::pair<double, CurvePoint> > knots;
+	SaturationState sat;
+	if ((hold == 'T' || hold == 'P') && rp->saturation(hold, value, &sat) == 0) {
+		CurvePoint liquid = { sat.T, sat.P, sat.DL, sat.HL, sat.SL, 0 };
+		CurvePoint vapor = { sat.T, sat.P, sat.DV, sat.HV, sat.SV, 1 };
+		double l = alongValue(along, liquid), v = alongValue(along, vapor);
+		if (logAlong) {
+			l = log(l);
+			v = log(v);
+		}
+
+		bool vaporFirst = v < l || (v == l && along == 'P');
+		knots.push_back(std::make_pair(vaporFirst ? v : l, vaporFirst ? vapor : liquid));
+		knots.push_back(std::make_pair(vaporFirst ? l : v, vaporFirst ? liquid : vapor));
+	}
+
+	std::vector<std::pair<double, CurvePoint> > inside;
+	for (size_t k = 0; k < knots.size(); k++)
+		if (knots[k].first > a && knots[k].first < b)
+			inside.push_back(knots[k]);
+
+	std::vector<double> bounds(1, a);
+	std::vector<const CurvePoint*> fixed(1, (const CurvePoint*)NULL);
+	for (size_t k = 0; k < inside.size(); k++) {
+		bounds.push_back(inside[k].first);
+		fixed.push_back(&inside[k].second);
+	}
+	bounds.push_back(b);
+	fixed.push_back(NULL);
+
+	std::vector<CurvePoint> out;
+	CurveSampler sampler(fcn, 1, tolerance);
+	for (size_t k = 0; k + 1 < bounds.size(); k++) {
+		std::vector<CurvePoint> segment;
+		if (bounds[k+1] > bounds[k]) {
+			int n = std::max(2, (int)ceil(points * (bounds[k+1] - bounds[k]) / (b - a)));
+			sampler.sample(bounds[k], bounds[k+1], n, fixed[k], fixed[k+1], segment);
+		}
+		else {
+			segment.push_back(*fixed[k]);
+			segment.push_back(*fixed[k+1]);
+		}
+
+		// every segment after the first starts where the last one ended
+		out.insert(out.end(), segment.begin() + (k > 0 && fixed[k] && !segment.empty() ? 1 : 0), segment.end());
+	}
+	if (out.empty()) {
+		strcpy(err, rp->errorMessage());
+		return false;
+	}
+
+	this->columns.assign(ISOLINE_COLUMNS, std::vector<double>());
+	for (size_t i = 0; i < out.size(); i++)
+		for (int c = 0; c < ISOLINE_COLUMNS; c++)
+			this->columns[c].push_back(out[i][c]);
+	return true;
+}
+
+Local<Object> DiagramCurve::toJs(Isolate* iso) {
+	Local<Object> obj = Object::New(iso);
+	const char** names = this->dome ? domeNames : isolineNames;
+
+	for (size_t c = 0; c < this->columns.size(); c++) {
+		size_t n = this->columns[c].size();
+		Local<ArrayBuffer> buffer = ArrayBuffer::New(iso, n * sizeof(double));
+		memcpy(buffer->GetContents().Data(), this->columns[c].data(), n * sizeof(double));
+		obj->Set(String::NewFromUtf8(iso, names[c]), Float64Array::New(buffer, 0, n));
+	}
+
+	if (this->dome) {
+		obj->Set(String::NewFromUtf8(iso, "Tc"), Number::New(iso, this->Tc));
+		obj->Set(String::NewFromUtf8(iso, "Pc"), Number::New(iso, this->Pc));
+		obj->Set(String::NewFromUtf8(iso, "Dc"), Number::New(iso, this->Dc));
+	}
+	return obj;
+}
+
+std::shared_ptr<DiagramCurve> DiagramCache::find(const std::string& key) {
+	std::lock_guard<std::mutex> lock(mutex);
+	std::map<std::string, LruList::iterator>::iterator it = index.find(key);
+	if (it == index.end())
+		return std::shared_ptr<DiagramCurve>();
+
+	lru.splice(lru.begin(), lru, it->second);
+	return it->second->second;
+}
+
+// a curve that's evicted lives on for as long as anybody's still turning it into js
+void DiagramCache::add(const std::string& key, std::shared_ptr<DiagramCurve> curve) {
+	std::lock_guard<std::mutex> lock(mutex);
+	std::map<std::string, LruList::iterator>::iterator it = index.find(key);
+	if (it != index.end()) {
+		lru.erase(it->second);
+		index.erase(it);
+	}
+
+	lru.push_front(std::make_pair(key, curve));
+	index[key] = lru.begin();
+	while (lru.size() > maxCurves) {
+		index.erase(lru.back().first);
+		lru.pop_back();
+	}
+}
+
+// points and tolerance, which every curve takes
+static bool curveOptions(Local<Value> arg, int* points, double* tolerance, Isolate* iso) {
+	*points = 50;
+	*tolerance = defaultTolerance;
+	if (!arg->IsObject())
+		return true;
+
+	Local<Object> options = arg->ToObject();
+	Local<Value> val = options->Get(String::NewFromUtf8(iso, "points"));
+	if (!val->IsUndefined())
+		*points = val->Int32Value();
+	val = options->Get(String::NewFromUtf8(iso, "tolerance"));
+	if (!val->IsUndefined())
+		*tolerance = val->NumberValue();
+
+	if (*points < 2 || !(*tolerance > 0)) {
+		iso->ThrowException(Exception::TypeError(String::NewFromUtf8(iso, "Curves need at least 2 points and a positive tolerance")));
+		return false;
+	}
+	return true;
+}
+
+// builds a curve on an engine that has the fluid, unless we already have it
+static void sendCurve(const FunctionCallbackInfo<Value>& args, const char* fluid, const std::string& key,
+		const std::function<bool(RefpropContext*, DiagramCurve*, char*)>& build) {
+	Isolate* iso = args.GetIsolate();
+
+	std::shared_ptr<DiagramCurve> curve = DiagramCache::find(key);
+	if (!curve) {
+		if (!RefpropContext::instance(iso))
+			return;
+
+		FluidScheduler::noteFluid(fluid);
+		RefpropContext* rp = EnginePool::instance()->engineFor(fluid);
+		RefpropLock lock(rp, true);
+
+		char err[errormessagelength+1];
+		curve.reset(new DiagramCurve());
+		if (rp->loadFluid(fluid) != 0) {
+			iso->ThrowException(Exception::TypeError(String::NewFromUtf8(iso, rp->errorMessage())));
+			return;
+		}
+		if (!build(rp, curve.get(), err)) {
+			iso->ThrowException(Exception::Error(String::NewFromUtf8(iso, err)));
+			return;
+		}
+		DiagramCache::add(key, curve);
+	}
+
+	args.GetReturnValue().Set(curve->toJs(iso));
+}
+
+void saturationDome(const FunctionCallbackInfo<Value>& args) {
+	if (fluidChosen(RefpropContext::selectedFluid, args.GetIsolate()))
+		domeCurve(args, RefpropContext::selectedFluid);
+}
+
+void domeCurve(const FunctionCallbackInfo<Value>& args, const char* fluid) {
+	Isolate* iso = args.GetIsolate();
+	// args[0] is optionally {points: 50, tolerance: 1e-3}.  returns Float64Arrays T, P, DL, DV, HL, HV, SL
+	// and SV from the triple point to the critical point, which is also there as Tc, Pc and Dc
+
+	int points;
+	double tolerance;
+	if (!curveOptions(args[0], &points, &tolerance, iso))
+		return;
+
+	char key[refpropcharlength + 64];
+	snprintf(key, sizeof(key), "%s|dome|%d|%.17g", fluid, points, tolerance);
+
+	sendCurve(args, fluid, key, [points, tolerance](RefpropContext* rp, DiagramCurve* curve, char* err) {
+		return curve->buildDome(rp, points, tolerance, err);
+	});
+}
+
+void isoline(const FunctionCallbackInfo<Value>& args) {
+	if (fluidChosen(RefpropContext::selectedFluid, args.GetIsolate()))
+		isolineCurve(args, RefpropContext::selectedFluid);
+}
+
+void isolineCurve(const FunctionCallbackInfo<Value>& args, const char* fluid) {
+	Isolate* iso = args.GetIsolate();
+	// args[0] is e.g. {T: 300, P: [min, max]} for an isotherm drawn along pressure, plus points and
+	// tolerance if the defaults won't do: one of T, P, D, H, S held at a number, another given as a range.
+	// returns Float64Arrays T, P, D, H, S and Q
+
+	if (args.Length() < 1 || !args[0]->IsObject()) {
+		iso->ThrowException(Exception::TypeError(String::NewFromUtf8(iso, "Must say which property to hold and which to run along")));
+		return;
+	}
+
+	Local<Object> options = args[0]->ToObject();
+	char hold = 0, along = 0;
+	double value = 0, min = 0, max = 0;
+	const char* letters = "TPDHS";
+	for (int i = 0; letters[i]; i++) {
+		char key[2] = { letters[i], '\0' };
+		Local<Value> val = options->Get(String::NewFromUtf8(iso, key));
+		if (val->IsNumber() && !hold) {
+			hold = letters[i];
+			value = val->NumberValue();
+		}
+		else if (val->IsArray() && !along && Local<Array>::Cast(val)->Length() == 2) {
+			along = letters[i];
+			min = Local<Array>::Cast(val)->Get(0)->NumberValue();
+			max = Local<Array>::Cast(val)->Get(1)->NumberValue();
+		}
+	}
+
+	if (!hold || !along || !(max > min)) {
+		iso->ThrowException(Exception::TypeError(String::NewFromUtf8(iso, "Isolines need one property held at a number and another with a [min, max] range")));
+		return;
+	}
+
+	int points;
+	double tolerance;
+	if (!curveOptions(args[0], &points, &tolerance, iso))
+		return;
+
+	char key[refpropcharlength + 160];
+	snprintf(key, sizeof(key), "%s|%c=%.17g|%c:%.17g:%.17g|%d|%.17g", fluid, hold, value, along, min, max, points, tolerance);
+
+	sendCurve(args, fluid, key, [hold, value, along, min, max, points, tolerance](RefpropContext* rp, DiagramCurve* curve, char* err) {
+		return curve->buildIsoline(rp, hold, value, along, min, max, points, tolerance, err);
+	});
+}
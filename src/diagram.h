@@ -0,0 +1,52 @@
+#ifndef NODE_REFPROP_DIAGRAM_H
+#define NODE_REFPROP_DIAGRAM_H
+
+#include <list>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "node-refprop.h"
+
+// one curve of a property diagram, as columns of doubles.  the saturation dome runs from the triple
+// point up to the critical point with columns T, P, DL, DV, HL, HV, SL, SV; an isoline holds one
+// property fixed and runs along another with columns T, P, D, H, S, Q.  points are spaced evenly to
+// start with, then intervals get bisected wherever the curve bends away from the chord, which mostly
+// means near the critical point and where isolines cross the dome
+class DiagramCurve {
+public:
+	enum { DOME_COLUMNS = 8, ISOLINE_COLUMNS = 6 };
+
+	bool buildDome(RefpropContext* rp, int points, double tolerance, char* err);
+	bool buildIsoline(RefpropContext* rp, char hold, double value, char along, double min, double max, int points, double tolerance, char* err);
+
+	v8::Local<v8::Object> toJs(v8::Isolate* iso);
+
+private:
+	bool dome;
+	std::vector<std::vector<double> > columns;
+	double Tc, Pc, Dc;
+};
+
+// curves only depend on the fluid and how they were asked for, so each one is built once, whichever js
+// thread asks first
+class DiagramCache {
+public:
+	static std::shared_ptr<DiagramCurve> find(const std::string& key);
+	static void add(const std::string& key, std::shared_ptr<DiagramCurve> curve);
+
+	// isolines are keyed on whatever values they were asked for, so there's no end to them.  past this
+	// many curves the least recently used goes
+	static const size_t maxCurves = 256;
+
+private:
+	typedef std::list<std::pair<std::string, std::shared_ptr<DiagramCurve> > > LruList;  // most recently used at the front
+
+	static LruList lru;
+	static std::map<std::string, LruList::iterator> index;
+	static std::mutex mutex;
+};
+
+#endif
@@ -0,0 +1,276 @@
+#include <stdio.h>
+#include <string.h>
+#include <sys/stat.h>
+
+#ifndef _WIN32
+#include <unistd.h>
+#endif
+
+#include "disk-cache.h"
+#include "engine-pool.h"
+
+using namespace v8;
+using namespace node;
+
+#define diskCacheMagic "RPCACHE"
+#define diskCacheVersion 1
+#define diskCacheByteOrder 0x01020304
+#define slotBusy 1ULL               // claimed, and being written
+#define slotReady (1ULL << 63)      // set in every published tag, so they're never 0 or slotBusy
+#define defaultDiskEntries (1 << 16)
+
+// processes share the tags through the mapping, which only works if they're real atomics
+static_assert(ATOMIC_LLONG_LOCK_FREE == 2, "the disk cache needs lock-free 64-bit atomics");
+
+struct DiskCache::Header {
+	char magic[8];
+	uint32_t version;
+	uint32_t byteOrder;
+	uint64_t library;    // the signature of the library that started the file
+	uint64_t capacity;   // slots, a power of two
+	uint64_t slotBytes;  // sizeof(Slot), which changes along with ThermoState
+	std::atomic<uint64_t> entries;
+};
+
+struct DiskCache::Slot {
+	std::atomic<uint64_t> tag;  // 0 while empty, then slotBusy, then the key's hash | slotReady
+	Key key;
+	ThermoState state;
+};
+
+// the slots start on a cache line of their own
+#define slotsOffset ((sizeof(Header) + 63) / 64 * 64)
+
+DiskCache* DiskCache::active = NULL;
+
+// fnv-1a, which is plenty for keys this short
+static uint64_t mix(uint64_t h, const void* data, size_t length) {
+	const unsigned char* bytes = (const unsigned char*)data;
+	for (size_t i = 0; i < length; i++) {
+		h ^= bytes[i];
+		h *= 0x100000001b3ULL;
+	}
+	return h;
+}
+
+// a file's name, size and modification time.  a file that isn't there still counts by name
+static uint64_t mixFile(uint64_t h, std::string path) {
+	while (!path.empty() && path[path.size() - 1] == ' ')
+		path.erase(path.size() - 1);  // fortran pads its strings
+	h = mix(h, path.data(), path.size());
+
+	struct stat st;
+	if (stat(path.c_str(), &st) == 0) {
+		uint64_t info[2] = { (uint64_t)st.st_size, (uint64_t)st.st_mtime };
+		h = mix(h, info, sizeof(info));
+	}
+	return h;
+}
+
+static uint64_t librarySignature() {
+	return mixFile(0xcbf29ce484222325ULL, RefpropContext::libraryPath);
+}
+
+uint64_t DiskCache::signature(const std::string& files) {
+	uint64_t h = librarySignature();
+	size_t start = 0;
+	while (start <= files.size()) {
+		size_t bar = files.find('|', start);
+		if (bar == std::string::npos)
+			bar = files.size();
+		if (bar > start)
+			h = mixFile(h, files.substr(start, bar - start));
+		start = bar + 1;
+	}
+	return h;
+}
+
+DiskCache::Key::Key(uint64_t fluid, const char props[2], const double vals[2], const double z[ncmax]) {
+	memset(this, 0, sizeof(Key));  // the padding gets compared and hashed too
+
+	int first = props[0] <= props[1] ? 0 : 1;
+	this->fluid = fluid;
+	this->props[0] = props[first];
+	this->props[1] = props[1-first];
+	this->vals[0] = vals[first];
+	this->vals[1] = vals[1-first];
+	memcpy(this->z, z, sizeof(this->z));
+}
+
+uint64_t DiskCache::Key::hash() const {
+	return mix(0xcbf29ce484222325ULL, this, sizeof(Key));
+}
+
+DiskCache::DiskCache() : hits(0), misses(0), stores(0), full(0), header(NULL), slots(NULL), mask(0) {
+}
+
+bool DiskCache::attach(const char* path, uint64_t library, char* err) {
+	if (!this->file.open(path, err, true) || this->file.size < slotsOffset)
+		return false;
+
+	Header* h = (Header*)this->file.data;
+	if (memcmp(h->magic, diskCacheMagic, sizeof(diskCacheMagic)) != 0 || h->version != diskCacheVersion ||
+			h->byteOrder != diskCacheByteOrder || h->library != library || h->slotBytes != sizeof(Slot))
+		return false;
+	if (h->capacity == 0 || (h->capacity & (h->capacity - 1)) != 0 || h->capacity > (this->file.size - slotsOffset) / sizeof(Slot))
+		return false;
+
+	this->header = h;
+	this->slots = (Slot*)(this->file.data + slotsOffset);
+	this->mask = (size_t)h->capacity - 1;
+	return true;
+}
+
+DiskCache* DiskCache::open(const char* path, size_t capacity, char* err) {
+	uint64_t library = librarySignature();
+	size_t slots = 64;
+	while (slots < capacity)
+		slots <<= 1;
+
+	DiskCache* cache = new DiskCache();
+	if (cache->attach(path, library, err))
+		return cache;
+
+	// whatever's there gets replaced, so make sure it's one of ours first
+	bool foreign = cache->file.data && (cache->file.size < sizeof(diskCacheMagic) || memcmp(cache->file.data, diskCacheMagic, sizeof(diskCacheMagic)) != 0);
+	delete cache;
+	if (foreign) {
+		snprintf(err, errormessagelength, "%s isn't a disk cache", path);
+		return NULL;
+	}
+
+	// missing, or made by another build or library.  the new file is put together off to the side and
+	// renamed into place, so other processes never map half of one; any that still have the old file
+	// mapped carry on with it until they open the cache again
+	char temp[filepathlength+64];
+#ifdef _WIN32
+	snprintf(temp, sizeof(temp), "%s.%lu.tmp", path, (unsigned long)GetCurrentProcessId());
+#else
+	snprintf(temp, sizeof(temp), "%s.%lu.tmp", path, (unsigned long)getpid());
+#endif
+	MappedFile* fresh = new MappedFile();
+	if (!fresh->create(temp, slotsOffset + slots * sizeof(Slot), err)) {
+		delete fresh;
+		return NULL;
+	}
+
+	// the slots are already zero, which is empty
+	Header* header = (Header*)fresh->data;
+	memcpy(header->magic, diskCacheMagic, sizeof(diskCacheMagic));
+	header->version = diskCacheVersion;
+	header->byteOrder = diskCacheByteOrder;
+	header->library = library;
+	header->capacity = slots;
+	header->slotBytes = sizeof(Slot);
+	header->entries.store(0);
+	delete fresh;
+
+#ifdef _WIN32
+	bool moved = MoveFileExA(temp, path, MOVEFILE_REPLACE_EXISTING) != 0;
+#else
+	bool moved = rename(temp, path) == 0;
+#endif
+	if (!moved) {
+		snprintf(err, errormessagelength, "Couldn't put the disk cache in place at %s", path);
+		remove(temp);
+		return NULL;
+	}
+
+	// someone else may have replaced it again in the meantime, which is fine as long as it fits
+	cache = new DiskCache();
+	if (cache->attach(path, library, err))
+		return cache;
+	delete cache;
+	snprintf(err, errormessagelength, "Couldn't set up the disk cache at %s", path);
+	return NULL;
+}
+
+bool DiskCache::lookup(uint64_t fluid, const char props[2], const double vals[2], ThermoState* obj) {
+	Key key(fluid, props, vals, obj->Z);
+	uint64_t h = key.hash(), tag = h | slotReady;
+
+	for (int i = 0; i < maxProbes; i++) {
+		Slot& slot = this->slots[(h + i) & this->mask];
+		uint64_t seen = slot.tag.load(std::memory_order_acquire);
+		if (seen == 0)
+			break;  // slots never empty out again, so the key can't be any further along
+		if (seen == tag && memcmp(&slot.key, &key, sizeof(Key)) == 0) {
+			*obj = slot.state;
+			this->hits++;
+			return true;
+		}
+	}
+	this->misses++;
+	return false;
+}
+
+void DiskCache::store(uint64_t fluid, const char props[2], const double vals[2], const ThermoState* obj) {
+	Key key(fluid, props, vals, obj->Z);
+	uint64_t h = key.hash(), tag = h | slotReady;
+
+	for (int i = 0; i < maxProbes; i++) {
+		Slot& slot = this->slots[(h + i) & this->mask];
+		uint64_t seen = slot.tag.load(std::memory_order_acquire);
+		if (seen == 0 && slot.tag.compare_exchange_strong(seen, slotBusy, std::memory_order_acquire)) {
+			memcpy(&slot.key, &key, sizeof(Key));
+			slot.state = *obj;
+			slot.tag.store(tag, std::memory_order_release);
+			this->header->entries.fetch_add(1, std::memory_order_relaxed);
+			this->stores++;
+			return;
+		}
+
+		// another engine or process got there first
+		if (seen == tag && memcmp(&slot.key, &key, sizeof(Key)) == 0)
+			return;
+	}
+	this->full++;
+}
+
+size_t DiskCache::entries() {
+	return (size_t)this->header->entries.load(std::memory_order_relaxed);
+}
+
+size_t DiskCache::capacity() {
+	return this->mask + 1;
+}
+
+void setDiskCache(const FunctionCallbackInfo<Value>& args) {
+	Isolate* iso = args.GetIsolate();
+	// args[0] is the cache file, shared with any other process that names the same one, and args[1]
+	// is optionally {entries: 65536}, which only matters when the file is new.  null turns it off
+
+	bool off = args.Length() < 1 || args[0]->IsNull() || args[0]->IsUndefined() || args[0]->IsFalse();
+	size_t entries = defaultDiskEntries;
+	if (!off && args.Length() > 1 && args[1]->IsObject()) {
+		Local<Value> val = args[1]->ToObject()->Get(String::NewFromUtf8(iso, "entries"));
+		if (val->IsNumber() && val->NumberValue() >= 1)
+			entries = (size_t)val->NumberValue();
+	}
+
+	RefpropContext* rp = RefpropContext::instance(iso);
+	if (!rp)
+		return;
+	RefpropLock lock(rp);
+
+	DiskCache* cache = NULL;
+	if (!off) {
+		String::Utf8Value path(args[0]->ToString());
+		char err[errormessagelength+1];
+		cache = DiskCache::open(*path, entries, err);
+		if (!cache) {
+			iso->ThrowException(Exception::TypeError(String::NewFromUtf8(iso, err)));
+			return;
+		}
+	}
+
+	// no engine can be partway through a lookup when the old one goes
+	EnginePool* pool = EnginePool::instance();
+	for (int i = 1; i < pool->size(); i++)
+		pool->engine(i)->lock();
+	DiskCache* old = DiskCache::active;
+	DiskCache::active = cache;
+	for (int i = 1; i < pool->size(); i++)
+		pool->engine(i)->unlock();
+	delete old;
+}
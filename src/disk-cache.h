@@ -0,0 +1,66 @@
+#ifndef NODE_REFPROP_DISK_CACHE_H
+#define NODE_REFPROP_DISK_CACHE_H
+
+#include <stdint.h>
+#include <atomic>
+#include <string>
+
+#include "node-refprop.h"
+#include "mapped-file.h"
+
+// flash results that outlive the process, so a restarted worker doesn't redo the flashes its
+// predecessor already paid for.  it's one memory-mapped file holding an open-addressing hash table,
+// shared by every engine and by every process on the host that points at the same file.
+// entries are keyed on the fluid's signature (its fluid files and the library they were loaded into,
+// down to their sizes and modification times), the input pair, the exact bits of the inputs and the
+// composition.  a changed fluid file or library gets a new signature, so stale entries just stop
+// matching; opening the file with a different library starts it over.
+// slots are only ever filled, never rewritten: a writer claims an empty slot with a compare-and-swap,
+// copies the entry in and then publishes its tag, and readers only look at published slots.  when the
+// probe runs out the state just isn't stored.  off until setDiskCache names a file
+class DiskCache {
+public:
+	// opens (or creates) the cache file with room for capacity entries.  an existing file keeps its own
+	// capacity.  NULL and a message in err if the file can't be mapped
+	static DiskCache* open(const char* path, size_t capacity, char* err);
+
+	// the cache every engine uses.  only changed with every engine locked (see setDiskCache)
+	static DiskCache* active;
+
+	// a hash of the files a fluid was loaded from and the library, '|'-separated like refprop's hf
+	static uint64_t signature(const std::string& files);
+
+	// like FlashCache's: obj comes in with its composition and gets the cached state copied over it
+	bool lookup(uint64_t fluid, const char props[2], const double vals[2], ThermoState* obj);
+	void store(uint64_t fluid, const char props[2], const double vals[2], const ThermoState* obj);
+
+	size_t entries();
+	size_t capacity();
+	std::atomic<unsigned long long> hits, misses, stores, full;  // this process's, not the file's
+
+	static const int maxProbes = 32;
+
+private:
+	struct Key {
+		uint64_t fluid;
+		char props[2];  // sorted, as in FlashCache
+		double vals[2];
+		double z[ncmax];
+
+		Key(uint64_t fluid, const char props[2], const double vals[2], const double z[ncmax]);
+		uint64_t hash() const;
+	};
+
+	struct Header;
+	struct Slot;
+
+	MappedFile file;
+	Header* header;
+	Slot* slots;
+	size_t mask;  // capacity - 1
+
+	DiskCache();
+	bool attach(const char* path, uint64_t library, char* err);  // maps the file, if it's a cache this build can share
+};
+
+#endif
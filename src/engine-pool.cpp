@@ -0,0 +1,400 @@
+#include <algorithm>
+
+#include "engine-pool.h"
+
+using namespace v8;
+using namespace node;
+
+std::atomic<EnginePool*> EnginePool::_instance(NULL);
+
+PoolJob::PoolJob(size_t rows, const char* fluid) : failedRow(rows) {
+	this->rows = rows;
+	strncpy(this->fluid, fluid ? fluid : "", refpropcharlength-1);
+	this->fluid[refpropcharlength-1] = '\0';
+	this->herr[0] = '\0';
+}
+
+void PoolJob::fail(size_t row, const char* message) {
+	std::lock_guard<std::mutex> lock(this->mutex);
+	if (row < this->failedRow) {
+		this->failedRow = row;
+		strncpy(this->herr, message, errormessagelength);
+		this->herr[errormessagelength] = '\0';
+	}
+}
+
+bool PoolJob::failed() {
+	return this->failedRow < this->rows;
+}
+
+Local<Value> PoolJob::error(Isolate* iso) {
+	char msg[errormessagelength+64];
+	sprintf(msg, "Row %lu: %s", (unsigned long)this->failedRow, this->herr);
+	return Exception::TypeError(String::NewFromUtf8(iso, msg));
+}
+
+EnginePool* EnginePool::instance() {
+	EnginePool* pool = _instance;
+	if (pool)
+		return pool;
+
+	static std::mutex creating;
+	std::lock_guard<std::mutex> lock(creating);
+
+	if (!_instance)
+		_instance = new EnginePool();
+	return _instance;
+}
+
+EnginePool::EnginePool() {
+	this->generation = 0;
+	this->switches = 0;
+	this->active = 0;
+	this->stopping = false;
+
+	Worker* w = new Worker();
+	w->rp = RefpropContext::instance(NULL);
+	w->begin = w->end = 0;
+	w->job = NULL;
+	w->lastSwitch = 0;
+	this->workers.push_back(w);
+}
+
+int EnginePool::size() {
+	return (int)this->workers.size();
+}
+
+RefpropContext* EnginePool::engine(int i) {
+	return this->workers[i]->rp;
+}
+
+bool EnginePool::resize(int n, char* err) {
+	std::lock_guard<std::mutex> lock(this->runMutex);
+
+	if (n < 1)
+		n = 1;
+	if (n == this->size())
+		return true;
+
+	// load the new copies before touching anything, so a failure leaves the pool as it was
+	std::vector<RefpropContext*> added;
+	for (int i = this->size(); i < n; i++) {
+		RefpropContext* rp = new RefpropContext(RefpropContext::libraryPath, i);
+		if (!rp->isLoaded()) {
+			strcpy(err, rp->errorMessage());
+			delete rp;
+			for (size_t j = 0; j < added.size(); j++)
+				delete added[j];
+			return false;
+		}
+		added.push_back(rp);
+	}
+
+	this->stopWorkers();
+
+	while (this->size() > n) {
+		delete this->workers.back()->rp;
+		delete this->workers.back();
+		this->workers.pop_back();
+	}
+	for (size_t j = 0; j < added.size(); j++) {
+		Worker* w = new Worker();
+		w->rp = added[j];
+		w->begin = w->end = 0;
+		w->job = NULL;
+		w->lastSwitch = 0;
+		this->workers.push_back(w);
+	}
+
+	this->startWorkers();
+	return true;
+}
+
+void EnginePool::startWorkers() {
+	this->stopping = false;
+	for (int i = 1; i < this->size(); i++)
+		this->workers[i]->thread = std::thread(&EnginePool::workerLoop, this, i);
+}
+
+void EnginePool::stopWorkers() {
+	{
+		std::lock_guard<std::mutex> lock(this->mutex);
+		this->stopping = true;
+	}
+	this->wake.notify_all();
+
+	for (int i = 1; i < this->size(); i++)
+		if (this->workers[i]->thread.joinable())
+			this->workers[i]->thread.join();
+}
+
+void EnginePool::run(PoolJob* job) {
+	this->run(std::vector<PoolJob*>(1, job));
+}
+
+void EnginePool::run(const std::vector<PoolJob*>& jobs) {
+	std::lock_guard<std::mutex> runLock(this->runMutex);
+
+	// every job needs at least one engine to itself, so take them a pool's worth at a time
+	for (size_t first = 0; first < jobs.size(); first += this->workers.size()) {
+		int numJobs = (int)std::min(jobs.size() - first, this->workers.size());
+		this->runWave((PoolJob**)&jobs[first], numJobs);
+	}
+}
+
+bool EnginePool::hasFluid(int w, const char* fluid) {
+	RefpropContext* rp = this->workers[w]->rp;
+
+	// engine 0 is already ours; anybody else might be in the middle of a one-off call
+	if (w > 0)
+		rp->lock();
+	bool loaded = strcmp(rp->getFluid(), fluid) == 0;
+	if (w > 0)
+		rp->unlock();
+	return loaded;
+}
+
+// hands every engine a job.  each job first gets an engine that already has its fluid loaded (or failing
+// that, one whose fluid nobody here wants), then the leftovers go wherever rows per engine is highest
+void EnginePool::assign(PoolJob** jobs, int numJobs) {
+	int n = this->size();
+	std::vector<int> engines(numJobs, 0);
+
+	for (int i = 0; i < n; i++)
+		this->workers[i]->job = NULL;
+
+	for (int j = 0; j < numJobs; j++)
+		for (int i = 0; i < n && !engines[j]; i++)
+			if (!this->workers[i]->job && this->hasFluid(i, jobs[j]->fluid)) {
+				this->workers[i]->job = jobs[j];
+				engines[j]++;
+			}
+
+	for (int j = 0; j < numJobs; j++) {
+		if (engines[j])
+			continue;
+
+		int pick = -1;
+		for (int i = 0; i < n; i++) {
+			if (this->workers[i]->job)
+				continue;
+
+			bool wanted = false;
+			for (int k = 0; k < numJobs && !wanted; k++)
+				wanted = !engines[k] && k != j && this->hasFluid(i, jobs[k]->fluid);
+			if (pick < 0 || !wanted)
+				pick = i;
+			if (!wanted)
+				break;
+		}
+		this->workers[pick]->job = jobs[j];
+		engines[j]++;
+	}
+
+	for (int i = 0; i < n; i++) {
+		if (this->workers[i]->job)
+			continue;
+
+		int best = 0;
+		for (int j = 1; j < numJobs; j++) {
+			double load = (double)jobs[j]->rows / engines[j], bestLoad = (double)jobs[best]->rows / engines[best];
+			if (load > bestLoad || (load == bestLoad && jobs[j]->fluid[0] && this->hasFluid(i, jobs[j]->fluid)))
+				best = j;
+		}
+		this->workers[i]->job = jobs[best];
+		engines[best]++;
+	}
+}
+
+void EnginePool::runWave(PoolJob** jobs, int numJobs) {
+	int n = this->size();
+	this->assign(jobs, numJobs);
+
+	// deal each job's rows out in contiguous ranges over its engines, so neighbouring states land together
+	for (int j = 0; j < numJobs; j++) {
+		int count = 0, k = 0;
+		for (int i = 0; i < n; i++)
+			if (this->workers[i]->job == jobs[j])
+				count++;
+
+		for (int i = 0; i < n; i++) {
+			Worker* w = this->workers[i];
+			if (w->job != jobs[j])
+				continue;
+
+			std::lock_guard<std::mutex> lock(w->mutex);
+			w->begin = jobs[j]->rows * k / count;
+			w->end = jobs[j]->rows * (k+1) / count;
+			k++;
+		}
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(this->mutex);
+		this->active = n - 1;
+		this->generation++;
+	}
+	this->wake.notify_all();
+
+	this->work(0);
+
+	std::unique_lock<std::mutex> lock(this->mutex);
+	this->done.wait(lock, [this] { return this->active == 0; });
+}
+
+RefpropContext* EnginePool::engineFor(const char* fluid) {
+	int n = this->size();
+	int first = n > 1 ? 1 : 0;
+
+	for (int i = 0; i < n; i++) {
+		RefpropContext* rp = this->workers[i]->rp;
+		rp->lock();
+		if (strcmp(rp->getFluid(), fluid) == 0)
+			return rp;
+		rp->unlock();
+	}
+
+	// js threads can get here at the same time (see Broker), so they take turns picking
+	int oldest = first;
+	{
+		std::lock_guard<std::mutex> lock(this->mutex);
+		for (int i = first; i < n; i++)
+			if (this->workers[i]->lastSwitch < this->workers[oldest]->lastSwitch)
+				oldest = i;
+		this->workers[oldest]->lastSwitch = ++this->switches;
+	}
+	this->workers[oldest]->rp->lock();
+	return this->workers[oldest]->rp;
+}
+
+void EnginePool::workerLoop(int w) {
+	unsigned long seen;
+	{
+		// workers started by resize() mustn't mistake an earlier run for one they're part of
+		std::lock_guard<std::mutex> lock(this->mutex);
+		seen = this->generation;
+	}
+
+	for (;;) {
+		{
+			std::unique_lock<std::mutex> lock(this->mutex);
+			this->wake.wait(lock, [this, seen] { return this->stopping || this->generation != seen; });
+			if (this->stopping)
+				return;
+			seen = this->generation;
+		}
+
+		{
+			RefpropLock engineLock(this->workers[w]->rp);
+			this->work(w);
+		}
+
+		std::lock_guard<std::mutex> lock(this->mutex);
+		if (--this->active == 0)
+			this->done.notify_all();
+	}
+}
+
+void EnginePool::work(int w) {
+	Worker* self = this->workers[w];
+	PoolJob* job = self->job;
+
+	// a job without a fluid would flash in whatever this engine last had loaded.  the calls in from js
+	// check first, so this is only a backstop
+	if (!job->fluid[0]) {
+		if (job->rows > 0)
+			job->fail(0, noFluidMessage);
+		return;
+	}
+	if (self->rp->loadFluid(job->fluid) != 0) {
+		// the fluid isn't going to load on any of the other copies either
+		if (job->rows > 0)
+			job->fail(0, self->rp->errorMessage());
+		return;
+	}
+
+	for (;;) {
+		size_t begin, end;
+		{
+			std::lock_guard<std::mutex> lock(self->mutex);
+			begin = self->begin;
+			end = std::min(self->begin + chunkRows, self->end);
+			self->begin = end;
+		}
+
+		if (begin >= end) {
+			if (!this->steal(w))
+				return;
+			continue;
+		}
+
+		if (begin < job->failedRow)
+			job->runRows(self->rp, begin, end);
+	}
+}
+
+// moves the back half of the biggest remaining range of w's job onto worker w.  false once there's nothing left
+bool EnginePool::steal(int w) {
+	for (;;) {
+		int victim = -1;
+		size_t most = 0;
+
+		for (int i = 0; i < this->size(); i++) {
+			Worker* v = this->workers[i];
+			if (v->job != this->workers[w]->job)
+				continue;
+			std::lock_guard<std::mutex> lock(v->mutex);
+			if (v->end > v->begin && v->end - v->begin > most) {
+				most = v->end - v->begin;
+				victim = i;
+			}
+		}
+		if (victim < 0)
+			return false;
+
+		size_t begin, end;
+		{
+			Worker* v = this->workers[victim];
+			std::lock_guard<std::mutex> lock(v->mutex);
+			if (v->end <= v->begin)
+				continue;  // somebody beat us to it; look again
+			end = v->end;
+			begin = v->begin + (v->end - v->begin) / 2;
+			v->end = begin;
+		}
+
+		Worker* self = this->workers[w];
+		std::lock_guard<std::mutex> lock(self->mutex);
+		self->begin = begin;
+		self->end = end;
+		return true;
+	}
+}
+
+void setEngines(const FunctionCallbackInfo<Value>& args) {
+	Isolate* iso = args.GetIsolate();
+
+	if (args.Length() < 1 || !args[0]->IsNumber()) {
+		iso->ThrowException(Exception::TypeError(String::NewFromUtf8(iso, "Must specify the number of engines")));
+		return;
+	}
+
+	RefpropContext* rp = RefpropContext::instance(iso);
+	if (!rp)
+		return;
+
+	char err[errormessagelength+1];
+	if (!EnginePool::instance()->resize(args[0]->Int32Value(), err)) {
+		iso->ThrowException(Exception::Error(String::NewFromUtf8(iso, err)));
+		return;
+	}
+	args.GetReturnValue().Set(Integer::New(iso, EnginePool::instance()->size()));
+}
+
+void getEngines(const FunctionCallbackInfo<Value>& args) {
+	Isolate* iso = args.GetIsolate();
+
+	if (!RefpropContext::instance(iso))
+		return;
+	args.GetReturnValue().Set(Integer::New(iso, EnginePool::instance()->size()));
+}
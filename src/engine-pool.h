@@ -0,0 +1,101 @@
+#ifndef NODE_REFPROP_ENGINE_POOL_H
+#define NODE_REFPROP_ENGINE_POOL_H
+
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "node-refprop.h"
+
+// a batch of independent rows that the pool spreads over its engines
+class PoolJob {
+public:
+	PoolJob(size_t rows, const char* fluid);
+	virtual ~PoolJob() {}
+
+	// computes rows [begin, end) on rp, which already has the job's fluid loaded
+	virtual void runRows(RefpropContext* rp, size_t begin, size_t end) = 0;
+
+	// records a failed row.  only the lowest one is kept, and rows past it aren't started
+	void fail(size_t row, const char* message);
+	bool failed();
+	v8::Local<v8::Value> error(v8::Isolate* iso);  // what a failed job throws: the row and its message
+
+	// back on the js thread once every row has run, for whatever the job hands back to js
+	virtual void finish(v8::Isolate* iso) {}
+
+	size_t rows;
+	char fluid[refpropcharlength];  // empty to use whatever each engine has loaded
+
+	std::atomic<size_t> failedRow;  // == rows if nothing failed
+	char herr[errormessagelength+1];
+
+private:
+	std::mutex mutex;
+};
+
+// N independent copies of the refprop library, each with its own fluid and its own thread.  engine 0
+// is RefpropContext::instance() and runs on whichever thread calls run(); the rest have worker threads.
+// rows are dealt out in contiguous ranges and idle engines steal the back half of the busiest range
+// working on the same job.  jobs in different fluids go to different engines where there are enough
+// of them, preferring engines that already have the fluid loaded, so several fluids stay resident.
+class EnginePool {
+public:
+	static EnginePool* instance();
+
+	int size();
+	RefpropContext* engine(int i);
+
+	// loads or unloads copies of the library until there are n engines.  returns false (leaving the
+	// pool as it was) and fills err if a copy won't load
+	bool resize(int n, char* err);
+
+	// runs the job across every engine and returns once all of its rows are done.  the caller must
+	// hold engine 0's lock; the pool takes the others' itself
+	void run(PoolJob* job);
+	void run(const std::vector<PoolJob*>& jobs);
+
+	// locks and returns an engine for a one-off call in fluid: one that already has it loaded if
+	// there is one, otherwise the one that least recently had to switch.  engine 0 is only switched
+	// when it's the only engine.  the caller unlocks it
+	RefpropContext* engineFor(const char* fluid);
+
+	static const size_t chunkRows = 64;
+
+private:
+	EnginePool();
+
+	struct Worker {
+		RefpropContext* rp;
+		std::thread thread;
+		std::mutex mutex;  // guards begin/end, which thieves shrink from the back
+		size_t begin, end;
+		PoolJob* job;      // what this engine is working on during run()
+		unsigned long lastSwitch;
+	};
+
+	static std::atomic<EnginePool*> _instance;
+
+	std::vector<Worker*> workers;
+	std::mutex runMutex;  // one job at a time
+
+	std::mutex mutex;
+	std::condition_variable wake, done;
+	unsigned long generation;
+	unsigned long switches;  // clock for Worker::lastSwitch
+	int active;
+	bool stopping;
+
+	void runWave(PoolJob** jobs, int numJobs);
+	void assign(PoolJob** jobs, int numJobs);
+	bool hasFluid(int w, const char* fluid);
+	void workerLoop(int w);
+	void work(int w);
+	bool steal(int w);
+	void stopWorkers();
+	void startWorkers();
+};
+
+#endif
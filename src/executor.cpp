@@ -0,0 +1,327 @@
+#include "executor.h"
+#include <map>
+#include <string>
+
+#include "engine-pool.h"
+#include "fluids.h"
+#include "broker.h"
+
+using namespace v8;
+using namespace node;
+
+thread_local FlashExecutor* FlashExecutor::_instance = NULL;
+
+FlashRequest::FlashRequest(Kind kind, Isolate* iso) {
+	this->kind = kind;
+	this->fluid[0] = '\0';
+	this->flashFcn = NULL;
+	this->want = allProperties;
+	this->lazy = false;
+	this->ierr = 0;
+	this->herr[0] = '\0';
+	this->statusErrors = RefpropContext::statusErrors;
+	this->badInput = false;
+	this->job = NULL;
+	this->resolver.Reset(iso, Promise::Resolver::New(iso));
+}
+
+FlashRequest::~FlashRequest() {
+	delete this->job;
+	this->result.Reset();
+	this->resolver.Reset();
+}
+
+FlashExecutor* FlashExecutor::instance() {
+	if (!_instance)
+		_instance = new FlashExecutor();
+	return _instance;
+}
+
+FlashExecutor::FlashExecutor() {
+	this->busy = false;
+	this->loop = GetCurrentEventLoop(Isolate::GetCurrent());
+	this->work.data = this;
+	this->batchRan = true;
+	this->orphaned = false;
+	this->_fluid[0] = '\0';
+	this->loadedFluid[0] = '\0';
+	this->settingFluid = 0;
+}
+
+void FlashExecutor::release() {
+	FlashExecutor* ex = _instance;
+	if (!ex)
+		return;
+	_instance = NULL;
+
+	if (ex->busy) {
+		std::unique_lock<std::mutex> lock(ex->mutex);
+		ex->ran.wait(lock, [ex] { return ex->batchRan; });
+	}
+
+	for (size_t i = 0; i < ex->pending.size(); i++)
+		delete ex->pending[i];
+	for (size_t i = 0; i < ex->running.size(); i++)
+		delete ex->running[i];
+	ex->pending.clear();
+	ex->running.clear();
+
+	// the loop may or may not get round to batchDone now
+	if (ex->busy)
+		ex->orphaned = true;
+	else
+		delete ex;
+}
+
+void FlashExecutor::fluidChanged(const char* fluid) {
+	strncpy(this->_fluid, fluid, refpropcharlength-1);
+	this->_fluid[refpropcharlength-1] = '\0';
+	strcpy(this->loadedFluid, this->_fluid);
+}
+
+void FlashExecutor::fluidRequested(const char* fluid) {
+	strncpy(this->_fluid, fluid, refpropcharlength-1);
+	this->_fluid[refpropcharlength-1] = '\0';
+	this->settingFluid++;
+}
+
+const char* FlashExecutor::currentFluid() {
+	return this->_fluid;
+}
+
+void FlashExecutor::submit(FlashRequest* req) {
+	if (req->kind != FlashRequest::SET_FLUID)
+		FluidScheduler::noteFluid(req->fluid);
+
+	this->pending.push_back(req);
+	if (!this->busy)
+		this->startBatch();
+}
+
+void FlashExecutor::startBatch() {
+	this->running.swap(this->pending);
+	this->busy = true;
+	this->batchRan = false;
+	uv_queue_work(this->loop, &this->work, runBatch, batchDone);
+}
+
+// the flash requests for one fluid, spread over the engine pool.  every request keeps its
+// own error, so the job as a whole never fails
+class RequestJob : public PoolJob {
+public:
+	RequestJob(const std::vector<FlashRequest*>& reqs) : PoolJob(reqs.size(), reqs[0]->fluid), reqs(reqs) {}
+
+	void runRows(RefpropContext* rp, size_t begin, size_t end) {
+		for (size_t i = begin; i < end; i++) {
+			FlashRequest* req = this->reqs[i];
+
+			req->ierr = rp->initState(&req->state, &req->comp);
+			req->badInput = req->ierr != 0;
+			if (req->ierr == 0)
+				req->ierr = rp->flash(req->flashFcn, req->props, req->vals, &req->state, req->lazy ? req->want & ~transportMask : req->want, &req->guess);
+			if (req->ierr != 0) {
+				strncpy(req->herr, rp->errorMessage(), errormessagelength);
+				req->herr[errormessagelength] = '\0';
+			}
+		}
+	}
+
+private:
+	std::vector<FlashRequest*> reqs;
+};
+
+// runs on the thread pool, so no v8 in here
+void FlashExecutor::runBatch(uv_work_t* work) {
+	FlashExecutor* ex = (FlashExecutor*) work->data;
+	{
+		Broker::Session session;
+		flashBatch(ex);
+	}
+
+	std::lock_guard<std::mutex> lock(ex->mutex);
+	ex->batchRan = true;
+	ex->ran.notify_all();
+}
+
+void FlashExecutor::flashBatch(FlashExecutor* ex) {
+	RefpropContext* rp = RefpropContext::instance(NULL);  // already created by whoever submitted
+	RefpropLock lock(rp);
+
+	// every flash already knows its fluid, so setFluid requests only have to say whether the fluid loads
+	// and the flashes can go in any order.  grouping them by fluid means each fluid gets set up at most
+	// once per batch, and the pool keeps different fluids on different engines
+	std::vector<std::string> order;
+	std::map<std::string, std::vector<FlashRequest*> > groups;
+	std::vector<PoolJob*> columnJobs;
+
+	for (size_t i = 0; i < ex->running.size(); i++) {
+		FlashRequest* req = ex->running[i];
+
+		if (req->kind == FlashRequest::SET_FLUID) {
+			req->ierr = rp->loadFluid(req->fluid);
+			if (req->ierr != 0) {
+				strncpy(req->herr, rp->errorMessage(), errormessagelength);
+				req->herr[errormessagelength] = '\0';
+			}
+			continue;
+		}
+
+		// a batch of rows is a job of its own
+		if (req->kind == FlashRequest::COLUMNS) {
+			columnJobs.push_back(req->job);
+			continue;
+		}
+
+		std::vector<FlashRequest*>& group = groups[req->fluid];
+		if (group.empty())
+			order.push_back(req->fluid);
+		group.push_back(req);
+	}
+
+	std::vector<RequestJob*> jobs;
+	for (size_t i = 0; i < order.size(); i++)
+		jobs.push_back(new RequestJob(groups[order[i]]));
+
+	std::vector<PoolJob*> all(jobs.begin(), jobs.end());
+	all.insert(all.end(), columnJobs.begin(), columnJobs.end());
+	EnginePool::instance()->run(all);
+
+	for (size_t i = 0; i < jobs.size(); i++) {
+		// a fluid that wouldn't load fails the job rather than the requests
+		if (jobs[i]->failed()) {
+			std::vector<FlashRequest*>& group = groups[order[i]];
+			for (size_t k = 0; k < group.size(); k++) {
+				group[k]->ierr = 1;
+				group[k]->badInput = true;
+				strcpy(group[k]->herr, jobs[i]->herr);
+			}
+		}
+		delete jobs[i];
+	}
+}
+
+void FlashExecutor::batchDone(uv_work_t* work, int status) {
+	FlashExecutor* ex = (FlashExecutor*) work->data;
+	if (ex->orphaned) {
+		delete ex;
+		return;
+	}
+
+	Isolate* iso = Isolate::GetCurrent();
+	HandleScope scope(iso);
+
+	for (size_t i = 0; i < ex->running.size(); i++) {
+		FlashRequest* req = ex->running[i];
+		Local<Promise::Resolver> resolver = Local<Promise::Resolver>::New(iso, req->resolver);
+
+		if (req->kind == FlashRequest::COLUMNS) {
+			req->job->finish(iso);
+			if (req->job->failed())
+				resolver->Reject(req->job->error(iso));
+			else
+				resolver->Resolve(Local<Value>::New(iso, req->result));
+		}
+		else if (req->kind == FlashRequest::FLASH && req->badInput)
+			resolver->Reject(Exception::TypeError(String::NewFromUtf8(iso, req->herr)));
+		else if (req->kind == FlashRequest::FLASH && (req->ierr <= 0 || req->statusErrors))
+			resolver->Resolve(flashResult(iso, &req->state, req->ierr, req->herr, req->want, req->lazy ? req->fluid : NULL));
+		else if (req->ierr != 0) {
+			// a fluid that didn't load is forgotten, unless another setFluidAsync has come along since
+			if (req->kind == FlashRequest::SET_FLUID && --ex->settingFluid == 0)
+				strcpy(ex->_fluid, ex->loadedFluid);
+			resolver->Reject(Exception::Error(String::NewFromUtf8(iso, req->herr)));
+		}
+		else {
+			strcpy(RefpropContext::selectedFluid, req->fluid);
+			strcpy(ex->loadedFluid, req->fluid);
+			ex->settingFluid--;
+			resolver->Resolve(Undefined(iso));
+		}
+
+		delete req;
+	}
+	ex->running.clear();
+	ex->busy = false;
+
+	// anything that came in while we were busy goes out as the next batch
+	if (!ex->pending.empty())
+		ex->startBatch();
+}
+
+void setFluidAsync(const FunctionCallbackInfo<Value>& args) {
+	Isolate* iso = args.GetIsolate();
+
+	if (args.Length() < 1) {
+		iso->ThrowException(Exception::TypeError(
+			String::NewFromUtf8(iso, "Must specify the fluid type when creating a refprop context")));
+		return;
+	}
+
+	if (!RefpropContext::instance(iso))  // make sure the library is loaded before we go off the js thread
+		return;
+	EnginePool::instance();
+
+	String::Utf8Value requestedFluid(args[0]->ToString());
+	FlashRequest* req = new FlashRequest(FlashRequest::SET_FLUID, iso);
+	strncpy(req->fluid, *requestedFluid, refpropcharlength-1);
+	req->fluid[refpropcharlength-1] = '\0';
+
+	args.GetReturnValue().Set(Local<Promise::Resolver>::New(iso, req->resolver)->GetPromise());
+
+	// flashes submitted from here on follow it, without waiting to hear whether it loads
+	FlashExecutor* ex = FlashExecutor::instance();
+	ex->fluidRequested(req->fluid);
+	ex->submit(req);
+}
+
+void statePointAsync(const FunctionCallbackInfo<Value>& args) {
+	const char* fluid = FlashExecutor::instance()->currentFluid();
+	if (fluidChosen(fluid, args.GetIsolate()))
+		flashAsync(args, fluid);
+}
+
+void flashAsync(const FunctionCallbackInfo<Value>& args, const char* fluid) {
+	Isolate* iso = args.GetIsolate();
+	// same arguments as statePoint.  malformed arguments throw right away; only refprop errors reject
+
+	if (args.Length() < 1) {
+		iso->ThrowException(Exception::TypeError(String::NewFromUtf8(iso, "Must provide quantities to establish thermodynamic state")));
+		return;
+	}
+
+	char props[2];
+	double values[2];
+	Composition comp;
+	FlashGuess guess;
+	if (!parseCoords(args[0], props, values, iso, &comp, &guess))
+		return;
+
+	PropertyMask want;
+	bool lazy;
+	if (!parseOutputs(args[1], &want, &lazy, iso))
+		return;
+
+	RefpropContext* rp = RefpropContext::instance(iso);
+	if (!rp)
+		return;
+	EnginePool::instance();
+
+	RefpropContext::FlashFcn flashFcn = rp->flashFcnLookup(props, iso);  // the table is never written after construction
+	if (NULL == flashFcn)
+		return;
+
+	FlashExecutor* ex = FlashExecutor::instance();
+	FlashRequest* req = new FlashRequest(FlashRequest::FLASH, iso);
+	strncpy(req->fluid, fluid, refpropcharlength-1);
+	req->fluid[refpropcharlength-1] = '\0';
+	req->props[0] = props[0]; req->props[1] = props[1];
+	req->vals[0] = values[0]; req->vals[1] = values[1];
+	req->comp = comp;
+	req->guess = guess;
+	req->flashFcn = flashFcn;
+	req->want = want;
+	req->lazy = lazy;
+
+	args.GetReturnValue().Set(Local<Promise::Resolver>::New(iso, req->resolver)->GetPromise());
+	ex->submit(req);
+}
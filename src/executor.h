@@ -0,0 +1,91 @@
+#ifndef NODE_REFPROP_EXECUTOR_H
+#define NODE_REFPROP_EXECUTOR_H
+
+#include <condition_variable>
+#include <mutex>
+#include <vector>
+
+#include "node-refprop.h"
+
+class PoolJob;
+
+// one queued call into refprop, made by the *Async functions
+class FlashRequest {
+public:
+	enum Kind { SET_FLUID, FLASH, COLUMNS };
+
+	FlashRequest(Kind kind, v8::Isolate* iso);
+	~FlashRequest();
+
+	Kind kind;
+	char fluid[refpropcharlength];  // the fluid to flash in, or to load for SET_FLUID
+
+	char props[2];
+	double vals[2];
+	Composition comp;
+	FlashGuess guess;
+	RefpropContext::FlashFcn flashFcn;
+	PropertyMask want;  // what the caller asked for; with lazy, transport is left to toJs's getters
+	bool lazy;
+	ThermoState state;
+
+	long ierr;
+	char herr[errormessagelength+1];
+	bool statusErrors;  // setErrorMode's, as of when the request was made
+	bool badInput;      // a composition that doesn't fit or a fluid that won't load, which rejects in either mode, like statePoint throws
+
+	PoolJob* job;  // a whole batch of rows, for COLUMNS, which resolves to result
+	v8::Persistent<v8::Value> result;
+
+	v8::Persistent<v8::Promise::Resolver> resolver;
+};
+
+// owns the refprop context on behalf of the *Async functions.  requests are queued on the js thread;
+// whatever has piled up while the previous batch was running goes to the libuv thread pool as one
+// batch, so there's never more than one thread inside refprop and a burst of requests only costs one
+// trip through the pool.  every js thread has its own executor on its own event loop, so promises
+// settle where they were made.  everything except runBatch runs on that thread.
+class FlashExecutor {
+public:
+	static FlashExecutor* instance();  // the calling thread's
+
+	// drops the calling thread's executor as its environment shuts down.  queued requests go unsettled,
+	// and a batch that's out on the thread pool is waited for, so nothing outlives the isolate's handles
+	static void release();
+
+	// hands the request to the executor, which resolves or rejects its promise and then deletes it
+	void submit(FlashRequest* req);
+
+	// requests flash in whatever fluid was most recently asked for at the time they were submitted.
+	// fluidChanged is for a fluid that has loaded; one still waiting on a setFluidAsync only holds
+	// until that rejects, and then requests go back to the last one that loaded
+	void fluidChanged(const char* fluid);
+	void fluidRequested(const char* fluid);  // by a setFluidAsync that's about to be submitted
+	const char* currentFluid();
+
+private:
+	FlashExecutor();
+
+	static thread_local FlashExecutor* _instance;
+
+	std::vector<FlashRequest*> pending;  // waiting for the next batch
+	std::vector<FlashRequest*> running;  // owned by the thread pool until batchDone
+	bool busy;
+	uv_loop_t* loop;
+	uv_work_t work;
+
+	std::mutex mutex;  // for release() to wait on runBatch
+	std::condition_variable ran;
+	bool batchRan;
+	bool orphaned;  // released while busy: batchDone only has to delete it
+	char _fluid[refpropcharlength];
+	char loadedFluid[refpropcharlength];
+	int settingFluid;  // setFluidAsync requests not yet settled
+
+	void startBatch();
+	static void runBatch(uv_work_t* work);
+	static void flashBatch(FlashExecutor* ex);
+	static void batchDone(uv_work_t* work, int status);
+};
+
+#endif
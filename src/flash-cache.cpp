@@ -0,0 +1,204 @@
+#include "flash-cache.h"
+#include "engine-pool.h"
+#include "disk-cache.h"
+
+using namespace v8;
+using namespace node;
+
+size_t FlashCache::defaultMaxEntries = 0;
+size_t FlashCache::defaultMaxBytes = 0;
+
+FlashCache::Key::Key(const char props[2], const double vals[2], const double z[ncmax]) {
+	memset(this, 0, sizeof(Key));  // the padding takes part in operator==
+
+	int first = props[0] <= props[1] ? 0 : 1;
+	this->props[0] = props[first];
+	this->props[1] = props[1-first];
+	this->vals[0] = vals[first];
+	this->vals[1] = vals[1-first];
+	memcpy(this->z, z, sizeof(this->z));
+}
+
+// compare bits rather than values, so a cached state is only ever handed back for the exact same inputs
+bool FlashCache::Key::operator==(const Key& other) const {
+	return memcmp(this, &other, sizeof(Key)) == 0;
+}
+
+size_t FlashCache::KeyHash::operator()(const Key& key) const {
+	unsigned long long bits[2];
+	memcpy(bits, key.vals, sizeof(bits));
+
+	unsigned long long h = ((unsigned long long)key.props[0] << 8) | (unsigned char)key.props[1];
+	for (int i = 0; i < 2; i++)
+		h ^= bits[i] + 0x9e3779b97f4a7c15ULL + (h << 6) + (h >> 2);
+
+	// a pure fluid's composition is always the same, so only mixtures get past the first fraction
+	for (int i = 0; i < ncmax && key.z[i] != 0 && key.z[i] != 1; i++) {
+		unsigned long long zbits;
+		memcpy(&zbits, &key.z[i], sizeof(zbits));
+		h ^= zbits + 0x9e3779b97f4a7c15ULL + (h << 6) + (h >> 2);
+	}
+	return (size_t)h;
+}
+
+FlashCache::Entry::Entry(const Key& key, const ThermoState& state) : key(key), state(state) {
+	// roughly what an entry costs: the list node and its slot in the index
+	this->size = sizeof(Entry) + 2*sizeof(void*) + sizeof(Key) + 3*sizeof(void*);
+}
+
+FlashCache::FlashCache() {
+	this->hits = this->misses = this->evictions = 0;
+	this->totalBytes = 0;
+	this->maxEntries = defaultMaxEntries;
+	this->maxBytes = defaultMaxBytes;
+}
+
+void FlashCache::configure(size_t maxEntries, size_t maxBytes) {
+	this->maxEntries = maxEntries;
+	this->maxBytes = maxBytes;
+	this->evict();
+}
+
+bool FlashCache::lookup(const char props[2], const double vals[2], ThermoState* obj) {
+	if (this->maxEntries == 0 || this->maxBytes == 0)
+		return false;
+
+	std::unordered_map<Key, LruList::iterator, KeyHash>::iterator it = this->index.find(Key(props, vals, obj->Z));
+	if (it == this->index.end()) {
+		this->misses++;
+		return false;
+	}
+
+	// bump it to the front
+	this->lru.splice(this->lru.begin(), this->lru, it->second);
+	*obj = it->second->state;
+	this->hits++;
+	return true;
+}
+
+void FlashCache::store(const char props[2], const double vals[2], const ThermoState* obj) {
+	if (this->maxEntries == 0 || this->maxBytes == 0)
+		return;
+
+	// a key that's already here is the same state with more transport properties filled in
+	Key key(props, vals, obj->Z);
+	std::unordered_map<Key, LruList::iterator, KeyHash>::iterator it = this->index.find(key);
+	if (it != this->index.end()) {
+		this->totalBytes -= it->second->size;
+		this->lru.erase(it->second);
+		this->index.erase(it);
+	}
+
+	this->lru.push_front(Entry(key, *obj));
+	this->index[key] = this->lru.begin();
+	this->totalBytes += this->lru.front().size;
+	this->evict();
+}
+
+void FlashCache::evict() {
+	while (!this->lru.empty() && (this->lru.size() > this->maxEntries || this->totalBytes > this->maxBytes)) {
+		this->totalBytes -= this->lru.back().size;
+		this->index.erase(this->lru.back().key);
+		this->lru.pop_back();
+		this->evictions++;
+	}
+}
+
+void FlashCache::clear() {
+	this->index.clear();
+	this->lru.clear();
+	this->totalBytes = 0;
+}
+
+size_t FlashCache::entries() {
+	return this->lru.size();
+}
+
+size_t FlashCache::bytes() {
+	return this->totalBytes;
+}
+
+void setCacheSize(const FunctionCallbackInfo<Value>& args) {
+	Isolate* iso = args.GetIsolate();
+	// args[0] is the most entries each engine may cache, args[1] (optional) the most bytes.  0 turns it off
+
+	if (args.Length() < 1 || !args[0]->IsNumber()) {
+		iso->ThrowException(Exception::TypeError(String::NewFromUtf8(iso, "Must specify the number of cache entries")));
+		return;
+	}
+
+	double entries = args[0]->NumberValue();
+	size_t maxBytes = (size_t)-1;
+	if (args.Length() > 1 && args[1]->IsNumber()) {
+		double bytes = args[1]->NumberValue();
+		maxBytes = bytes > 0 ? (size_t)bytes : 0;
+	}
+
+	RefpropContext* rp = RefpropContext::instance(iso);
+	if (!rp)
+		return;
+	RefpropLock lock(rp);
+
+	FlashCache::defaultMaxEntries = entries > 0 ? (size_t)entries : 0;
+	FlashCache::defaultMaxBytes = maxBytes;
+
+	EnginePool* pool = EnginePool::instance();
+	for (int i = 0; i < pool->size(); i++) {
+		RefpropContext* engine = pool->engine(i);
+		if (i > 0)
+			engine->lock();
+		engine->flashCache()->configure(FlashCache::defaultMaxEntries, FlashCache::defaultMaxBytes);
+		if (i > 0)
+			engine->unlock();
+	}
+}
+
+void getCacheStats(const FunctionCallbackInfo<Value>& args) {
+	Isolate* iso = args.GetIsolate();
+	// totals over every engine in the pool
+
+	RefpropContext* rp = RefpropContext::instance(iso);
+	if (!rp)
+		return;
+	RefpropLock lock(rp);
+
+	double hits = 0, misses = 0, evictions = 0, entries = 0, bytes = 0;
+
+	EnginePool* pool = EnginePool::instance();
+	for (int i = 0; i < pool->size(); i++) {
+		RefpropContext* engine = pool->engine(i);
+		if (i > 0)
+			engine->lock();
+
+		FlashCache* cache = engine->flashCache();
+		hits += cache->hits;
+		misses += cache->misses;
+		evictions += cache->evictions;
+		entries += cache->entries();
+		bytes += cache->bytes();
+
+		if (i > 0)
+			engine->unlock();
+	}
+
+	Local<Object> obj = Object::New(iso);
+	obj->Set(String::NewFromUtf8(iso, "hits"), Number::New(iso, hits));
+	obj->Set(String::NewFromUtf8(iso, "misses"), Number::New(iso, misses));
+	obj->Set(String::NewFromUtf8(iso, "evictions"), Number::New(iso, evictions));
+	obj->Set(String::NewFromUtf8(iso, "entries"), Number::New(iso, entries));
+	obj->Set(String::NewFromUtf8(iso, "bytes"), Number::New(iso, bytes));
+
+	// setDiskCache's, shared by the whole pool
+	DiskCache* disk = DiskCache::active;
+	if (disk) {
+		Local<Object> diskObj = Object::New(iso);
+		diskObj->Set(String::NewFromUtf8(iso, "hits"), Number::New(iso, (double)disk->hits));
+		diskObj->Set(String::NewFromUtf8(iso, "misses"), Number::New(iso, (double)disk->misses));
+		diskObj->Set(String::NewFromUtf8(iso, "stores"), Number::New(iso, (double)disk->stores));
+		diskObj->Set(String::NewFromUtf8(iso, "full"), Number::New(iso, (double)disk->full));
+		diskObj->Set(String::NewFromUtf8(iso, "entries"), Number::New(iso, (double)disk->entries()));
+		diskObj->Set(String::NewFromUtf8(iso, "capacity"), Number::New(iso, (double)disk->capacity()));
+		obj->Set(String::NewFromUtf8(iso, "disk"), diskObj);
+	}
+	args.GetReturnValue().Set(obj);
+}
@@ -0,0 +1,64 @@
+#ifndef NODE_REFPROP_FLASH_CACHE_H
+#define NODE_REFPROP_FLASH_CACHE_H
+
+#include <list>
+#include <unordered_map>
+
+#include "node-refprop.h"
+
+// bounded LRU memo of flash results for one RefpropContext.  it only ever holds states of the fluid
+// that context has loaded (loadFluid clears it whenever setup actually reruns), so entries are keyed
+// on the input pair, the exact bits of the input values and the composition they were flashed at.
+// off until setCacheSize gives it a budget.
+class FlashCache {
+public:
+	FlashCache();
+
+	// limits of 0 disable the cache; shrinking evicts right away
+	void configure(size_t maxEntries, size_t maxBytes);
+
+	// copies a cached state into obj and returns true, or counts a miss and returns false.  obj comes
+	// in with the composition to look for already in it (see RefpropContext::initState)
+	bool lookup(const char props[2], const double vals[2], ThermoState* obj);
+	void store(const char props[2], const double vals[2], const ThermoState* obj);
+	void clear();
+
+	size_t entries();
+	size_t bytes();
+	unsigned long long hits, misses, evictions;
+
+	// applied to every engine's cache, including ones the pool loads later
+	static size_t defaultMaxEntries, defaultMaxBytes;
+
+private:
+	struct Key {
+		char props[2];  // sorted, so {T, P} and {P, T} share entries
+		double vals[2];
+		double z[ncmax];
+
+		Key(const char props[2], const double vals[2], const double z[ncmax]);
+		bool operator==(const Key& other) const;
+	};
+
+	struct KeyHash {
+		size_t operator()(const Key& key) const;
+	};
+
+	struct Entry {
+		Key key;
+		ThermoState state;
+		size_t size;
+
+		Entry(const Key& key, const ThermoState& state);
+	};
+
+	typedef std::list<Entry> LruList;  // most recently used at the front
+
+	LruList lru;
+	std::unordered_map<Key, LruList::iterator, KeyHash> index;
+	size_t maxEntries, maxBytes, totalBytes;
+
+	void evict();
+};
+
+#endif
@@ -0,0 +1,316 @@
+#include <math.h>
+#include <string.h>
+#include <set>
+#include <string>
+
+#include "flash-plan.h"
+#include "engine-pool.h"
+#include "fluids.h"
+#include "broker.h"
+
+using namespace v8;
+using namespace node;
+
+// the units compile() knows besides the SI ones, by the SI unit they stand in for
+static const struct {
+	const char* name;
+	const char* si;
+	double scale, offset;
+} knownUnits[] = {
+	{ "C", "K", 1, 273.15 },
+	{ "F", "K", 5.0 / 9, 273.15 - 32 * 5.0 / 9 },
+	{ "R", "K", 5.0 / 9, 0 },
+	{ "kPa", "Pa", 1e3, 0 },
+	{ "MPa", "Pa", 1e6, 0 },
+	{ "bar", "Pa", 1e5, 0 },
+	{ "atm", "Pa", 101325, 0 },
+	{ "psi", "Pa", 6894.757293168, 0 },
+	{ "g/cm3", "kg/m3", 1e3, 0 },
+	{ "kJ/kg", "J/kg", 1e3, 0 },
+	{ "kJ/(kg K)", "J/(kg K)", 1e3, 0 },
+	{ "mW/(m K)", "W/(m K)", 1e-3, 0 },
+	{ "mPa s", "Pa s", 1e-3, 0 },
+	{ "uPa s", "Pa s", 1e-6, 0 },
+	{ "mN/m", "N/m", 1e-3, 0 },
+};
+
+// the plans this js thread has handed out.  v8 doesn't run weak callbacks for an isolate that's going
+// away, so whatever's left here when the environment shuts down is freed by releasePlans
+static thread_local std::set<FlashPlan*> livePlans;
+
+void FlashPlan::release(const WeakCallbackInfo<FlashPlan>& data) {
+	FlashPlan* plan = data.GetParameter();
+	livePlans.erase(plan);
+	plan->function.Reset();
+	delete plan;
+}
+
+void releasePlans() {
+	for (std::set<FlashPlan*>::iterator it = livePlans.begin(); it != livePlans.end(); ++it) {
+		(*it)->function.Reset();
+		delete *it;
+	}
+	livePlans.clear();
+}
+
+// the unit units[name] gives for property idx, or SI if there isn't one.  false if it threw
+static bool parseUnit(Local<Object> units, const char* name, int idx, UnitScale* unit, Isolate* iso) {
+	Local<Value> val = units->Get(String::NewFromUtf8(iso, name));
+	if (val->IsUndefined())
+		return true;
+	if (idx < 0) {
+		iso->ThrowException(Exception::TypeError(String::NewFromUtf8(iso, (std::string("Unknown property ") + name).c_str())));
+		return false;
+	}
+
+	String::Utf8Value text(val->ToString());
+	const char* si = ThermoState::propertyUnit(idx);
+	if (strcmp(*text, si) == 0)
+		return true;
+	for (size_t i = 0; i < sizeof(knownUnits) / sizeof(knownUnits[0]); i++) {
+		if (strcmp(*text, knownUnits[i].name) == 0 && strcmp(si, knownUnits[i].si) == 0) {
+			unit->scale = knownUnits[i].scale;
+			unit->offset = knownUnits[i].offset;
+			return true;
+		}
+	}
+
+	std::string msg = std::string(*text) + " isn't a unit of " + name + ", which is in " + si;
+	iso->ThrowException(Exception::TypeError(String::NewFromUtf8(iso, msg.c_str())));
+	return false;
+}
+
+// a column of rows through a plan, spread over the engine pool
+class PlanJob : public PoolJob {
+public:
+	PlanJob(size_t rows, const FlashPlan* plan) : PoolJob(rows, plan->fluid), plan(plan) {}
+
+	const FlashPlan* plan;
+	const double* in[2];
+	std::vector<double*> out;
+	bool statusErrors;
+
+	void runRows(RefpropContext* rp, size_t begin, size_t end) {
+		const FlashPlan* plan = this->plan;
+		ThermoState state;
+
+		for (size_t i = begin; i < end; i++) {
+			double vals[2] = { plan->in[0].toSI(this->in[0][i]), plan->in[1].toSI(this->in[1][i]) };
+			rp->initState(&state);
+			long ierr = rp->flash(plan->flashFcn, plan->props, vals, &state, plan->want);
+			if (ierr > 0 && !this->statusErrors) {
+				this->fail(i, rp->errorMessage());
+				return;
+			}
+			for (size_t j = 0; j < this->out.size(); j++)
+				this->out[j][i] = ierr > 0 ? NAN : plan->out[j].fromSI(state.property(plan->outIdx[j]));
+		}
+	}
+};
+
+// plan(colA, colB): Float64Arrays in, a Float64Array (or an object of them) out.  failed rows throw,
+// or come back NaN in status mode
+static void planColumns(const FunctionCallbackInfo<Value>& args, FlashPlan* plan, bool single) {
+	Isolate* iso = args.GetIsolate();
+
+	size_t rows, len;
+	double* in[2];
+	if (!float64Data(args[0], &in[0], &rows) || !float64Data(args[1], &in[1], &len) || len != rows) {
+		iso->ThrowException(Exception::TypeError(String::NewFromUtf8(iso, "Input columns must be Float64Arrays of the same length")));
+		return;
+	}
+
+	RefpropContext* rp = RefpropContext::instance(iso);
+	if (!rp)
+		return;
+	RefpropLock lock(rp);
+
+	PlanJob job(rows, plan);
+	job.in[0] = in[0];
+	job.in[1] = in[1];
+	job.statusErrors = RefpropContext::statusErrors;
+
+	std::vector<Local<Float64Array> > columns;
+	for (size_t j = 0; j < plan->outIdx.size(); j++) {
+		Local<ArrayBuffer> buffer = ArrayBuffer::New(iso, rows * sizeof(double));
+		columns.push_back(Float64Array::New(buffer, 0, rows));
+		job.out.push_back((double*)buffer->GetContents().Data());
+	}
+
+	FluidScheduler::noteFluid(plan->fluid);
+	EnginePool::instance()->run(&job);
+	if (job.failed()) {
+		iso->ThrowException(job.error(iso));
+		return;
+	}
+
+	if (single) {
+		args.GetReturnValue().Set(columns[0]);
+		return;
+	}
+	Local<Object> result = Object::New(iso);
+	for (size_t j = 0; j < columns.size(); j++)
+		result->Set(propertyKey(iso, plan->outIdx[j]), columns[j]);
+	args.GetReturnValue().Set(result);
+}
+
+// what compile() hands back.  there's a copy for each shape of result, so which one it is never gets
+// looked at per call: a bare number for a plan with one output, named as a string, or an object
+template <bool single>
+static void planCall(const FunctionCallbackInfo<Value>& args) {
+	Isolate* iso = args.GetIsolate();
+	FlashPlan* plan = (FlashPlan*)Local<External>::Cast(args.Data())->Value();
+
+	if (args.Length() < 2) {
+		iso->ThrowException(Exception::TypeError(String::NewFromUtf8(iso, "Must provide both inputs")));
+		return;
+	}
+	if (!args[0]->IsNumber()) {
+		planColumns(args, plan, single);
+		return;
+	}
+
+	double vals[2] = { plan->in[0].toSI(args[0]->NumberValue()), plan->in[1].toSI(args[1]->NumberValue()) };
+
+	RefpropContext* rp = EnginePool::instance()->engineFor(plan->fluid);
+	RefpropLock lock(rp, true);
+	if (rp->loadFluid(plan->fluid) != 0) {
+		iso->ThrowException(Exception::TypeError(String::NewFromUtf8(iso, rp->errorMessage())));
+		return;
+	}
+
+	ThermoState state;
+	rp->initState(&state);
+	long ierr = rp->flash(plan->flashFcn, plan->props, vals, &state, plan->want);
+	if (ierr > 0 && !RefpropContext::statusErrors) {
+		iso->ThrowException(Exception::TypeError(String::NewFromUtf8(iso, rp->errorMessage())));
+		return;
+	}
+
+	if (single) {
+		args.GetReturnValue().Set(ierr > 0 ? NAN : plan->out[0].fromSI(state.property(plan->outIdx[0])));
+		return;
+	}
+
+	Local<Object> result = Object::New(iso);
+	for (size_t j = 0; j < plan->outIdx.size(); j++)
+		result->Set(propertyKey(iso, plan->outIdx[j]), Number::New(iso, ierr > 0 ? NAN : plan->out[j].fromSI(state.property(plan->outIdx[j]))));
+	if (ierr != 0 || RefpropContext::statusErrors)
+		result->Set(String::NewFromUtf8(iso, "ierr"), Number::New(iso, (double)ierr));
+	if (ierr != 0)
+		result->Set(String::NewFromUtf8(iso, "herr"), statusMessage(iso, rp->errorMessage()));
+	args.GetReturnValue().Set(result);
+}
+
+void compile(const FunctionCallbackInfo<Value>& args) {
+	if (fluidChosen(RefpropContext::selectedFluid, args.GetIsolate()))
+		planCompile(args, RefpropContext::selectedFluid);
+}
+
+void planCompile(const FunctionCallbackInfo<Value>& args, const char* fluid) {
+	Isolate* iso = args.GetIsolate();
+	// args[0] is {inputs: 'PH', outputs: ['T', 'D', 'S'], units: {P: 'kPa', T: 'C'}}.  inputs can also be
+	// ['P', 'H'], and outputs one name, 'T', for a plan that returns bare numbers.  units are for inputs
+	// and outputs alike; anything left out stays SI.  returns a function of the two inputs, plan(p, h),
+	// that returns {T, D, S}.  given two Float64Arrays, it returns a Float64Array for each output.
+	// the plan keeps the fluid selected now (or the handle's), whatever setFluid picks later.  a state
+	// that won't flash throws, or comes back as NaN (with ierr and herr on an object) in status mode
+
+	if (args.Length() < 1 || !args[0]->IsObject()) {
+		iso->ThrowException(Exception::TypeError(String::NewFromUtf8(iso, "Must provide the plan's inputs and outputs")));
+		return;
+	}
+	Local<Object> options = args[0]->ToObject();
+
+	std::unique_ptr<FlashPlan> plan(new FlashPlan());
+	strncpy(plan->fluid, fluid, refpropcharlength-1);
+	plan->fluid[refpropcharlength-1] = '\0';
+
+	std::string inputNames[2];
+	Local<Value> inputs = options->Get(String::NewFromUtf8(iso, "inputs"));
+	if (inputs->IsArray() && Local<Array>::Cast(inputs)->Length() == 2) {
+		for (uint32_t i = 0; i < 2; i++)
+			inputNames[i] = *String::Utf8Value(Local<Array>::Cast(inputs)->Get(i)->ToString());
+	}
+	else if (inputs->IsString()) {
+		String::Utf8Value pair(inputs);
+		if (pair.length() == 2) {
+			inputNames[0] = std::string(1, (*pair)[0]);
+			inputNames[1] = std::string(1, (*pair)[1]);
+		}
+	}
+	if (inputNames[0].size() != 1 || inputNames[1].size() != 1) {
+		iso->ThrowException(Exception::TypeError(String::NewFromUtf8(iso, "Thermodynamic state established by exactly 2 values")));
+		return;
+	}
+	plan->props[0] = inputNames[0][0];
+	plan->props[1] = inputNames[1][0];
+
+	std::vector<std::string> outputNames;
+	Local<Value> outputs = options->Get(String::NewFromUtf8(iso, "outputs"));
+	bool single = outputs->IsString();
+	if (single)
+		outputNames.push_back(*String::Utf8Value(outputs));
+	else if (outputs->IsArray()) {
+		Local<Array> list = Local<Array>::Cast(outputs);
+		for (uint32_t i = 0; i < list->Length(); i++)
+			outputNames.push_back(*String::Utf8Value(list->Get(i)->ToString()));
+	}
+	if (outputNames.empty()) {
+		iso->ThrowException(Exception::TypeError(String::NewFromUtf8(iso, "A plan needs at least one output")));
+		return;
+	}
+
+	plan->want = allProperties & ~transportMask;
+	for (size_t j = 0; j < outputNames.size(); j++) {
+		int idx = ThermoState::propertyIndex(outputNames[j].c_str());
+		if (idx < 0) {
+			iso->ThrowException(Exception::TypeError(String::NewFromUtf8(iso, "Unknown property requested")));
+			return;
+		}
+		plan->outIdx.push_back(idx);
+		plan->out.push_back(UnitScale());
+		plan->want |= propertyBit(idx);
+	}
+
+	// an input pair we can't flash has no units to look up either
+	RefpropContext* rp = RefpropContext::instance(iso);
+	if (!rp)
+		return;
+
+	plan->flashFcn = rp->flashFcnLookup(plan->props, iso);
+	if (!plan->flashFcn)
+		return;
+
+	Local<Value> units = options->Get(String::NewFromUtf8(iso, "units"));
+	if (units->IsObject()) {
+		Local<Object> table = units->ToObject();
+		for (int i = 0; i < 2; i++)
+			if (!parseUnit(table, inputNames[i].c_str(), ThermoState::propertyIndex(inputNames[i].c_str()), &plan->in[i], iso))
+				return;
+		for (size_t j = 0; j < outputNames.size(); j++)
+			if (!parseUnit(table, outputNames[j].c_str(), plan->outIdx[j], &plan->out[j], iso))
+				return;
+	}
+	else if (!units->IsUndefined()) {
+		iso->ThrowException(Exception::TypeError(String::NewFromUtf8(iso, "units must be an object of unit names")));
+		return;
+	}
+
+	// a fluid that won't load should fail here rather than on the first call
+	{
+		RefpropContext* engine = EnginePool::instance()->engineFor(plan->fluid);
+		RefpropLock lock(engine, true);
+		if (engine->loadFluid(plan->fluid) != 0) {
+			iso->ThrowException(Exception::TypeError(String::NewFromUtf8(iso, engine->errorMessage())));
+			return;
+		}
+	}
+
+	FunctionCallback call = single ? brokered<planCall<true> > : brokered<planCall<false> >;
+	Local<Function> function = FunctionTemplate::New(iso, call, External::New(iso, plan.get()))->GetFunction();
+	plan->function.Reset(iso, function);
+	plan->function.SetWeak(plan.get(), FlashPlan::release, WeakCallbackType::kParameter);
+	livePlans.insert(plan.release());
+	args.GetReturnValue().Set(function);
+}
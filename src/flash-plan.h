@@ -0,0 +1,37 @@
+#ifndef NODE_REFPROP_FLASH_PLAN_H
+#define NODE_REFPROP_FLASH_PLAN_H
+
+#include <vector>
+
+#include "node-refprop.h"
+
+// a unit a caller can use in place of a property's SI one: si = value * scale + offset
+struct UnitScale {
+	double scale, offset;
+
+	UnitScale() : scale(1), offset(0) {}
+	double toSI(double value) const { return value * this->scale + this->offset; }
+	double fromSI(double value) const { return (value - this->offset) / this->scale; }
+};
+
+// statePoint with everything but the flash done ahead of time.  compile() resolves the fluid, the input
+// pair's flash function, the outputs, their keys and any unit conversions once, and hands back a native
+// function that does nothing per call but convert, flash and copy out.  the plan lives as long as that
+// function does
+struct FlashPlan {
+	char fluid[refpropcharlength];
+	char props[2];
+	RefpropContext::FlashFcn flashFcn;
+	PropertyMask want;
+	UnitScale in[2];
+	std::vector<int> outIdx;
+	std::vector<UnitScale> out;
+
+	v8::Persistent<v8::Function> function;
+
+	static void release(const v8::WeakCallbackInfo<FlashPlan>& data);
+};
+
+void releasePlans();  // every plan the calling thread still has, as its environment shuts down
+
+#endif
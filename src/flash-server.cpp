@@ -0,0 +1,638 @@
+#include <errno.h>
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+#include <algorithm>
+#include <set>
+
+#ifndef _WIN32
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+#endif
+
+#include "flash-server.h"
+#include "engine-pool.h"
+#include "broker.h"
+
+using namespace v8;
+using namespace node;
+
+#define ringMagic "RPRING"
+#define ringVersion 1
+#define ringByteOrder 0x01020304
+
+// the two processes share head and tail through the mapping, which only works if they're real atomics
+static_assert(ATOMIC_LLONG_LOCK_FREE == 2, "the flash server needs lock-free 64-bit atomics");
+
+struct RingHeader {
+	char magic[8];
+	uint32_t version;
+	uint32_t byteOrder;
+	uint64_t slots;
+	uint64_t recordBytes;  // sizeof(RingRecord), which changes along with ThermoState
+	char fluid[refpropcharlength];  // what the rows are in.  only changed while the ring is empty
+	alignas(64) std::atomic<uint64_t> head;  // rows written so far; only the client moves it
+	alignas(64) std::atomic<uint64_t> tail;  // rows answered so far; only the server moves it
+};
+
+struct RingRecord {
+	char props[2];
+	double vals[2];
+	PropertyMask want;
+	int64_t ierr;
+	char herr[errormessagelength+1];
+	ThermoState state;
+};
+
+// the records start on a cache line of their own
+#define recordsOffset ((sizeof(RingHeader) + 63) / 64 * 64)
+
+#ifndef _WIN32
+
+static bool sendAll(int fd, const void* data, size_t length) {
+	const char* p = (const char*)data;
+	while (length > 0) {
+		ssize_t sent = send(fd, p, length, MSG_NOSIGNAL);
+		if (sent < 0 && errno == EINTR)
+			continue;
+		if (sent <= 0)
+			return false;
+		p += sent;
+		length -= (size_t)sent;
+	}
+	return true;
+}
+
+static bool recvAll(int fd, void* data, size_t length) {
+	char* p = (char*)data;
+	while (length > 0) {
+		ssize_t got = recv(fd, p, length, 0);
+		if (got < 0 && errno == EINTR)
+			continue;
+		if (got <= 0)
+			return false;
+		p += got;
+		length -= (size_t)got;
+	}
+	return true;
+}
+
+static bool socketAddress(const char* path, struct sockaddr_un* addr, char* err) {
+	memset(addr, 0, sizeof(*addr));
+	addr->sun_family = AF_UNIX;
+	if (strlen(path) >= sizeof(addr->sun_path)) {
+		snprintf(err, errormessagelength, "Socket path %s is too long", path);
+		return false;
+	}
+	strcpy(addr->sun_path, path);
+	return true;
+}
+
+// a slice of a client's ring, from tail up to head, spread over the pool like any other batch.  a row
+// that won't flash keeps its own error, so the job only fails when the fluid won't load
+class RingJob : public PoolJob {
+public:
+	RingJob(RingRecord* records, size_t slots, uint64_t first, size_t rows, const char* fluid)
+		: PoolJob(rows, fluid), records(records), slots(slots), first(first) {}
+
+	void runRows(RefpropContext* rp, size_t begin, size_t end) {
+		for (size_t i = begin; i < end; i++) {
+			RingRecord* r = &this->records[(this->first + i) % this->slots];
+
+			RefpropContext::FlashFcn flashFcn = rp->findFlashFcn(r->props);
+			if (!flashFcn) {
+				r->ierr = 1;
+				strcpy(r->herr, "Property combination not supported!");
+				continue;
+			}
+			r->ierr = rp->initState(&r->state);
+			if (r->ierr == 0)
+				r->ierr = rp->flash(flashFcn, r->props, r->vals, &r->state, r->want);
+			if (r->ierr != 0) {
+				strncpy(r->herr, rp->errorMessage(), errormessagelength);
+				r->herr[errormessagelength] = '\0';
+			}
+		}
+	}
+
+private:
+	RingRecord* records;
+	size_t slots;
+	uint64_t first;
+};
+
+FlashServer::FlashServer() : slots(0), listener(-1), stopping(false), serial(0) {
+}
+
+FlashServer* FlashServer::start(const char* path, size_t slots, char* err) {
+	struct sockaddr_un addr;
+	if (!socketAddress(path, &addr, err))
+		return NULL;
+
+	int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+	if (fd < 0) {
+		snprintf(err, errormessagelength, "Couldn't open a socket: %s", strerror(errno));
+		return NULL;
+	}
+
+	// a socket left over from a server that didn't get to clean up can go, but nothing else at the path
+	// can: not a file someone pointed us at, and not a server that's still answering
+	struct stat st;
+	if (lstat(path, &st) == 0) {
+		if (!S_ISSOCK(st.st_mode)) {
+			snprintf(err, errormessagelength, "Couldn't listen on %s: something other than a socket is there", path);
+			::close(fd);
+			return NULL;
+		}
+		int probe = socket(AF_UNIX, SOCK_STREAM, 0);
+		int answered = probe < 0 ? -1 : connect(probe, (struct sockaddr*)&addr, sizeof(addr));
+		int why = errno;
+		if (probe >= 0)
+			::close(probe);
+		if (answered == 0 || why != ECONNREFUSED) {
+			snprintf(err, errormessagelength, "Couldn't listen on %s: %s", path, answered == 0 ? "already serving" : strerror(why));
+			::close(fd);
+			return NULL;
+		}
+		unlink(path);
+	}
+	if (bind(fd, (struct sockaddr*)&addr, sizeof(addr)) != 0 || listen(fd, 64) != 0) {
+		snprintf(err, errormessagelength, "Couldn't listen on %s: %s", path, strerror(errno));
+		::close(fd);
+		return NULL;
+	}
+
+	FlashServer* server = new FlashServer();
+	server->path = path;
+	server->slots = slots;
+	server->listener = fd;
+	server->acceptor = std::thread(&FlashServer::acceptLoop, server);
+	return server;
+}
+
+FlashServer::~FlashServer() {
+	this->stopping = true;
+	shutdown(this->listener, SHUT_RDWR);
+	this->acceptor.join();
+	::close(this->listener);
+	unlink(this->path.c_str());
+
+	// hanging up wakes each connection out of recv, and it sees itself out
+	std::unique_lock<std::mutex> lock(this->mutex);
+	for (size_t i = 0; i < this->clients.size(); i++)
+		shutdown(this->clients[i], SHUT_RDWR);
+	this->idle.wait(lock, [this] { return this->clients.empty(); });
+}
+
+void FlashServer::acceptLoop() {
+	for (;;) {
+		int fd = accept(this->listener, NULL, NULL);
+		if (fd < 0) {
+			if (this->stopping)
+				return;
+			if (errno == EINTR || errno == ECONNABORTED)
+				continue;
+			return;
+		}
+
+		std::lock_guard<std::mutex> lock(this->mutex);
+		if (this->stopping) {
+			::close(fd);
+			return;
+		}
+		this->clients.push_back(fd);
+		std::thread(&FlashServer::serve, this, fd, ++this->serial).detach();
+	}
+}
+
+// one client, from handing it its ring until it hangs up
+void FlashServer::serve(int fd, unsigned long id) {
+	char ring[filepathlength+1] = {0};  // sent whole, so none of the stack goes along with the name
+	char err[errormessagelength+1];
+	snprintf(ring, sizeof(ring), "%s.%lu", this->path.c_str(), id);
+
+	// every row a client flashes passes through here, so nobody else gets to open it.  anything left at
+	// the name (by a server that died before its client got round to the ack, say) goes first; if
+	// something puts it back in the meantime, the create fails rather than writing through it
+	MappedFile file;
+	unlink(ring);
+	bool ok = file.create(ring, recordsOffset + this->slots * sizeof(RingRecord), err, true);
+	if (ok) {
+		RingHeader* h = (RingHeader*)file.data;
+		memcpy(h->magic, ringMagic, sizeof(ringMagic));
+		h->version = ringVersion;
+		h->byteOrder = ringByteOrder;
+		h->slots = this->slots;
+		h->recordBytes = sizeof(RingRecord);
+		h->fluid[0] = '\0';
+		h->head.store(0);
+		h->tail.store(0);
+
+		// the client maps the ring by name and says so, and then the name can go
+		char ack;
+		ok = sendAll(fd, ring, sizeof(ring)) && recvAll(fd, &ack, 1);
+		unlink(ring);
+	}
+
+	while (ok) {
+		char bells[64];
+		ssize_t got = recv(fd, bells, sizeof(bells), 0);
+		if (got < 0 && errno == EINTR)
+			continue;
+		if (got <= 0)
+			break;  // the client hung up, or we're stopping
+
+		RingHeader* h = (RingHeader*)file.data;
+		uint64_t tail = h->tail.load(std::memory_order_relaxed);
+		uint64_t head = h->head.load(std::memory_order_acquire);
+		if (head - tail > this->slots)
+			break;  // a client that's lost track of the ring
+
+		if (head != tail)
+			this->flashRows(h, (RingRecord*)(file.data + recordsOffset), tail, head);
+		h->tail.store(head, std::memory_order_release);
+		ok = sendAll(fd, "r", 1);
+	}
+
+	// closed under the lock, so the number can't be reused for a new client while it's still listed
+	std::lock_guard<std::mutex> lock(this->mutex);
+	this->clients.erase(std::find(this->clients.begin(), this->clients.end(), fd));
+	::close(fd);
+	this->idle.notify_all();
+}
+
+void FlashServer::flashRows(RingHeader* h, RingRecord* records, uint64_t tail, uint64_t head) {
+	char fluid[refpropcharlength];
+	memcpy(fluid, h->fluid, refpropcharlength);
+	fluid[refpropcharlength-1] = '\0';
+
+	RingJob job(records, this->slots, tail, (size_t)(head - tail), fluid);
+	{
+		// engine 0 is what the pool wants held, the same as any synchronous batch
+		Broker::Session session;
+		RefpropContext* rp = RefpropContext::instance(NULL);  // loaded by serve()
+		RefpropLock lock(rp);
+		EnginePool::instance()->run(&job);
+	}
+
+	if (job.failed())
+		for (uint64_t row = tail; row < head; row++) {
+			RingRecord* r = &records[row % this->slots];
+			r->ierr = 1;
+			strcpy(r->herr, job.herr);
+		}
+}
+
+FlashClient::FlashClient() : fd(-1), header(NULL), records(NULL), slots(0) {
+	this->fluid[0] = '\0';
+}
+
+FlashClient::~FlashClient() {
+	this->close();
+	this->handle.Reset();
+}
+
+void FlashClient::close() {
+	if (this->fd >= 0)
+		::close(this->fd);
+	this->fd = -1;
+}
+
+FlashClient* FlashClient::connect(const char* path, char* err) {
+	struct sockaddr_un addr;
+	if (!socketAddress(path, &addr, err))
+		return NULL;
+
+	std::unique_ptr<FlashClient> client(new FlashClient());
+	client->fd = socket(AF_UNIX, SOCK_STREAM, 0);
+	if (client->fd < 0 || ::connect(client->fd, (struct sockaddr*)&addr, sizeof(addr)) != 0) {
+		snprintf(err, errormessagelength, "Couldn't connect to %s: %s", path, strerror(errno));
+		return NULL;
+	}
+
+	char ring[filepathlength+1];
+	if (!recvAll(client->fd, ring, sizeof(ring))) {
+		snprintf(err, errormessagelength, "%s hung up before handing over a ring", path);
+		return NULL;
+	}
+	ring[filepathlength] = '\0';
+	if (!client->file.open(ring, err, true))
+		return NULL;
+
+	RingHeader* h = (RingHeader*)client->file.data;
+	if (client->file.size < recordsOffset || memcmp(h->magic, ringMagic, sizeof(ringMagic)) != 0 || h->version != ringVersion ||
+			h->byteOrder != ringByteOrder || h->recordBytes != sizeof(RingRecord) || h->slots == 0 ||
+			h->slots > (client->file.size - recordsOffset) / sizeof(RingRecord)) {
+		snprintf(err, errormessagelength, "The server on %s is a different build", path);
+		return NULL;
+	}
+	if (!sendAll(client->fd, "a", 1)) {
+		snprintf(err, errormessagelength, "%s hung up before the ring was mapped", path);
+		return NULL;
+	}
+
+	client->header = h;
+	client->records = (RingRecord*)(client->file.data + recordsOffset);
+	client->slots = (size_t)h->slots;
+	return client.release();
+}
+
+bool FlashClient::flash(const char* fluid, const char props[2], double* const in[2], size_t rows, PropertyMask want,
+		const std::function<void(size_t row, long ierr, const char* herr, ThermoState* state)>& done, char* err) {
+	if (this->fd < 0) {
+		strcpy(err, "The connection to the flash server is closed");
+		return false;
+	}
+
+	// every call leaves the ring empty, so the fluid can change in between
+	strncpy(this->header->fluid, fluid, refpropcharlength-1);
+	this->header->fluid[refpropcharlength-1] = '\0';
+
+	uint64_t first = this->header->head.load(std::memory_order_relaxed);
+	uint64_t head = first, read = first, end = first + rows;
+	while (read < end) {
+		// whatever the server's answered and we've copied out is free again
+		uint64_t limit = std::min(end, read + this->slots);
+		if (head < limit) {
+			for (; head < limit; head++) {
+				RingRecord* r = &this->records[head % this->slots];
+				size_t row = (size_t)(head - first);
+				r->props[0] = props[0];
+				r->props[1] = props[1];
+				r->vals[0] = in[0][row];
+				r->vals[1] = in[1][row];
+				r->want = want;
+			}
+			this->header->head.store(head, std::memory_order_release);
+			if (!sendAll(this->fd, "d", 1))
+				break;
+		}
+
+		// a doorbell can be left over from a previous round, so it's tail that says whether anything's back
+		uint64_t tail;
+		char bell;
+		while ((tail = this->header->tail.load(std::memory_order_acquire)) == read && recvAll(this->fd, &bell, 1))
+			;
+		if (tail == read)
+			break;
+
+		for (; read < tail; read++) {
+			RingRecord* r = &this->records[read % this->slots];
+			done((size_t)(read - first), (long)r->ierr, r->herr, &r->state);
+		}
+	}
+
+	if (read < end) {
+		strcpy(err, "Lost the connection to the flash server");
+		this->close();
+		return false;
+	}
+	return true;
+}
+
+#endif
+
+// one server per process, whichever js thread starts it
+static FlashServer* server = NULL;
+static std::mutex serverMutex;
+
+void serve(const FunctionCallbackInfo<Value>& args) {
+	Isolate* iso = args.GetIsolate();
+	// args[0] is the unix socket to listen on; null stops serving.  args[1] is optionally {slots: 1024},
+	// the records in each client's ring.  the clients flash on this process's engines and caches, so
+	// setEngines, setCacheSize and setDiskCache here apply to all of them
+
+#ifdef _WIN32
+	iso->ThrowException(Exception::Error(String::NewFromUtf8(iso, "The flash server needs unix sockets")));
+#else
+	bool off = args.Length() < 1 || args[0]->IsNull() || args[0]->IsUndefined() || args[0]->IsFalse();
+	size_t slots = FlashServer::defaultSlots;
+	if (!off && args.Length() > 1 && args[1]->IsObject()) {
+		Local<Value> val = args[1]->ToObject()->Get(String::NewFromUtf8(iso, "slots"));
+		if (val->IsNumber() && val->NumberValue() >= 1)
+			slots = (size_t)val->NumberValue();
+	}
+
+	if (!off) {
+		if (!RefpropContext::instance(iso))
+			return;
+		EnginePool::instance();
+	}
+
+	std::lock_guard<std::mutex> lock(serverMutex);
+	delete server;
+	server = NULL;
+	if (off)
+		return;
+
+	String::Utf8Value path(args[0]->ToString());
+	char err[errormessagelength+1];
+	server = FlashServer::start(*path, slots, err);
+	if (!server)
+		iso->ThrowException(Exception::Error(String::NewFromUtf8(iso, err)));
+#endif
+}
+
+#ifndef _WIN32
+
+// handles are per isolate, like the fluid handles'
+static thread_local Persistent<FunctionTemplate> clientTemplate;
+static thread_local std::set<FlashClient*> liveClients;
+
+static void releaseClient(const WeakCallbackInfo<FlashClient>& data) {
+	FlashClient* client = data.GetParameter();
+	liveClients.erase(client);
+	delete client;
+}
+
+// the client a method was called on, or NULL (with an exception thrown) if it wasn't called on one
+static FlashClient* holderClient(const FunctionCallbackInfo<Value>& args) {
+	Isolate* iso = args.GetIsolate();
+	Local<Object> holder = args.Holder();
+
+	if (!Local<FunctionTemplate>::New(iso, clientTemplate)->HasInstance(holder)) {
+		iso->ThrowException(Exception::TypeError(String::NewFromUtf8(iso, "Must be called on a flash client")));
+		return NULL;
+	}
+	return (FlashClient*)Local<External>::Cast(holder->GetInternalField(0))->Value();
+}
+
+static void clientSetFluid(const FunctionCallbackInfo<Value>& args) {
+	Isolate* iso = args.GetIsolate();
+	FlashClient* client = holderClient(args);
+	if (!client)
+		return;
+
+	String::Utf8Value requestedFluid(args.Length() > 0 ? args[0]->ToString() : String::Empty(iso));
+	if (requestedFluid.length() == 0 || requestedFluid.length() >= refpropcharlength) {
+		iso->ThrowException(Exception::TypeError(String::NewFromUtf8(iso, "Error loading fluid requested fluid!")));
+		return;
+	}
+	strcpy(client->fluid, *requestedFluid);
+}
+
+// statePointBatch, flashed by the server.  the same arguments, less the mixture and hint options: the
+// pair, the two input columns, the output columns and optionally {errors, status}.  the fluid is the one
+// the client's setFluid picked, and the server only says whether it loads once the rows get there
+static void clientStatePointBatch(const FunctionCallbackInfo<Value>& args) {
+	Isolate* iso = args.GetIsolate();
+	FlashClient* client = holderClient(args);
+	if (!client)
+		return;
+
+	if (args.Length() < 4 || !args[3]->IsObject()) {
+		iso->ThrowException(Exception::TypeError(String::NewFromUtf8(iso, "Must provide an input pair, two input columns and an object of output columns")));
+		return;
+	}
+	if (!client->fluid[0]) {
+		iso->ThrowException(Exception::TypeError(String::NewFromUtf8(iso, "Must choose the client's fluid with setFluid first")));
+		return;
+	}
+
+	String::Utf8Value pair(args[0]->ToString());
+	if (pair.length() != 2) {
+		iso->ThrowException(Exception::TypeError(String::NewFromUtf8(iso, "Thermodynamic state established by exactly 2 values")));
+		return;
+	}
+
+	size_t rows, len;
+	double* in[2];
+	if (!float64Data(args[1], &in[0], &rows) || !float64Data(args[2], &in[1], &len) || len != rows) {
+		iso->ThrowException(Exception::TypeError(String::NewFromUtf8(iso, "Input columns must be Float64Arrays of the same length")));
+		return;
+	}
+
+	Local<Array> errors;
+	int32_t* status = NULL;
+	if (args.Length() > 4 && args[4]->IsObject()) {
+		Local<Object> options = args[4]->ToObject();
+		Local<Value> val = options->Get(String::NewFromUtf8(iso, "errors"));
+		if (val->IsArray())
+			errors = Local<Array>::Cast(val);
+		else if (!val->IsUndefined()) {
+			iso->ThrowException(Exception::TypeError(String::NewFromUtf8(iso, "errors must be an array")));
+			return;
+		}
+
+		val = options->Get(String::NewFromUtf8(iso, "status"));
+		if (val->IsInt32Array() && Local<Int32Array>::Cast(val)->Length() == rows) {
+			Local<Int32Array> arr = Local<Int32Array>::Cast(val);
+			status = (int32_t*)((char*)arr->Buffer()->GetContents().Data() + arr->ByteOffset());
+		}
+		else if (!val->IsUndefined()) {
+			iso->ThrowException(Exception::TypeError(String::NewFromUtf8(iso, "status must be an Int32Array the same length as the inputs")));
+			return;
+		}
+	}
+
+	std::vector<int> outIdx;
+	std::vector<double*> out;
+	PropertyMask want = 0;
+	Local<Object> outputs = args[3]->ToObject();
+	Local<Array> keys = outputs->GetOwnPropertyNames();
+	for (uint32_t j = 0; j < keys->Length(); j++) {
+		String::Utf8Value key(keys->Get(j)->ToString());
+		int idx = ThermoState::propertyIndex(*key);
+		double* col;
+
+		if (idx < 0 || !float64Data(outputs->Get(keys->Get(j)), &col, &len) || len != rows) {
+			iso->ThrowException(Exception::TypeError(String::NewFromUtf8(iso, "Output columns must be Float64Arrays of known properties, the same length as the inputs")));
+			return;
+		}
+		outIdx.push_back(idx);
+		out.push_back(col);
+		want |= propertyBit(idx);
+	}
+
+	// like statePointBatch, a failed row throws unless there's somewhere else to put its error.  the
+	// rest of the rows have been flashed by then
+	bool keepGoing = !errors.IsEmpty() || status || RefpropContext::statusErrors;
+	size_t failedRow = rows;
+	char failure[errormessagelength+1];
+	char props[2] = { (*pair)[0], (*pair)[1] };
+	char err[errormessagelength+1];
+
+	bool ok = client->flash(client->fluid, props, in, rows, want, [&](size_t row, long ierr, const char* herr, ThermoState* state) {
+		for (size_t c = 0; c < out.size(); c++)
+			out[c][row] = ierr > 0 ? NAN : state->property(outIdx[c]);
+		if (status)
+			status[row] = (int32_t)ierr;
+		if (ierr > 0 && !errors.IsEmpty())
+			errors->Set((uint32_t)row, statusMessage(iso, herr));
+		if (ierr > 0 && failedRow == rows) {
+			failedRow = row;
+			strcpy(failure, herr);
+		}
+	}, err);
+
+	if (!ok) {
+		iso->ThrowException(Exception::Error(String::NewFromUtf8(iso, err)));
+		return;
+	}
+	if (failedRow < rows && !keepGoing) {
+		char msg[errormessagelength+64];
+		sprintf(msg, "Row %lu: %s", (unsigned long)failedRow, failure);
+		iso->ThrowException(Exception::TypeError(String::NewFromUtf8(iso, msg)));
+		return;
+	}
+	args.GetReturnValue().Set(args[3]);
+}
+
+static void clientClose(const FunctionCallbackInfo<Value>& args) {
+	FlashClient* client = holderClient(args);
+	if (client)
+		client->close();
+}
+
+#endif
+
+void connect(const FunctionCallbackInfo<Value>& args) {
+	Isolate* iso = args.GetIsolate();
+	// args[0] is the socket serve() is listening on.  the client's methods are setFluid, statePointBatch
+	// and close; it closes itself when it's collected.  nothing here loads the library
+
+#ifdef _WIN32
+	iso->ThrowException(Exception::Error(String::NewFromUtf8(iso, "The flash server needs unix sockets")));
+#else
+	if (args.Length() < 1 || !args[0]->IsString()) {
+		iso->ThrowException(Exception::TypeError(String::NewFromUtf8(iso, "Must give the flash server's socket")));
+		return;
+	}
+
+	String::Utf8Value path(args[0]->ToString());
+	char err[errormessagelength+1];
+	FlashClient* client = FlashClient::connect(*path, err);
+	if (!client) {
+		iso->ThrowException(Exception::Error(String::NewFromUtf8(iso, err)));
+		return;
+	}
+
+	if (clientTemplate.IsEmpty()) {
+		Local<FunctionTemplate> tpl = FunctionTemplate::New(iso);
+		tpl->SetClassName(String::NewFromUtf8(iso, "FlashClient"));
+		tpl->InstanceTemplate()->SetInternalFieldCount(1);
+		NODE_SET_PROTOTYPE_METHOD(tpl, "setFluid", clientSetFluid);
+		NODE_SET_PROTOTYPE_METHOD(tpl, "statePointBatch", clientStatePointBatch);
+		NODE_SET_PROTOTYPE_METHOD(tpl, "close", clientClose);
+		clientTemplate.Reset(iso, tpl);
+	}
+
+	Local<Object> handle = Local<FunctionTemplate>::New(iso, clientTemplate)->GetFunction()->NewInstance();
+	handle->SetInternalField(0, External::New(iso, client));
+	client->handle.Reset(iso, handle);
+	client->handle.SetWeak(client, releaseClient, WeakCallbackType::kParameter);
+	liveClients.insert(client);
+	args.GetReturnValue().Set(handle);
+#endif
+}
+
+void releaseClients() {
+#ifndef _WIN32
+	for (std::set<FlashClient*>::iterator it = liveClients.begin(); it != liveClients.end(); ++it)
+		delete *it;
+	liveClients.clear();
+	clientTemplate.Reset();
+#endif
+}
@@ -0,0 +1,86 @@
+#ifndef NODE_REFPROP_FLASH_SERVER_H
+#define NODE_REFPROP_FLASH_SERVER_H
+
+#include <stdint.h>
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "node-refprop.h"
+#include "mapped-file.h"
+
+struct RingHeader;
+struct RingRecord;
+
+// one process on the host flashing for all the others, so a host running dozens of node processes still
+// only loads the library, runs setup and warms its caches once.  serve() listens on a unix socket, and
+// every client that connects gets a ring of fixed-layout records in a memory-mapped file the two of them
+// share: the inputs, what's wanted back, ierr and herr, and a ThermoState the answer lands in.  nothing
+// is serialized either way.  the client fills free slots with rows, publishes them by moving the ring's
+// head along and rings a doorbell (a byte on the socket) once for the lot; the server flashes everything
+// between tail and head as one job across its engine pool, moves tail along and rings back.  a batch
+// bigger than the ring streams through it, the client refilling slots as their answers are copied out.
+// both ends have to be the same build, which the ring's header checks, and the same user, since the
+// ring is only readable by its owner.  not on windows
+class FlashServer {
+public:
+	// listens on path with rings of slots records for each client.  NULL and a message in err if it can't
+	static FlashServer* start(const char* path, size_t slots, char* err);
+	~FlashServer();  // stops listening, hangs up on every client and waits for them to go
+
+	static const size_t defaultSlots = 1024;
+
+private:
+	FlashServer();
+
+	std::string path;
+	size_t slots;
+	int listener;
+	std::atomic<bool> stopping;
+	std::thread acceptor;
+
+	std::mutex mutex;  // guards clients
+	std::condition_variable idle;
+	std::vector<int> clients;  // the socket of every connection being served
+	unsigned long serial;      // names each connection's ring
+
+	void acceptLoop();
+	void serve(int fd, unsigned long id);
+	void flashRows(RingHeader* header, RingRecord* records, uint64_t tail, uint64_t head);
+};
+
+// a process's connection to a FlashServer, and the ring it shares with it
+class FlashClient {
+public:
+	// NULL and a message in err if there's no server at path, or it isn't this build
+	static FlashClient* connect(const char* path, char* err);
+	~FlashClient();
+
+	// flashes rows of in[0] and in[1] in fluid, handing each one's ierr, herr and state to done as it
+	// comes back, not necessarily at once but always in order.  false with a message in err if the
+	// connection goes, in which case it stays closed
+	bool flash(const char* fluid, const char props[2], double* const in[2], size_t rows, PropertyMask want,
+		const std::function<void(size_t row, long ierr, const char* herr, ThermoState* state)>& done, char* err);
+	void close();
+	bool closed() { return this->fd < 0; }
+
+	char fluid[refpropcharlength];  // what setFluid picked for this client
+	v8::Persistent<v8::Object> handle;
+
+private:
+	FlashClient();
+
+	int fd;
+	MappedFile file;
+	RingHeader* header;
+	RingRecord* records;
+	size_t slots;
+};
+
+void releaseClients();  // every client the calling thread still has, as its environment shuts down
+
+#endif
@@ -0,0 +1,223 @@
+#include "fluids.h"
+#include "engine-pool.h"
+#include "broker.h"
+
+using namespace v8;
+using namespace node;
+
+std::atomic<unsigned long> FluidScheduler::naiveSwitches(0);
+thread_local char FluidScheduler::lastFluid[refpropcharlength] = "";
+
+static thread_local Persistent<FunctionTemplate> fluidTemplate;
+
+void releaseFluidTemplate() {
+	fluidTemplate.Reset();
+}
+
+void FluidScheduler::noteFluid(const char* fluid) {
+	if (!fluid[0] || strcmp(fluid, lastFluid) == 0)
+		return;
+
+	naiveSwitches++;
+	strncpy(lastFluid, fluid, refpropcharlength-1);
+	lastFluid[refpropcharlength-1] = '\0';
+}
+
+// the fluid name a handle method was called on, or false if it wasn't called on a handle
+static bool handleFluid(const FunctionCallbackInfo<Value>& args, char fluid[refpropcharlength]) {
+	Isolate* iso = args.GetIsolate();
+	Local<Object> holder = args.Holder();
+
+	// anything else with an internal field (a flash client, say) would have its pointer read as a name
+	if (fluidTemplate.IsEmpty() || !Local<FunctionTemplate>::New(iso, fluidTemplate)->HasInstance(holder)) {
+		iso->ThrowException(Exception::TypeError(String::NewFromUtf8(iso, "Must be called on a fluid handle")));
+		return false;
+	}
+
+	String::Utf8Value name(holder->GetInternalField(0));
+	strncpy(fluid, *name, refpropcharlength-1);
+	fluid[refpropcharlength-1] = '\0';
+	return true;
+}
+
+// same as the global flashPoint, but in the handle's fluid no matter what setFluid last picked
+static void fluidFlashPoint(const FunctionCallbackInfo<Value>& args, PropertyMask extra) {
+	Isolate* iso = args.GetIsolate();
+
+	char fluid[refpropcharlength];
+	if (!handleFluid(args, fluid))
+		return;
+
+	if (args.Length() < 1) {
+		iso->ThrowException(Exception::TypeError(String::NewFromUtf8(iso, "Must provide quantities to establish thermodynamic state")));
+		return;
+	}
+
+	char props[2];
+	double values[2];
+	Composition comp;
+	FlashGuess guess;
+	if (!parseCoords(args[0], props, values, iso, &comp, &guess))
+		return;
+
+	PropertyMask want;
+	bool lazy;
+	if (!parseOutputs(args[1], &want, &lazy, iso))
+		return;
+	want |= extra;
+
+	if (!RefpropContext::instance(iso))
+		return;
+
+	FluidScheduler::noteFluid(fluid);
+	RefpropContext* rp = EnginePool::instance()->engineFor(fluid);
+	RefpropLock lock(rp, true);
+
+	if (rp->loadFluid(fluid) != 0) {
+		iso->ThrowException(Exception::TypeError(String::NewFromUtf8(iso, rp->errorMessage())));
+		return;
+	}
+	ThermoState state;
+	if (rp->doFlash(props, values, &state, iso, lazy ? want & ~transportMask : want, &comp, &guess))
+		args.GetReturnValue().Set(flashResult(iso, &state, rp->errorCode(), rp->errorMessage(), want, lazy ? fluid : NULL));
+}
+
+static void fluidStatePoint(const FunctionCallbackInfo<Value>& args) {
+	fluidFlashPoint(args, 0);
+}
+
+static void fluidStatePointWithDerivatives(const FunctionCallbackInfo<Value>& args) {
+	fluidFlashPoint(args, derivativeMask);
+}
+
+static void fluidStatePointBatch(const FunctionCallbackInfo<Value>& args) {
+	char fluid[refpropcharlength];
+	if (handleFluid(args, fluid))
+		flashColumns(args, fluid);
+}
+
+static void fluidStatePointBatchAsync(const FunctionCallbackInfo<Value>& args) {
+	char fluid[refpropcharlength];
+	if (handleFluid(args, fluid))
+		flashColumnsAsync(args, fluid);
+}
+
+static void fluidStatePointAsync(const FunctionCallbackInfo<Value>& args) {
+	char fluid[refpropcharlength];
+	if (handleFluid(args, fluid))
+		flashAsync(args, fluid);
+}
+
+static void fluidSaturationDome(const FunctionCallbackInfo<Value>& args) {
+	char fluid[refpropcharlength];
+	if (handleFluid(args, fluid))
+		domeCurve(args, fluid);
+}
+
+static void fluidIsoline(const FunctionCallbackInfo<Value>& args) {
+	char fluid[refpropcharlength];
+	if (handleFluid(args, fluid))
+		isolineCurve(args, fluid);
+}
+
+static void fluidEvaluateGraph(const FunctionCallbackInfo<Value>& args) {
+	char fluid[refpropcharlength];
+	if (handleFluid(args, fluid))
+		graphEvaluate(args, fluid);
+}
+
+static void fluidWriteGrid(const FunctionCallbackInfo<Value>& args) {
+	char fluid[refpropcharlength];
+	if (handleFluid(args, fluid))
+		gridWrite(args, fluid);
+}
+
+static void fluidSolveState(const FunctionCallbackInfo<Value>& args) {
+	char fluid[refpropcharlength];
+	if (handleFluid(args, fluid))
+		stateSolve(args, fluid);
+}
+
+static void fluidSolveStateBatch(const FunctionCallbackInfo<Value>& args) {
+	char fluid[refpropcharlength];
+	if (handleFluid(args, fluid))
+		batchSolve(args, fluid);
+}
+
+static void fluidCompile(const FunctionCallbackInfo<Value>& args) {
+	char fluid[refpropcharlength];
+	if (handleFluid(args, fluid))
+		planCompile(args, fluid);
+}
+
+void fluid(const FunctionCallbackInfo<Value>& args) {
+	Isolate* iso = args.GetIsolate();
+	// returns a handle with its own statePoint, statePointWithDerivatives, statePointBatch,
+	// statePointAsync, statePointBatchAsync, saturationDome, isoline, evaluateGraph, writeGrid, solveState,
+	// solveStateBatch and compile, so callers that juggle several fluids don't have to setFluid back and forth.
+	// the fluid is loaded right away, on an engine of its own if the pool has one to spare, so a bad
+	// name throws here
+
+	if (args.Length() < 1) {
+		iso->ThrowException(Exception::TypeError(String::NewFromUtf8(iso, "Must specify the fluid type")));
+		return;
+	}
+
+	String::Utf8Value requestedFluid(args[0]->ToString());
+	if (requestedFluid.length() == 0 || requestedFluid.length() >= refpropcharlength) {
+		iso->ThrowException(Exception::TypeError(String::NewFromUtf8(iso, "Error loading fluid requested fluid!")));
+		return;
+	}
+
+	if (!RefpropContext::instance(iso))
+		return;
+
+	{
+		RefpropContext* rp = EnginePool::instance()->engineFor(*requestedFluid);
+		RefpropLock lock(rp, true);
+		if (rp->loadFluid(*requestedFluid) != 0) {
+			iso->ThrowException(Exception::TypeError(String::NewFromUtf8(iso, "Error loading fluid requested fluid!")));
+			return;
+		}
+	}
+
+	if (fluidTemplate.IsEmpty()) {
+		Local<FunctionTemplate> tpl = FunctionTemplate::New(iso);
+		tpl->SetClassName(String::NewFromUtf8(iso, "Fluid"));
+		tpl->InstanceTemplate()->SetInternalFieldCount(1);
+		NODE_SET_PROTOTYPE_METHOD(tpl, "statePoint", brokered<fluidStatePoint>);
+		NODE_SET_PROTOTYPE_METHOD(tpl, "statePointWithDerivatives", brokered<fluidStatePointWithDerivatives>);
+		NODE_SET_PROTOTYPE_METHOD(tpl, "statePointBatch", brokered<fluidStatePointBatch>);
+		NODE_SET_PROTOTYPE_METHOD(tpl, "statePointAsync", brokered<fluidStatePointAsync>);
+		NODE_SET_PROTOTYPE_METHOD(tpl, "statePointBatchAsync", brokered<fluidStatePointBatchAsync>);
+		NODE_SET_PROTOTYPE_METHOD(tpl, "saturationDome", brokered<fluidSaturationDome>);
+		NODE_SET_PROTOTYPE_METHOD(tpl, "isoline", brokered<fluidIsoline>);
+		NODE_SET_PROTOTYPE_METHOD(tpl, "evaluateGraph", brokered<fluidEvaluateGraph>);
+		NODE_SET_PROTOTYPE_METHOD(tpl, "writeGrid", brokered<fluidWriteGrid>);
+		NODE_SET_PROTOTYPE_METHOD(tpl, "solveState", brokered<fluidSolveState>);
+		NODE_SET_PROTOTYPE_METHOD(tpl, "solveStateBatch", brokered<fluidSolveStateBatch>);
+		NODE_SET_PROTOTYPE_METHOD(tpl, "compile", brokered<fluidCompile>);
+		fluidTemplate.Reset(iso, tpl);
+	}
+
+	Local<String> name = String::NewFromUtf8(iso, *requestedFluid);
+	Local<Object> handle = Local<FunctionTemplate>::New(iso, fluidTemplate)->GetFunction()->NewInstance();
+	handle->SetInternalField(0, name);
+	handle->Set(String::NewFromUtf8(iso, "name"), name);
+	args.GetReturnValue().Set(handle);
+}
+
+void getSchedulerStats(const FunctionCallbackInfo<Value>& args) {
+	Isolate* iso = args.GetIsolate();
+	// setupCalls is what we really spent; setupSwitchesAvoided is how many more a single context
+	// would have needed for the same sequence of calls
+
+	unsigned long setups = RefpropContext::setupCalls;
+	unsigned long naive = FluidScheduler::naiveSwitches;
+	unsigned long avoided = naive > setups ? naive - setups : 0;
+
+	Local<Object> obj = Object::New(iso);
+	obj->Set(String::NewFromUtf8(iso, "setupCalls"), Number::New(iso, (double)setups));
+	obj->Set(String::NewFromUtf8(iso, "setupSwitchesAvoided"), Number::New(iso, (double)avoided));
+	args.GetReturnValue().Set(obj);
+}
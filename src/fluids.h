@@ -0,0 +1,22 @@
+#ifndef NODE_REFPROP_FLUIDS_H
+#define NODE_REFPROP_FLUIDS_H
+
+#include "node-refprop.h"
+
+// bookkeeping for fluid handles.  every call that flashes in some fluid notes it here, which gives us
+// how many SETUPdll calls a single context would have made by switching whenever the fluid changed.
+// comparing that against the setups we really made says how many switches the pool saved.
+// each js thread counts the switches its own context would have made
+class FluidScheduler {
+public:
+	static void noteFluid(const char* fluid);
+
+	static std::atomic<unsigned long> naiveSwitches;
+
+private:
+	static thread_local char lastFluid[refpropcharlength];
+};
+
+void releaseFluidTemplate();  // the calling thread's handle template, as its environment shuts down
+
+#endif
@@ -0,0 +1,337 @@
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+#include <string>
+#include <vector>
+
+#ifndef _WIN32
+#include <unistd.h>
+#endif
+
+#include "grid-file.h"
+#include "engine-pool.h"
+#include "fluids.h"
+
+using namespace v8;
+using namespace node;
+
+static uint64_t alignUp(uint64_t offset) {
+	return (offset + gridAlignment - 1) / gridAlignment * gridAlignment;
+}
+
+// the grid's points, flashed across the engine pool straight into the mapped columns.  a point that
+// won't flash gets NaNs and its ierr, and the rest carry on.  warnings keep their values
+class GridJob : public PoolJob {
+public:
+	GridJob(size_t rows, const char* fluid) : PoolJob(rows, fluid) {}
+
+	char pair[2];
+	double min[2], step[2];
+	size_t n1;
+	RefpropContext::FlashFcn flashFcn;
+	PropertyMask want;
+	std::vector<int> props;
+	std::vector<double*> columns;
+	int32_t* ierr;
+
+	void runRows(RefpropContext* rp, size_t begin, size_t end) {
+		ThermoState state;
+		double vals[2];
+
+		for (size_t r = begin; r < end; r++) {
+			vals[0] = this->min[0] + (r / this->n1) * this->step[0];
+			vals[1] = this->min[1] + (r % this->n1) * this->step[1];
+
+			rp->initState(&state);
+			long ierr = rp->flash(this->flashFcn, this->pair, vals, &state, this->want);
+			this->ierr[r] = (int32_t)ierr;
+			for (size_t c = 0; c < this->columns.size(); c++)
+				this->columns[c][r] = ierr <= 0 ? state.property(this->props[c]) : NAN;
+		}
+	}
+};
+
+// reads [min, max, nodes] for one axis out of the options object
+static bool gridAxis(Local<Object> options, char letter, double* min, double* max, uint64_t* n, Isolate* iso) {
+	char key[2] = { letter, '\0' };
+	Local<Value> val = options->Get(String::NewFromUtf8(iso, key));
+	if (!val->IsArray() || Local<Array>::Cast(val)->Length() != 3)
+		return false;
+
+	Local<Array> axis = Local<Array>::Cast(val);
+	*min = axis->Get(0)->NumberValue();
+	*max = axis->Get(1)->NumberValue();
+	double nodes = axis->Get(2)->NumberValue();
+	*n = nodes >= 2 ? (uint64_t)nodes : 0;
+	return *n >= 2 && *max > *min;
+}
+
+void writeGrid(const FunctionCallbackInfo<Value>& args) {
+	if (fluidChosen(RefpropContext::selectedFluid, args.GetIsolate()))
+		gridWrite(args, RefpropContext::selectedFluid);
+}
+
+void gridWrite(const FunctionCallbackInfo<Value>& args, const char* fluid) {
+	Isolate* iso = args.GetIsolate();
+	// args[0] is the file to write.  args[1] is {inputs: 'TP', T: [min, max, nodes], P: [min, max, nodes],
+	// outputs: ['H', 'S', ...]}, with outputs defaulting to T, P, D, H, S and Q.  every point of the grid
+	// is flashed, spread over the engine pool, and the results go straight into the file (see
+	// grid-file.h), which loadGrid maps back in.  returns {points, failed, bytes}
+
+	if (args.Length() < 2 || !args[1]->IsObject()) {
+		iso->ThrowException(Exception::TypeError(String::NewFromUtf8(iso, "Must provide a file name and the grid's inputs and axes")));
+		return;
+	}
+
+	String::Utf8Value path(args[0]->ToString());
+	Local<Object> options = args[1]->ToObject();
+	String::Utf8Value inputs(options->Get(String::NewFromUtf8(iso, "inputs"))->ToString());
+	if (path.length() == 0 || inputs.length() != 2) {
+		iso->ThrowException(Exception::TypeError(String::NewFromUtf8(iso, "Grid inputs must be two property letters, e.g. 'TP'")));
+		return;
+	}
+
+	GridHeader header;
+	memset(&header, 0, sizeof(header));
+	for (int a = 0; a < 2; a++) {
+		header.inputs[a] = (*inputs)[a];
+		if (!gridAxis(options, header.inputs[a], &header.min[a], &header.max[a], &header.n[a], iso)) {
+			iso->ThrowException(Exception::TypeError(String::NewFromUtf8(iso, "Each grid input needs a [min, max, nodes] axis with at least two nodes")));
+			return;
+		}
+	}
+
+	std::vector<std::string> names;
+	Local<Value> outputs = options->Get(String::NewFromUtf8(iso, "outputs"));
+	if (outputs->IsArray()) {
+		Local<Array> list = Local<Array>::Cast(outputs);
+		for (uint32_t i = 0; i < list->Length(); i++)
+			names.push_back(*String::Utf8Value(list->Get(i)->ToString()));
+	}
+	else {
+		const char* defaults[] = { "T", "P", "D", "H", "S", "Q" };
+		names.assign(defaults, defaults + 6);
+	}
+
+	GridJob job((size_t)(header.n[0] * header.n[1]), fluid);
+	// transport properties only get computed for the columns that ask for them
+	job.want = allProperties & ~transportMask;
+	for (size_t c = 0; c < names.size(); c++) {
+		int prop = ThermoState::propertyIndex(names[c].c_str());
+		if (prop < 0) {
+			std::string msg = "Unknown grid output " + names[c];
+			iso->ThrowException(Exception::TypeError(String::NewFromUtf8(iso, msg.c_str())));
+			return;
+		}
+		job.props.push_back(prop);
+		job.want |= propertyBit(prop);
+	}
+
+	RefpropContext* rp = RefpropContext::instance(iso);
+	if (!rp)
+		return;
+	RefpropLock lock(rp);
+
+	job.flashFcn = rp->flashFcnLookup(header.inputs, iso);
+	if (!job.flashFcn)
+		return;
+
+	// lay the file out: header, directory, then the columns and ierr on their own boundaries
+	header.numColumns = job.props.size();
+	header.headerBytes = sizeof(GridHeader) + header.numColumns * sizeof(GridColumn);
+	header.points = job.rows;
+	std::vector<GridColumn> directory(header.numColumns);
+	uint64_t offset = alignUp(header.headerBytes);
+	for (size_t c = 0; c < directory.size(); c++) {
+		memset(&directory[c], 0, sizeof(GridColumn));
+		strncpy(directory[c].name, names[c].c_str(), sizeof(directory[c].name) - 1);
+		strncpy(directory[c].units, ThermoState::propertyUnit(job.props[c]), sizeof(directory[c].units) - 1);
+		directory[c].offset = offset;
+		offset = alignUp(offset + header.points * sizeof(double));
+	}
+	header.ierrOffset = offset;
+	uint64_t bytes = offset + header.points * sizeof(int32_t);
+
+	memcpy(header.magic, gridMagic, strlen(gridMagic));
+	header.version = gridVersion;
+	header.byteOrder = gridByteOrder;
+	strncpy(header.fluid, fluid, refpropcharlength);
+
+	// written off to the side and renamed into place, so anyone mapping the old grid never sees half of
+	// the new one, and a failed run leaves the old one alone
+	char suffix[32];
+#ifdef _WIN32
+	snprintf(suffix, sizeof(suffix), ".%lu.tmp", (unsigned long)GetCurrentProcessId());
+#else
+	snprintf(suffix, sizeof(suffix), ".%lu.tmp", (unsigned long)getpid());
+#endif
+	std::string temp = std::string(*path) + suffix;
+
+	char err[errormessagelength+1];
+	MappedFile* file = new MappedFile();
+	if (!file->create(temp.c_str(), (size_t)bytes, err)) {
+		delete file;
+		iso->ThrowException(Exception::TypeError(String::NewFromUtf8(iso, err)));
+		return;
+	}
+
+	memcpy(file->data, &header, sizeof(header));
+	if (!directory.empty())
+		memcpy(file->data + sizeof(header), &directory[0], directory.size() * sizeof(GridColumn));
+	for (size_t c = 0; c < directory.size(); c++)
+		job.columns.push_back((double*)(file->data + directory[c].offset));
+	job.ierr = (int32_t*)(file->data + header.ierrOffset);
+
+	for (int a = 0; a < 2; a++) {
+		job.pair[a] = header.inputs[a];
+		job.min[a] = header.min[a];
+		job.step[a] = (header.max[a] - header.min[a]) / (header.n[a] - 1);
+	}
+	job.n1 = (size_t)header.n[1];
+
+	FluidScheduler::noteFluid(fluid);
+	EnginePool::instance()->run(&job);
+
+	uint64_t failed = 0;
+	for (size_t r = 0; r < job.rows; r++)
+		if (job.ierr[r] > 0)
+			failed++;
+	delete file;
+
+	// only the fluid itself failing gets here; a half-written grid is no use to anyone
+	if (job.failed()) {
+		remove(temp.c_str());
+		iso->ThrowException(job.error(iso));
+		return;
+	}
+
+#ifdef _WIN32
+	bool moved = MoveFileExA(temp.c_str(), *path, MOVEFILE_REPLACE_EXISTING) != 0;
+#else
+	bool moved = rename(temp.c_str(), *path) == 0;
+#endif
+	if (!moved) {
+		std::string msg = std::string("Couldn't put the grid in place at ") + *path;
+		remove(temp.c_str());
+		iso->ThrowException(Exception::TypeError(String::NewFromUtf8(iso, msg.c_str())));
+		return;
+	}
+
+	Local<Object> result = Object::New(iso);
+	result->Set(String::NewFromUtf8(iso, "points"), Number::New(iso, (double)header.points));
+	result->Set(String::NewFromUtf8(iso, "failed"), Number::New(iso, (double)failed));
+	result->Set(String::NewFromUtf8(iso, "bytes"), Number::New(iso, (double)bytes));
+	args.GetReturnValue().Set(result);
+}
+
+// a loaded grid's mapping, which lives as long as js holds on to any of its arrays
+struct GridMapping {
+	MappedFile file;
+	Persistent<ArrayBuffer> buffer;
+
+	static void release(const WeakCallbackInfo<GridMapping>& data) {
+		GridMapping* mapping = data.GetParameter();
+		mapping->buffer.Reset();
+		delete mapping;
+	}
+};
+
+// whatever's wrong with a mapped grid file, or NULL if it's fine to use
+static const char* checkGrid(const MappedFile& file) {
+	if (file.size < sizeof(GridHeader))
+		return "Not a grid file";
+
+	const GridHeader* header = (const GridHeader*)file.data;
+	if (memcmp(header->magic, gridMagic, strlen(gridMagic)) != 0)
+		return "Not a grid file";
+	if (header->byteOrder != gridByteOrder)
+		return "Grid file was written with the other byte order";
+	if (header->version != gridVersion)
+		return "Grid file version isn't one this build reads";
+	if (memchr(header->fluid, '\0', sizeof(header->fluid)) == NULL)
+		return "Grid file is corrupt";
+
+	uint64_t size = file.size;
+	if (header->numColumns > (size - sizeof(GridHeader)) / sizeof(GridColumn) ||
+			header->headerBytes != sizeof(GridHeader) + header->numColumns * sizeof(GridColumn) ||
+			header->n[0] < 2 || header->n[1] < 2 || header->n[1] > size || header->n[0] > size / header->n[1] ||
+			header->points != header->n[0] * header->n[1])
+		return "Grid file is corrupt";
+
+	const GridColumn* directory = (const GridColumn*)(file.data + sizeof(GridHeader));
+	for (uint64_t c = 0; c < header->numColumns; c++) {
+		const GridColumn& col = directory[c];
+		if (col.offset % sizeof(double) != 0 || col.offset > size || header->points > (size - col.offset) / sizeof(double) ||
+				memchr(col.name, '\0', sizeof(col.name)) == NULL || memchr(col.units, '\0', sizeof(col.units)) == NULL)
+			return "Grid file is corrupt";
+	}
+	if (header->ierrOffset % sizeof(int32_t) != 0 || header->ierrOffset > size || header->points > (size - header->ierrOffset) / sizeof(int32_t))
+		return "Grid file is corrupt";
+	return NULL;
+}
+
+void loadGrid(const FunctionCallbackInfo<Value>& args) {
+	Isolate* iso = args.GetIsolate();
+	// args[0] is a file writeGrid wrote.  it's mapped rather than read, and the arrays that come back
+	// are views straight onto the mapping, so loading costs next to nothing whatever the grid's size.
+	// returns {version, fluid, inputs, points, axes: {T: {min, max, nodes}, ...}, columns: {H: Float64Array, ...},
+	// units: {H: 'J/kg', ...}, ierr: Int32Array}.  writes to the arrays stay in memory
+
+	if (args.Length() < 1) {
+		iso->ThrowException(Exception::TypeError(String::NewFromUtf8(iso, "Must provide a grid file")));
+		return;
+	}
+
+	String::Utf8Value path(args[0]->ToString());
+	char err[errormessagelength+1];
+	GridMapping* mapping = new GridMapping();
+	if (!mapping->file.open(*path, err)) {
+		delete mapping;
+		iso->ThrowException(Exception::TypeError(String::NewFromUtf8(iso, err)));
+		return;
+	}
+
+	const char* problem = checkGrid(mapping->file);
+	if (problem) {
+		delete mapping;
+		iso->ThrowException(Exception::TypeError(String::NewFromUtf8(iso, problem)));
+		return;
+	}
+
+	const GridHeader* header = (const GridHeader*)mapping->file.data;
+	const GridColumn* directory = (const GridColumn*)(mapping->file.data + sizeof(GridHeader));
+	size_t points = (size_t)header->points;
+
+	Local<ArrayBuffer> buffer = ArrayBuffer::New(iso, mapping->file.data, mapping->file.size);
+	mapping->buffer.Reset(iso, buffer);
+	mapping->buffer.SetWeak(mapping, GridMapping::release, WeakCallbackType::kParameter);
+
+	char inputs[3] = { header->inputs[0], header->inputs[1], '\0' };
+	Local<Object> result = Object::New(iso);
+	result->Set(String::NewFromUtf8(iso, "version"), Number::New(iso, header->version));
+	result->Set(String::NewFromUtf8(iso, "fluid"), String::NewFromUtf8(iso, header->fluid));
+	result->Set(String::NewFromUtf8(iso, "inputs"), String::NewFromUtf8(iso, inputs));
+	result->Set(String::NewFromUtf8(iso, "points"), Number::New(iso, (double)points));
+
+	Local<Object> axes = Object::New(iso);
+	for (int a = 0; a < 2; a++) {
+		char key[2] = { header->inputs[a], '\0' };
+		Local<Object> axis = Object::New(iso);
+		axis->Set(String::NewFromUtf8(iso, "min"), Number::New(iso, header->min[a]));
+		axis->Set(String::NewFromUtf8(iso, "max"), Number::New(iso, header->max[a]));
+		axis->Set(String::NewFromUtf8(iso, "nodes"), Number::New(iso, (double)header->n[a]));
+		axes->Set(String::NewFromUtf8(iso, key), axis);
+	}
+	result->Set(String::NewFromUtf8(iso, "axes"), axes);
+
+	Local<Object> columns = Object::New(iso), units = Object::New(iso);
+	for (uint64_t c = 0; c < header->numColumns; c++) {
+		Local<String> name = String::NewFromUtf8(iso, directory[c].name);
+		columns->Set(name, Float64Array::New(buffer, (size_t)directory[c].offset, points));
+		units->Set(name, String::NewFromUtf8(iso, directory[c].units));
+	}
+	result->Set(String::NewFromUtf8(iso, "columns"), columns);
+	result->Set(String::NewFromUtf8(iso, "units"), units);
+	result->Set(String::NewFromUtf8(iso, "ierr"), Int32Array::New(buffer, (size_t)header->ierrOffset, points));
+	args.GetReturnValue().Set(result);
+}
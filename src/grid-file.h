@@ -0,0 +1,39 @@
+#ifndef NODE_REFPROP_GRID_FILE_H
+#define NODE_REFPROP_GRID_FILE_H
+
+#include <stdint.h>
+
+#include "node-refprop.h"
+#include "mapped-file.h"
+
+// property grids on disk, for consumers that want a big map of states without flashing any of them.
+// the file is column-oriented so a reader can map it and use the columns where they lie:
+//   GridHeader, then numColumns GridColumns, then each column's points doubles, then points int32 ierr
+// codes.  points run along axis 1 fastest, so point i is at (i / n[1], i % n[1]).  columns start on
+// 64-byte boundaries.  everything is in the writer's byte order, which byteOrder records
+#define gridMagic "RPGRID"
+#define gridVersion 1
+#define gridByteOrder 0x01020304
+#define gridAlignment 64
+
+struct GridHeader {
+	char magic[8];
+	uint32_t version;
+	uint32_t byteOrder;
+	uint64_t headerBytes;  // the header and the column directory
+	uint64_t points;
+	char fluid[refpropcharlength+1];
+	char inputs[8];        // the two axis letters
+	double min[2], max[2];
+	uint64_t n[2];         // nodes along each axis, spread evenly from min to max
+	uint64_t numColumns;
+	uint64_t ierrOffset;
+};
+
+struct GridColumn {
+	char name[16];
+	char units[24];
+	uint64_t offset;
+};
+
+#endif
@@ -0,0 +1,596 @@
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+#include <algorithm>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "inverse-solver.h"
+#include "engine-pool.h"
+#include "fluids.h"
+
+using namespace v8;
+using namespace node;
+
+#define defaultTolerance 1e-10
+#define densityRange 1e-8  // the bottom of the density search, as a fraction of the fluid's highest density
+
+void RefpropContext::limits(double* Tmin, double* Tmax, double* Dmax, double* Pmax) {
+	char htyp[] = "EOS";
+	double mm;
+	this->WMOLdll(this->composition, mm);
+	this->LIMITSdll(htyp, this->composition, *Tmin, *Tmax, *Dmax, *Pmax, lengthofreference);
+
+	*Dmax *= mm;
+	*Pmax *= 1e3;
+}
+
+// what the target's slope along the search needs computed, when it has one
+static PropertyMask slopeMask(char known, int target) {
+	if (known == 'T' && (target == PROP_P || target == PROP_H || target == PROP_S || target == PROP_E))
+		return propertyBit(PROP_dPdD) | propertyBit(PROP_dPdT);
+	if (known == 'P' && (target == PROP_T || target == PROP_H || target == PROP_S || target == PROP_E))
+		return propertyBit(PROP_dDdT);
+	return 0;
+}
+
+// properties that don't mean anything in two phases (refprop hands back -9.99999e6 for CP and W there)
+static bool onePhaseOnly(int target) {
+	return target == PROP_CP || target == PROP_W || (propertyBit(target) & (onePhaseTransportMask | derivativeMask));
+}
+
+InverseSolver::InverseSolver() : guess(NAN), min(NAN), max(NAN), tolerance(defaultTolerance), target(-1), flashFcn(NULL), need(0), slopes(false) {
+	this->props[0] = this->props[1] = 0;
+	this->targetName[0] = '\0';
+}
+
+bool InverseSolver::configure(char known, const char* target, Local<Value> options, RefpropContext* rp, Isolate* iso) {
+	this->props[0] = known;
+	this->props[1] = (known == 'D' || known == 'Q') ? 'T' : 'D';
+	this->target = ThermoState::propertyIndex(target);
+	if (this->target < 0) {
+		iso->ThrowException(Exception::TypeError(String::NewFromUtf8(iso, "Unknown target property")));
+		return false;
+	}
+	strncpy(this->targetName, target, sizeof(this->targetName) - 1);
+	this->targetName[sizeof(this->targetName) - 1] = '\0';
+
+	// the composition doesn't change along the search, and the searched property has nothing to find
+	int searched = this->props[1] == 'T' ? PROP_T : PROP_D;
+	if (this->target == PROP_Z || this->target == PROP_X || this->target == PROP_Y || this->target == searched) {
+		iso->ThrowException(Exception::TypeError(String::NewFromUtf8(iso, "That property can't be solved for")));
+		return false;
+	}
+
+	this->flashFcn = rp->findFlashFcn(this->props);
+	if (!this->flashFcn) {
+		iso->ThrowException(Exception::TypeError(String::NewFromUtf8(iso, "The known property must be one of TPDHSEQ")));
+		return false;
+	}
+
+	PropertyMask slope = slopeMask(known, this->target);
+	this->slopes = slope != 0;
+	this->need = propertyBit(this->target) | slope;
+
+	if (!options.IsEmpty() && options->IsObject()) {
+		Local<Object> opts = options->ToObject();
+		const char* keys[] = { "guess", "min", "max", "tolerance" };
+		double* vals[] = { &this->guess, &this->min, &this->max, &this->tolerance };
+		for (int i = 0; i < 4; i++) {
+			Local<Value> val = opts->Get(String::NewFromUtf8(iso, keys[i]));
+			if (val->IsNumber())
+				*vals[i] = val->NumberValue();
+			else if (!val->IsUndefined() && !(i == 0 && val->IsFloat64Array())) {  // the batch takes a column of guesses
+				std::string msg = std::string(keys[i]) + " must be a number";
+				iso->ThrowException(Exception::TypeError(String::NewFromUtf8(iso, msg.c_str())));
+				return false;
+			}
+		}
+		if (!(this->tolerance > 0)) {
+			iso->ThrowException(Exception::TypeError(String::NewFromUtf8(iso, "tolerance must be above 0")));
+			return false;
+		}
+	}
+	return true;
+}
+
+double InverseSolver::slope(ThermoState* st) const {
+	if (!this->slopes || (st->Q >= 0 && st->Q <= 1))
+		return NAN;
+
+	// d(target)/d(rho) along an isotherm or an isobar, from the usual maxwell relations
+	Derivatives* d = &st->derivs;
+	double T = st->T, D = st->D;
+	if (this->props[0] == 'T') {
+		switch (this->target) {
+			case PROP_P: return d->dPdD;
+			case PROP_H: return (d->dPdD - T * d->dPdT / D) / D;
+			case PROP_S: return -d->dPdT / (D * D);
+			case PROP_E: return (st->P - T * d->dPdT) / (D * D);
+		}
+	}
+	else {
+		switch (this->target) {
+			case PROP_T: return 1 / d->dDdT;
+			case PROP_H: return st->CP / d->dDdT;
+			case PROP_S: return st->CP / (T * d->dDdT);
+			case PROP_E: return st->CP / d->dDdT + st->P / (D * D);
+		}
+	}
+	return NAN;
+}
+
+// the search's samples stay out of the caches; only the state solve() settles on is worth keeping
+void InverseSolver::evaluate(RefpropContext* rp, double known, double targetValue, Sample* s, ThermoState* state) const {
+	double vals[2] = { known, s->x };
+	FlashGuess sample;
+	sample.keep = false;
+	s->f = s->slope = NAN;
+	if (rp->initState(state) != 0 || rp->flash(this->flashFcn, this->props, vals, state, this->need, &sample) > 0)
+		return;
+	if (onePhaseOnly(this->target) && state->Q >= 0 && state->Q <= 1)
+		return;
+
+	s->f = state->property(this->target) - targetValue;
+	s->slope = this->slope(state);
+}
+
+bool InverseSolver::range(RefpropContext* rp, double* lo, double* hi, char* herr) const {
+	double Tmin, Tmax, Dmax, Pmax;
+	rp->limits(&Tmin, &Tmax, &Dmax, &Pmax);
+
+	if (this->props[1] == 'D') {
+		*lo = Dmax * densityRange;
+		*hi = Dmax;
+	}
+	else if (this->props[0] == 'Q') {
+		// along the dome, which ends at the critical point
+		double Tc, Pc, Dc;
+		if (rp->criticalPoint(&Tc, &Pc, &Dc) != 0) {
+			strcpy(herr, rp->errorMessage());
+			return false;
+		}
+		*lo = Tmin;
+		*hi = Tc * (1 - 1e-9);
+	}
+	else {
+		*lo = Tmin;
+		*hi = Tmax;
+	}
+
+	if (!isnan(this->min))
+		*lo = this->min;
+	if (!isnan(this->max))
+		*hi = this->max;
+	if (!(*lo > 0 && *hi > *lo)) {
+		snprintf(herr, errormessagelength, "Nothing to search between %c = %g and %g", this->props[1], *lo, *hi);
+		return false;
+	}
+	return true;
+}
+
+// two samples with the target on either side of them.  the samples are evenly spaced in the log of the
+// searched property: outward from the guess, both ways at once, or up from the bottom of the range.
+// samples where the flash fails are stepped over
+bool InverseSolver::bracket(RefpropContext* rp, double known, double targetValue, double guess, double lo, double hi,
+		Sample* a, Sample* b, ThermoState* state) const {
+	double width = log(hi / lo) / scanPoints;
+	Sample s;
+
+	if (!(guess > lo && guess < hi)) {
+		Sample last;
+		last.f = NAN;
+		for (int i = 0; i <= scanPoints; i++) {
+			s.x = i == scanPoints ? hi : lo * exp(width * i);
+			this->evaluate(rp, known, targetValue, &s, state);
+			if (isnan(s.f))
+				continue;
+			if (!isnan(last.f) && last.f * s.f <= 0) {
+				*a = last;
+				*b = s;
+				return true;
+			}
+			last = s;
+		}
+		return false;
+	}
+
+	Sample center;
+	center.x = guess;
+	this->evaluate(rp, known, targetValue, &center, state);
+	Sample last[2] = { center, center };
+	bool done[2] = { false, false };
+	for (int k = 1; !(done[0] && done[1]); k++) {
+		for (int side = 0; side < 2; side++) {
+			if (done[side])
+				continue;
+			s.x = guess * exp((side ? -width : width) * k / 2);
+			if (s.x >= hi || s.x <= lo) {
+				s.x = side ? lo : hi;
+				done[side] = true;
+			}
+			this->evaluate(rp, known, targetValue, &s, state);
+			if (isnan(s.f))
+				continue;
+			if (!isnan(last[side].f) && last[side].f * s.f <= 0) {
+				*a = last[side];
+				*b = s;
+				return true;
+			}
+			last[side] = s;
+		}
+	}
+	return false;
+}
+
+long InverseSolver::solve(RefpropContext* rp, double knownValue, double targetValue, double guess, ThermoState* state,
+		PropertyMask want, char* herr) const {
+	if (isnan(guess))
+		guess = this->guess;
+
+	double lo, hi;
+	if (!this->range(rp, &lo, &hi, herr))
+		return 1;
+
+	Sample a, b;
+	if (!this->bracket(rp, knownValue, targetValue, guess, lo, hi, &a, &b, state)) {
+		snprintf(herr, errormessagelength, "No state with %c = %g and %s = %g between %c = %g and %g",
+			this->props[0], knownValue, this->targetName, targetValue, this->props[1], lo, hi);
+		return 1;
+	}
+
+	// brent's method, with b the best estimate, a the other side of the bracket and c the last b
+	if (fabs(a.f) < fabs(b.f))
+		std::swap(a, b);
+	Sample c = a, s;
+	double d = c.x;
+	bool bisected = true;
+	double close = this->tolerance * fabs(targetValue);
+
+	for (int i = 0; b.f != 0 && fabs(b.f) > close && fabs(b.x - a.x) > 4e-16 * fabs(b.x); i++) {
+		if (i == maxIterations) {
+			snprintf(herr, errormessagelength, "%s = %g didn't converge along %c = %g", this->targetName, targetValue, this->props[0], knownValue);
+			return 1;
+		}
+
+		if (!isnan(b.slope) && b.slope != 0)
+			s.x = b.x - b.f / b.slope;  // newton
+		else if (a.f != c.f && b.f != c.f)
+			s.x = a.x * b.f * c.f / ((a.f - b.f) * (a.f - c.f)) + b.x * a.f * c.f / ((b.f - a.f) * (b.f - c.f))
+				+ c.x * a.f * b.f / ((c.f - a.f) * (c.f - b.f));  // inverse quadratic
+		else
+			s.x = b.x - b.f * (b.x - a.x) / (b.f - a.f);  // secant
+
+		// bisect instead of a step that leaves the bracket or isn't shrinking it fast enough
+		double m = (3 * a.x + b.x) / 4;
+		if (!(s.x > std::min(m, b.x) && s.x < std::max(m, b.x)) || fabs(s.x - b.x) >= fabs((bisected ? b.x : d) - c.x) / 2) {
+			s.x = (a.x + b.x) / 2;
+			bisected = true;
+		}
+		else
+			bisected = false;
+
+		this->evaluate(rp, knownValue, targetValue, &s, state);
+		if (isnan(s.f) && !bisected) {
+			s.x = (a.x + b.x) / 2;
+			bisected = true;
+			this->evaluate(rp, knownValue, targetValue, &s, state);
+		}
+		if (isnan(s.f)) {
+			snprintf(herr, errormessagelength, "%s isn't defined between %c = %g and %g along %c = %g", this->targetName,
+				this->props[1], std::min(a.x, b.x), std::max(a.x, b.x), this->props[0], knownValue);
+			return 1;
+		}
+
+		d = c.x;
+		c = b;
+		if (a.f * s.f < 0)
+			b = s;
+		else
+			a = s;
+		if (fabs(a.f) < fabs(b.f))
+			std::swap(a, b);
+	}
+
+	// the one that's handed back gets everything asked for
+	double vals[2] = { knownValue, b.x };
+	long ierr = rp->initState(state);
+	if (ierr == 0)
+		ierr = rp->flash(this->flashFcn, this->props, vals, state, want | this->need);
+	if (ierr != 0)
+		strcpy(herr, rp->errorMessage());
+	return ierr;
+}
+
+
+// the flash letter for a property, or 0 if refprop can't flash on it
+static char flashLetter(int prop) {
+	switch (prop) {
+		case PROP_T: return 'T';
+		case PROP_P: return 'P';
+		case PROP_D: return 'D';
+		case PROP_H: return 'H';
+		case PROP_S: return 'S';
+		case PROP_E: return 'E';
+		case PROP_Q: return 'Q';
+	}
+	return 0;
+}
+
+// the known property and the target out of a pair like {T: 300, W: 400}.  the known one is whichever
+// comes first in TPDHSEQ.  false if it threw
+static bool parsePair(Local<Value> arg, char* known, double* knownValue, std::string* target, double* targetValue, Isolate* iso) {
+	if (!arg->IsObject()) {
+		iso->ThrowException(Exception::TypeError(String::NewFromUtf8(iso, "Must provide a known property and a target, e.g. {T: 300, W: 400}")));
+		return false;
+	}
+
+	Local<Object> coords = arg->ToObject();
+	Local<Array> keys = coords->GetOwnPropertyNames();
+	if (keys->Length() != 2) {
+		iso->ThrowException(Exception::TypeError(String::NewFromUtf8(iso, "Thermodynamic state established by exactly 2 values")));
+		return false;
+	}
+
+	const char* flashString = "TPDHSEQ";
+	std::string names[2];
+	double values[2];
+	int rank[2];
+	for (uint32_t i = 0; i < 2; i++) {
+		names[i] = *String::Utf8Value(keys->Get(i)->ToString());
+		values[i] = coords->Get(keys->Get(i))->NumberValue();
+		const char* letter = names[i].size() == 1 ? strchr(flashString, names[i][0]) : NULL;
+		rank[i] = letter ? (int)(letter - flashString) : 7;
+	}
+
+	int k = rank[0] <= rank[1] ? 0 : 1;
+	if (rank[k] == 7) {
+		iso->ThrowException(Exception::TypeError(String::NewFromUtf8(iso, "One of the pair must be one of TPDHSEQ")));
+		return false;
+	}
+	*known = names[k][0];
+	*knownValue = values[k];
+	*target = names[1-k];
+	*targetValue = values[1-k];
+	return true;
+}
+
+void solveState(const FunctionCallbackInfo<Value>& args) {
+	if (fluidChosen(RefpropContext::selectedFluid, args.GetIsolate()))
+		stateSolve(args, RefpropContext::selectedFluid);
+}
+
+void stateSolve(const FunctionCallbackInfo<Value>& args, const char* fluid) {
+	Isolate* iso = args.GetIsolate();
+	// args[0] is one property refprop can flash on and the value of any other, like {T: 300, W: 400}
+	// args[1] is the requested properties, like statePoint's
+	// args[2] is optional {guess, min, max, tolerance}: a starting value and bounds for the property the
+	//  solver searches along (D, or T if the known one is D or Q), and how close the target has to come,
+	//  relative to its value (1e-10).  without a guess, the root at the lowest D or T wins
+	// returns the state, in the fluid's own composition.  one that can't be found throws, or comes back
+	// as {ierr, herr} in status mode.  a pair statePoint takes, like {T: 300, H: 400e3}, is just flashed
+	// unless there are options; with them it's searched too, which is how to pick between several roots
+
+	if (args.Length() < 1) {
+		iso->ThrowException(Exception::TypeError(String::NewFromUtf8(iso, "Must provide a known property and a target")));
+		return;
+	}
+
+	char known = 0;
+	std::string target;
+	double knownValue = 0, targetValue = 0;
+	if (!parsePair(args[0], &known, &knownValue, &target, &targetValue, iso))
+		return;
+
+	PropertyMask want;
+	bool lazy;
+	if (!parseOutputs(args[1], &want, &lazy, iso))
+		return;
+
+	if (!RefpropContext::instance(iso))
+		return;
+
+	FluidScheduler::noteFluid(fluid);
+	RefpropContext* rp = EnginePool::instance()->engineFor(fluid);
+	RefpropLock lock(rp, true);
+
+	if (rp->loadFluid(fluid) != 0) {
+		iso->ThrowException(Exception::TypeError(String::NewFromUtf8(iso, rp->errorMessage())));
+		return;
+	}
+
+	PropertyMask flashWant = lazy ? want & ~transportMask : want;
+	ThermoState state;
+
+	// a pair refprop flashes on only needs searching when the caller wants a say in which root it gets, or
+	// the flash doesn't converge
+	char props[2] = { known, flashLetter(ThermoState::propertyIndex(target.c_str())) };
+	RefpropContext::FlashFcn flashFcn = props[1] ? rp->findFlashFcn(props) : NULL;
+	if (flashFcn && !(args.Length() > 2 && args[2]->IsObject())) {
+		double values[2] = { knownValue, targetValue };
+		if (rp->initState(&state) == 0 && rp->flash(flashFcn, props, values, &state, flashWant) <= 0) {
+			args.GetReturnValue().Set(flashResult(iso, &state, rp->errorCode(), rp->errorMessage(), want, lazy ? fluid : NULL));
+			return;
+		}
+	}
+
+	InverseSolver solver;
+	if (!solver.configure(known, target.c_str(), args.Length() > 2 ? args[2] : Local<Value>(), rp, iso))
+		return;
+
+	char herr[errormessagelength+1];
+	long ierr = solver.solve(rp, knownValue, targetValue, NAN, &state, flashWant, herr);
+	if (ierr > 0 && !RefpropContext::statusErrors) {
+		iso->ThrowException(Exception::Error(String::NewFromUtf8(iso, herr)));
+		return;
+	}
+	args.GetReturnValue().Set(flashResult(iso, &state, ierr, herr, want, lazy ? fluid : NULL));
+}
+
+// a column of solves, spread over the engine pool like statePointBatch's flashes
+class SolveJob : public PoolJob {
+public:
+	SolveJob(size_t rows, const char* fluid) : PoolJob(rows, fluid), guesses(NULL), want(0), status(NULL), statusErrors(false) {}
+
+	InverseSolver solver;
+	const double* in[2];  // the known property, then the target
+	const double* guesses;
+	std::vector<int> outIdx;
+	std::vector<double*> out;
+	PropertyMask want;
+
+	// errors and status work like statePointBatch's
+	v8::Persistent<v8::Array> errors;
+	std::vector<std::pair<size_t, std::string> > rowErrors;
+	std::mutex rowErrorsMutex;
+	int32_t* status;
+	bool statusErrors;
+
+	~SolveJob() {
+		this->errors.Reset();
+	}
+
+	void runRows(RefpropContext* rp, size_t begin, size_t end) {
+		ThermoState state;
+		char herr[errormessagelength+1];
+
+		for (size_t i = begin; i < end; i++) {
+			double guess = this->guesses ? this->guesses[i] : NAN;
+			long ierr = this->solver.solve(rp, this->in[0][i], this->in[1][i], guess, &state, this->want, herr);
+			if (this->status)
+				this->status[i] = (int32_t)ierr;
+
+			if (ierr > 0) {
+				if (this->errors.IsEmpty() && !this->status && !this->statusErrors) {
+					this->fail(i, herr);
+					return;
+				}
+				for (size_t j = 0; j < this->out.size(); j++)
+					this->out[j][i] = NAN;
+				if (!this->errors.IsEmpty()) {
+					std::lock_guard<std::mutex> lock(this->rowErrorsMutex);
+					this->rowErrors.push_back(std::make_pair(i, std::string(herr)));
+				}
+				continue;
+			}
+
+			for (size_t j = 0; j < this->out.size(); j++)
+				this->out[j][i] = state.property(this->outIdx[j]);
+		}
+	}
+
+	void finish(Isolate* iso) {
+		if (this->errors.IsEmpty())
+			return;
+
+		Local<Array> errors = Local<Array>::New(iso, this->errors);
+		for (size_t k = 0; k < this->rowErrors.size(); k++)
+			errors->Set((uint32_t)this->rowErrors[k].first, statusMessage(iso, this->rowErrors[k].second.c_str()));
+	}
+};
+
+void solveStateBatch(const FunctionCallbackInfo<Value>& args) {
+	if (fluidChosen(RefpropContext::selectedFluid, args.GetIsolate()))
+		batchSolve(args, RefpropContext::selectedFluid);
+}
+
+void batchSolve(const FunctionCallbackInfo<Value>& args, const char* fluid) {
+	Isolate* iso = args.GetIsolate();
+	// args[0] is the known property's letter and args[1] the target's name, like 'T' and 'W'
+	// args[2] and args[3] are Float64Arrays of their values
+	// args[4] is an object of output columns, like statePointBatch's
+	// args[5] is optional: solveState's {guess, min, max, tolerance}, where guess can also be a Float64Array
+	//  with one for each row, plus statePointBatch's errors and status.  every row is searched, even for a
+	//  pair statePointBatch would flash
+
+	if (args.Length() < 5 || !args[4]->IsObject()) {
+		iso->ThrowException(Exception::TypeError(String::NewFromUtf8(iso, "Must provide a known property, a target, their columns and an object of output columns")));
+		return;
+	}
+
+	String::Utf8Value known(args[0]->ToString());
+	String::Utf8Value target(args[1]->ToString());
+	if (known.length() != 1) {
+		iso->ThrowException(Exception::TypeError(String::NewFromUtf8(iso, "The known property must be one of TPDHSEQ")));
+		return;
+	}
+
+	size_t rows, len;
+	double *in[2];
+	if (!float64Data(args[2], &in[0], &rows) || !float64Data(args[3], &in[1], &len) || len != rows) {
+		iso->ThrowException(Exception::TypeError(String::NewFromUtf8(iso, "Input columns must be Float64Arrays of the same length")));
+		return;
+	}
+
+	RefpropContext* rp = RefpropContext::instance(iso);
+	if (!rp)
+		return;
+	RefpropLock lock(rp);
+
+	Local<Value> options = args.Length() > 5 ? args[5] : Local<Value>();
+	SolveJob job(rows, fluid);
+	job.in[0] = in[0];
+	job.in[1] = in[1];
+	job.statusErrors = RefpropContext::statusErrors;
+	if (!job.solver.configure((*known)[0], *target, options, rp, iso))
+		return;
+
+	if (!options.IsEmpty() && options->IsObject()) {
+		Local<Object> opts = options->ToObject();
+		Local<Value> guesses = opts->Get(String::NewFromUtf8(iso, "guess"));
+		if (guesses->IsFloat64Array()) {
+			double* col;
+			float64Data(guesses, &col, &len);
+			job.guesses = col;
+			if (len != rows) {
+				iso->ThrowException(Exception::TypeError(String::NewFromUtf8(iso, "A guess column must be the same length as the inputs")));
+				return;
+			}
+		}
+
+		Local<Value> errors = opts->Get(String::NewFromUtf8(iso, "errors"));
+		if (errors->IsArray())
+			job.errors.Reset(iso, Local<Array>::Cast(errors));
+		else if (!errors->IsUndefined()) {
+			iso->ThrowException(Exception::TypeError(String::NewFromUtf8(iso, "errors must be an array")));
+			return;
+		}
+
+		Local<Value> status = opts->Get(String::NewFromUtf8(iso, "status"));
+		if (status->IsInt32Array() && Local<Int32Array>::Cast(status)->Length() == rows) {
+			Local<Int32Array> arr = Local<Int32Array>::Cast(status);
+			job.status = (int32_t*)((char*)arr->Buffer()->GetContents().Data() + arr->ByteOffset());
+		}
+		else if (!status->IsUndefined()) {
+			iso->ThrowException(Exception::TypeError(String::NewFromUtf8(iso, "status must be an Int32Array the same length as the inputs")));
+			return;
+		}
+	}
+
+	Local<Object> outputs = args[4]->ToObject();
+	Local<Array> keys = outputs->GetOwnPropertyNames();
+	for (uint32_t j = 0; j < keys->Length(); j++) {
+		String::Utf8Value key(keys->Get(j)->ToString());
+		int idx = ThermoState::propertyIndex(*key);
+		double* col;
+
+		if (idx < 0 || !float64Data(outputs->Get(keys->Get(j)), &col, &len) || len != rows) {
+			iso->ThrowException(Exception::TypeError(String::NewFromUtf8(iso, "Output columns must be Float64Arrays of known properties, the same length as the inputs")));
+			return;
+		}
+		job.outIdx.push_back(idx);
+		job.out.push_back(col);
+		job.want |= propertyBit(idx);
+	}
+
+	FluidScheduler::noteFluid(fluid);
+	EnginePool::instance()->run(&job);
+	job.finish(iso);
+
+	if (job.failed()) {
+		iso->ThrowException(job.error(iso));
+		return;
+	}
+	args.GetReturnValue().Set(args[4]);
+}
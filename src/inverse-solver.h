@@ -0,0 +1,54 @@
+#ifndef NODE_REFPROP_INVERSE_SOLVER_H
+#define NODE_REFPROP_INVERSE_SOLVER_H
+
+#include "node-refprop.h"
+
+// states pinned down by one property refprop can flash on (T, P, D, H, S, E or Q) and the value of any
+// other, transport properties included: {T: 300, W: 400}, {P: 1e6, mu: 2e-5}.  the known property is held
+// and the solver searches along a second flash property for the state with the target value.  that's D,
+// or T when D or Q is the one that's known, so every step is an ordinary TD, PD, DH... or TQ flash.
+// the search brackets a root by sampling (outward from a guess, or up from the bottom of the range so
+// the lowest one wins), then closes in with brent's method, taking newton steps in place of the
+// interpolation wherever the equation of state gives the target's slope: P, H, S and E along an
+// isotherm, and T, H, S and E along an isobar, in one phase.  those pairs can be flashed anyway; they're
+// searched when the flash has more than one root to choose from, or won't converge
+class InverseSolver {
+public:
+	InverseSolver();
+
+	// sets up the search for target with known held.  false (with an exception thrown) for a pair that
+	// can't be searched.  options may be undefined or {guess, min, max, tolerance}, the bounds and guess
+	// being values of the searched property (along()) and the tolerance relative to the target
+	bool configure(char known, const char* target, v8::Local<v8::Value> options, RefpropContext* rp, v8::Isolate* iso);
+
+	// the state with the known property at knownValue and the target at targetValue, flashed for want.
+	// guess is NaN for none.  rp has to have the fluid loaded.  on failure, returns ierr with herr saying why
+	long solve(RefpropContext* rp, double knownValue, double targetValue, double guess, ThermoState* state, PropertyMask want, char* herr) const;
+
+	char along() const { return this->props[1]; }
+
+	double guess, min, max;  // NaN where the caller left them to us
+	double tolerance;
+
+	static const int scanPoints = 24;     // samples across the whole range while bracketing
+	static const int maxIterations = 100;
+
+private:
+	char props[2];  // the known property, then the searched one, in the order the flash takes them
+	int target;
+	char targetName[16];  // for messages
+	RefpropContext::FlashFcn flashFcn;
+	PropertyMask need;  // the target, plus whatever its slope takes
+	bool slopes;        // whether slope() can say anything for this pair
+
+	struct Sample {
+		double x, f, slope;  // f is the target's miss, NaN where the flash fails or the target means nothing
+	};
+
+	void evaluate(RefpropContext* rp, double known, double targetValue, Sample* s, ThermoState* state) const;
+	double slope(ThermoState* state) const;
+	bool range(RefpropContext* rp, double* lo, double* hi, char* herr) const;
+	bool bracket(RefpropContext* rp, double known, double targetValue, double guess, double lo, double hi, Sample* a, Sample* b, ThermoState* state) const;
+};
+
+#endif
@@ -0,0 +1,125 @@
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include "mapped-file.h"
+
+MappedFile::MappedFile() : data(NULL), size(0) {
+#ifdef _WIN32
+	this->file = INVALID_HANDLE_VALUE;
+	this->mapping = NULL;
+#else
+	this->fd = -1;
+#endif
+}
+
+MappedFile::~MappedFile() {
+	this->close();
+}
+
+#ifdef _WIN32
+bool MappedFile::create(const char* path, size_t size, char* err, bool isPrivate) {
+	this->file = CreateFileA(path, GENERIC_READ | GENERIC_WRITE, 0, NULL, isPrivate ? CREATE_NEW : CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL);
+	if (this->file != INVALID_HANDLE_VALUE)
+		this->mapping = CreateFileMappingA(this->file, NULL, PAGE_READWRITE, (DWORD)((uint64_t)size >> 32), (DWORD)size, NULL);
+	if (this->mapping)
+		this->data = (char*)MapViewOfFile(this->mapping, FILE_MAP_WRITE, 0, 0, size);
+	if (!this->data) {
+		snprintf(err, errormessagelength, "Couldn't create %s (error %lu)", path, GetLastError());
+		this->close();
+		return false;
+	}
+	this->size = size;
+	return true;
+}
+
+bool MappedFile::open(const char* path, char* err, bool shared) {
+	LARGE_INTEGER length;
+	this->file = CreateFileA(path, shared ? GENERIC_READ | GENERIC_WRITE : GENERIC_READ, shared ? FILE_SHARE_READ | FILE_SHARE_WRITE : FILE_SHARE_READ,
+		NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+	if (this->file != INVALID_HANDLE_VALUE && GetFileSizeEx(this->file, &length) && length.QuadPart > 0)
+		this->mapping = CreateFileMappingA(this->file, NULL, shared ? PAGE_READWRITE : PAGE_WRITECOPY, 0, 0, NULL);
+	if (this->mapping)
+		this->data = (char*)MapViewOfFile(this->mapping, shared ? FILE_MAP_WRITE : FILE_MAP_COPY, 0, 0, 0);
+	if (!this->data) {
+		snprintf(err, errormessagelength, "Couldn't map %s (error %lu)", path, GetLastError());
+		this->close();
+		return false;
+	}
+	this->size = (size_t)length.QuadPart;
+	return true;
+}
+
+void MappedFile::close() {
+	if (this->data)
+		UnmapViewOfFile(this->data);
+	if (this->mapping)
+		CloseHandle(this->mapping);
+	if (this->file != INVALID_HANDLE_VALUE)
+		CloseHandle(this->file);
+	this->data = NULL;
+	this->mapping = NULL;
+	this->file = INVALID_HANDLE_VALUE;
+}
+#else
+bool MappedFile::create(const char* path, size_t size, char* err, bool isPrivate) {
+	this->fd = isPrivate ? ::open(path, O_RDWR | O_CREAT | O_EXCL | O_NOFOLLOW, 0600) : ::open(path, O_RDWR | O_CREAT | O_TRUNC, 0644);
+	if (this->fd < 0 || ftruncate(this->fd, (off_t)size) != 0) {
+		snprintf(err, errormessagelength, "Couldn't create %s: %s", path, strerror(errno));
+		this->close();
+		return false;
+	}
+
+	void* data = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, this->fd, 0);
+	if (data == MAP_FAILED) {
+		snprintf(err, errormessagelength, "Couldn't map %s: %s", path, strerror(errno));
+		this->close();
+		return false;
+	}
+	this->data = (char*)data;
+	this->size = size;
+	return true;
+}
+
+bool MappedFile::open(const char* path, char* err, bool shared) {
+	struct stat st;
+	this->fd = ::open(path, shared ? O_RDWR : O_RDONLY);
+	if (this->fd < 0 || fstat(this->fd, &st) != 0 || st.st_size == 0) {
+		snprintf(err, errormessagelength, "Couldn't open %s: %s", path, this->fd < 0 ? strerror(errno) : "empty file");
+		this->close();
+		return false;
+	}
+
+	// a private mapping is still writable, so js can scribble on a grid's arrays without touching the
+	// file.  pages are only copied if it does
+	void* data = mmap(NULL, (size_t)st.st_size, PROT_READ | PROT_WRITE, shared ? MAP_SHARED : MAP_PRIVATE, this->fd, 0);
+	if (data == MAP_FAILED) {
+		snprintf(err, errormessagelength, "Couldn't map %s: %s", path, strerror(errno));
+		this->close();
+		return false;
+	}
+	this->data = (char*)data;
+	this->size = (size_t)st.st_size;
+
+	// the mapping holds on to the file by itself
+	::close(this->fd);
+	this->fd = -1;
+	return true;
+}
+
+void MappedFile::close() {
+	if (this->data)
+		munmap(this->data, this->size);
+	if (this->fd >= 0)
+		::close(this->fd);
+	this->data = NULL;
+	this->fd = -1;
+}
+#endif
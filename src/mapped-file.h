@@ -0,0 +1,31 @@
+#ifndef NODE_REFPROP_MAPPED_FILE_H
+#define NODE_REFPROP_MAPPED_FILE_H
+
+#include "node-refprop.h"
+
+// a file mapped into memory: an existing one, or one freshly created read-write at a given size
+class MappedFile {
+public:
+	MappedFile();
+	~MappedFile();  // unmaps
+
+	// private makes a file only this user can open, and fails rather than reuse or follow anything
+	// already at path
+	bool create(const char* path, size_t size, char* err, bool isPrivate = false);
+	// shared maps it read-write, so writes land in the file and other processes see them.  otherwise
+	// it's private: writes are allowed, but they stay in this process
+	bool open(const char* path, char* err, bool shared = false);
+
+	char* data;
+	size_t size;
+
+private:
+#ifdef _WIN32
+	HANDLE file, mapping;
+#else
+	int fd;
+#endif
+	void close();
+};
+
+#endif
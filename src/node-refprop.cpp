@@ -1,60 +1,249 @@
 #include <node.h>
-
-#include <windows.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include <algorithm>
+#include <map>
+#include <mutex>
+#include <string>
 
 #include "node-refprop.h"
+#include "executor.h"
+#include "engine-pool.h"
+#include "flash-cache.h"
+#include "property-table.h"
+#include "fluids.h"
+#include "disk-cache.h"
+#include "broker.h"
 
 using namespace v8;
 using namespace node;
 
-RefpropContext* RefpropContext::_instance = NULL;
+std::atomic<RefpropContext*> RefpropContext::_instance(NULL);
+thread_local char RefpropContext::selectedFluid[refpropcharlength] = "";
+thread_local bool RefpropContext::statusErrors = false;
+std::atomic<unsigned long> RefpropContext::setupCalls(0);
+char RefpropContext::libraryPath[filepathlength+1] = "";
+char RefpropContext::fluidPath[filepathlength+1] = "";
+char RefpropContext::mixturePath[filepathlength+1] = "";
+
+#ifdef _WIN32
+#define defaultLibrary "C:\\Program Files (x86)\\REFPROP\\REFPRP64.DLL"
+#define defaultFluids "C:\\Program Files (x86)\\REFPROP\\fluids\\"
+#define defaultMixtures "C:\\Program Files (x86)\\REFPROP\\mixtures\\"
+#define librarySymbol(lib, name) GetProcAddress(lib, name)
+#define closeLibrary(lib) FreeLibrary(lib)
+#else
+#include <unistd.h>
+#define defaultLibrary "/opt/refprop/librefprop.so"
+#define defaultFluids "/opt/refprop/FLUIDS/"
+#define defaultMixtures "/opt/refprop/MIXTURES/"
+#define librarySymbol(lib, name) dlsym(lib, name)
+#define closeLibrary(lib) dlclose(lib)
+#endif
+
+// false if the two don't fit in a path together, rather than quietly cutting it short
+static bool joinPath(char* dest, const char* path, const char* suffix) {
+	return snprintf(dest, filepathlength+1, "%s%s", path, suffix) <= filepathlength;
+}
+
+bool RefpropContext::defaultPaths(char* err) {
+	const char* env;
+	const char* tooLong = NULL;
+	char prefix[filepathlength+1];
 
-// singleton pattern
+	if ((env = getenv("RPPREFIX")) != NULL && env[0]) {
+		// refprop's own convention for where it lives outside windows
+		bool fits = joinPath(prefix, env, strchr("/\\", env[strlen(env)-1]) ? "" : "/");
+#ifdef _WIN32
+		fits = fits && joinPath(libraryPath, prefix, "REFPRP64.DLL");
+		fits = fits && joinPath(fluidPath, prefix, "fluids\\");
+		fits = fits && joinPath(mixturePath, prefix, "mixtures\\");
+#else
+		fits = fits && joinPath(libraryPath, prefix, "librefprop.so");
+		fits = fits && joinPath(fluidPath, prefix, "FLUIDS/");
+		fits = fits && joinPath(mixturePath, prefix, "MIXTURES/");
+#endif
+		if (!fits)
+			tooLong = "RPPREFIX";
+	}
+	else {
+		joinPath(libraryPath, defaultLibrary, "");
+		joinPath(fluidPath, defaultFluids, "");
+		joinPath(mixturePath, defaultMixtures, "");
+	}
+
+	if ((env = getenv("REFPROP_LIBRARY")) != NULL && env[0] && !joinPath(libraryPath, env, ""))
+		tooLong = "REFPROP_LIBRARY";
+	if ((env = getenv("REFPROP_FLUIDS")) != NULL && env[0] && !joinPath(fluidPath, env, ""))
+		tooLong = "REFPROP_FLUIDS";
+	if ((env = getenv("REFPROP_MIXTURES")) != NULL && env[0] && !joinPath(mixturePath, env, ""))
+		tooLong = "REFPROP_MIXTURES";
+
+	if (tooLong) {
+		libraryPath[0] = '\0';  // so the next call looks again rather than using whatever got cut short
+		snprintf(err, errormessagelength+1, "%s is too long; library, fluid and mixture paths have to fit in %d characters", tooLong, filepathlength);
+		return false;
+	}
+	return true;
+}
+
+// singleton pattern.  this is the context every synchronous call goes through; the engine pool loads
+// its extra copies of the library alongside it.  there's one per process, whichever js thread gets here first
 RefpropContext* RefpropContext::instance(v8::Isolate* iso) {
-	if (!_instance)   // Only allow one instance of class to be generated.
-		_instance = new RefpropContext(iso);
+	RefpropContext* loaded = _instance;
+	if (loaded)
+		return loaded;
+
+	static std::mutex creating;
+	std::lock_guard<std::mutex> lock(creating);
+
+	if (!_instance) {  // Only allow one instance of class to be generated.
+		char err[errormessagelength+1];
+		if (!libraryPath[0] && !defaultPaths(err)) {
+			if (iso)
+				iso->ThrowException(Exception::TypeError(String::NewFromUtf8(iso, err)));
+			return NULL;
+		}
+		RefpropContext* rp = new RefpropContext(libraryPath, 0);
+
+		if (!rp->isLoaded()) {
+			if (iso)
+				iso->ThrowException(Exception::TypeError(String::NewFromUtf8(iso, rp->errorMessage())));
+			delete rp;
+			return NULL;
+		}
+		_instance = rp;
+	}
 	return _instance;
 }
 
-RefpropContext::RefpropContext(v8::Isolate* iso) {
-	this->RefpropDllInstance = LoadLibrary("C:\\Program Files (x86)\\REFPROP\\REFPRP64.DLL");
+// windows hands back the module it already has if we load the same file twice, and so does dlopen;
+// refprop keeps all of its state in fortran common blocks, so every extra engine gets its own copy of
+// the library on disk
+#ifdef _WIN32
+static LibraryHandle loadPrivateCopy(const char* path, int copy) {
+	if (copy == 0)
+		return LoadLibrary(path);
+
+	char tmpDir[MAX_PATH], copyPath[MAX_PATH+64];
+	GetTempPath(MAX_PATH, tmpDir);
+	sprintf(copyPath, "%sREFPRP64-%lu-%d.DLL", tmpDir, (unsigned long)GetCurrentProcessId(), copy);
+
+	if (!CopyFile(path, copyPath, FALSE))
+		return NULL;
+	return LoadLibrary(copyPath);
+}
+#else
+static LibraryHandle loadPrivateCopy(const char* path, int copy) {
+	if (copy == 0)
+		return dlopen(path, RTLD_NOW | RTLD_LOCAL);
+
+	const char* tmpDir = getenv("TMPDIR");
+	char copyPath[filepathlength+64];
+	snprintf(copyPath, sizeof(copyPath), "%s/librefprop-%lu-%d.so", tmpDir && tmpDir[0] ? tmpDir : "/tmp", (unsigned long)getpid(), copy);
+
+	FILE* in = fopen(path, "rb");
+	FILE* out = in ? fopen(copyPath, "wb") : NULL;
+	bool copied = in && out;
+	char buf[1 << 16];
+	size_t n;
+	while (copied && (n = fread(buf, 1, sizeof(buf), in)) > 0)
+		copied = fwrite(buf, 1, n, out) == n;
+	if (in)
+		fclose(in);
+	if (out && fclose(out) != 0)
+		copied = false;
+	if (!copied)
+		return NULL;
+
+	// the mapping keeps the file alive after it's unlinked, so there's nothing to clean up later
+	LibraryHandle lib = dlopen(copyPath, RTLD_NOW | RTLD_LOCAL);
+	unlink(copyPath);
+	return lib;
+}
+#endif
+
+RefpropContext::RefpropContext(const char* path, int copy) {
+	uv_mutex_init(&this->mutex);
+	this->cache = new FlashCache();
+	this->signature = 0;
+	this->tableGeneration = (unsigned long)-1;
+	this->_fluid[0] = '\0';
+	this->nc = 1;
+	memset(this->composition, 0, sizeof(this->composition));
+	this->composition[0] = 1;
+	this->forgetCompositions();
+	this->Tcrit = 0;
+	this->satHeld = 0;
+	this->stats = NULL;
+	this->ierr = 0;
+	strcpy(this->herr, "Ok");
+
+	this->RefpropDllInstance = loadPrivateCopy(path, copy);
 
 	if (NULL == this->RefpropDllInstance) {
-		iso->ThrowException(Exception::TypeError(String::NewFromUtf8(iso, "Failed to load refprop.dll")));
+		snprintf(this->herr, sizeof(this->herr), "Failed to load the refprop library from %s", path);
 		return;
 	}
 
-	this->SETUPdll = (fp_SETUPdllTYPE) GetProcAddress(this->RefpropDllInstance,"SETUPdll");
-	if (NULL == this->SETUPdll) {
-		iso->ThrowException(Exception::TypeError(String::NewFromUtf8(iso, "Failed to locate setup function pointer")));
+	this->SETUPdll = (fp_SETUPdllTYPE) librarySymbol(this->RefpropDllInstance,"SETUPdll");
+	if (!this->SETUPdll) {
+		strcpy(this->herr, "Failed to locate setup function pointer");
+		closeLibrary(this->RefpropDllInstance);
+		this->RefpropDllInstance = NULL;
 		return;
 	}
 
 	// get function pointers into DLL
-	this->DEFLSHdll = (fp_DEFLSHdllTYPE) GetProcAddress(this->RefpropDllInstance,"DEFLSHdll");
-	this->DHFLSHdll = (fp_DHFLSHdllTYPE) GetProcAddress(this->RefpropDllInstance,"DHFLSHdll");
-	this->DSFLSHdll = (fp_DSFLSHdllTYPE) GetProcAddress(this->RefpropDllInstance,"DSFLSHdll");
-	this->ESFLSHdll = (fp_ESFLSHdllTYPE) GetProcAddress(this->RefpropDllInstance,"ESFLSHdll");
-	this->HSFLSHdll = (fp_HSFLSHdllTYPE) GetProcAddress(this->RefpropDllInstance,"HSFLSHdll");
-	this->PDFLSHdll = (fp_PDFLSHdllTYPE) GetProcAddress(this->RefpropDllInstance,"PDFLSHdll");
-	this->PEFLSHdll = (fp_PEFLSHdllTYPE) GetProcAddress(this->RefpropDllInstance,"PEFLSHdll");
-	this->PHFLSHdll = (fp_PHFLSHdllTYPE) GetProcAddress(this->RefpropDllInstance,"PHFLSHdll");
-	this->PQFLSHdll = (fp_PQFLSHdllTYPE) GetProcAddress(this->RefpropDllInstance,"PQFLSHdll");
-	this->PSFLSHdll = (fp_PSFLSHdllTYPE) GetProcAddress(this->RefpropDllInstance,"PSFLSHdll");
-	this->TDFLSHdll = (fp_TDFLSHdllTYPE) GetProcAddress(this->RefpropDllInstance,"TDFLSHdll");
-	this->TEFLSHdll = (fp_TEFLSHdllTYPE) GetProcAddress(this->RefpropDllInstance,"TEFLSHdll");
-	this->THFLSHdll = (fp_THFLSHdllTYPE) GetProcAddress(this->RefpropDllInstance,"THFLSHdll");
-	this->TPFLSHdll = (fp_TPFLSHdllTYPE) GetProcAddress(this->RefpropDllInstance,"TPFLSHdll");
-	this->TQFLSHdll = (fp_TQFLSHdllTYPE) GetProcAddress(this->RefpropDllInstance,"TQFLSHdll");
-	this->TSFLSHdll = (fp_TSFLSHdllTYPE) GetProcAddress(this->RefpropDllInstance,"TSFLSHdll");
-	this->WMOLdll = (fp_WMOLdllTYPE) GetProcAddress(this->RefpropDllInstance,"WMOLdll");
-	this->TRNPRPdll = (fp_TRNPRPdllTYPE) GetProcAddress(this->RefpropDllInstance,"TRNPRPdll");
-	this->CVCPdll = (fp_CVCPdllTYPE) GetProcAddress(this->RefpropDllInstance,"CVCPdll");
-	this->SURTENdll = (fp_SURTENdllTYPE) GetProcAddress(this->RefpropDllInstance,"SURTENdll");
+	this->DEFLSHdll = (fp_DEFLSHdllTYPE) librarySymbol(this->RefpropDllInstance,"DEFLSHdll");
+	this->DHFLSHdll = (fp_DHFLSHdllTYPE) librarySymbol(this->RefpropDllInstance,"DHFLSHdll");
+	this->DSFLSHdll = (fp_DSFLSHdllTYPE) librarySymbol(this->RefpropDllInstance,"DSFLSHdll");
+	this->ESFLSHdll = (fp_ESFLSHdllTYPE) librarySymbol(this->RefpropDllInstance,"ESFLSHdll");
+	this->HSFLSHdll = (fp_HSFLSHdllTYPE) librarySymbol(this->RefpropDllInstance,"HSFLSHdll");
+	this->PDFLSHdll = (fp_PDFLSHdllTYPE) librarySymbol(this->RefpropDllInstance,"PDFLSHdll");
+	this->PEFLSHdll = (fp_PEFLSHdllTYPE) librarySymbol(this->RefpropDllInstance,"PEFLSHdll");
+	this->PHFLSHdll = (fp_PHFLSHdllTYPE) librarySymbol(this->RefpropDllInstance,"PHFLSHdll");
+	this->PQFLSHdll = (fp_PQFLSHdllTYPE) librarySymbol(this->RefpropDllInstance,"PQFLSHdll");
+	this->PSFLSHdll = (fp_PSFLSHdllTYPE) librarySymbol(this->RefpropDllInstance,"PSFLSHdll");
+	this->TDFLSHdll = (fp_TDFLSHdllTYPE) librarySymbol(this->RefpropDllInstance,"TDFLSHdll");
+	this->TEFLSHdll = (fp_TEFLSHdllTYPE) librarySymbol(this->RefpropDllInstance,"TEFLSHdll");
+	this->THFLSHdll = (fp_THFLSHdllTYPE) librarySymbol(this->RefpropDllInstance,"THFLSHdll");
+	this->TPFLSHdll = (fp_TPFLSHdllTYPE) librarySymbol(this->RefpropDllInstance,"TPFLSHdll");
+	this->TQFLSHdll = (fp_TQFLSHdllTYPE) librarySymbol(this->RefpropDllInstance,"TQFLSHdll");
+	this->TSFLSHdll = (fp_TSFLSHdllTYPE) librarySymbol(this->RefpropDllInstance,"TSFLSHdll");
+	this->WMOLdll = (fp_WMOLdllTYPE) librarySymbol(this->RefpropDllInstance,"WMOLdll");
+	this->XMOLEdll = (fp_XMOLEdllTYPE) librarySymbol(this->RefpropDllInstance,"XMOLEdll");
+	this->PHFL1dll = (fp_PHFL1dllTYPE) librarySymbol(this->RefpropDllInstance,"PHFL1dll");
+	this->PSFL1dll = (fp_PSFL1dllTYPE) librarySymbol(this->RefpropDllInstance,"PSFL1dll");
+	this->PDFL1dll = (fp_PDFL1dllTYPE) librarySymbol(this->RefpropDllInstance,"PDFL1dll");
+	this->TPRHOdll = (fp_TPRHOdllTYPE) librarySymbol(this->RefpropDllInstance,"TPRHOdll");
+	this->THERMdll = (fp_THERMdllTYPE) librarySymbol(this->RefpropDllInstance,"THERMdll");
+	this->SETMIXdll = (fp_SETMIXdllTYPE) librarySymbol(this->RefpropDllInstance,"SETMIXdll");
+	this->THERM2dll = (fp_THERM2dllTYPE) librarySymbol(this->RefpropDllInstance,"THERM2dll");
+	this->THERM3dll = (fp_THERM3dllTYPE) librarySymbol(this->RefpropDllInstance,"THERM3dll");
+	this->DPDDdll = (fp_DPDDdllTYPE) librarySymbol(this->RefpropDllInstance,"DPDDdll");
+	this->DPDTdll = (fp_DPDTdllTYPE) librarySymbol(this->RefpropDllInstance,"DPDTdll");
+	this->DDDTdll = (fp_DDDTdllTYPE) librarySymbol(this->RefpropDllInstance,"DDDTdll");
+	this->CRITPdll = (fp_CRITPdllTYPE) librarySymbol(this->RefpropDllInstance,"CRITPdll");
+	this->INFOdll = (fp_INFOdllTYPE) librarySymbol(this->RefpropDllInstance,"INFOdll");
+	this->LIMITSdll = (fp_LIMITSdllTYPE) librarySymbol(this->RefpropDllInstance,"LIMITSdll");
+	this->SATTdll = (fp_SATTdllTYPE) librarySymbol(this->RefpropDllInstance,"SATTdll");
+	this->SATPdll = (fp_SATPdllTYPE) librarySymbol(this->RefpropDllInstance,"SATPdll");
+	this->ENTHALdll = (fp_ENTHALdllTYPE) librarySymbol(this->RefpropDllInstance,"ENTHALdll");
+	this->ENTROdll = (fp_ENTROdllTYPE) librarySymbol(this->RefpropDllInstance,"ENTROdll");
+	this->TRNPRPdll = (fp_TRNPRPdllTYPE) librarySymbol(this->RefpropDllInstance,"TRNPRPdll");
+	this->CVCPdll = (fp_CVCPdllTYPE) librarySymbol(this->RefpropDllInstance,"CVCPdll");
+	this->SURTENdll = (fp_SURTENdllTYPE) librarySymbol(this->RefpropDllInstance,"SURTENdll");
 
 	// build the flash function lookup table
 	this->flashString = "TPDHSEQ";
 
+	// pairs that refprop can't flash on (TT, HQ, ...) stay NULL
+	for (int i = 0; i < 7; i++)
+		for (int j = 0; j < 7; j++)
+			flashTable[i][j] = NULL;
+
 	this->flashTable[0][1] = &RefpropContext::calcTP;
 	this->flashTable[0][2] = &RefpropContext::calcTD;
 	this->flashTable[0][3] = &RefpropContext::calcTH;
@@ -78,14 +267,31 @@ RefpropContext::RefpropContext(v8::Isolate* iso) {
 
 	// make it a symmetric matrix
 	for (int i = 0; i < 7; i++)
-		for (int j = 0; j < 7; j++)
+		for (int j = i+1; j < 7; j++)
 			flashTable[j][i] = flashTable[i][j];
 }
 
+RefpropContext::~RefpropContext() {
+	if (this->RefpropDllInstance)
+		closeLibrary(this->RefpropDllInstance);
+	delete this->cache;
+	uv_mutex_destroy(&this->mutex);
+}
+
+bool RefpropContext::started() {
+	return _instance != NULL;
+}
+
+bool RefpropContext::isLoaded() {
+	return this->RefpropDllInstance != NULL;
+}
+
 void setFluid(const FunctionCallbackInfo<Value>& args) {
 	Isolate* iso = args.GetIsolate();
 
 	RefpropContext* rp = RefpropContext::instance(iso);
+	if (!rp)
+		return;
 
 	// now we do error checking to ensure we can pop out the requestedFluid argument
     if (args.Length() < 1) {
@@ -95,47 +301,258 @@ void setFluid(const FunctionCallbackInfo<Value>& args) {
 
     // now pull out the requestedFluid and cram it into a c-style string
 	String::Utf8Value requestedFluid(args[0]->ToString());
+	RefpropLock lock(rp);
+	FluidScheduler::noteFluid(*requestedFluid);
 	rp->setFluid(*requestedFluid, iso);
+	FlashExecutor::instance()->fluidChanged(RefpropContext::selectedFluid);
 	args.GetReturnValue().Set(Undefined(iso));
 }
 
 void getFluid(const FunctionCallbackInfo<Value>& args) {
 	Isolate* iso = args.GetIsolate();
 	RefpropContext* rp = RefpropContext::instance(iso);
+	if (!rp)
+		return;
+	RefpropLock lock(rp);
 
-	Local<String> fluid = String::NewFromUtf8(iso, rp->getFluid());
+	Local<String> fluid = String::NewFromUtf8(iso, RefpropContext::selectedFluid);
 	args.GetReturnValue().Set(fluid);
 }
 
+void setErrorMode(const FunctionCallbackInfo<Value>& args) {
+	Isolate* iso = args.GetIsolate();
+	// args[0] is 'throw', the default, or 'status'.  in status mode a flash refprop can't solve doesn't
+	// throw: statePoint and statePointAsync return {ierr, herr} instead, every state they do return has
+	// ierr (0 when all went well), and batch rows just come back NaN (see statePointBatch's status
+	// option for their codes).  returns the mode it was in
+
+	String::Utf8Value mode(args.Length() > 0 ? args[0]->ToString() : String::Empty(iso));
+	if (strcmp(*mode, "throw") != 0 && strcmp(*mode, "status") != 0) {
+		iso->ThrowException(Exception::TypeError(String::NewFromUtf8(iso, "Error mode must be 'throw' or 'status'")));
+		return;
+	}
+
+	Local<String> previous = String::NewFromUtf8(iso, RefpropContext::statusErrors ? "status" : "throw");
+	args.GetReturnValue().Set(previous);
+	RefpropContext::statusErrors = strcmp(*mode, "status") == 0;
+}
+
+Local<String> statusMessage(Isolate* iso, const char* herr) {
+	return String::NewFromUtf8(iso, herr, String::kInternalizedString);
+}
+
+Local<Object> flashResult(Isolate* iso, ThermoState* state, long ierr, const char* herr, PropertyMask want, const char* lazyFluid) {
+	// a failed flash has nothing worth reporting but the failure.  a warning rides along with the state
+	// whichever mode we're in, so it isn't lost; status mode adds ierr to every state
+	Local<Object> obj = ierr > 0 ? Object::New(iso) : state->toJs(iso, want, lazyFluid);
+	if (ierr != 0 || RefpropContext::statusErrors)
+		obj->Set(String::NewFromUtf8(iso, "ierr"), Number::New(iso, (double)ierr));
+	if (ierr != 0)
+		obj->Set(String::NewFromUtf8(iso, "herr"), statusMessage(iso, herr));
+	return obj;
+}
+
+void setPaths(const FunctionCallbackInfo<Value>& args) {
+	Isolate* iso = args.GetIsolate();
+	// args[0] is {library: '/path/to/librefprop.so', fluids: '/path/to/FLUIDS/', mixtures: '/path/to/MIXTURES/'},
+	// each one optional.  has to happen before anything loads the library.  returns the paths in use either way
+
+	char err[errormessagelength+1];
+	if (!RefpropContext::libraryPath[0] && !RefpropContext::defaultPaths(err)) {
+		iso->ThrowException(Exception::TypeError(String::NewFromUtf8(iso, err)));
+		return;
+	}
+
+	const char* keys[] = { "library", "fluids", "mixtures" };
+	char* paths[] = { RefpropContext::libraryPath, RefpropContext::fluidPath, RefpropContext::mixturePath };
+
+	if (args.Length() > 0 && args[0]->IsObject()) {
+		Local<Object> options = args[0]->ToObject();
+
+		if (RefpropContext::started()) {
+			iso->ThrowException(Exception::Error(String::NewFromUtf8(iso, "The refprop library is already loaded; set its paths before using it")));
+			return;
+		}
+
+		for (int i = 0; i < 3; i++) {
+			String::Utf8Value path(options->Get(String::NewFromUtf8(iso, keys[i]))->ToString());
+			if (strlen(*path) > filepathlength) {
+				iso->ThrowException(Exception::TypeError(String::NewFromUtf8(iso, "Library, fluid and mixture paths have to fit in 255 characters")));
+				return;
+			}
+		}
+		for (int i = 0; i < 3; i++) {
+			Local<Value> path = options->Get(String::NewFromUtf8(iso, keys[i]));
+			if (!path->IsUndefined())
+				strcpy(paths[i], *String::Utf8Value(path->ToString()));
+		}
+	}
+
+	Local<Object> obj = Object::New(iso);
+	for (int i = 0; i < 3; i++)
+		obj->Set(String::NewFromUtf8(iso, keys[i]), String::NewFromUtf8(iso, paths[i]));
+	args.GetReturnValue().Set(obj);
+}
+
 void RefpropContext::setFluid(char *requestedFluid, Isolate* iso) {
-	// if they're just asking for the same string we've already loaded, don't bother doing anything
-	if (strcmp(this->_fluid, requestedFluid) != 0) {
-		long i,ierr=0;
+	if (this->loadFluid(requestedFluid) != 0)
+		iso->ThrowException(Exception::TypeError(String::NewFromUtf8(iso, "Error loading fluid requested fluid!")));
+	else
+		strcpy(selectedFluid, requestedFluid);
+}
 
-		char hf[refpropcharlength*ncmax], hrf[lengthofreference],
-			herr[errormessagelength],hfmix[refpropcharlength];
+long RefpropContext::loadSelected() {
+	if (!selectedFluid[0]) {
+		this->ierr = 1;
+		strcpy(this->herr, noFluidMessage);
+		return this->ierr;
+	}
+	return this->loadFluid(selectedFluid);
+}
+
+// every js thread starts out without a fluid (see Broker), and an engine's leftover fluid would be some
+// other caller's, so the global calls throw until setFluid picks one
+bool fluidChosen(const char* fluid, Isolate* iso) {
+	if (fluid[0])
+		return true;
+	iso->ThrowException(Exception::TypeError(String::NewFromUtf8(iso, noFluidMessage)));
+	return false;
+}
 
-		// Explicitly set the fluid file PATH... this doesn't work generically but fuck it
-		char *FLD_PATH = "C:\\Program Files (x86)\\REFPROP\\fluids\\";
-		strcpy(hf,FLD_PATH);
-		strcpy(hfmix,FLD_PATH);
+// the fluid file for one component: a bare name gets the .FLD extension, anything with an extension of
+// its own (a pseudo-pure .PPF, say) is taken as is
+static bool appendComponent(char* hf, size_t size, const char* name, size_t length) {
+	bool bare = true;
+	for (size_t i = 0; i < length; i++)
+		if (name[i] == '.')
+			bare = false;
 
-		//...initialize the program and set the pure fluid component name
-		i=1;
-		strcat(hf,requestedFluid);
-		strcat(hf,".FLD");
-		strcat(hfmix,"HMX.BNC");
+	size_t used = strlen(hf);
+	int n = snprintf(hf + used, size - used, "%s%s%.*s%s", used ? "|" : "", RefpropContext::fluidPath, (int)length, name, bare ? ".FLD" : "");
+	return n >= 0 && (size_t)n < size - used;
+}
+
+static bool isMixtureFile(const char* name) {
+	size_t length = strlen(name);
+	return length > 4 && (strcmp(name + length - 4, ".mix") == 0 || strcmp(name + length - 4, ".MIX") == 0);
+}
+
+long RefpropContext::loadFluid(const char *requestedFluid) {
+	this->ierr = 0;
+
+	// if they're just asking for the same string we've already loaded, don't bother doing anything.  the
+	// fluid string names a component set, so a mixture only reloads when its components change; the
+	// fractions come with each call
+	if (strcmp(this->_fluid, requestedFluid) != 0) {
+		long i = 0;
+
+		char hf[refpropcharlength*ncmax], hrf[lengthofreference+1],
+			hfmix[refpropcharlength];
+		double x[ncmax] = {0};
+
+		// refprop wants full paths to the fluid files, and they have to fit in its fixed-length strings;
+		// one that doesn't fails the load rather than reaching setup cut short
+		hf[0] = '\0';
 		strcpy(hrf,"DEF");
-		strcpy(herr,"Ok");
+		strcpy(this->herr,"Ok");
+		if (snprintf(hfmix, sizeof(hfmix), "%sHMX.BNC", fluidPath) >= (int)sizeof(hfmix)) {
+			this->ierr = 1;
+			snprintf(this->herr, sizeof(this->herr), "The fluid path has to leave room for HMX.BNC in %d characters", (int)sizeof(hfmix) - 1);
+		}
+		std::string files = hfmix;  // everything the disk cache's signature covers
 
 		// when we get to this point, they've asked for a new fluid, so we'll load that mother into the existing refprop context
-		this->SETUPdll(i, hf, hfmix, hrf, ierr, herr,refpropcharlength*ncmax,refpropcharlength,lengthofreference,errormessagelength);
+		setupCalls++;
+		unsigned long long start = Stats::now();
+		if (isMixtureFile(requestedFluid)) {
+			// one of refprop's predefined mixtures, which brings its own composition
+			char hmxnme[filepathlength+1];
+			if (snprintf(hmxnme, sizeof(hmxnme), "%s%s", mixturePath, requestedFluid) > filepathlength) {
+				this->ierr = 1;
+				snprintf(this->herr, sizeof(this->herr), "Mixture files have to fit in %d characters along with the mixture path", filepathlength);
+			}
+			else if (this->ierr == 0) {
+				this->SETMIXdll(hmxnme, hfmix, hrf, i, hf, x, this->ierr, this->herr,filepathlength,refpropcharlength,lengthofreference,refpropcharlength*ncmax,errormessagelength);
+				files = files + "|" + hmxnme;
+			}
+		}
+		else {
+			// "R32|R125" is a mixture of those two, in equal parts unless a call says otherwise
+			const char* name = requestedFluid;
+			while (this->ierr == 0) {
+				const char* bar = strchr(name, '|');
+				size_t length = bar ? (size_t)(bar - name) : strlen(name);
+				if (i == ncmax || length == 0 || !appendComponent(hf, sizeof(hf), name, length)) {
+					this->ierr = 1;
+					snprintf(this->herr, sizeof(this->herr), "Mixtures take 1 to %d components, and their fluid files have to fit in %d characters", ncmax, (int)sizeof(hf) - 1);
+				}
+				else
+					i++;
+
+				if (!bar)
+					break;
+				name = bar + 1;
+			}
+			for (long c = 0; c < i; c++)
+				x[c] = 1.0 / i;
+
+			if (this->ierr == 0)
+				this->SETUPdll(i, hf, hfmix, hrf, this->ierr, this->herr,refpropcharlength*ncmax,refpropcharlength,lengthofreference,errormessagelength);
+		}
 
-		if (ierr != 0)
-			iso->ThrowException(Exception::TypeError(String::NewFromUtf8(iso, "Error loading fluid requested fluid!")));
-		else
+		if (this->ierr == 0) {
 			strcpy(this->_fluid, requestedFluid);
+			this->nc = i;
+			memcpy(this->composition, x, sizeof(this->composition));
+			this->stats = Stats::fluid(requestedFluid);
+			this->stats->setup.record(Stats::now() - start);
+			hf[sizeof(hf) - 1] = '\0';
+			this->signature = DiskCache::signature(files + "|" + hf);
+		}
+		else {
+			this->_fluid[0] = '\0';  // setup may have gotten partway; don't trust what's loaded
+			this->stats = NULL;
+			Stats::recordError(this->ierr);
+		}
+		this->cache->clear();
+		this->forgetCompositions();
+		this->tableGeneration = (unsigned long)-1;  // the new fluid may have a table of its own
+		this->Tcrit = 0;
+		this->satHeld = 0;
+	}
+	return this->ierr;
+}
+
+long RefpropContext::components() {
+	return this->nc;
+}
+
+// a new fluid has a different molar mass, even for the same fractions
+void RefpropContext::forgetCompositions() {
+	this->fluidMolarMass = 0;
+	this->lastFractions[0] = -1;  // no real composition has a negative fraction
+	this->lastMassBasis = false;
+}
+
+void RefpropContext::lock() {
+	uv_mutex_lock(&this->mutex);
+}
+
+void RefpropContext::unlock() {
+	uv_mutex_unlock(&this->mutex);
+}
+
+FlashCache* RefpropContext::flashCache() {
+	return this->cache;
+}
+
+PropertyTable* RefpropContext::propertyTable() {
+	unsigned long generation = TableRegistry::generation;
+	if (generation != this->tableGeneration) {
+		this->table = TableRegistry::find(this->_fluid);
+		this->tableGeneration = generation;
 	}
+	return this->table.get();
 }
 
 char* RefpropContext::getFluid() {
@@ -143,62 +560,746 @@ char* RefpropContext::getFluid() {
 }
 
 void statePoint(const FunctionCallbackInfo<Value>& args) {
+	flashPoint(args, 0);
+}
+
+void statePointWithDerivatives(const FunctionCallbackInfo<Value>& args) {
+	// same as statePoint, plus the equation of state's derivatives (dPdD, dPdT, dDdT, dDdP, the second
+	// derivatives of P, JT, kappaT, beta, kappaS and isenK) out of the same native call
+	flashPoint(args, derivativeMask);
+}
+
+// statePoint, with extra added to whatever properties the caller asked for
+void flashPoint(const FunctionCallbackInfo<Value>& args, PropertyMask extra) {
 	Isolate *iso = args.GetIsolate();
 	// there should be at least one and maybe two arguments
 	// args[0] should be an object with two fields.  the keys should be used to lookup the correct flash function
+	//  - plus, for mixtures, an optional composition and its basis, and an optional phase hint (see parseCoords)
 	// args[1] might be an array with strings in it.  the strings represent requested properties
 	//  - we'll go ahead and always reply with all the flash function properties, but give out whatever else they want
+	//  - or it's {properties: [...], lazy: true}, and the transport properties get worked out when they're first read
 
 	if (args.Length() < 1) {
 		iso->ThrowException(Exception::TypeError(String::NewFromUtf8(iso, "Must provide quantities to establish thermodynamic state")));
+		return;
+	}
+
+	char props[2];
+	double values[2];
+	Composition comp;
+	FlashGuess guess;
+	if (!parseCoords(args[0], props, values, iso, &comp, &guess))
+		return;
+
+	PropertyMask want;
+	bool lazy;
+	if (!parseOutputs(args[1], &want, &lazy, iso))
+		return;
+	want |= extra;
+
+	// grab refprop
+	RefpropContext* rp = RefpropContext::instance(iso);
+	if (!rp)
+		return;
+	RefpropLock lock(rp);
+
+	FluidScheduler::noteFluid(RefpropContext::selectedFluid);
+	if (rp->loadSelected() != 0) {
+		iso->ThrowException(Exception::TypeError(String::NewFromUtf8(iso, rp->errorMessage())));
+		return;
 	}
+	ThermoState state;
+	if (rp->doFlash(props, values, &state, iso, lazy ? want & ~transportMask : want, &comp, &guess))
+		args.GetReturnValue().Set(flashResult(iso, &state, rp->errorCode(), rp->errorMessage(), want, lazy ? RefpropContext::selectedFluid : NULL));
+}
 
-	// get the key/value pairs that establish the thermodynamic state
-	Local<Object> coords = args[0]->ToObject()->Clone();  // note that the keys are available with coords->GetOwnPropertyNames();
+// get the key/value pairs that establish the thermodynamic state, e.g. {T: 300, P: 101.3e3}.  with comp,
+// a mixture's composition can come along too: {T: 300, P: 101.3e3, composition: [.7, .3], basis: 'mass'}.
+// with guess, so can the phase the caller knows it's in: {P: 2e6, H: 450e3, phase: 'vapor', checkPhase: false}
+bool parseCoords(Local<Value> arg, char props[2], double values[2], Isolate* iso, Composition* comp, FlashGuess* guess) {
+	Local<Object> coords = arg->ToObject()->Clone();  // note that the keys are available with coords->GetOwnPropertyNames();
 	Local<Array> keys = coords->GetOwnPropertyNames();
 
-	if (keys->Length() != 2) {
-		iso->ThrowException(Exception::TypeError(String::NewFromUtf8(iso, "Thermodynamic state established by exactly 2 values")));
+	Local<Value> coordKeys[2];
+	uint32_t numCoords = 0;
+	for (uint32_t i = 0; i < keys->Length(); i++) {
+		String::Utf8Value key(keys->Get(i)->ToString());
+		if (comp && (strcmp(*key, "composition") == 0 || strcmp(*key, "basis") == 0))
+			continue;
+		if (guess && (strcmp(*key, "phase") == 0 || strcmp(*key, "checkPhase") == 0))
+			continue;
+		if (numCoords < 2)
+			coordKeys[numCoords] = keys->Get(i);
+		numCoords++;
 	}
 
-	char props[2];
-	double values[2];
+	if (numCoords != 2) {
+		iso->ThrowException(Exception::TypeError(String::NewFromUtf8(iso, "Thermodynamic state established by exactly 2 values")));
+		return false;
+	}
 
 	for (int i=0; i < 2; i++) {
-		String::Utf8Value key(keys->Get(i)->ToString());
+		String::Utf8Value key(coordKeys[i]->ToString());
 		props[i] = (*key)[0];
-		values[i] = coords->Get(keys->Get(i))->ToNumber()->Value();
+		values[i] = coords->Get(coordKeys[i])->ToNumber()->Value();
 	}
 
-	// grab refprop
-	RefpropContext* rp = RefpropContext::instance(iso);
-	ThermoState *state = rp->doFlash(props, values, iso);
+	if (comp && !parseComposition(coords->Get(String::NewFromUtf8(iso, "composition")), coords->Get(String::NewFromUtf8(iso, "basis")), comp, iso))
+		return false;
+	if (guess && !parsePhase(coords->Get(String::NewFromUtf8(iso, "phase")), coords->Get(String::NewFromUtf8(iso, "checkPhase")), guess, iso))
+		return false;
+	return true;
+}
 
-	args.GetReturnValue().Set(state->toJs(iso));
+// a phase hint, 'liquid', 'vapor' or 'supercritical', and whether to check it (the default).  single-phase
+// PH, PS, PD and TP flashes with a hint skip refprop's saturation checks
+bool parsePhase(Local<Value> phase, Local<Value> check, FlashGuess* guess, Isolate* iso) {
+	guess->phase = PHASE_UNKNOWN;
+	guess->check = check->IsUndefined() || check->BooleanValue();
+	if (phase->IsUndefined())
+		return true;
+
+	String::Utf8Value name(phase->ToString());
+	if (strcmp(*name, "liquid") == 0)
+		guess->phase = PHASE_LIQUID;
+	else if (strcmp(*name, "vapor") == 0)
+		guess->phase = PHASE_VAPOR;
+	else if (strcmp(*name, "supercritical") == 0)
+		guess->phase = PHASE_SUPERCRITICAL;
+	else {
+		iso->ThrowException(Exception::TypeError(String::NewFromUtf8(iso, "Phase must be 'liquid', 'vapor' or 'supercritical'")));
+		return false;
+	}
+	return true;
 }
 
-RefpropContext::FlashFcn RefpropContext::flashFcnLookup(const char props[2], Isolate* iso) {
-	int idx[2];
+// a composition as an array of fractions, and its basis: 'mole' (the default) or 'mass'.  an undefined
+// composition leaves comp empty, for the fluid's own
+bool parseComposition(Local<Value> arg, Local<Value> basis, Composition* comp, Isolate* iso) {
+	comp->n = 0;
+	comp->mass = false;
 
-	for (int i=0; i < 2; i++) {
-		char* e = strchr(this->flashString, props[i]);
-		if (e) {
-			idx[i] = (int)(e - this->flashString);
+	if (!basis->IsUndefined()) {
+		String::Utf8Value name(basis->ToString());
+		if (strcmp(*name, "mass") != 0 && strcmp(*name, "mole") != 0) {
+			iso->ThrowException(Exception::TypeError(String::NewFromUtf8(iso, "Composition basis must be 'mole' or 'mass'")));
+			return false;
 		}
+		comp->mass = strcmp(*name, "mass") == 0;
+	}
+	if (arg->IsUndefined())
+		return true;
+
+	if (!arg->IsArray() && !arg->IsFloat64Array()) {
+		iso->ThrowException(Exception::TypeError(String::NewFromUtf8(iso, "Composition must be an array of fractions")));
+		return false;
+	}
+	Local<Object> fractions = arg->ToObject();
+	uint32_t n = fractions->Get(String::NewFromUtf8(iso, "length"))->Uint32Value();
+	if (n == 0 || n > ncmax) {
+		iso->ThrowException(Exception::TypeError(String::NewFromUtf8(iso, "Composition must have a fraction for each of the fluid's components")));
+		return false;
+	}
+
+	comp->n = n;
+	for (uint32_t i = 0; i < n; i++)
+		comp->x[i] = fractions->Get(i)->NumberValue();
+	return true;
+}
+
+// which properties a caller asked for: all of them if arg is undefined, otherwise an array of names or
+// {properties: [...], lazy: true}.  only the transport properties cost anything extra
+bool parseOutputs(Local<Value> arg, PropertyMask* want, bool* lazy, Isolate* iso) {
+	*want = allProperties;
+	*lazy = false;
+	if (arg.IsEmpty() || arg->IsUndefined())
+		return true;
+
+	Local<Value> names = arg;
+	if (!arg->IsArray()) {
+		if (!arg->IsObject()) {
+			iso->ThrowException(Exception::TypeError(String::NewFromUtf8(iso, "Requested properties must be an array of names")));
+			return false;
+		}
+		Local<Object> options = arg->ToObject();
+		*lazy = options->Get(String::NewFromUtf8(iso, "lazy"))->BooleanValue();
+		names = options->Get(String::NewFromUtf8(iso, "properties"));
+		if (names->IsUndefined())
+			return true;
+		if (!names->IsArray()) {
+			iso->ThrowException(Exception::TypeError(String::NewFromUtf8(iso, "Requested properties must be an array of names")));
+			return false;
+		}
+	}
+
+	Local<Array> list = Local<Array>::Cast(names);
+	*want = allProperties & ~transportMask;
+	for (uint32_t i = 0; i < list->Length(); i++) {
+		String::Utf8Value name(list->Get(i)->ToString());
+		int idx = ThermoState::propertyIndex(*name);
+		if (idx < 0) {
+			iso->ThrowException(Exception::TypeError(String::NewFromUtf8(iso, "Unknown property requested")));
+			return false;
+		}
+		*want |= propertyBit(idx);
+	}
+	return true;
+}
+
+// points data at a Float64Array's backing store, or returns false if it isn't one
+bool float64Data(Local<Value> val, double** data, size_t* length) {
+	if (!val->IsFloat64Array())
+		return false;
+
+	// an empty array may have no backing store at all, which is still a perfectly good column
+	Local<Float64Array> arr = Local<Float64Array>::Cast(val);
+	*length = arr->Length();
+	*data = *length ? (double*)((char*)arr->Buffer()->GetContents().Data() + arr->ByteOffset()) : NULL;
+	return true;
+}
+
+// statePointBatch's rows, as handed to the engine pool
+class ColumnJob : public PoolJob {
+public:
+	ColumnJob(size_t rows, const char* fluid) : PoolJob(rows, fluid), inputRows(rows), warmRows(0), warmNs(0), coldRows(0), coldNs(0) {}
+
+	char props[2];
+	RefpropContext::FlashFcn flashFcn;
+	double* in[2];
+	std::vector<int> outIdx;
+	std::vector<double*> out;
+	PropertyMask want;  // outIdx as a mask, so flash() only does the transport calls we'll keep
+
+	// a mixture's composition: the same one for every row, or with rowFractions, n fractions per row
+	Composition comp;
+	const double* rowFractions;
+	bool trajectory;  // rows are points along a path, so each one starts from the one before
+	FlashGuess guess;  // the phase hint every row shares
+
+	// with an errors array, a row that won't flash gets NaN outputs and its message in the array, and
+	// the rest carry on.  the messages wait here until finish(), since the rows run off the js thread
+	v8::Persistent<v8::Array> errors;
+	std::vector<std::pair<size_t, std::string> > rowErrors;
+	std::mutex rowErrorsMutex;
+
+	// with a status column, every row gets its ierr there: 0, a warning below 0 (the row keeps its
+	// outputs) or a failure above it (NaN outputs).  failed rows don't throw with that, or in status mode
+	int32_t* status;
+	bool statusErrors;
+
+	// with schedule, the rows are flashed in order of their inputs (by the first, then the second) with
+	// exact repeats flashed once, each row starting from the one before it.  neighbouring rows then sit
+	// in the same phase and near each other on the surface, so the single-phase solves warm-start and
+	// the caches stay hot.  order is the rows to flash, in that order; the job's rows are positions in it.
+	// finish() copies the repeats' results over from the rows they repeat
+	std::vector<size_t> order;
+	std::vector<std::pair<size_t, size_t> > repeats;  // a row, and the earlier row it repeats
+	size_t inputRows;
+	std::atomic<unsigned long long> warmRows, warmNs, coldRows, coldNs;  // solves, and their time, with and without a start
+	v8::Persistent<v8::Object> report;
+
+	v8::Persistent<v8::Object> outputs;
+	v8::Persistent<v8::Array> columns;  // every array the rows touch, kept alive for async jobs
+
+	~ColumnJob() {
+		this->errors.Reset();
+		this->report.Reset();
+		this->outputs.Reset();
+		this->columns.Reset();
+	}
+
+	void schedule();
+
+	void runRows(RefpropContext* rp, size_t begin, size_t end) {
+		if (!this->order.empty()) {
+			this->runScheduled(rp, begin, end);
+			return;
+		}
+
+		PropertyTable* table = rp->propertyTable();
+		if (table && table->covers(this->props) && this->tabulated(table)) {
+			this->interpolateRows(rp, table, begin, end);
+			return;
+		}
+
+		// the first row of every range starts cold.  after that, the last state flashed is the guess
+		ThermoState states[2];
+		ThermoState* near = NULL;
+		for (size_t i = begin; i < end; i++) {
+			ThermoState* state = &states[(i - begin) % 2];
+			if (!this->flashRow(rp, state, i, near)) {
+				if (!this->keepGoing())
+					return;
+				near = NULL;
+			}
+			else if (this->trajectory)
+				near = state;
+		}
+	}
+
+	void finish(Isolate* iso) {
+		if (!this->order.empty())
+			this->unschedule(iso);
+		if (this->errors.IsEmpty())
+			return;
+
+		Local<Array> errors = Local<Array>::New(iso, this->errors);
+		for (size_t k = 0; k < this->rowErrors.size(); k++)
+			errors->Set((uint32_t)this->rowErrors[k].first, statusMessage(iso, this->rowErrors[k].second.c_str()));
+	}
+
+private:
+	void runScheduled(RefpropContext* rp, size_t begin, size_t end) {
+		ThermoState states[2];
+		ThermoState* near = NULL;
+		for (size_t p = begin; p < end; p++) {
+			ThermoState* state = &states[(p - begin) % 2];
+			bool warm = near != NULL;
+			bool ok = this->flashRow(rp, state, this->order[p], near, p);
+
+			unsigned long long ns = rp->lastSolveNs();
+			if (ns) {
+				(warm ? this->warmRows : this->coldRows)++;
+				(warm ? this->warmNs : this->coldNs) += ns;
+			}
+			if (!ok) {
+				if (!this->keepGoing())
+					return;
+				near = NULL;
+			}
+			else
+				near = state;
+		}
+	}
+
+	// puts the job back in terms of the caller's rows, once every position has run
+	void unschedule(Isolate* iso) {
+		size_t flashed = this->rows, failed = this->failedRow;
+		this->rows = this->inputRows;
+		this->failedRow = failed < flashed ? this->order[failed] : this->rows;
+
+		for (size_t k = 0; k < this->repeats.size(); k++) {
+			size_t row = this->repeats[k].first, first = this->repeats[k].second;
+			for (size_t j = 0; j < this->out.size(); j++)
+				this->out[j][row] = this->out[j][first];
+			if (this->status)
+				this->status[row] = this->status[first];
+		}
+		if (!this->errors.IsEmpty() && !this->repeats.empty()) {
+			std::map<size_t, std::string> failed(this->rowErrors.begin(), this->rowErrors.end());
+			for (size_t k = 0; k < this->repeats.size(); k++) {
+				std::map<size_t, std::string>::iterator it = failed.find(this->repeats[k].second);
+				if (it != failed.end())
+					this->rowErrors.push_back(std::make_pair(this->repeats[k].first, it->second));
+			}
+		}
+
+		if (this->report.IsEmpty())
+			return;
+
+		// what the schedule saved can only be estimated: each repeat saved a solve, and each warm start
+		// saved the difference between this batch's cold and warm solves
+		unsigned long long warm = this->warmRows, cold = this->coldRows;
+		double mean = warm + cold ? (double)(this->warmNs + this->coldNs) / (warm + cold) : 0;
+		double savedNs = this->repeats.size() * mean;
+		if (warm && cold)
+			savedNs += warm * std::max(0.0, (double)this->coldNs / cold - (double)this->warmNs / warm);
+
+		Local<Object> report = Local<Object>::New(iso, this->report);
+		report->Set(String::NewFromUtf8(iso, "rows"), Number::New(iso, (double)this->inputRows));
+		report->Set(String::NewFromUtf8(iso, "duplicates"), Number::New(iso, (double)this->repeats.size()));
+		report->Set(String::NewFromUtf8(iso, "warmStarts"), Number::New(iso, (double)warm));
+		report->Set(String::NewFromUtf8(iso, "coldStarts"), Number::New(iso, (double)cold));
+		report->Set(String::NewFromUtf8(iso, "solveNs"), Number::New(iso, (double)(this->warmNs + this->coldNs)));
+		report->Set(String::NewFromUtf8(iso, "savedNs"), Number::New(iso, savedNs));
+	}
+
+	bool keepGoing() {
+		return !this->errors.IsEmpty() || this->status || this->statusErrors;
+	}
+
+	// position is where the row falls in the job, when that isn't the row itself (see schedule)
+	bool flashRow(RefpropContext* rp, ThermoState* state, size_t i, const ThermoState* near = NULL, size_t position = (size_t)-1) {
+		FlashGuess guess = this->guess;
+		guess.near = near;
+
+		double vals[2] = { this->in[0][i], this->in[1][i] };
+
+		Composition comp = this->comp;
+		if (this->rowFractions)
+			memcpy(comp.x, this->rowFractions + i * comp.n, comp.n * sizeof(double));
+
+		long ierr = rp->initState(state, &comp);
+		if (ierr == 0)
+			ierr = rp->flash(this->flashFcn, this->props, vals, state, this->want, &guess);
+		if (this->status)
+			this->status[i] = (int32_t)ierr;
+
+		if (ierr > 0) {
+			if (!this->keepGoing()) {
+				this->fail(position == (size_t)-1 ? i : position, rp->errorMessage());
+				return false;
+			}
+			for (size_t j = 0; j < this->out.size(); j++)
+				this->out[j][i] = NAN;
+			if (!this->errors.IsEmpty()) {
+				std::lock_guard<std::mutex> lock(this->rowErrorsMutex);
+				this->rowErrors.push_back(std::make_pair(i, std::string(rp->errorMessage())));
+			}
+			return false;
+		}
+
+		for (size_t j = 0; j < this->out.size(); j++)
+			this->out[j][i] = state->property(this->outIdx[j]);
+		return true;
+	}
+
+	bool tabulated(PropertyTable* table) {
+		for (size_t j = 0; j < this->outIdx.size(); j++)
+			if (!table->tabulates(this->outIdx[j]))
+				return false;
+		return true;
+	}
+
+	// evaluates whole columns out of the table, then goes back for the rows it couldn't answer
+	void interpolateRows(RefpropContext* rp, PropertyTable* table, size_t begin, size_t end) {
+		int cell[EnginePool::chunkRows];
+		double u[EnginePool::chunkRows], v[EnginePool::chunkRows];
+		ThermoState state;
+
+		for (size_t first = begin; first < end; first += EnginePool::chunkRows) {
+			size_t rows = std::min(end - first, EnginePool::chunkRows);
+
+			table->locate(this->props, this->in[0] + first, this->in[1] + first, rows, cell, u, v);
+			for (size_t j = 0; j < this->out.size(); j++)
+				table->evaluate(this->outIdx[j], cell, u, v, rows, this->out[j] + first);
+
+			for (size_t r = 0; r < rows; r++) {
+				if (cell[r] >= 0) {
+					if (this->status)
+						this->status[first + r] = 0;
+				}
+				else if (!this->flashRow(rp, &state, first + r) && !this->keepGoing())
+					return;
+			}
+		}
+	}
+};
+
+// NaN sorts last, so the order stays strict
+static int compareInputs(double a, double b) {
+	if (isnan(a) || isnan(b))
+		return (int)isnan(a) - (int)isnan(b);
+	return a < b ? -1 : a > b;
+}
+
+void ColumnJob::schedule() {
+	size_t n = this->inputRows, fractions = this->rowFractions ? this->comp.n : 0;
+	const double* in0 = this->in[0];
+	const double* in1 = this->in[1];
+	const double* z = this->rowFractions;
+
+	std::vector<size_t> sorted(n);
+	for (size_t i = 0; i < n; i++)
+		sorted[i] = i;
+	std::sort(sorted.begin(), sorted.end(), [=](size_t a, size_t b) {
+		int c = compareInputs(in0[a], in0[b]);
+		if (c == 0)
+			c = compareInputs(in1[a], in1[b]);
+		if (c == 0 && fractions)
+			c = memcmp(z + a * fractions, z + b * fractions, fractions * sizeof(double));
+		return c != 0 ? c < 0 : a < b;
+	});
+
+	// repeats are exact: the same bits in every input
+	size_t first = 0;
+	for (size_t k = 0; k < n; k++) {
+		size_t row = sorted[k];
+		if (k > 0 && memcmp(&in0[row], &in0[first], sizeof(double)) == 0 && memcmp(&in1[row], &in1[first], sizeof(double)) == 0 &&
+				(!fractions || memcmp(z + row * fractions, z + first * fractions, fractions * sizeof(double)) == 0))
+			this->repeats.push_back(std::make_pair(row, first));
 		else {
+			this->order.push_back(row);
+			first = row;
+		}
+	}
+
+	this->rows = this->order.size();
+	this->failedRow = this->rows;
+}
+
+void statePointBatch(const FunctionCallbackInfo<Value>& args) {
+	if (fluidChosen(RefpropContext::selectedFluid, args.GetIsolate()))
+		flashColumns(args, RefpropContext::selectedFluid);
+}
+
+void statePointBatchAsync(const FunctionCallbackInfo<Value>& args) {
+	const char* fluid = FlashExecutor::instance()->currentFluid();
+	if (fluidChosen(fluid, args.GetIsolate()))
+		flashColumnsAsync(args, fluid);
+}
+
+// statePointBatch's arguments, checked and turned into a job for the pool.  NULL if they threw
+static ColumnJob* parseColumns(const FunctionCallbackInfo<Value>& args, const char* fluid, RefpropContext* rp) {
+	Isolate *iso = args.GetIsolate();
+	// args[0] is a two-letter string naming the input pair, same letters as the keys to statePoint
+	// args[1] and args[2] are Float64Arrays holding the input columns, in the same order as the letters
+	// args[3] is an object whose keys are the requested properties and whose values are Float64Arrays
+	//  - every column has to be the same length; row i of the outputs is the state at row i of the inputs
+	//  - derivative columns (dPdD and the rest, see statePointWithDerivatives) work like any other property
+	//  - rows are spread over every engine in the pool (see setEngines)
+	// args[4] is optional:
+	//  - {composition, basis} for a mixture, like statePoint's.  the composition is either an array for every
+	//    row, or a Float64Array with each row's fractions one after the other
+	//  - trajectory: true says the rows walk a path (along an isentrope, down a heat exchanger), so each
+	//    single-phase PH, PS, PD or TP row is solved starting from the row before it.  rows that cross the
+	//    dome, or don't converge that way, get the usual flash
+	//  - phase and checkPhase, a phase hint for every row, like statePoint's
+	//  - errors, an array that gets the message for each row that won't flash, at that row's index.  without
+	//    it (or status, or status mode) the first failed row throws
+	//  - status, an Int32Array that gets every row's ierr.  rows with warnings (below 0) keep their outputs
+	//  - schedule: true flashes the rows sorted by their inputs, each starting from the one before, with exact
+	//    repeats flashed once; the outputs still line up with the inputs.  for batches in no particular
+	//    order with repeats in them, like historian replays.  given an object, schedule also gets filled in
+	//    with {rows, duplicates, warmStarts, coldStarts, solveNs, savedNs}, savedNs being an estimate
+
+	if (args.Length() < 4 || !args[3]->IsObject()) {
+		iso->ThrowException(Exception::TypeError(String::NewFromUtf8(iso, "Must provide an input pair, two input columns and an object of output columns")));
+		return NULL;
+	}
+
+	String::Utf8Value pair(args[0]->ToString());
+	if (pair.length() != 2) {
+		iso->ThrowException(Exception::TypeError(String::NewFromUtf8(iso, "Thermodynamic state established by exactly 2 values")));
+		return NULL;
+	}
+
+	size_t rows, len;
+	double *in[2];
+	if (!float64Data(args[1], &in[0], &rows) || !float64Data(args[2], &in[1], &len) || len != rows) {
+		iso->ThrowException(Exception::TypeError(String::NewFromUtf8(iso, "Input columns must be Float64Arrays of the same length")));
+		return NULL;
+	}
+
+	std::unique_ptr<ColumnJob> job(new ColumnJob(rows, fluid));
+	job->props[0] = (*pair)[0];
+	job->props[1] = (*pair)[1];
+	job->in[0] = in[0];
+	job->in[1] = in[1];
+	job->want = 0;
+	job->rowFractions = NULL;
+	job->trajectory = false;
+	job->status = NULL;
+	job->statusErrors = RefpropContext::statusErrors;
+
+	bool scheduled = false;
+	Local<Array> columns = Array::New(iso);
+	columns->Set(0, args[1]);
+	columns->Set(1, args[2]);
+
+	if (args.Length() > 4 && args[4]->IsObject()) {
+		Local<Object> options = args[4]->ToObject();
+		Local<Value> composition = options->Get(String::NewFromUtf8(iso, "composition"));
+		Local<Value> basis = options->Get(String::NewFromUtf8(iso, "basis"));
+		job->trajectory = options->Get(String::NewFromUtf8(iso, "trajectory"))->BooleanValue();
+		if (!parsePhase(options->Get(String::NewFromUtf8(iso, "phase")), options->Get(String::NewFromUtf8(iso, "checkPhase")), &job->guess, iso))
+			return NULL;
+
+		Local<Value> errors = options->Get(String::NewFromUtf8(iso, "errors"));
+		if (errors->IsArray())
+			job->errors.Reset(iso, Local<Array>::Cast(errors));
+		else if (!errors->IsUndefined()) {
+			iso->ThrowException(Exception::TypeError(String::NewFromUtf8(iso, "errors must be an array")));
+			return NULL;
+		}
+
+		Local<Value> status = options->Get(String::NewFromUtf8(iso, "status"));
+		if (status->IsInt32Array() && Local<Int32Array>::Cast(status)->Length() == rows) {
+			Local<Int32Array> arr = Local<Int32Array>::Cast(status);
+			job->status = (int32_t*)((char*)arr->Buffer()->GetContents().Data() + arr->ByteOffset());
+			columns->Set(columns->Length(), status);
+		}
+		else if (!status->IsUndefined()) {
+			iso->ThrowException(Exception::TypeError(String::NewFromUtf8(iso, "status must be an Int32Array the same length as the inputs")));
+			return NULL;
+		}
+
+		Local<Value> schedule = options->Get(String::NewFromUtf8(iso, "schedule"));
+		scheduled = schedule->BooleanValue();
+		if (schedule->IsObject())
+			job->report.Reset(iso, schedule->ToObject());
+
+		if (composition->IsFloat64Array()) {
+			double* fractions;
+			float64Data(composition, &fractions, &len);
+			job->rowFractions = fractions;
+			// an empty batch takes an empty column, and leaves rowFractions NULL
+			if (rows == 0 ? len != 0 : len % rows != 0 || len / rows == 0 || len / rows > ncmax) {
+				iso->ThrowException(Exception::TypeError(String::NewFromUtf8(iso, "A composition column must have the same number of fractions for every row")));
+				return NULL;
+			}
+			columns->Set(columns->Length(), composition);
+			composition = Undefined(iso);  // parseComposition only gets the basis
+		}
+		if (!parseComposition(composition, basis, &job->comp, iso))
+			return NULL;
+		if (job->rowFractions)
+			job->comp.n = (long)(len / rows);
+	}
+
+	// resolve the output columns up front so the rows are nothing but flashes and stores
+	Local<Object> outputs = args[3]->ToObject();
+	Local<Array> keys = outputs->GetOwnPropertyNames();
+
+	for (uint32_t j = 0; j < keys->Length(); j++) {
+		String::Utf8Value key(keys->Get(j)->ToString());
+		int idx = ThermoState::propertyIndex(*key);
+		Local<Value> column = outputs->Get(keys->Get(j));
+		double* col;
+
+		if (idx < 0 || !float64Data(column, &col, &len) || len != rows) {
+			iso->ThrowException(Exception::TypeError(String::NewFromUtf8(iso, "Output columns must be Float64Arrays of known properties, the same length as the inputs")));
+			return NULL;
+		}
+		job->outIdx.push_back(idx);
+		job->out.push_back(col);
+		job->want |= propertyBit(idx);
+		columns->Set(columns->Length(), column);
+	}
+
+	job->flashFcn = rp->flashFcnLookup(job->props, iso);
+	if (!job->flashFcn)
+		return NULL;
+	if (scheduled)
+		job->schedule();
+
+	job->outputs.Reset(iso, outputs);
+	job->columns.Reset(iso, columns);
+	return job.release();
+}
+
+void flashColumns(const FunctionCallbackInfo<Value>& args, const char* fluid) {
+	Isolate *iso = args.GetIsolate();
+	// see parseColumns for the arguments
+
+	RefpropContext* rp = RefpropContext::instance(iso);
+	if (!rp)
+		return;
+	RefpropLock lock(rp);
+
+	std::unique_ptr<ColumnJob> job(parseColumns(args, fluid, rp));
+	if (!job)
+		return;
+
+	FluidScheduler::noteFluid(fluid);
+	EnginePool::instance()->run(job.get());
+	job->finish(iso);
+
+	if (job->failed()) {
+		iso->ThrowException(job->error(iso));
+		return;
+	}
+	args.GetReturnValue().Set(args[3]);
+}
+
+void flashColumnsAsync(const FunctionCallbackInfo<Value>& args, const char* fluid) {
+	Isolate *iso = args.GetIsolate();
+	// same arguments as statePointBatch, but the rows run off the event loop, queued with the other async
+	// calls.  resolves to the outputs once they're filled in.  the columns mustn't be touched until then
+
+	RefpropContext* rp = RefpropContext::instance(iso);
+	if (!rp)
+		return;
+	EnginePool::instance();
+
+	ColumnJob* job = parseColumns(args, fluid, rp);  // the flash table is never written after construction
+	if (!job)
+		return;
+
+	FlashRequest* req = new FlashRequest(FlashRequest::COLUMNS, iso);
+	strncpy(req->fluid, fluid, refpropcharlength-1);
+	req->fluid[refpropcharlength-1] = '\0';
+	req->job = job;
+	req->result.Reset(iso, args[3]);
+
+	args.GetReturnValue().Set(Local<Promise::Resolver>::New(iso, req->resolver)->GetPromise());
+	FlashExecutor::instance()->submit(req);
+}
+
+RefpropContext::FlashFcn RefpropContext::flashFcnLookup(const char props[2], Isolate* iso) {
+	for (int i=0; i < 2; i++) {
+		if (!props[i] || !strchr(this->flashString, props[i])) {
 			iso->ThrowException(Exception::TypeError(String::NewFromUtf8(iso, "Provided thermodynamic quantities must be one of TPDHSEQ")));
 			return NULL;
 		}
 	}
+
+	FlashFcn flashFcn = this->findFlashFcn(props);
+	if (NULL == flashFcn)
+		iso->ThrowException(Exception::TypeError(String::NewFromUtf8(iso, "Property combination not supported!")));
+	return flashFcn;
+}
+
+RefpropContext::FlashFcn RefpropContext::findFlashFcn(const char props[2]) {
+	int idx[2];
+
+	for (int i=0; i < 2; i++) {
+		char* e = props[i] ? strchr(this->flashString, props[i]) : NULL;
+		if (!e)
+			return NULL;
+		idx[i] = (int)(e - this->flashString);
+	}
 	return this->flashTable[idx[0]][idx[1]];
 }
 
-void RegisterModule(Local<Object> exports) {
+void RegisterModule(Local<Object> exports, Local<Context> context) {
 	// syntax for registering functions to the exports object is:
-	// NODE_SET_METHOD(exports, "name_of_function", functionPointer);
-	NODE_SET_METHOD(exports, "setFluid", setFluid);
-	NODE_SET_METHOD(exports, "statePoint", statePoint);
-	NODE_SET_METHOD(exports, "getFluid", getFluid);
+	// NODE_SET_METHOD(exports, "name_of_function", brokered<functionPointer>);
+	// with exclusive<> in place of brokered<> for anything that changes what every js thread shares
+	Broker::attach(context->GetIsolate());
+
+	NODE_SET_METHOD(exports, "setPaths", exclusive<setPaths>);
+	NODE_SET_METHOD(exports, "setFluid", brokered<setFluid>);
+	NODE_SET_METHOD(exports, "statePoint", brokered<statePoint>);
+	NODE_SET_METHOD(exports, "statePointWithDerivatives", brokered<statePointWithDerivatives>);
+	NODE_SET_METHOD(exports, "statePointBatch", brokered<statePointBatch>);
+	NODE_SET_METHOD(exports, "statePointBatchAsync", brokered<statePointBatchAsync>);
+	NODE_SET_METHOD(exports, "setEngines", exclusive<setEngines>);
+	NODE_SET_METHOD(exports, "getEngines", brokered<getEngines>);
+	NODE_SET_METHOD(exports, "setCacheSize", brokered<setCacheSize>);
+	NODE_SET_METHOD(exports, "getCacheStats", brokered<getCacheStats>);
+	NODE_SET_METHOD(exports, "setDiskCache", exclusive<setDiskCache>);
+	NODE_SET_METHOD(exports, "buildTable", brokered<buildTable>);
+	NODE_SET_METHOD(exports, "dropTable", brokered<dropTable>);
+	NODE_SET_METHOD(exports, "saturationDome", brokered<saturationDome>);
+	NODE_SET_METHOD(exports, "isoline", brokered<isoline>);
+	NODE_SET_METHOD(exports, "evaluateGraph", brokered<evaluateGraph>);
+	NODE_SET_METHOD(exports, "writeGrid", brokered<writeGrid>);
+	NODE_SET_METHOD(exports, "loadGrid", brokered<loadGrid>);
+	NODE_SET_METHOD(exports, "solveState", brokered<solveState>);
+	NODE_SET_METHOD(exports, "solveStateBatch", brokered<solveStateBatch>);
+	NODE_SET_METHOD(exports, "compile", brokered<compile>);
+	// these two wait on threads that take sessions of their own, so they mustn't hold one
+	NODE_SET_METHOD(exports, "serve", serve);
+	NODE_SET_METHOD(exports, "connect", connect);
+	NODE_SET_METHOD(exports, "fluid", brokered<fluid>);
+	NODE_SET_METHOD(exports, "getSchedulerStats", brokered<getSchedulerStats>);
+	NODE_SET_METHOD(exports, "setFluidAsync", brokered<setFluidAsync>);
+	NODE_SET_METHOD(exports, "statePointAsync", brokered<statePointAsync>);
+	NODE_SET_METHOD(exports, "getFluid", brokered<getFluid>);
+	NODE_SET_METHOD(exports, "setErrorMode", brokered<setErrorMode>);
+	NODE_SET_METHOD(exports, "getStats", brokered<getStats>);
+	NODE_SET_METHOD(exports, "resetStats", brokered<resetStats>);
+#ifdef REFPROP_BENCH
+	NODE_SET_METHOD(exports, "getBenchStats", brokered<getBenchStats>);
+	NODE_SET_METHOD(exports, "resetBenchStats", brokered<resetBenchStats>);
+#endif
+}
+
+// context-aware, so node runs this again for every worker_thread that loads the addon rather than
+// handing it exports made in some other isolate
+void RegisterModuleContext(Local<Object> exports, Local<Value> module, Local<Context> context, void* priv) {
+	RegisterModule(exports, context);
 }
 
-NODE_MODULE(refprop, RegisterModule)
+NODE_MODULE_CONTEXT_AWARE(refprop, RegisterModuleContext)
@@ -2,8 +2,30 @@
 #define NODE_REFPROP_H
 
 #include <node.h>
+#include <uv.h>
+
+#ifdef _WIN32
 #include <windows.h>
-#include "refprop1.h"
+typedef HINSTANCE LibraryHandle;
+#else
+#include <dlfcn.h>
+typedef void* LibraryHandle;
+#define __stdcall  // only means anything to 32-bit windows
+#endif
+#include "REFPROP1.H"
+
+#include <atomic>
+#include <memory>
+#include <utility>
+
+#include "stats.h"
+#ifdef REFPROP_BENCH
+#include "bench.h"
+#endif
+
+class ThermoState;
+class FlashCache;
+class PropertyTable;
 
 // constants for calling refprop... fortran calling conventions, basically
 #define refpropcharlength 255
@@ -14,37 +36,95 @@
 #define numparams 72
 #define maxcoefs 50
 
-class TransportProps {
-public:
-	virtual void append(v8::Local<v8::Object> obj, v8::Isolate* iso) = 0;
+// flat list of every property a state can report, used by the columnar (batch) interface
+enum Property {
+	PROP_T, PROP_P, PROP_Z, PROP_D, PROP_DL, PROP_DV, PROP_X, PROP_Y, PROP_Q,
+	PROP_E, PROP_H, PROP_S, PROP_CV, PROP_CP, PROP_W,
+	// transport properties come last; the ones that don't apply to the phase come back as NaN
+	PROP_k, PROP_mu, PROP_kL, PROP_kV, PROP_muL, PROP_muV,
+	PROP_CPL, PROP_CPV, PROP_CVL, PROP_CVV, PROP_sigma,
+	// derivatives of the equation of state, only worked out when they're asked for
+	PROP_dPdD, PROP_dPdT, PROP_dDdT, PROP_dDdP, PROP_d2PdD2, PROP_d2PdT2, PROP_d2PdTdD,
+	PROP_JT, PROP_kappaT, PROP_beta, PROP_kappaS, PROP_isenK,
+	PROP_COUNT
 };
 
-class OnePhaseTransport : public TransportProps {
-public:
-	double mu, k;
-	void append(v8::Local<v8::Object> obj, v8::Isolate* iso);
-};
+// a set of properties, one bit per Property, for callers that only want some of them
+typedef unsigned long long PropertyMask;
+#define propertyBit(idx) ((PropertyMask)1 << (idx))
+#define derivativeMask (propertyBit(PROP_COUNT) - propertyBit(PROP_dPdD))
+#define allProperties (propertyBit(PROP_dPdD) - 1)  // what a plain statePoint reports: no derivatives
+#define onePhaseTransportMask (propertyBit(PROP_k) | propertyBit(PROP_mu))
+#define twoPhaseTransportMask (propertyBit(PROP_kL) | propertyBit(PROP_kV) | propertyBit(PROP_muL) | propertyBit(PROP_muV) \
+	| propertyBit(PROP_CPL) | propertyBit(PROP_CPV) | propertyBit(PROP_CVL) | propertyBit(PROP_CVV) | propertyBit(PROP_sigma))
+#define transportMask (onePhaseTransportMask | twoPhaseTransportMask)
 
-class TwoPhaseTransport : public TransportProps {
-public:
+// transport properties, kept inline in the state so flashing never allocates.  which of them mean
+// anything depends on the phase (see ThermoState::phaseTransport); the rest stay NaN
+struct TransportProps {
+	double mu, k;
 	double muL, muV, kL, kV;
 	double CPV, CPL, CVV, CVL; // do these belong here?  i don't know and i don't care
 	double sigma;
-	void append(v8::Local<v8::Object> obj, v8::Isolate* iso);
+
+	void clear();  // back to all NaN
+	double property(int idx);
+};
+
+// the equation of state's derivatives, in the same mass-specific SI units as everything else.  they stay
+// NaN in two phases, where derivatives at the bulk density don't describe anything physical
+struct Derivatives {
+	double dPdD, dPdT, dDdT, dDdP;  // dP/drho|T, dP/dT|rho, drho/dT|P, drho/dP|T
+	double d2PdD2, d2PdT2, d2PdTdD;
+	double JT;      // joule-thomson coefficient, K/Pa
+	double kappaT;  // isothermal compressibility, 1/Pa
+	double beta;    // volume expansivity, 1/K
+	double kappaS;  // adiabatic compressibility, 1/Pa
+	double isenK;   // isentropic expansion coefficient
+
+	void clear();
+	double property(int idx);
+};
+
+// a routine in the refprop library.  calls straight through, except in benchmark builds, which time
+// every call so the time spent in the solver can be told apart from our own
+template <typename F>
+struct LibraryCall {
+	F fcn;
+
+	LibraryCall& operator=(F f) { this->fcn = f; return *this; }
+	operator bool() const { return this->fcn != NULL; }
+
+	template <typename... Args>
+	void operator()(Args&&... args) {
+#ifdef REFPROP_BENCH
+		BenchTimer timer;
+#endif
+		this->fcn(std::forward<Args>(args)...);
+	}
 };
 
 class ThermoState {
 public:
-	v8::Local<v8::Object> toJs(v8::Isolate* iso);
+	ThermoState();  // plain old data from here on, so copies are just copies
+
+	// the flash properties plus whichever transport properties and derivatives are in want and have been computed.
+	// with a lazyFluid, the rest of want's transport properties become getters that work them out in
+	// that fluid the first time they're read
+	v8::Local<v8::Object> toJs(v8::Isolate* iso, PropertyMask want = allProperties, const char* lazyFluid = NULL);
+
+	static int propertyIndex(const char* name);  // -1 if the name isn't a known property
+	static const char* propertyUnit(int idx);    // "K", "J/(kg K)"...
+	double property(int idx);
 
 	double T;
 	double P;
-	double Z;
+	double Z[ncmax];  // overall composition, in mole fractions
 	double D;
 	double DL;
 	double DV;
-	double X;
-	double Y;
+	double X[ncmax];  // liquid and vapor compositions, in two phases
+	double Y[ncmax];
 	double Q;
 	double E;
 	double H;
@@ -53,38 +133,189 @@ public:
 	double CP;
 	double W;
 	double molarMass;
+	long nc;  // how many of Z, X and Y are in use
+
+	TransportProps trnprp;
+	Derivatives derivs;
+	PropertyMask computed;  // the transport properties and derivatives we know, counting the ones that don't apply to the phase
+
+	PropertyMask phaseTransport();  // the transport properties that do apply to the phase
+};
+
+// the composition a caller asked for, in whichever basis they gave it.  n == 0 means the fluid's own:
+// the one component of a pure fluid, a mixture file's composition, or equal parts of each component
+struct Composition {
+	long n;
+	double x[ncmax];
+	bool mass;  // mass fractions rather than mole fractions
 
-	TransportProps* trnprp;
+	Composition() : n(0), mass(false) {}
+};
+
+// what a caller knows about a state before it's flashed: which single phase it's in, and/or a neighbouring
+// state on the same path to start the solve from
+enum PhaseHint { PHASE_UNKNOWN, PHASE_LIQUID, PHASE_VAPOR, PHASE_SUPERCRITICAL };
+
+struct FlashGuess {
+	PhaseHint phase;
+	bool check;  // make sure a hinted state really is in that phase, and flash it properly if it isn't
+	const ThermoState* near;
+	bool keep;  // whether the result goes in the flash and disk caches; a solver's trial states needn't
+
+	FlashGuess() : phase(PHASE_UNKNOWN), check(true), near(NULL), keep(true) {}
+};
+
+// both sides of the dome at one temperature or pressure, in the usual specific units
+struct SaturationState {
+	double T, P;
+	double DL, DV, HL, HV, SL, SV;
 };
 
 void setFluid(const v8::FunctionCallbackInfo<v8::Value>& args);
 void getFluid(const v8::FunctionCallbackInfo<v8::Value>& args);
+void setPaths(const v8::FunctionCallbackInfo<v8::Value>& args);
 void statePoint(const v8::FunctionCallbackInfo<v8::Value>& args);
+void statePointWithDerivatives(const v8::FunctionCallbackInfo<v8::Value>& args);
+void flashPoint(const v8::FunctionCallbackInfo<v8::Value>& args, PropertyMask extra);  // statePoint, plus extra
+void statePointBatch(const v8::FunctionCallbackInfo<v8::Value>& args);
+void statePointBatchAsync(const v8::FunctionCallbackInfo<v8::Value>& args);
+void flashColumns(const v8::FunctionCallbackInfo<v8::Value>& args, const char* fluid);  // statePointBatch in a given fluid
+void flashColumnsAsync(const v8::FunctionCallbackInfo<v8::Value>& args, const char* fluid);  // statePointBatchAsync in a given fluid
+bool parseCoords(v8::Local<v8::Value> arg, char props[2], double values[2], v8::Isolate* iso, Composition* comp = NULL, FlashGuess* guess = NULL);
+bool parsePhase(v8::Local<v8::Value> phase, v8::Local<v8::Value> check, FlashGuess* guess, v8::Isolate* iso);
+bool parseComposition(v8::Local<v8::Value> arg, v8::Local<v8::Value> basis, Composition* comp, v8::Isolate* iso);
+bool parseOutputs(v8::Local<v8::Value> arg, PropertyMask* want, bool* lazy, v8::Isolate* iso);
+bool float64Data(v8::Local<v8::Value> val, double** data, size_t* length);
+#define noFluidMessage "Must choose a fluid with setFluid first"
+bool fluidChosen(const char* fluid, v8::Isolate* iso);  // throws unless fluid names one
+void setEngines(const v8::FunctionCallbackInfo<v8::Value>& args);
+void getEngines(const v8::FunctionCallbackInfo<v8::Value>& args);
+void setErrorMode(const v8::FunctionCallbackInfo<v8::Value>& args);
+v8::Local<v8::String> propertyKey(v8::Isolate* iso, int idx);  // a property's name, interned once
+void releaseResultTemplates();  // the calling thread's keys and result templates, as its environment shuts down
+v8::Local<v8::String> statusMessage(v8::Isolate* iso, const char* herr);  // interned, so repeats share one string
+v8::Local<v8::Object> flashResult(v8::Isolate* iso, ThermoState* state, long ierr, const char* herr, PropertyMask want, const char* lazyFluid);
+void setCacheSize(const v8::FunctionCallbackInfo<v8::Value>& args);
+void getCacheStats(const v8::FunctionCallbackInfo<v8::Value>& args);
+void setDiskCache(const v8::FunctionCallbackInfo<v8::Value>& args);
+void buildTable(const v8::FunctionCallbackInfo<v8::Value>& args);
+void fluid(const v8::FunctionCallbackInfo<v8::Value>& args);
+void getSchedulerStats(const v8::FunctionCallbackInfo<v8::Value>& args);
+void dropTable(const v8::FunctionCallbackInfo<v8::Value>& args);
+void saturationDome(const v8::FunctionCallbackInfo<v8::Value>& args);
+void isoline(const v8::FunctionCallbackInfo<v8::Value>& args);
+void domeCurve(const v8::FunctionCallbackInfo<v8::Value>& args, const char* fluid);  // saturationDome in a given fluid
+void isolineCurve(const v8::FunctionCallbackInfo<v8::Value>& args, const char* fluid);  // isoline in a given fluid
+void evaluateGraph(const v8::FunctionCallbackInfo<v8::Value>& args);
+void graphEvaluate(const v8::FunctionCallbackInfo<v8::Value>& args, const char* fluid);  // evaluateGraph in a given fluid
+void writeGrid(const v8::FunctionCallbackInfo<v8::Value>& args);
+void gridWrite(const v8::FunctionCallbackInfo<v8::Value>& args, const char* fluid);  // writeGrid in a given fluid
+void loadGrid(const v8::FunctionCallbackInfo<v8::Value>& args);
+void solveState(const v8::FunctionCallbackInfo<v8::Value>& args);
+void stateSolve(const v8::FunctionCallbackInfo<v8::Value>& args, const char* fluid);  // solveState in a given fluid
+void solveStateBatch(const v8::FunctionCallbackInfo<v8::Value>& args);
+void batchSolve(const v8::FunctionCallbackInfo<v8::Value>& args, const char* fluid);  // solveStateBatch in a given fluid
+void compile(const v8::FunctionCallbackInfo<v8::Value>& args);
+void planCompile(const v8::FunctionCallbackInfo<v8::Value>& args, const char* fluid);  // compile in a given fluid
+void serve(const v8::FunctionCallbackInfo<v8::Value>& args);
+void connect(const v8::FunctionCallbackInfo<v8::Value>& args);
+void setFluidAsync(const v8::FunctionCallbackInfo<v8::Value>& args);
+void statePointAsync(const v8::FunctionCallbackInfo<v8::Value>& args);
+void flashAsync(const v8::FunctionCallbackInfo<v8::Value>& args, const char* fluid);  // statePointAsync in a given fluid
 
 class RefpropContext {
 public:
 	typedef void (RefpropContext::*FlashFcn)(ThermoState*);
 
-	static RefpropContext* instance(v8::Isolate* iso);  // singleton pattern
+	static RefpropContext* instance(v8::Isolate* iso);  // singleton pattern; NULL (and a pending exception) if the library won't load
+
+	// where the library, the fluid files and the predefined mixtures are.  they start out as REFPROP_LIBRARY,
+	// REFPROP_FLUIDS and REFPROP_MIXTURES, or the usual places under RPPREFIX, or refprop's default install;
+	// setPaths changes them
+	static char libraryPath[filepathlength+1];
+	static char fluidPath[filepathlength+1];
+	static char mixturePath[filepathlength+1];
+	static bool defaultPaths(char* err);  // false, with a message in err, if the environment's paths don't fit
+	static bool started();  // whether instance() has loaded the library yet
+
+	// loads a private copy of the library, for the engine pool.  copy 0 is the library itself
+	RefpropContext(const char* path, int copy);
+	~RefpropContext();
+	bool isLoaded();
 
 	void setFluid(char* reqdFluid, v8::Isolate* iso);
-	char* getFluid();
-	ThermoState* doFlash(const char props[], const double vals[], v8::Isolate* iso);
+	long loadFluid(const char* reqdFluid);  // same as setFluid, but reports through ierr/errorMessage()
+	char* getFluid();  // the fluid this context has loaded right now
+	long components();  // how many components the loaded fluid has
 
-private:
-	RefpropContext(v8::Isolate* iso);  // constructor private to enforce singleton pattern
+	// the fluid setFluid last asked for.  fluid handles load others in the meantime, so the global
+	// calls put it back with loadSelected first.  every js thread (see Broker) selects its own
+	static thread_local char selectedFluid[refpropcharlength];
+	long loadSelected();
+
+	// setErrorMode('status'): flashes that refprop can't solve come back as ierr and herr rather than as
+	// exceptions.  bad arguments throw either way.  set per js thread, like selectedFluid
+	static thread_local bool statusErrors;
+
+	static std::atomic<unsigned long> setupCalls;  // SETUPdll calls across every context
+
+	// false if it threw.  a failed flash only throws outside status mode; otherwise doFlash returns true
+	// and errorCode() says what went wrong, for flashResult.  a warning (ierr < 0) keeps its state
+	bool doFlash(const char props[], const double vals[], ThermoState* obj, v8::Isolate* iso, PropertyMask want = allProperties,
+		const Composition* comp = NULL, const FlashGuess* guess = NULL);
+
+	// lower-level pieces of doFlash, for callers that flash many states with the same input pair.
+	// flash() doesn't touch v8; it returns ierr and leaves the message in errorMessage().  it only calls
+	// the transport routines the properties in want need; the flash properties always come back
+	FlashFcn flashFcnLookup(const char props[2], v8::Isolate* iso);
+	FlashFcn findFlashFcn(const char props[2]);  // NULL for anything unsupported
+	long initState(ThermoState* obj, const Composition* comp = NULL);  // only fails for a composition that doesn't fit the fluid
+	long flash(FlashFcn flashFcn, const char props[2], const double vals[2], ThermoState* obj, PropertyMask want = allProperties,
+		const FlashGuess* guess = NULL);
+	long completeState(ThermoState* obj, PropertyMask want);  // fills in transport properties and derivatives a flashed state is missing
+	const char* errorMessage();
+	long errorCode();  // the last call's ierr: 0, a warning below 0 or a failure above it
+	unsigned long long lastSolveNs();  // how long the last flash() spent in the solver; 0 if a cache or table answered it
 
-	static RefpropContext* _instance;
+	// the fixed points of the loaded fluid and its saturation states, for the diagram generator.  all
+	// of them report through ierr/errorMessage() like flash()
+	long criticalPoint(double* T, double* P, double* D);
+	double tripleTemperature();
+	long saturation(char prop, double value, SaturationState* sat);  // prop is 'T' (SATT) or 'P' (SATP)
+	void limits(double* Tmin, double* Tmax, double* Dmax, double* Pmax);  // where the equation of state holds, for the inverse solver
+
+	// refprop isn't reentrant, so anything that calls into it has to hold the lock (see RefpropLock)
+	void lock();
+	void unlock();
+
+	FlashCache* flashCache();
+	PropertyTable* propertyTable();  // the table built for the loaded fluid, if there is one
+
+private:
+	static std::atomic<RefpropContext*> _instance;
 	char _fluid[refpropcharlength];
+	long nc;
+	double composition[ncmax];  // the loaded fluid's own composition, for calls that don't give one
+	double fluidMolarMass;      // and its molar mass; 0 until initState first needs it
+
+	// the last composition initState was given, as normalized fractions in its basis, and what that came to
+	double lastFractions[ncmax];
+	bool lastMassBasis;
+	double lastZ[ncmax];
+	double lastMolarMass;
+	void forgetCompositions();
 	long ierr;
 	char herr[errormessagelength+1];
+	uv_mutex_t mutex;
+	FlashCache* cache;  // states we've already flashed in the loaded fluid; cleared whenever setup reruns
+	uint64_t signature;  // the loaded fluid's files and library, which key its states in the disk cache
+	std::shared_ptr<PropertyTable> table;
+	unsigned long tableGeneration;  // which generation of the table registry `table` came from
 
-	HINSTANCE RefpropDllInstance;  // holds the DLL functions so we don't have to reload every time
+	LibraryHandle RefpropDllInstance;  // holds the DLL functions so we don't have to reload every time
 	char* flashString;
 	FlashFcn flashTable[7][7];
-	FlashFcn flashFcnLookup(const char props[2], v8::Isolate* iso);
 
-	ThermoState* thermoState();
 	void toMolar(ThermoState *obj);
 	void toSpecific(ThermoState *obj);
 
@@ -105,102 +336,133 @@ private:
 	void calcTQ(ThermoState*);
 	void calcPQ(ThermoState*);
 
-	void doTransport(ThermoState* state);
+	// a state that's known to be in one phase needs no saturation checks.  singlePhaseFlash solves PH, PS, PD
+	// and TP for the hinted phase, or the one guess->near was in, starting from near's T and D if there is
+	// one.  it gives up (false) on anything else, a failed solve or, when it checks, a state that turns
+	// out not to be in that phase.  obj is in molar units, like the flash functions
+	bool singlePhaseFlash(const char props[2], ThermoState* obj, const FlashGuess* guess);
+	double singlePhase(double T, double P, char held);  // refprop's q code for a state off the dome, or 0 if it's on it
+	bool critical();      // makes sure of Tcrit and Pcrit
+	double Tcrit, Pcrit;  // worked out once per fluid; Tcrit is 0 until then
+	char satHeld;         // the last saturation point singlePhase looked up, at satValue of T or P
+	double satValue, satOther;
+
+	void doTransport(ThermoState* state, PropertyMask want);
+	void doDerivatives(ThermoState* state, PropertyMask want);
+	void fillState(ThermoState* state, PropertyMask want);  // both of those, timed
+
+	// what getStats reports for flashes in the loaded fluid.  flashState is flash() without the timing;
+	// it leaves how long the solve and the transport properties took here
+	FluidStats* stats;
+	long flashState(FlashFcn flashFcn, const char props[2], const double vals[2], ThermoState* obj, PropertyMask want, const FlashGuess* guess);
+	bool solved;
+	unsigned long long solveNs, libraryNs;
 
 	//Define explicit function pointers to refprop methods
-	fp_ABFL1dllTYPE ABFL1dll;
-	fp_ABFL2dllTYPE ABFL2dll;
-	fp_ACTVYdllTYPE ACTVYdll;
-	fp_AGdllTYPE AGdll;
-	fp_CCRITdllTYPE CCRITdll;
-	fp_CP0dllTYPE CP0dll;
-	fp_CRITPdllTYPE CRITPdll;
-	fp_CSATKdllTYPE CSATKdll;
-	fp_CV2PKdllTYPE CV2PKdll;
-	fp_CVCPKdllTYPE CVCPKdll;
-	fp_CVCPdllTYPE CVCPdll;
-	fp_DBDTdllTYPE DBDTdll;
-	fp_DBFL1dllTYPE DBFL1dll;
-	fp_DBFL2dllTYPE DBFL2dll;
-	fp_DDDPdllTYPE DDDPdll;
-	fp_DDDTdllTYPE DDDTdll;
-	fp_DEFLSHdllTYPE DEFLSHdll;
-	fp_DHD1dllTYPE DHD1dll;
-	fp_DHFLSHdllTYPE DHFLSHdll;
-	fp_DIELECdllTYPE DIELECdll;
-	fp_DOTFILLdllTYPE DOTFILLdll;
-	fp_DPDD2dllTYPE DPDD2dll;
-	fp_DPDDKdllTYPE DPDDKdll;
-	fp_DPDDdllTYPE DPDDdll;
-	fp_DPDTKdllTYPE DPDTKdll;
-	fp_DPDTdllTYPE DPDTdll;
-	fp_DPTSATKdllTYPE DPTSATKdll;
-	fp_DSFLSHdllTYPE DSFLSHdll;
-	fp_ENTHALdllTYPE ENTHALdll;
-	fp_ENTROdllTYPE ENTROdll;
-	fp_ESFLSHdllTYPE ESFLSHdll;
-	fp_FGCTYdllTYPE FGCTYdll;
-	fp_FPVdllTYPE FPVdll;
-	fp_GERG04dllTYPE GERG04dll;
-	fp_GETFIJdllTYPE GETFIJdll;
-	fp_GETKTVdllTYPE GETKTVdll;
-	fp_GIBBSdllTYPE GIBBSdll;
-	fp_HSFLSHdllTYPE HSFLSHdll;
-	fp_INFOdllTYPE INFOdll;
-	fp_LIMITKdllTYPE LIMITKdll;
-	fp_LIMITSdllTYPE LIMITSdll;
-	fp_LIMITXdllTYPE LIMITXdll;
-	fp_MELTPdllTYPE MELTPdll;
-	fp_MELTTdllTYPE MELTTdll;
-	fp_MLTH2OdllTYPE MLTH2Odll;
-	fp_NAMEdllTYPE NAMEdll;
-	fp_PDFL1dllTYPE PDFL1dll;
-	fp_PDFLSHdllTYPE PDFLSHdll;
-	fp_PEFLSHdllTYPE PEFLSHdll;
-	fp_PHFL1dllTYPE PHFL1dll;
-	fp_PHFLSHdllTYPE PHFLSHdll;
-	fp_PQFLSHdllTYPE PQFLSHdll;
-	fp_PREOSdllTYPE PREOSdll;
-	fp_PRESSdllTYPE PRESSdll;
-	fp_PSFL1dllTYPE PSFL1dll;
-	fp_PSFLSHdllTYPE PSFLSHdll;
-	fp_PUREFLDdllTYPE PUREFLDdll;
-	fp_QMASSdllTYPE QMASSdll;
-	fp_QMOLEdllTYPE QMOLEdll;
-	fp_SATDdllTYPE SATDdll;
-	fp_SATEdllTYPE SATEdll;
-	fp_SATHdllTYPE SATHdll;
-	fp_SATPdllTYPE SATPdll;
-	fp_SATSdllTYPE SATSdll;
-	fp_SATTdllTYPE SATTdll;
-	fp_SETAGAdllTYPE SETAGAdll;
-	fp_SETKTVdllTYPE SETKTVdll;
-	fp_SETMIXdllTYPE SETMIXdll;
-	fp_SETMODdllTYPE SETMODdll;
-	fp_SETREFdllTYPE SETREFdll;
-	fp_SETUPdllTYPE SETUPdll;
-	fp_SPECGRdllTYPE SPECGRdll;
-	fp_SUBLPdllTYPE SUBLPdll;
-	fp_SUBLTdllTYPE SUBLTdll;
-	fp_SURFTdllTYPE SURFTdll;
-	fp_SURTENdllTYPE SURTENdll;
-	fp_TDFLSHdllTYPE TDFLSHdll;
-	fp_TEFLSHdllTYPE TEFLSHdll;
-	fp_THERM0dllTYPE THERM0dll;
-	fp_THERM2dllTYPE THERM2dll;
-	fp_THERM3dllTYPE THERM3dll;
-	fp_THERMdllTYPE THERMdll;
-	fp_THFLSHdllTYPE THFLSHdll;
-	fp_TPFLSHdllTYPE TPFLSHdll;
-	fp_TPRHOdllTYPE TPRHOdll;
-	fp_TQFLSHdllTYPE TQFLSHdll;
-	fp_TRNPRPdllTYPE TRNPRPdll;
-	fp_TSFLSHdllTYPE TSFLSHdll;
-	fp_VIRBdllTYPE VIRBdll;
-	fp_VIRCdllTYPE VIRCdll;
-	fp_WMOLdllTYPE WMOLdll;
-	fp_XMASSdllTYPE XMASSdll;
-	fp_XMOLEdllTYPE XMOLEdll;
+	LibraryCall<fp_ABFL1dllTYPE> ABFL1dll;
+	LibraryCall<fp_ABFL2dllTYPE> ABFL2dll;
+	LibraryCall<fp_ACTVYdllTYPE> ACTVYdll;
+	LibraryCall<fp_AGdllTYPE> AGdll;
+	LibraryCall<fp_CCRITdllTYPE> CCRITdll;
+	LibraryCall<fp_CP0dllTYPE> CP0dll;
+	LibraryCall<fp_CRITPdllTYPE> CRITPdll;
+	LibraryCall<fp_CSATKdllTYPE> CSATKdll;
+	LibraryCall<fp_CV2PKdllTYPE> CV2PKdll;
+	LibraryCall<fp_CVCPKdllTYPE> CVCPKdll;
+	LibraryCall<fp_CVCPdllTYPE> CVCPdll;
+	LibraryCall<fp_DBDTdllTYPE> DBDTdll;
+	LibraryCall<fp_DBFL1dllTYPE> DBFL1dll;
+	LibraryCall<fp_DBFL2dllTYPE> DBFL2dll;
+	LibraryCall<fp_DDDPdllTYPE> DDDPdll;
+	LibraryCall<fp_DDDTdllTYPE> DDDTdll;
+	LibraryCall<fp_DEFLSHdllTYPE> DEFLSHdll;
+	LibraryCall<fp_DHD1dllTYPE> DHD1dll;
+	LibraryCall<fp_DHFLSHdllTYPE> DHFLSHdll;
+	LibraryCall<fp_DIELECdllTYPE> DIELECdll;
+	LibraryCall<fp_DOTFILLdllTYPE> DOTFILLdll;
+	LibraryCall<fp_DPDD2dllTYPE> DPDD2dll;
+	LibraryCall<fp_DPDDKdllTYPE> DPDDKdll;
+	LibraryCall<fp_DPDDdllTYPE> DPDDdll;
+	LibraryCall<fp_DPDTKdllTYPE> DPDTKdll;
+	LibraryCall<fp_DPDTdllTYPE> DPDTdll;
+	LibraryCall<fp_DPTSATKdllTYPE> DPTSATKdll;
+	LibraryCall<fp_DSFLSHdllTYPE> DSFLSHdll;
+	LibraryCall<fp_ENTHALdllTYPE> ENTHALdll;
+	LibraryCall<fp_ENTROdllTYPE> ENTROdll;
+	LibraryCall<fp_ESFLSHdllTYPE> ESFLSHdll;
+	LibraryCall<fp_FGCTYdllTYPE> FGCTYdll;
+	LibraryCall<fp_FPVdllTYPE> FPVdll;
+	LibraryCall<fp_GERG04dllTYPE> GERG04dll;
+	LibraryCall<fp_GETFIJdllTYPE> GETFIJdll;
+	LibraryCall<fp_GETKTVdllTYPE> GETKTVdll;
+	LibraryCall<fp_GIBBSdllTYPE> GIBBSdll;
+	LibraryCall<fp_HSFLSHdllTYPE> HSFLSHdll;
+	LibraryCall<fp_INFOdllTYPE> INFOdll;
+	LibraryCall<fp_LIMITKdllTYPE> LIMITKdll;
+	LibraryCall<fp_LIMITSdllTYPE> LIMITSdll;
+	LibraryCall<fp_LIMITXdllTYPE> LIMITXdll;
+	LibraryCall<fp_MELTPdllTYPE> MELTPdll;
+	LibraryCall<fp_MELTTdllTYPE> MELTTdll;
+	LibraryCall<fp_MLTH2OdllTYPE> MLTH2Odll;
+	LibraryCall<fp_NAMEdllTYPE> NAMEdll;
+	LibraryCall<fp_PDFL1dllTYPE> PDFL1dll;
+	LibraryCall<fp_PDFLSHdllTYPE> PDFLSHdll;
+	LibraryCall<fp_PEFLSHdllTYPE> PEFLSHdll;
+	LibraryCall<fp_PHFL1dllTYPE> PHFL1dll;
+	LibraryCall<fp_PHFLSHdllTYPE> PHFLSHdll;
+	LibraryCall<fp_PQFLSHdllTYPE> PQFLSHdll;
+	LibraryCall<fp_PREOSdllTYPE> PREOSdll;
+	LibraryCall<fp_PRESSdllTYPE> PRESSdll;
+	LibraryCall<fp_PSFL1dllTYPE> PSFL1dll;
+	LibraryCall<fp_PSFLSHdllTYPE> PSFLSHdll;
+	LibraryCall<fp_PUREFLDdllTYPE> PUREFLDdll;
+	LibraryCall<fp_QMASSdllTYPE> QMASSdll;
+	LibraryCall<fp_QMOLEdllTYPE> QMOLEdll;
+	LibraryCall<fp_SATDdllTYPE> SATDdll;
+	LibraryCall<fp_SATEdllTYPE> SATEdll;
+	LibraryCall<fp_SATHdllTYPE> SATHdll;
+	LibraryCall<fp_SATPdllTYPE> SATPdll;
+	LibraryCall<fp_SATSdllTYPE> SATSdll;
+	LibraryCall<fp_SATTdllTYPE> SATTdll;
+	LibraryCall<fp_SETAGAdllTYPE> SETAGAdll;
+	LibraryCall<fp_SETKTVdllTYPE> SETKTVdll;
+	LibraryCall<fp_SETMIXdllTYPE> SETMIXdll;
+	LibraryCall<fp_SETMODdllTYPE> SETMODdll;
+	LibraryCall<fp_SETREFdllTYPE> SETREFdll;
+	LibraryCall<fp_SETUPdllTYPE> SETUPdll;
+	LibraryCall<fp_SPECGRdllTYPE> SPECGRdll;
+	LibraryCall<fp_SUBLPdllTYPE> SUBLPdll;
+	LibraryCall<fp_SUBLTdllTYPE> SUBLTdll;
+	LibraryCall<fp_SURFTdllTYPE> SURFTdll;
+	LibraryCall<fp_SURTENdllTYPE> SURTENdll;
+	LibraryCall<fp_TDFLSHdllTYPE> TDFLSHdll;
+	LibraryCall<fp_TEFLSHdllTYPE> TEFLSHdll;
+	LibraryCall<fp_THERM0dllTYPE> THERM0dll;
+	LibraryCall<fp_THERM2dllTYPE> THERM2dll;
+	LibraryCall<fp_THERM3dllTYPE> THERM3dll;
+	LibraryCall<fp_THERMdllTYPE> THERMdll;
+	LibraryCall<fp_THFLSHdllTYPE> THFLSHdll;
+	LibraryCall<fp_TPFLSHdllTYPE> TPFLSHdll;
+	LibraryCall<fp_TPRHOdllTYPE> TPRHOdll;
+	LibraryCall<fp_TQFLSHdllTYPE> TQFLSHdll;
+	LibraryCall<fp_TRNPRPdllTYPE> TRNPRPdll;
+	LibraryCall<fp_TSFLSHdllTYPE> TSFLSHdll;
+	LibraryCall<fp_VIRBdllTYPE> VIRBdll;
+	LibraryCall<fp_VIRCdllTYPE> VIRCdll;
+	LibraryCall<fp_WMOLdllTYPE> WMOLdll;
+	LibraryCall<fp_XMASSdllTYPE> XMASSdll;
+	LibraryCall<fp_XMOLEdllTYPE> XMOLEdll;
+};
+
+// holds the context's lock for as long as it's in scope
+class RefpropLock {
+public:
+	RefpropLock(RefpropContext* rp) : rp(rp) { rp->lock(); }
+	RefpropLock(RefpropContext* rp, bool adopt) : rp(rp) { if (!adopt) rp->lock(); }  // adopt one that's already locked
+	~RefpropLock() { rp->unlock(); }
+
+private:
+	RefpropContext* rp;
 };
 
 #endif
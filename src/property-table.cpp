@@ -0,0 +1,423 @@
+#include <math.h>
+#include <algorithm>
+#include <map>
+#include <mutex>
+#include <string>
+
+#include "property-table.h"
+#include "engine-pool.h"
+
+using namespace v8;
+using namespace node;
+
+// everything a single-phase flash produces that's worth fitting
+static const int fittedProperties[] = { PROP_T, PROP_P, PROP_D, PROP_E, PROP_H, PROP_S, PROP_CV, PROP_CP, PROP_W, PROP_k, PROP_mu };
+static const int numFitted = sizeof(fittedProperties) / sizeof(fittedProperties[0]);
+
+static int letterProperty(char c) {
+	switch (c) {
+		case 'T': return PROP_T;
+		case 'P': return PROP_P;
+		case 'D': return PROP_D;
+		case 'H': return PROP_H;
+		case 'S': return PROP_S;
+		case 'E': return PROP_E;
+		case 'Q': return PROP_Q;
+	}
+	return -1;
+}
+
+PropertyTable::PropertyTable(const char pair[2], const double min[2], const double max[2], const int n[2]) {
+	for (int a = 0; a < 2; a++) {
+		this->pair[a] = pair[a];
+		this->min[a] = min[a];
+		this->max[a] = max[a];
+		this->n[a] = n[a];
+		this->step[a] = (max[a] - min[a]) / (n[a] - 1);
+	}
+
+	// the inputs come straight off the grid, so there's no point fitting them
+	for (int p = 0; p < PROP_COUNT; p++)
+		this->columnOf[p] = -1;
+	for (int c = 0; c < numFitted; c++) {
+		int prop = fittedProperties[c];
+		if (prop != letterProperty(pair[0]) && prop != letterProperty(pair[1])) {
+			this->columnOf[prop] = (int)this->columns.size();
+			this->columns.push_back(prop);
+		}
+	}
+}
+
+// the grid's nodes, flashed across the engine pool.  failed nodes just get phase 0, which keeps the
+// cells around them on the exact flash
+class NodeJob : public PoolJob {
+public:
+	NodeJob(PropertyTable* table, const double min[2], const double step[2], int n1, const std::vector<int>& columns, const char* fluid)
+		: PoolJob(0, fluid), table(table), n1(n1), columns(columns) {
+		this->min[0] = min[0]; this->min[1] = min[1];
+		this->step[0] = step[0]; this->step[1] = step[1];
+	}
+
+	PropertyTable* table;
+	double min[2], step[2];
+	int n1;
+	const std::vector<int>& columns;
+	RefpropContext::FlashFcn flashFcn;
+
+	std::vector<double> nodes;         // [column][node]
+	std::vector<signed char> phase;    // -1 liquid, 1 vapor or supercritical, 0 two-phase or failed
+	std::vector<double> Q;
+
+	void runRows(RefpropContext* rp, size_t begin, size_t end) {
+		ThermoState state;
+		double vals[2];
+
+		// a mixture's table would only hold for its default composition, and calls can ask for any other
+		if (rp->components() > 1) {
+			this->fail(begin, "Property tables only cover pure fluids");
+			return;
+		}
+
+		for (size_t r = begin; r < end; r++) {
+			vals[0] = this->min[0] + (r / this->n1) * this->step[0];
+			vals[1] = this->min[1] + (r % this->n1) * this->step[1];
+
+			rp->initState(&state);
+			if (rp->flash(this->flashFcn, this->table->pair, vals, &state) != 0 || (state.Q >= 0 && state.Q <= 1)) {
+				this->phase[r] = 0;
+				continue;
+			}
+
+			this->phase[r] = state.Q < 0 ? -1 : 1;
+			this->Q[r] = state.Q;
+			for (size_t c = 0; c < this->columns.size(); c++)
+				this->nodes[c * this->rows + r] = state.property(this->columns[c]);
+		}
+	}
+};
+
+bool PropertyTable::build(const char* fluid, char* err) {
+	if (this->n[0] < 2 || this->n[1] < 2 || !(this->max[0] > this->min[0]) || !(this->max[1] > this->min[1])) {
+		strcpy(err, "Each table axis needs at least two nodes over a non-empty range");
+		return false;
+	}
+
+	RefpropContext* rp = EnginePool::instance()->engine(0);
+	NodeJob job(this, this->min, this->step, this->n[1], this->columns, fluid);
+	job.rows = (size_t)this->n[0] * this->n[1];
+	job.failedRow = job.rows;
+	job.flashFcn = rp->findFlashFcn(this->pair);
+	if (!job.flashFcn) {
+		strcpy(err, "Property combination not supported!");
+		return false;
+	}
+
+	job.nodes.assign(this->columns.size() * job.rows, 0);
+	job.phase.assign(job.rows, 0);
+	job.Q.assign(job.rows, NAN);
+
+	EnginePool::instance()->run(&job);
+	if (job.failed()) {
+		strcpy(err, job.herr);
+		return false;
+	}
+
+	this->fit(job.nodes, job.phase);
+
+	// every cell that got a patch takes its phase code from its first corner
+	size_t numCells = this->cells();
+	this->cellQ.assign(numCells, NAN);
+	for (size_t cell = 0; cell < numCells; cell++) {
+		int i0 = (int)(cell / (this->n[1] - 1)), i1 = (int)(cell % (this->n[1] - 1));
+		size_t node = (size_t)i0 * this->n[1] + i1;
+		if (job.phase[node] != 0 && job.phase[node] == job.phase[node+1] &&
+				job.phase[node] == job.phase[node + this->n[1]] && job.phase[node] == job.phase[node + this->n[1] + 1])
+			this->cellQ[cell] = job.Q[node];
+	}
+	return true;
+}
+
+// slope of f along one axis at a node, on the unit-spaced grid, using only neighbours in the same phase
+static double slope(const double* f, const std::vector<signed char>& phase, int i0, int i1, int d0, int d1, const int n[2]) {
+	size_t node = (size_t)i0 * n[1] + i1, stride = (size_t)d0 * n[1] + d1;
+	bool back = i0 - d0 >= 0 && i1 - d1 >= 0 && phase[node - stride] == phase[node];
+	bool fwd = i0 + d0 < n[0] && i1 + d1 < n[1] && phase[node + stride] == phase[node];
+
+	if (back && fwd)
+		return (f[node + stride] - f[node - stride]) / 2;
+	if (fwd)
+		return f[node + stride] - f[node];
+	if (back)
+		return f[node] - f[node - stride];
+	return 0;
+}
+
+void PropertyTable::fit(const std::vector<double>& nodes, const std::vector<signed char>& phase) {
+	static const double M[4][4] = { {1, 0, 0, 0}, {0, 0, 1, 0}, {-3, 3, -2, -1}, {2, -2, 1, 1} };
+
+	size_t numNodes = (size_t)this->n[0] * this->n[1], numCells = this->cells();
+	std::vector<double> fu(numNodes), fv(numNodes), fuv(numNodes);
+	this->coef.assign(this->columns.size() * numCells * 16, 0);
+
+	for (size_t c = 0; c < this->columns.size(); c++) {
+		const double* f = &nodes[c * numNodes];
+
+		for (int i0 = 0; i0 < this->n[0]; i0++)
+			for (int i1 = 0; i1 < this->n[1]; i1++) {
+				fu[(size_t)i0 * this->n[1] + i1] = slope(f, phase, i0, i1, 1, 0, this->n);
+				fv[(size_t)i0 * this->n[1] + i1] = slope(f, phase, i0, i1, 0, 1, this->n);
+			}
+		for (int i0 = 0; i0 < this->n[0]; i0++)
+			for (int i1 = 0; i1 < this->n[1]; i1++)
+				fuv[(size_t)i0 * this->n[1] + i1] = slope(&fv[0], phase, i0, i1, 1, 0, this->n);
+
+		for (size_t cell = 0; cell < numCells; cell++) {
+			int i0 = (int)(cell / (this->n[1] - 1)), i1 = (int)(cell % (this->n[1] - 1));
+			size_t n00 = (size_t)i0 * this->n[1] + i1, n01 = n00 + 1, n10 = n00 + this->n[1], n11 = n10 + 1;
+
+			// the standard bicubic patch, a = M F M^T
+			double F[4][4] = {
+				{ f[n00], f[n01], fv[n00], fv[n01] },
+				{ f[n10], f[n11], fv[n10], fv[n11] },
+				{ fu[n00], fu[n01], fuv[n00], fuv[n01] },
+				{ fu[n10], fu[n11], fuv[n10], fuv[n11] }
+			};
+			double MF[4][4];
+			for (int i = 0; i < 4; i++)
+				for (int j = 0; j < 4; j++) {
+					MF[i][j] = 0;
+					for (int k = 0; k < 4; k++)
+						MF[i][j] += M[i][k] * F[k][j];
+				}
+
+			double* a = &this->coef[(c * numCells + cell) * 16];
+			for (int i = 0; i < 4; i++)
+				for (int j = 0; j < 4; j++) {
+					a[i*4 + j] = 0;
+					for (int k = 0; k < 4; k++)
+						a[i*4 + j] += MF[i][k] * M[j][k];
+				}
+		}
+	}
+}
+
+bool PropertyTable::covers(const char props[2]) {
+	return (props[0] == this->pair[0] && props[1] == this->pair[1]) || (props[0] == this->pair[1] && props[1] == this->pair[0]);
+}
+
+void PropertyTable::locate(const char props[2], const double* x0, const double* x1, size_t rows, int* cell, double* u, double* v) {
+	// axis 0 of the table might be the second input
+	const double* a0 = props[0] == this->pair[0] ? x0 : x1;
+	const double* a1 = props[0] == this->pair[0] ? x1 : x0;
+
+	for (size_t r = 0; r < rows; r++) {
+		double s0 = (a0[r] - this->min[0]) / this->step[0];
+		double s1 = (a1[r] - this->min[1]) / this->step[1];
+
+		// written this way round so NaNs land outside too
+		if (!(s0 >= 0 && s0 <= this->n[0] - 1 && s1 >= 0 && s1 <= this->n[1] - 1)) {
+			cell[r] = -1;
+			continue;
+		}
+
+		// the top edge of the grid belongs to the last cell
+		int i0 = std::min((int)s0, this->n[0] - 2), i1 = std::min((int)s1, this->n[1] - 2);
+		int c = i0 * (this->n[1] - 1) + i1;
+
+		cell[r] = isnan(this->cellQ[c]) ? -1 : c;
+		u[r] = s0 - i0;
+		v[r] = s1 - i1;
+	}
+}
+
+void PropertyTable::evaluate(int prop, const int* cell, const double* u, const double* v, size_t rows, double* out) {
+	int numCells = (int)this->cells();
+
+	if (prop == letterProperty(this->pair[0]) || prop == letterProperty(this->pair[1])) {
+		int axis = prop == letterProperty(this->pair[0]) ? 0 : 1;
+		const double* w = axis == 0 ? u : v;
+		for (size_t r = 0; r < rows; r++) {
+			int c = cell[r] < 0 ? 0 : cell[r];
+			int i = axis == 0 ? c / (this->n[1] - 1) : c % (this->n[1] - 1);
+			out[r] = this->min[axis] + (i + w[r]) * this->step[axis];
+		}
+		return;
+	}
+
+	if (prop == PROP_Q) {
+		for (size_t r = 0; r < rows; r++)
+			out[r] = cell[r] < 0 ? NAN : this->cellQ[cell[r]];
+		return;
+	}
+
+	if (prop == PROP_DL || prop == PROP_DV)
+		prop = PROP_D;  // there's only the one phase
+
+	if (this->columnOf[prop] < 0) {
+		// kL, sigma and friends don't exist outside the dome
+		for (size_t r = 0; r < rows; r++)
+			out[r] = NAN;
+		return;
+	}
+
+	// horner in v inside horner in u.  no branches, so this vectorizes into gathers and fmas
+	const double* base = &this->coef[(size_t)this->columnOf[prop] * numCells * 16];
+	for (size_t r = 0; r < rows; r++) {
+		const double* a = base + (size_t)(cell[r] < 0 ? 0 : cell[r]) * 16;
+		double uu = u[r], vv = v[r];
+
+		double b3 = a[12] + vv*(a[13] + vv*(a[14] + vv*a[15]));
+		double b2 = a[8] + vv*(a[9] + vv*(a[10] + vv*a[11]));
+		double b1 = a[4] + vv*(a[5] + vv*(a[6] + vv*a[7]));
+		double b0 = a[0] + vv*(a[1] + vv*(a[2] + vv*a[3]));
+		out[r] = b0 + uu*(b1 + uu*(b2 + uu*b3));
+	}
+}
+
+bool PropertyTable::tabulates(int prop) {
+	return prop != PROP_X && prop != PROP_Y && prop != PROP_Z && prop < PROP_dPdD;
+}
+
+bool PropertyTable::lookup(const char props[2], const double vals[2], ThermoState* obj) {
+	if (!this->covers(props))
+		return false;
+
+	int cell;
+	double u, v;
+	this->locate(props, &vals[0], &vals[1], 1, &cell, &u, &v);
+	if (cell < 0)
+		return false;
+
+	double* fields[] = { &obj->T, &obj->P, &obj->D, &obj->E, &obj->H, &obj->S, &obj->CV, &obj->CP, &obj->W, &obj->Q };
+	int props_[] = { PROP_T, PROP_P, PROP_D, PROP_E, PROP_H, PROP_S, PROP_CV, PROP_CP, PROP_W, PROP_Q };
+	for (int i = 0; i < 10; i++)
+		this->evaluate(props_[i], &cell, &u, &v, 1, fields[i]);
+	obj->DL = obj->DV = obj->D;
+	obj->X[0] = obj->Y[0] = obj->Z[0];  // pure fluid, one phase
+
+	obj->trnprp.clear();
+	this->evaluate(PROP_k, &cell, &u, &v, 1, &obj->trnprp.k);
+	this->evaluate(PROP_mu, &cell, &u, &v, 1, &obj->trnprp.mu);
+	obj->computed = transportMask;
+	return true;
+}
+
+size_t PropertyTable::cells() {
+	return (size_t)(this->n[0] - 1) * (this->n[1] - 1);
+}
+
+size_t PropertyTable::exactCells() {
+	size_t exact = 0;
+	for (size_t c = 0; c < this->cellQ.size(); c++)
+		if (isnan(this->cellQ[c]))
+			exact++;
+	return exact;
+}
+
+size_t PropertyTable::bytes() {
+	return this->coef.size() * sizeof(double) + this->cellQ.size() * sizeof(double);
+}
+
+std::atomic<unsigned long> TableRegistry::generation(0);
+static std::map<std::string, std::shared_ptr<PropertyTable> > tables;
+static std::mutex tablesMutex;
+
+std::shared_ptr<PropertyTable> TableRegistry::find(const char* fluid) {
+	std::lock_guard<std::mutex> lock(tablesMutex);
+	std::map<std::string, std::shared_ptr<PropertyTable> >::iterator it = tables.find(fluid);
+	return it == tables.end() ? std::shared_ptr<PropertyTable>() : it->second;
+}
+
+void TableRegistry::add(const char* fluid, std::shared_ptr<PropertyTable> table) {
+	std::lock_guard<std::mutex> lock(tablesMutex);
+	tables[fluid] = table;
+	generation++;
+}
+
+void TableRegistry::drop(const char* fluid) {
+	std::lock_guard<std::mutex> lock(tablesMutex);
+	tables.erase(fluid);
+	generation++;
+}
+
+// reads [min, max, n] for one axis out of the options object
+static bool axisOption(Local<Object> options, char letter, double* min, double* max, int* n, Isolate* iso) {
+	char key[2] = { letter, '\0' };
+	Local<Value> val = options->Get(String::NewFromUtf8(iso, key));
+	if (!val->IsArray())
+		return false;
+
+	Local<Array> axis = Local<Array>::Cast(val);
+	if (axis->Length() != 3)
+		return false;
+
+	*min = axis->Get(0)->NumberValue();
+	*max = axis->Get(1)->NumberValue();
+	*n = axis->Get(2)->Int32Value();
+	return true;
+}
+
+void buildTable(const FunctionCallbackInfo<Value>& args) {
+	Isolate* iso = args.GetIsolate();
+	// args[0] is {inputs: 'PH', P: [min, max, nodes], H: [min, max, nodes]} for the current fluid.
+	// from then on, states of that fluid given by that pair are interpolated wherever the table can
+	// answer them.  building again replaces the table
+
+	if (args.Length() < 1 || !args[0]->IsObject()) {
+		iso->ThrowException(Exception::TypeError(String::NewFromUtf8(iso, "Must provide the table's inputs and axes")));
+		return;
+	}
+
+	Local<Object> options = args[0]->ToObject();
+	String::Utf8Value inputs(options->Get(String::NewFromUtf8(iso, "inputs"))->ToString());
+	if (inputs.length() != 2) {
+		iso->ThrowException(Exception::TypeError(String::NewFromUtf8(iso, "Table inputs must be two property letters, e.g. 'PH'")));
+		return;
+	}
+
+	char pair[2] = { (*inputs)[0], (*inputs)[1] };
+	double min[2], max[2];
+	int n[2];
+	for (int a = 0; a < 2; a++) {
+		if (!axisOption(options, pair[a], &min[a], &max[a], &n[a], iso)) {
+			iso->ThrowException(Exception::TypeError(String::NewFromUtf8(iso, "Each table input needs a [min, max, nodes] axis")));
+			return;
+		}
+	}
+
+	RefpropContext* rp = RefpropContext::instance(iso);
+	if (!rp || !fluidChosen(RefpropContext::selectedFluid, iso))
+		return;
+	RefpropLock lock(rp);
+
+	if (!rp->flashFcnLookup(pair, iso))
+		return;
+
+	// the old table would answer the new one's nodes
+	TableRegistry::drop(RefpropContext::selectedFluid);
+
+	std::shared_ptr<PropertyTable> table(new PropertyTable(pair, min, max, n));
+	char err[errormessagelength+1];
+	if (!table->build(RefpropContext::selectedFluid, err)) {
+		iso->ThrowException(Exception::Error(String::NewFromUtf8(iso, err)));
+		return;
+	}
+	TableRegistry::add(RefpropContext::selectedFluid, table);
+
+	Local<Object> obj = Object::New(iso);
+	obj->Set(String::NewFromUtf8(iso, "cells"), Number::New(iso, (double)table->cells()));
+	obj->Set(String::NewFromUtf8(iso, "exactCells"), Number::New(iso, (double)table->exactCells()));
+	obj->Set(String::NewFromUtf8(iso, "bytes"), Number::New(iso, (double)table->bytes()));
+	args.GetReturnValue().Set(obj);
+}
+
+void dropTable(const FunctionCallbackInfo<Value>& args) {
+	Isolate* iso = args.GetIsolate();
+
+	RefpropContext* rp = RefpropContext::instance(iso);
+	if (!rp)
+		return;
+	RefpropLock lock(rp);
+
+	TableRegistry::drop(RefpropContext::selectedFluid);
+}
@@ -0,0 +1,68 @@
+#ifndef NODE_REFPROP_PROPERTY_TABLE_H
+#define NODE_REFPROP_PROPERTY_TABLE_H
+
+#include <atomic>
+#include <memory>
+#include <vector>
+
+#include "node-refprop.h"
+
+// bicubic interpolation over a rectangular grid of states in one fluid, in the spirit of TTSE/BICUBIC.
+// the grid nodes are flashed once with refprop; every cell whose four corners are in the same single
+// phase gets a bicubic patch per property, fitted to the node values and finite-difference slopes.
+// cells that touch the two-phase dome or straddle the saturation line are left to the exact flash,
+// as is anything outside the grid.  tables never change once built, so engines share them freely.
+class PropertyTable {
+public:
+	// axis 0 is pair[0], axis 1 is pair[1]; each axis has n nodes spread evenly over [min, max]
+	PropertyTable(const char pair[2], const double min[2], const double max[2], const int n[2]);
+
+	// flashes the nodes across the engine pool (the caller holds engine 0's lock) and fits the cells
+	bool build(const char* fluid, char* err);
+
+	// true if the table was built over this input pair, in either order
+	bool covers(const char props[2]);
+
+	// interpolates the state at vals into obj; false if the point needs an exact flash
+	bool lookup(const char props[2], const double vals[2], ThermoState* obj);
+
+	// finds the cell and local coordinates of each row, for evaluate().  cell[i] is -1 for rows that
+	// need an exact flash.  x0/x1 are in the order of props, which covers() has to accept
+	void locate(const char props[2], const double* x0, const double* x1, size_t rows, int* cell, double* u, double* v);
+
+	// evaluates one property at rows that locate() placed in the table.  tight enough to vectorize
+	void evaluate(int prop, const int* cell, const double* u, const double* v, size_t rows, double* out);
+
+	// true if evaluate() can produce the property; inputs, Q, DL/DV and k/mu all count, X/Y/Z and derivatives don't
+	bool tabulates(int prop);
+
+	size_t cells();
+	size_t exactCells();
+	size_t bytes();
+
+	char pair[2];
+
+private:
+	double min[2], max[2], step[2];
+	int n[2];
+
+	std::vector<int> columns;      // property index of each fitted column
+	int columnOf[PROP_COUNT];      // column of each property, -1 if it isn't fitted
+	std::vector<double> coef;      // [column][cell][16], a_ij at i*4 + j for u^i v^j
+	std::vector<double> cellQ;     // phase code (refprop's out-of-dome quality) of each cell, NaN for exact cells
+
+	void fit(const std::vector<double>& nodes, const std::vector<signed char>& phase);
+};
+
+// one table per fluid, shared by every engine
+class TableRegistry {
+public:
+	static std::shared_ptr<PropertyTable> find(const char* fluid);
+	static void add(const char* fluid, std::shared_ptr<PropertyTable> table);
+	static void drop(const char* fluid);
+
+	// bumped on every add/drop so contexts know to look their table up again
+	static std::atomic<unsigned long> generation;
+};
+
+#endif
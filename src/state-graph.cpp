@@ -0,0 +1,527 @@
+#include <ctype.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <algorithm>
+
+#include "state-graph.h"
+#include "engine-pool.h"
+#include "fluids.h"
+
+using namespace v8;
+using namespace node;
+
+static bool isIdentifier(const char* name) {
+	if (!name[0] || !(isalpha((unsigned char)name[0]) || name[0] == '_'))
+		return false;
+	for (const char* c = name; *c; c++)
+		if (!(isalnum((unsigned char)*c) || *c == '_'))
+			return false;
+	return true;
+}
+
+// one expression at a time.  tracks how deep the stack gets so evaluation can use a fixed-size one
+struct StateGraph::Parser {
+	StateGraph* graph;
+	const std::string& text;
+	size_t node;  // the node the expression belongs to; it can only read the ones before it
+	std::vector<Op>* program;
+	char* err;
+	size_t pos;
+	int depth, deepest;
+
+	Parser(StateGraph* graph, const std::string& text, size_t node, std::vector<Op>* program, char* err)
+		: graph(graph), text(text), node(node), program(program), err(err), pos(0), depth(0), deepest(0) {}
+
+	bool fail(const char* what) {
+		snprintf(this->err, errormessagelength, "%s at character %lu of '%s'", what, (unsigned long)this->pos + 1, this->text.c_str());
+		return false;
+	}
+
+	void emit(OpCode code, double value = 0, int a = 0, int b = 0) {
+		Op op = { code, value, a, b };
+		this->program->push_back(op);
+
+		if (code == OP_CONST || code == OP_PARAM || code == OP_PROP)
+			this->deepest = std::max(this->deepest, ++this->depth);
+		else if (code != OP_NEG)
+			this->depth--;
+	}
+
+	char peek() {
+		while (this->pos < this->text.size() && isspace((unsigned char)this->text[this->pos]))
+			this->pos++;
+		return this->pos < this->text.size() ? this->text[this->pos] : '\0';
+	}
+
+	bool all() {
+		if (!this->expression())
+			return false;
+		if (this->peek())
+			return this->fail("Unexpected character");
+		if (this->deepest > maxDepth)
+			return this->fail("Expression too deeply nested");
+		return true;
+	}
+
+	bool expression() {
+		if (!this->term())
+			return false;
+		for (char c = this->peek(); c == '+' || c == '-'; c = this->peek()) {
+			this->pos++;
+			if (!this->term())
+				return false;
+			this->emit(c == '+' ? OP_ADD : OP_SUB);
+		}
+		return true;
+	}
+
+	bool term() {
+		if (!this->unary())
+			return false;
+		for (char c = this->peek(); c == '*' || c == '/'; c = this->peek()) {
+			this->pos++;
+			if (!this->unary())
+				return false;
+			this->emit(c == '*' ? OP_MUL : OP_DIV);
+		}
+		return true;
+	}
+
+	bool unary() {
+		char c = this->peek();
+		if (c == '-' || c == '+') {
+			this->pos++;
+			if (!this->unary())
+				return false;
+			if (c == '-')
+				this->emit(OP_NEG);
+			return true;
+		}
+		return this->power();
+	}
+
+	// ^ binds tighter than unary minus on its left and is right-associative, so -a^b^c is -(a^(b^c))
+	bool power() {
+		if (!this->primary())
+			return false;
+		if (this->peek() == '^') {
+			this->pos++;
+			if (!this->unary())
+				return false;
+			this->emit(OP_POW);
+		}
+		return true;
+	}
+
+	bool primary() {
+		char c = this->peek();
+		if (c == '(') {
+			this->pos++;
+			if (!this->expression())
+				return false;
+			if (this->peek() != ')')
+				return this->fail("Missing )");
+			this->pos++;
+			return true;
+		}
+
+		if (isdigit((unsigned char)c) || c == '.') {
+			const char* start = this->text.c_str() + this->pos;
+			char* end;
+			double value = strtod(start, &end);
+			if (end == start)
+				return this->fail("Bad number");
+			this->pos += end - start;
+			this->emit(OP_CONST, value);
+			return true;
+		}
+
+		if (!isalpha((unsigned char)c) && c != '_')
+			return this->fail(c ? "Unexpected character" : "Unexpected end");
+
+		std::string name = this->identifier();
+		if (this->pos < this->text.size() && this->text[this->pos] == '.') {
+			// node.property
+			this->pos++;
+			std::string prop = this->identifier();
+			int ref = this->graph->nodeIndex(name.c_str());
+			int idx = ThermoState::propertyIndex(prop.c_str());
+			if (ref < 0 || (size_t)ref >= this->node)
+				return this->fail("Not an earlier node");
+			if (idx < 0)
+				return this->fail("Unknown property");
+			this->graph->want[ref] |= propertyBit(idx);
+			this->emit(OP_PROP, 0, ref, idx);
+			return true;
+		}
+
+		std::vector<std::string>& params = this->graph->paramNames;
+		size_t p = std::find(params.begin(), params.end(), name) - params.begin();
+		if (p == params.size())
+			params.push_back(name);
+		this->emit(OP_PARAM, 0, (int)p);
+		return true;
+	}
+
+	std::string identifier() {
+		size_t start = this->pos;
+		while (this->pos < this->text.size() && (isalnum((unsigned char)this->text[this->pos]) || this->text[this->pos] == '_'))
+			this->pos++;
+		return this->text.substr(start, this->pos - start);
+	}
+};
+
+bool StateGraph::parse(const std::string& text, size_t node, std::vector<Op>* program, char* err) {
+	Parser parser(this, text, node, program, err);
+	return parser.all();
+}
+
+bool StateGraph::compile(Local<Value> arg, RefpropContext* rp, Isolate* iso) {
+	char err[errormessagelength+64];
+
+	if (!arg->IsArray() || Local<Array>::Cast(arg)->Length() == 0) {
+		iso->ThrowException(Exception::TypeError(String::NewFromUtf8(iso, "A state graph is an array of nodes")));
+		return false;
+	}
+
+	Local<Array> list = Local<Array>::Cast(arg);
+	for (uint32_t i = 0; i < list->Length(); i++) {
+		if (!list->Get(i)->IsObject()) {
+			iso->ThrowException(Exception::TypeError(String::NewFromUtf8(iso, "A state graph is an array of nodes")));
+			return false;
+		}
+		Local<Object> obj = list->Get(i)->ToObject();
+
+		String::Utf8Value name(obj->Get(String::NewFromUtf8(iso, "name"))->ToString());
+		if (!isIdentifier(*name) || this->nodeIndex(*name) >= 0) {
+			snprintf(err, sizeof(err), "Node %u needs a name of its own, made of letters, digits and _", i);
+			iso->ThrowException(Exception::TypeError(String::NewFromUtf8(iso, err)));
+			return false;
+		}
+
+		// every key but the name is an input
+		Node node;
+		Local<Value> inputs[2];
+		int numInputs = 0;
+		Local<Array> keys = obj->GetOwnPropertyNames();
+		for (uint32_t k = 0; k < keys->Length(); k++) {
+			String::Utf8Value key(keys->Get(k)->ToString());
+			if (strcmp(*key, "name") == 0)
+				continue;
+			if (numInputs < 2) {
+				node.props[numInputs] = key.length() == 1 ? (*key)[0] : '\0';
+				inputs[numInputs] = obj->Get(keys->Get(k));
+			}
+			numInputs++;
+		}
+
+		node.flashFcn = numInputs == 2 ? rp->findFlashFcn(node.props) : NULL;
+		if (!node.flashFcn) {
+			snprintf(err, sizeof(err), "Node %s: needs exactly 2 inputs that refprop can flash on, out of TPDHSEQ", *name);
+			iso->ThrowException(Exception::TypeError(String::NewFromUtf8(iso, err)));
+			return false;
+		}
+
+		this->want.push_back(0);
+		for (int k = 0; k < 2; k++) {
+			if (inputs[k]->IsNumber()) {
+				Op op = { OP_CONST, inputs[k]->NumberValue(), 0, 0 };
+				node.program[k].push_back(op);
+				continue;
+			}
+
+			char parseErr[errormessagelength+1];
+			String::Utf8Value text(inputs[k]->ToString());
+			if (!inputs[k]->IsString() || !this->parse(*text, i, &node.program[k], parseErr)) {
+				snprintf(err, sizeof(err), "Node %s, %c: %s", *name, node.props[k], inputs[k]->IsString() ? parseErr : "must be a number or an expression");
+				iso->ThrowException(Exception::TypeError(String::NewFromUtf8(iso, err)));
+				return false;
+			}
+		}
+
+		this->nodes.push_back(node);
+		this->nodeNames.push_back(*name);
+	}
+	return true;
+}
+
+int StateGraph::nodeIndex(const char* name) {
+	for (size_t i = 0; i < this->nodeNames.size(); i++)
+		if (this->nodeNames[i] == name)
+			return (int)i;
+	return -1;
+}
+
+double StateGraph::run(const std::vector<Op>& program, const double* params, ThermoState* states) {
+	double stack[maxDepth];
+	int top = 0;
+
+	for (size_t i = 0; i < program.size(); i++) {
+		const Op& op = program[i];
+		switch (op.code) {
+			case OP_CONST:
+				stack[top++] = op.value;
+				break;
+			case OP_PARAM:
+				stack[top++] = params[op.a];
+				break;
+			case OP_PROP:
+				stack[top++] = states[op.a].property(op.b);
+				break;
+			case OP_ADD:
+				top--;
+				stack[top-1] += stack[top];
+				break;
+			case OP_SUB:
+				top--;
+				stack[top-1] -= stack[top];
+				break;
+			case OP_MUL:
+				top--;
+				stack[top-1] *= stack[top];
+				break;
+			case OP_DIV:
+				top--;
+				stack[top-1] /= stack[top];
+				break;
+			case OP_POW:
+				top--;
+				stack[top-1] = pow(stack[top-1], stack[top]);
+				break;
+			case OP_NEG:
+				stack[top-1] = -stack[top-1];
+				break;
+		}
+	}
+	return stack[0];
+}
+
+long StateGraph::evaluate(RefpropContext* rp, const double* params, ThermoState* states, char* herr) {
+	for (size_t i = 0; i < this->nodes.size(); i++) {
+		Node& node = this->nodes[i];
+		double vals[2] = { this->run(node.program[0], params, states), this->run(node.program[1], params, states) };
+
+		// a NaN input (a transport property that doesn't apply to the phase, say) would only confuse refprop
+		if (!isfinite(vals[0]) || !isfinite(vals[1])) {
+			snprintf(herr, errormessagelength, "%s: inputs %c=%g, %c=%g aren't finite", this->nodeNames[i].c_str(), node.props[0], vals[0], node.props[1], vals[1]);
+			return 1;
+		}
+
+		long ierr = rp->initState(&states[i]);
+		if (ierr == 0)
+			ierr = rp->flash(node.flashFcn, node.props, vals, &states[i], this->want[i]);
+		if (ierr > 0) {
+			snprintf(herr, errormessagelength, "%s: %s", this->nodeNames[i].c_str(), rp->errorMessage());
+			return ierr;
+		}
+	}
+	return 0;
+}
+
+// the graph over columns of parameters, spread over the engine pool
+class GraphJob : public PoolJob {
+public:
+	GraphJob(size_t rows, const char* fluid, StateGraph* graph) : PoolJob(rows, fluid), graph(graph), status(NULL), statusErrors(false) {}
+
+	StateGraph* graph;
+	std::vector<const double*> paramColumns;  // NULL for parameters that are the same for every row
+	std::vector<double> paramValues;
+
+	struct Output {
+		int node, prop;
+		double* col;
+	};
+	std::vector<Output> outputs;
+
+	// like statePointBatch's: with a status column or in status mode, a row whose graph fails gets NaN
+	// outputs (and its ierr in status) rather than throwing
+	int32_t* status;
+	bool statusErrors;
+
+	void runRows(RefpropContext* rp, size_t begin, size_t end) {
+		std::vector<ThermoState> states(this->graph->nodeNames.size());
+		std::vector<double> params(this->paramValues);
+		char herr[errormessagelength+1];
+
+		for (size_t i = begin; i < end; i++) {
+			for (size_t p = 0; p < params.size(); p++)
+				if (this->paramColumns[p])
+					params[p] = this->paramColumns[p][i];
+
+			long ierr = this->graph->evaluate(rp, params.data(), states.data(), herr);
+			if (this->status)
+				this->status[i] = (int32_t)ierr;
+			if (ierr != 0) {
+				if (!this->status && !this->statusErrors) {
+					this->fail(i, herr);
+					return;
+				}
+				for (size_t j = 0; j < this->outputs.size(); j++)
+					this->outputs[j].col[i] = NAN;
+				continue;
+			}
+			for (size_t j = 0; j < this->outputs.size(); j++)
+				this->outputs[j].col[i] = states[this->outputs[j].node].property(this->outputs[j].prop);
+		}
+	}
+};
+
+void evaluateGraph(const FunctionCallbackInfo<Value>& args) {
+	if (fluidChosen(RefpropContext::selectedFluid, args.GetIsolate()))
+		graphEvaluate(args, RefpropContext::selectedFluid);
+}
+
+// one set of parameters: every node's state, in one call
+static void evaluateOnce(const FunctionCallbackInfo<Value>& args, const char* fluid, Local<Object> params) {
+	Isolate* iso = args.GetIsolate();
+
+	FluidScheduler::noteFluid(fluid);
+	RefpropContext* rp = EnginePool::instance()->engineFor(fluid);
+	RefpropLock lock(rp, true);
+
+	StateGraph graph;
+	if (!graph.compile(args[0], rp, iso))
+		return;
+
+	std::vector<double> values;
+	for (size_t p = 0; p < graph.paramNames.size(); p++) {
+		Local<Value> val = params->Get(String::NewFromUtf8(iso, graph.paramNames[p].c_str()));
+		if (!val->IsNumber()) {
+			std::string msg = "Parameter " + graph.paramNames[p] + " must be a number";
+			iso->ThrowException(Exception::TypeError(String::NewFromUtf8(iso, msg.c_str())));
+			return;
+		}
+		values.push_back(val->NumberValue());
+	}
+
+	if (rp->loadFluid(fluid) != 0) {
+		iso->ThrowException(Exception::TypeError(String::NewFromUtf8(iso, rp->errorMessage())));
+		return;
+	}
+
+	// in status mode a failed node comes back as {ierr, herr}, like a failed statePoint
+	std::vector<ThermoState> states(graph.nodeNames.size());
+	char herr[errormessagelength+1];
+	long ierr = graph.evaluate(rp, values.data(), states.data(), herr);
+	if (ierr != 0 && RefpropContext::statusErrors) {
+		Local<Object> failure = Object::New(iso);
+		failure->Set(String::NewFromUtf8(iso, "ierr"), Number::New(iso, (double)ierr));
+		failure->Set(String::NewFromUtf8(iso, "herr"), statusMessage(iso, herr));
+		args.GetReturnValue().Set(failure);
+		return;
+	}
+	if (ierr != 0) {
+		iso->ThrowException(Exception::Error(String::NewFromUtf8(iso, herr)));
+		return;
+	}
+
+	// transport properties nothing read are left to getters, like statePoint's lazy results
+	Local<Object> result = Object::New(iso);
+	for (size_t i = 0; i < states.size(); i++)
+		result->Set(String::NewFromUtf8(iso, graph.nodeNames[i].c_str()), states[i].toJs(iso, allProperties | graph.want[i], fluid));
+	args.GetReturnValue().Set(result);
+}
+
+// every row of parameter columns, into output columns
+static void evaluateBatch(const FunctionCallbackInfo<Value>& args, const char* fluid, Local<Object> params) {
+	Isolate* iso = args.GetIsolate();
+
+	RefpropContext* rp = RefpropContext::instance(iso);
+	RefpropLock lock(rp);
+
+	StateGraph graph;
+	if (!graph.compile(args[0], rp, iso))
+		return;
+
+	// the output columns say how many rows there are
+	Local<Object> outputs = args[2]->ToObject();
+	Local<Array> nodeKeys = outputs->GetOwnPropertyNames();
+	std::vector<GraphJob::Output> columns;
+	size_t rows = 0, len;
+
+	for (uint32_t n = 0; n < nodeKeys->Length(); n++) {
+		String::Utf8Value nodeName(nodeKeys->Get(n)->ToString());
+		int node = graph.nodeIndex(*nodeName);
+		Local<Value> props = outputs->Get(nodeKeys->Get(n));
+		if (node < 0 || !props->IsObject()) {
+			iso->ThrowException(Exception::TypeError(String::NewFromUtf8(iso, "Outputs are {node: {property: Float64Array}} for nodes in the graph")));
+			return;
+		}
+
+		Local<Array> propKeys = props->ToObject()->GetOwnPropertyNames();
+		for (uint32_t k = 0; k < propKeys->Length(); k++) {
+			String::Utf8Value propName(propKeys->Get(k)->ToString());
+			GraphJob::Output out;
+			out.node = node;
+			out.prop = ThermoState::propertyIndex(*propName);
+			if (out.prop < 0 || !float64Data(props->ToObject()->Get(propKeys->Get(k)), &out.col, &len) || (!columns.empty() && len != rows)) {
+				iso->ThrowException(Exception::TypeError(String::NewFromUtf8(iso, "Output columns must be Float64Arrays of known properties, all the same length")));
+				return;
+			}
+			rows = len;
+			graph.want[node] |= propertyBit(out.prop);
+			columns.push_back(out);
+		}
+	}
+
+	GraphJob job(rows, fluid, &graph);
+	job.outputs = columns;
+	job.statusErrors = RefpropContext::statusErrors;
+	if (args.Length() > 3 && args[3]->IsObject()) {
+		Local<Value> status = args[3]->ToObject()->Get(String::NewFromUtf8(iso, "status"));
+		if (status->IsInt32Array() && Local<Int32Array>::Cast(status)->Length() == rows) {
+			Local<Int32Array> arr = Local<Int32Array>::Cast(status);
+			job.status = arr->Length() ? (int32_t*)((char*)arr->Buffer()->GetContents().Data() + arr->ByteOffset()) : NULL;
+		}
+		else if (!status->IsUndefined()) {
+			iso->ThrowException(Exception::TypeError(String::NewFromUtf8(iso, "status must be an Int32Array the same length as the outputs")));
+			return;
+		}
+	}
+	for (size_t p = 0; p < graph.paramNames.size(); p++) {
+		Local<Value> val = params->Get(String::NewFromUtf8(iso, graph.paramNames[p].c_str()));
+		double* col = NULL;
+		bool isColumn = float64Data(val, &col, &len) && len == rows;
+		if (!isColumn && !val->IsNumber()) {
+			std::string msg = "Parameter " + graph.paramNames[p] + " must be a number or a Float64Array as long as the outputs";
+			iso->ThrowException(Exception::TypeError(String::NewFromUtf8(iso, msg.c_str())));
+			return;
+		}
+		job.paramColumns.push_back(isColumn ? col : NULL);
+		job.paramValues.push_back(isColumn ? 0 : val->NumberValue());
+	}
+
+	FluidScheduler::noteFluid(fluid);
+	EnginePool::instance()->run(&job);
+
+	if (job.failed()) {
+		iso->ThrowException(job.error(iso));
+		return;
+	}
+	args.GetReturnValue().Set(outputs);
+}
+
+void graphEvaluate(const FunctionCallbackInfo<Value>& args, const char* fluid) {
+	Isolate* iso = args.GetIsolate();
+	// args[0] is the graph, an array of nodes (see StateGraph).  args[1] holds the parameters by name.
+	// returns every node's state by name, all from one native call.
+	// with args[2], {node: {property: Float64Array}}, it's a batch instead: each parameter is a Float64Array
+	// with a value per row, or a number for every row, and row i of the outputs comes from row i of the
+	// parameters.  rows are spread over the engine pool like statePointBatch's.  args[3] can be {status},
+	// an Int32Array that gets each row's ierr.  with it, or in status mode, a row that fails gets NaN
+	// outputs instead of throwing, and a single evaluation returns {ierr, herr} for its failed node
+
+	if (args.Length() < 1) {
+		iso->ThrowException(Exception::TypeError(String::NewFromUtf8(iso, "Must provide a state graph")));
+		return;
+	}
+	if (!RefpropContext::instance(iso))
+		return;
+
+	Local<Object> params = args.Length() > 1 && args[1]->IsObject() ? args[1]->ToObject() : Object::New(iso);
+	if (args.Length() > 2 && args[2]->IsObject())
+		evaluateBatch(args, fluid, params);
+	else
+		evaluateOnce(args, fluid, params);
+}
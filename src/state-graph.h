@@ -0,0 +1,60 @@
+#ifndef NODE_REFPROP_STATE_GRAPH_H
+#define NODE_REFPROP_STATE_GRAPH_H
+
+#include <string>
+#include <vector>
+
+#include "node-refprop.h"
+
+// a sequence of states that feed each other, like the points around a refrigeration cycle.  each node
+// is flashed from an input pair whose values are arithmetic (+ - * / ^ and parentheses) over numbers,
+// named parameters and the properties of earlier nodes:
+//     [{name: 'evap', T: 'Te', Q: 1},
+//      {name: 'cond', T: 'Tc', Q: 0},
+//      {name: 'isen', P: 'cond.P', S: 'evap.S'},
+//      {name: 'comp', P: 'cond.P', H: 'evap.H + (isen.H - evap.H) / eta'},
+//      {name: 'valve', P: 'evap.P', H: 'cond.H'}]
+// the expressions compile to little stack programs up front, so evaluating the graph is nothing but
+// arithmetic and flashes, with no trips back to js in between
+class StateGraph {
+public:
+	// reads the nodes out of a js array.  false (with an exception thrown) if the graph doesn't make sense
+	bool compile(v8::Local<v8::Value> arg, RefpropContext* rp, v8::Isolate* iso);
+
+	// flashes every node in order, params in the order of paramNames.  states needs a slot per node.  on
+	// failure, returns ierr with herr saying which node failed and why
+	long evaluate(RefpropContext* rp, const double* params, ThermoState* states, char* herr);
+
+	int nodeIndex(const char* name);  // -1 if there's no such node
+
+	std::vector<std::string> nodeNames;
+	std::vector<std::string> paramNames;  // every parameter the expressions use, in order of first use
+	std::vector<PropertyMask> want;       // what each node has to compute: whatever later nodes read, plus outputs
+
+	static const int maxDepth = 32;  // deepest a program's stack can get
+
+private:
+	enum OpCode { OP_CONST, OP_PARAM, OP_PROP, OP_ADD, OP_SUB, OP_MUL, OP_DIV, OP_POW, OP_NEG };
+
+	struct Op {
+		OpCode code;
+		double value;  // OP_CONST
+		int a, b;      // the parameter, or the node and property
+	};
+
+	struct Node {
+		char props[2];
+		RefpropContext::FlashFcn flashFcn;
+		std::vector<Op> program[2];
+	};
+
+	std::vector<Node> nodes;
+
+	double run(const std::vector<Op>& program, const double* params, ThermoState* states);
+
+	// recursive descent over one expression, appending to program.  false and a message in err on a syntax error
+	struct Parser;
+	bool parse(const std::string& text, size_t node, std::vector<Op>* program, char* err);
+};
+
+#endif
@@ -0,0 +1,286 @@
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+#include <algorithm>
+
+#include "stats.h"
+
+using namespace v8;
+using namespace node;
+
+const char* Stats::pairNames[FluidStats::pairs] = {
+	"TP", "TD", "TH", "TS", "TE", "TQ", "PD", "PH", "PS", "PE", "PQ", "DH", "DS", "DE", "HS", "ES"
+};
+static const char* phaseNames[STATS_PHASES] = { "single", "two", "failed" };
+
+LatencyHistogram Stats::toJs;
+std::mutex Stats::mutex;
+std::map<std::string, std::unique_ptr<FluidStats>> Stats::fluids;
+std::map<long, unsigned long long> Stats::errors;
+std::atomic<unsigned long long> Stats::errorCounts[Stats::errorRange];
+
+static int highestBit(unsigned long long v) {
+#ifdef _MSC_VER
+	unsigned long idx;
+	_BitScanReverse64(&idx, v);
+	return (int)idx;
+#else
+	return 63 - __builtin_clzll(v);
+#endif
+}
+
+LatencyHistogram::LatencyHistogram() {
+	this->reset();
+}
+
+int LatencyHistogram::bucket(unsigned long long ns) {
+	if (ns < 8)
+		return (int)ns;
+	int e = highestBit(ns);
+	if (e >= 36)
+		return buckets - 1;
+	return (e - 2) * 8 + (int)((ns >> (e - 3)) & 7);
+}
+
+unsigned long long LatencyHistogram::bucketTop(int idx) {
+	if (idx < 8)
+		return idx;
+	int e = idx / 8 + 2;
+	return ((unsigned long long)(9 + idx % 8) << (e - 3)) - 1;
+}
+
+void LatencyHistogram::record(unsigned long long ns) {
+	this->counts[bucket(ns)].fetch_add(1, std::memory_order_relaxed);
+	this->total.fetch_add(1, std::memory_order_relaxed);
+	this->sumNs.fetch_add(ns, std::memory_order_relaxed);
+
+	unsigned long long max = this->maxNs.load(std::memory_order_relaxed);
+	while (ns > max && !this->maxNs.compare_exchange_weak(max, ns, std::memory_order_relaxed))
+		;
+}
+
+// not atomic as a whole: a flash finishing on another engine halfway through can leave a count behind
+void LatencyHistogram::reset() {
+	for (int i = 0; i < buckets; i++)
+		this->counts[i].store(0, std::memory_order_relaxed);
+	this->total.store(0, std::memory_order_relaxed);
+	this->sumNs.store(0, std::memory_order_relaxed);
+	this->maxNs.store(0, std::memory_order_relaxed);
+}
+
+unsigned long long LatencyHistogram::count() {
+	return this->total.load(std::memory_order_relaxed);
+}
+
+unsigned long long LatencyHistogram::sum() {
+	return this->sumNs.load(std::memory_order_relaxed);
+}
+
+double LatencyHistogram::percentile(double p) {
+	unsigned long long n = this->count();
+	if (n == 0)
+		return 0;
+
+	// the rank we're after, counting from 1
+	unsigned long long rank = (unsigned long long)(p / 100 * n + .5);
+	if (rank < 1)
+		rank = 1;
+
+	unsigned long long seen = 0;
+	for (int i = 0; i < buckets; i++) {
+		seen += this->counts[i].load(std::memory_order_relaxed);
+		if (seen >= rank)
+			return (double)std::min(bucketTop(i), this->maxNs.load(std::memory_order_relaxed));
+	}
+	return (double)this->maxNs.load(std::memory_order_relaxed);
+}
+
+Local<Object> LatencyHistogram::toJs(Isolate* iso) {
+	double n = (double)this->count();
+
+	Local<Object> obj = Object::New(iso);
+	obj->Set(String::NewFromUtf8(iso, "count"), Number::New(iso, n));
+	obj->Set(String::NewFromUtf8(iso, "meanNs"), Number::New(iso, n > 0 ? this->sum() / n : 0));
+	obj->Set(String::NewFromUtf8(iso, "p50Ns"), Number::New(iso, this->percentile(50)));
+	obj->Set(String::NewFromUtf8(iso, "p90Ns"), Number::New(iso, this->percentile(90)));
+	obj->Set(String::NewFromUtf8(iso, "p99Ns"), Number::New(iso, this->percentile(99)));
+	obj->Set(String::NewFromUtf8(iso, "maxNs"), Number::New(iso, (double)this->maxNs.load(std::memory_order_relaxed)));
+	return obj;
+}
+
+FlashStats::FlashStats() {
+	this->reset();
+}
+
+void FlashStats::reset() {
+	this->cached.store(0, std::memory_order_relaxed);
+	this->libraryNs.store(0, std::memory_order_relaxed);
+	this->solve.reset();
+	this->total.reset();
+}
+
+FluidStats::FluidStats() {
+	for (int i = 0; i < pairs; i++)
+		for (int j = 0; j < STATS_PHASES; j++)
+			this->flashes[i][j] = NULL;
+}
+
+FluidStats::~FluidStats() {
+	for (int i = 0; i < pairs; i++)
+		for (int j = 0; j < STATS_PHASES; j++)
+			delete this->flashes[i][j].load();
+}
+
+void FluidStats::recordFlash(int pair, StatsPhase phase, bool solved, unsigned long long solveNs, unsigned long long libraryNs, unsigned long long totalNs) {
+	if (pair < 0)
+		return;
+
+	// most fluids only ever see a few pairs, so their stats are made on demand.  two engines making
+	// the same ones at once just means one of them throws its copy away
+	FlashStats* stats = this->flashes[pair][phase].load(std::memory_order_acquire);
+	if (!stats) {
+		FlashStats* made = new FlashStats();
+		if (this->flashes[pair][phase].compare_exchange_strong(stats, made, std::memory_order_acq_rel))
+			stats = made;
+		else
+			delete made;
+	}
+
+	if (solved)
+		stats->solve.record(solveNs);
+	else
+		stats->cached.fetch_add(1, std::memory_order_relaxed);
+	stats->libraryNs.fetch_add(libraryNs, std::memory_order_relaxed);
+	stats->total.record(totalNs);
+}
+
+void FluidStats::reset() {
+	for (int i = 0; i < pairs; i++)
+		for (int j = 0; j < STATS_PHASES; j++) {
+			FlashStats* stats = this->flashes[i][j].load(std::memory_order_acquire);
+			if (stats)
+				stats->reset();
+		}
+	this->setup.reset();
+	this->transport.reset();
+}
+
+int Stats::pairSlot(const char props[2]) {
+	for (int i = 0; i < FluidStats::pairs; i++) {
+		const char* name = pairNames[i];
+		if ((name[0] == props[0] && name[1] == props[1]) || (name[0] == props[1] && name[1] == props[0]))
+			return i;
+	}
+	return -1;
+}
+
+FluidStats* Stats::fluid(const char* name) {
+	std::lock_guard<std::mutex> lock(mutex);
+	std::unique_ptr<FluidStats>& stats = fluids[name];
+	if (!stats)
+		stats.reset(new FluidStats());
+	return stats.get();
+}
+
+void Stats::recordError(long ierr) {
+	if (ierr >= -errorRange/2 && ierr < errorRange/2) {
+		errorCounts[ierr + errorRange/2].fetch_add(1, std::memory_order_relaxed);
+		return;
+	}
+
+	std::lock_guard<std::mutex> lock(mutex);
+	errors[ierr]++;
+}
+
+void Stats::reset() {
+	std::lock_guard<std::mutex> lock(mutex);
+	for (auto& fluid : fluids)
+		fluid.second->reset();
+	errors.clear();
+	for (long i = 0; i < errorRange; i++)
+		errorCounts[i].store(0, std::memory_order_relaxed);
+	toJs.reset();
+}
+
+void getStats(const FunctionCallbackInfo<Value>& args) {
+	Isolate* iso = args.GetIsolate();
+	// everything since the module loaded or the last resetStats, over every engine.  times are in ns.
+	// each flash splits into libraryNs, spent inside refprop, and bindingNs, spent in our own code
+	// around it; the totals at the top add toJs's marshalling to bindingNs
+	//  - flashes: one entry per fluid, input pair and phase ('single', 'two' or 'failed') that has
+	//    seen a call, with calls, cached (answered without a solve), libraryNs, bindingNs and the
+	//    solve and total histograms
+	//  - fluids: setup and transport histograms for each fluid
+	//  - toJs: the histogram for turning states into objects
+	//  - errors: how many flashes failed with each ierr
+	// a histogram is {count, meanNs, p50Ns, p90Ns, p99Ns, maxNs}
+
+	std::lock_guard<std::mutex> lock(Stats::mutex);
+
+	double libraryNs = 0, bindingNs = (double)Stats::toJs.sum();
+	Local<Array> flashes = Array::New(iso);
+	Local<Array> fluids = Array::New(iso);
+	uint32_t numFlashes = 0, numFluids = 0;
+
+	for (auto& fluid : Stats::fluids) {
+		Local<String> name = String::NewFromUtf8(iso, fluid.first.c_str());
+		FluidStats* fluidStats = fluid.second.get();
+
+		for (int i = 0; i < FluidStats::pairs; i++)
+			for (int j = 0; j < STATS_PHASES; j++) {
+				FlashStats* stats = fluidStats->flashes[i][j].load(std::memory_order_acquire);
+				if (!stats || stats->total.count() == 0)
+					continue;
+
+				double library = (double)stats->libraryNs.load(std::memory_order_relaxed);
+				double total = (double)stats->total.sum();
+				double binding = total > library ? total - library : 0;
+				libraryNs += library;
+				bindingNs += binding;
+
+				Local<Object> entry = Object::New(iso);
+				entry->Set(String::NewFromUtf8(iso, "fluid"), name);
+				entry->Set(String::NewFromUtf8(iso, "pair"), String::NewFromUtf8(iso, Stats::pairNames[i]));
+				entry->Set(String::NewFromUtf8(iso, "phase"), String::NewFromUtf8(iso, phaseNames[j]));
+				entry->Set(String::NewFromUtf8(iso, "calls"), Number::New(iso, (double)stats->total.count()));
+				entry->Set(String::NewFromUtf8(iso, "cached"), Number::New(iso, (double)stats->cached.load(std::memory_order_relaxed)));
+				entry->Set(String::NewFromUtf8(iso, "libraryNs"), Number::New(iso, library));
+				entry->Set(String::NewFromUtf8(iso, "bindingNs"), Number::New(iso, binding));
+				entry->Set(String::NewFromUtf8(iso, "solve"), stats->solve.toJs(iso));
+				entry->Set(String::NewFromUtf8(iso, "total"), stats->total.toJs(iso));
+				flashes->Set(numFlashes++, entry);
+			}
+
+		Local<Object> entry = Object::New(iso);
+		entry->Set(String::NewFromUtf8(iso, "fluid"), name);
+		entry->Set(String::NewFromUtf8(iso, "setup"), fluidStats->setup.toJs(iso));
+		entry->Set(String::NewFromUtf8(iso, "transport"), fluidStats->transport.toJs(iso));
+		fluids->Set(numFluids++, entry);
+	}
+
+	std::map<long, unsigned long long> counted(Stats::errors);
+	for (long i = 0; i < Stats::errorRange; i++) {
+		unsigned long long count = Stats::errorCounts[i].load(std::memory_order_relaxed);
+		if (count)
+			counted[i - Stats::errorRange/2] = count;
+	}
+
+	Local<Object> errors = Object::New(iso);
+	for (auto& error : counted)
+		errors->Set(Number::New(iso, (double)error.first)->ToString(), Number::New(iso, (double)error.second));
+
+	Local<Object> obj = Object::New(iso);
+	obj->Set(String::NewFromUtf8(iso, "libraryNs"), Number::New(iso, libraryNs));
+	obj->Set(String::NewFromUtf8(iso, "bindingNs"), Number::New(iso, bindingNs));
+	obj->Set(String::NewFromUtf8(iso, "flashes"), flashes);
+	obj->Set(String::NewFromUtf8(iso, "fluids"), fluids);
+	obj->Set(String::NewFromUtf8(iso, "toJs"), Stats::toJs.toJs(iso));
+	obj->Set(String::NewFromUtf8(iso, "errors"), errors);
+	args.GetReturnValue().Set(obj);
+}
+
+void resetStats(const FunctionCallbackInfo<Value>& args) {
+	Stats::reset();
+	args.GetReturnValue().Set(Undefined(args.GetIsolate()));
+}
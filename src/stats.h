@@ -0,0 +1,92 @@
+#ifndef NODE_REFPROP_STATS_H
+#define NODE_REFPROP_STATS_H
+
+#include <node.h>
+#include <atomic>
+#include <chrono>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+
+// latency histogram with hdr-style buckets: exact below 8ns, then 8 to every power of two, so a value
+// is never more than 12.5% off the top of its bucket.  recording is a handful of relaxed atomic adds,
+// cheap enough to leave on all the time, and safe from every engine's thread at once
+class LatencyHistogram {
+public:
+	LatencyHistogram();
+
+	void record(unsigned long long ns);
+	void reset();
+	unsigned long long count();
+	unsigned long long sum();
+	double percentile(double p);  // ns: the top of the bucket holding the pth percentile (0-100)
+	v8::Local<v8::Object> toJs(v8::Isolate* iso);
+
+	static const int buckets = 272;  // up to 2^36ns, about a minute; anything longer goes in the last one
+
+private:
+	std::atomic<unsigned long long> counts[buckets];
+	std::atomic<unsigned long long> total, sumNs, maxNs;
+
+	static int bucket(unsigned long long ns);
+	static unsigned long long bucketTop(int idx);
+};
+
+// how a flash came out, for splitting its stats
+enum StatsPhase { STATS_ONE_PHASE, STATS_TWO_PHASE, STATS_FAILED, STATS_PHASES };
+
+// one input pair in one phase of one fluid.  solve is the flash routine alone; total is the whole of
+// RefpropContext::flash, so whatever isn't libraryNs is ours (cache and table lookups, unit conversions)
+struct FlashStats {
+	std::atomic<unsigned long long> cached;  // answered by the flash cache or a property table, without a solve
+	std::atomic<unsigned long long> libraryNs;  // the solve plus transport properties and derivatives
+	LatencyHistogram solve, total;
+
+	FlashStats();
+	void reset();
+};
+
+// everything for one fluid string.  never freed, so engines can hold on to theirs without a lock
+struct FluidStats {
+	static const int pairs = 16;
+
+	std::atomic<FlashStats*> flashes[pairs][STATS_PHASES];  // made the first time they're needed
+	LatencyHistogram setup;      // SETUPdll/SETMIXdll whenever an engine switches to the fluid
+	LatencyHistogram transport;  // transport properties and derivatives, when a flash needed the library for them
+
+	FluidStats();
+	~FluidStats();
+	void recordFlash(int pair, StatsPhase phase, bool solved, unsigned long long solveNs, unsigned long long libraryNs, unsigned long long totalNs);
+	void reset();
+};
+
+// the registry behind getStats
+class Stats {
+public:
+	static const char* pairNames[FluidStats::pairs];
+	static int pairSlot(const char props[2]);  // where the pair's stats go, whichever order it comes in; -1 if it isn't one
+
+	static FluidStats* fluid(const char* name);  // made the first time a fluid is asked for
+	static void recordError(long ierr);
+	static LatencyHistogram toJs;  // ThermoState::toJs, the marshalling half of statePoint
+	static void reset();
+
+	static unsigned long long now() {
+		return (unsigned long long)std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+	}
+
+	// refprop's ierrs are small numbers, so nearly every one gets a relaxed atomic add in errorCounts
+	// rather than the lock; anything outside the range goes in errors
+	static const long errorRange = 1024;  // ierrs from -errorRange/2 up to errorRange/2 - 1
+	static std::atomic<unsigned long long> errorCounts[errorRange];
+
+	static std::mutex mutex;  // guards fluids and errors
+	static std::map<std::string, std::unique_ptr<FluidStats>> fluids;
+	static std::map<long, unsigned long long> errors;  // by ierr
+};
+
+void getStats(const v8::FunctionCallbackInfo<v8::Value>& args);
+void resetStats(const v8::FunctionCallbackInfo<v8::Value>& args);
+
+#endif
@@ -1,51 +1,300 @@
+#include <math.h>
+#include <algorithm>
+
 #include "node-refprop.h"
+#include "flash-cache.h"
+#include "property-table.h"
+#include "engine-pool.h"
+#include "disk-cache.h"
+#include "broker.h"
 
 using namespace v8;
 using namespace node;
 
+static const char* propertyNames[PROP_COUNT] = {
+	"T", "P", "Z", "D", "DL", "DV", "X", "Y", "Q",
+	"E", "H", "S", "CV", "CP", "W",
+	"k", "mu", "kL", "kV", "muL", "muV",
+	"CPL", "CPV", "CVL", "CVV", "sigma",
+	"dPdD", "dPdT", "dDdT", "dDdP", "d2PdD2", "d2PdT2", "d2PdTdD",
+	"JT", "kappaT", "beta", "kappaS", "isenK"
+};
+
+// what each property is measured in: the specific SI units statePoint reports
+static const char* propertyUnits[PROP_COUNT] = {
+	"K", "Pa", "mol/mol", "kg/m3", "kg/m3", "kg/m3", "mol/mol", "mol/mol", "-",
+	"J/kg", "J/kg", "J/(kg K)", "J/(kg K)", "J/(kg K)", "m/s",
+	"W/(m K)", "Pa s", "W/(m K)", "W/(m K)", "Pa s", "Pa s",
+	"J/(kg K)", "J/(kg K)", "J/(kg K)", "J/(kg K)", "N/m",
+	"Pa m3/kg", "Pa/K", "kg/(m3 K)", "kg/(m3 Pa)", "Pa m6/kg2", "Pa/K2", "Pa m3/(kg K)",
+	"K/Pa", "1/Pa", "1/K", "1/Pa", "-"
+};
+
+// the order results have always listed their properties in
+static const int flashProperties[] = { PROP_CP, PROP_CV, PROP_D, PROP_DL, PROP_DV, PROP_E, PROP_H, PROP_P, PROP_Q, PROP_S, PROP_T, PROP_W, PROP_X, PROP_Y, PROP_Z };
+static const int onePhaseProperties[] = { PROP_k, PROP_mu };
+static const int twoPhaseProperties[] = { PROP_kL, PROP_muL, PROP_kV, PROP_muV, PROP_CPL, PROP_CVL, PROP_CPV, PROP_CVV, PROP_sigma };
+
+#define countOf(a) (sizeof(a) / sizeof((a)[0]))
+
+// results are stamped out of these templates so they all share a handful of hidden classes, and the keys
+// are internalized once rather than made fresh for every result.  every shape has the flash properties;
+// the phase shapes add all of that phase's transport properties, in the usual order.  handles belong to
+// an isolate, so each js thread makes its own
+enum ResultShape { FLASH_ONLY, ONE_PHASE, TWO_PHASE, SHAPE_COUNT };
+static thread_local Persistent<String> propertyKeys[PROP_COUNT];
+static thread_local Persistent<ObjectTemplate> resultTemplates[SHAPE_COUNT];
+
+Local<String> propertyKey(Isolate* iso, int idx) {
+	if (propertyKeys[idx].IsEmpty())
+		propertyKeys[idx].Reset(iso, String::NewFromUtf8(iso, propertyNames[idx], String::kInternalizedString));
+	return Local<String>::New(iso, propertyKeys[idx]);
+}
+
+void releaseResultTemplates() {
+	for (int i = 0; i < PROP_COUNT; i++)
+		propertyKeys[i].Reset();
+	for (int i = 0; i < SHAPE_COUNT; i++)
+		resultTemplates[i].Reset();
+}
+
+static Local<ObjectTemplate> resultTemplate(Isolate* iso, ResultShape shape) {
+	if (resultTemplates[shape].IsEmpty()) {
+		Local<ObjectTemplate> tpl = ObjectTemplate::New(iso);
+		for (size_t i = 0; i < countOf(flashProperties); i++)
+			tpl->Set(propertyKey(iso, flashProperties[i]), Number::New(iso, 0));
+		if (shape == ONE_PHASE)
+			for (size_t i = 0; i < countOf(onePhaseProperties); i++)
+				tpl->Set(propertyKey(iso, onePhaseProperties[i]), Number::New(iso, 0));
+		if (shape == TWO_PHASE)
+			for (size_t i = 0; i < countOf(twoPhaseProperties); i++)
+				tpl->Set(propertyKey(iso, twoPhaseProperties[i]), Number::New(iso, 0));
+		resultTemplates[shape].Reset(iso, tpl);
+	}
+	return Local<ObjectTemplate>::New(iso, resultTemplates[shape]);
+}
+
+ThermoState::ThermoState() {
+	memset(this, 0, sizeof(ThermoState));
+	this->trnprp.clear();
+	this->derivs.clear();
+}
+
+int ThermoState::propertyIndex(const char* name) {
+	for (int i = 0; i < PROP_COUNT; i++)
+		if (strcmp(propertyNames[i], name) == 0)
+			return i;
+	return -1;
+}
+
+const char* ThermoState::propertyUnit(int idx) {
+	return propertyUnits[idx];
+}
+
+PropertyMask ThermoState::phaseTransport() {
+	return (this->Q > 1 || this->Q < 0) ? onePhaseTransportMask : twoPhaseTransportMask;
+}
+
+double ThermoState::property(int idx) {
+	switch (idx) {
+		case PROP_T: return this->T;
+		case PROP_P: return this->P;
+		case PROP_Z: return this->Z[0];
+		case PROP_D: return this->D;
+		case PROP_DL: return this->DL;
+		case PROP_DV: return this->DV;
+		case PROP_X: return this->X[0];
+		case PROP_Y: return this->Y[0];
+		case PROP_Q: return this->Q;
+		case PROP_E: return this->E;
+		case PROP_H: return this->H;
+		case PROP_S: return this->S;
+		case PROP_CV: return this->CV;
+		case PROP_CP: return this->CP;
+		case PROP_W: return this->W;
+	}
+	if (idx >= PROP_dPdD)
+		return this->derivs.property(idx);
+	return this->trnprp.property(idx);
+}
+
+// compositions are plain numbers for pure fluids, as they always have been, and arrays of mole fractions
+// for mixtures
+static Local<Value> compositionToJs(Isolate* iso, const double* x, long nc) {
+	if (nc <= 1)
+		return Number::New(iso, x[0]);
+
+	Local<Array> arr = Array::New(iso, nc);
+	for (long i = 0; i < nc; i++)
+		arr->Set(i, Number::New(iso, x[i]));
+	return arr;
+}
+
+// the other way, for lazyTransport.  returns the number of components
+static long compositionFromJs(Local<Value> val, double* x) {
+	if (!val->IsArray()) {
+		x[0] = val->NumberValue();
+		return 1;
+	}
+
+	Local<Array> arr = Local<Array>::Cast(val);
+	long nc = std::min((long)arr->Length(), (long)ncmax);
+	for (long i = 0; i < nc; i++)
+		x[i] = arr->Get(i)->NumberValue();
+	return nc;
+}
+
+// getter for a transport property toJs left for later.  the accessor data has what it takes to rebuild
+// the state, and remembers each value once it's been worked out
+static void lazyTransport(Local<String> name, const PropertyCallbackInfo<Value>& info) {
+	Isolate* iso = info.GetIsolate();
+	Broker::Session session;
+	Local<Object> data = info.Data()->ToObject();
+
+	Local<Value> known = data->Get(name);
+	if (!known->IsUndefined()) {
+		info.GetReturnValue().Set(known);
+		return;
+	}
+
+	ThermoState state;
+	state.T = data->Get(propertyKey(iso, PROP_T))->NumberValue();
+	state.Q = data->Get(propertyKey(iso, PROP_Q))->NumberValue();
+	state.nc = compositionFromJs(data->Get(propertyKey(iso, PROP_Z)), state.Z);
+	compositionFromJs(data->Get(propertyKey(iso, PROP_X)), state.X);
+	compositionFromJs(data->Get(propertyKey(iso, PROP_Y)), state.Y);
+	state.D = data->Get(propertyKey(iso, PROP_D))->NumberValue();
+	state.DL = data->Get(propertyKey(iso, PROP_DL))->NumberValue();
+	state.DV = data->Get(propertyKey(iso, PROP_DV))->NumberValue();
+	state.molarMass = data->Get(String::NewFromUtf8(iso, "molarMass"))->NumberValue();
+
+	String::Utf8Value fluid(data->Get(String::NewFromUtf8(iso, "fluid")));
+	String::Utf8Value prop(name);
+	int idx = ThermoState::propertyIndex(*prop);
+
+	if (!RefpropContext::instance(iso))
+		return;
+	RefpropContext* rp = EnginePool::instance()->engineFor(*fluid);
+	RefpropLock lock(rp, true);
+
+	if (rp->loadFluid(*fluid) != 0 || rp->completeState(&state, propertyBit(idx)) > 0) {
+		iso->ThrowException(Exception::TypeError(String::NewFromUtf8(iso, rp->errorMessage())));
+		return;
+	}
+
+	// one refprop call gives a couple of properties at once, so hang on to its neighbours as well
+	PropertyMask found = state.computed & state.phaseTransport();
+	for (int i = PROP_k; i < PROP_COUNT; i++)
+		if (found & propertyBit(i))
+			data->Set(propertyKey(iso, i), Number::New(iso, state.property(i)));
+	info.GetReturnValue().Set(data->Get(name));
+}
+
 // there should just be a way to return the thermostate object itself, but i haven't found it yet.
-Local<Object> ThermoState::toJs(Isolate* iso) {
-	Local<Object> obj = Object::New(iso);
-	obj->Set(String::NewFromUtf8(iso, "CP"), Number::New( iso, this->CP ));
-	obj->Set(String::NewFromUtf8(iso, "CV"), Number::New( iso, this->CV ));
-	obj->Set(String::NewFromUtf8(iso, "D"), Number::New( iso, this->D ));
-	obj->Set(String::NewFromUtf8(iso, "DL"), Number::New( iso, this->DL ));
-	obj->Set(String::NewFromUtf8(iso, "DV"), Number::New( iso, this->DV ));
-	obj->Set(String::NewFromUtf8(iso, "E"), Number::New( iso, this->E ));
-	obj->Set(String::NewFromUtf8(iso, "H"), Number::New( iso, this->H ));
-	obj->Set(String::NewFromUtf8(iso, "P"), Number::New( iso, this->P ));
-	obj->Set(String::NewFromUtf8(iso, "Q"), Number::New( iso, this->Q ));
-	obj->Set(String::NewFromUtf8(iso, "S"), Number::New( iso, this->S ));
-	obj->Set(String::NewFromUtf8(iso, "T"), Number::New( iso, this->T ));
-	obj->Set(String::NewFromUtf8(iso, "W"), Number::New( iso, this->W ));
-	obj->Set(String::NewFromUtf8(iso, "X"), Number::New( iso, this->X ));
-	obj->Set(String::NewFromUtf8(iso, "Y"), Number::New( iso, this->Y ));
-	obj->Set(String::NewFromUtf8(iso, "Z"), Number::New( iso, this->Z ));
-
-	this->trnprp->append(obj, iso);
+Local<Object> ThermoState::toJs(Isolate* iso, PropertyMask want, const char* lazyFluid) {
+	unsigned long long start = Stats::now();
+	PropertyMask phase = this->phaseTransport();
+	PropertyMask known = want & phase & this->computed;
+
+	const int* transportProperties = phase == onePhaseTransportMask ? onePhaseProperties : twoPhaseProperties;
+	size_t transportCount = phase == onePhaseTransportMask ? countOf(onePhaseProperties) : countOf(twoPhaseProperties);
+
+	// the usual full result fills in a phase template; anything less appends to the flash-only one, always
+	// in the same order, so those share hidden classes too
+	ResultShape shape = FLASH_ONLY;
+	if (known == phase)
+		shape = phase == onePhaseTransportMask ? ONE_PHASE : TWO_PHASE;
+
+	Local<Object> obj = resultTemplate(iso, shape)->NewInstance();
+	for (size_t i = 0; i < countOf(flashProperties); i++)
+		obj->Set(propertyKey(iso, flashProperties[i]), Number::New(iso, this->property(flashProperties[i])));
+	if (this->nc > 1) {
+		obj->Set(propertyKey(iso, PROP_X), compositionToJs(iso, this->X, this->nc));
+		obj->Set(propertyKey(iso, PROP_Y), compositionToJs(iso, this->Y, this->nc));
+		obj->Set(propertyKey(iso, PROP_Z), compositionToJs(iso, this->Z, this->nc));
+	}
+	for (size_t i = 0; i < transportCount; i++)
+		if (known & propertyBit(transportProperties[i]))
+			obj->Set(propertyKey(iso, transportProperties[i]), Number::New(iso, this->property(transportProperties[i])));
+
+	// derivatives only ever show up when they're asked for, so they needn't be in the templates
+	PropertyMask derivatives = want & derivativeMask & this->computed;
+	for (int i = PROP_dPdD; derivatives && i < PROP_COUNT; i++)
+		if (derivatives & propertyBit(i))
+			obj->Set(propertyKey(iso, i), Number::New(iso, this->property(i)));
+
+	PropertyMask lazy = lazyFluid ? want & phase & ~this->computed : 0;
+	if (lazy) {
+		Local<Object> data = Object::New(iso);
+		data->Set(String::NewFromUtf8(iso, "fluid"), String::NewFromUtf8(iso, lazyFluid));
+		data->Set(propertyKey(iso, PROP_T), Number::New(iso, this->T));
+		data->Set(propertyKey(iso, PROP_Q), Number::New(iso, this->Q));
+		data->Set(propertyKey(iso, PROP_Z), compositionToJs(iso, this->Z, this->nc));
+		data->Set(propertyKey(iso, PROP_X), compositionToJs(iso, this->X, this->nc));
+		data->Set(propertyKey(iso, PROP_Y), compositionToJs(iso, this->Y, this->nc));
+		data->Set(propertyKey(iso, PROP_D), Number::New(iso, this->D));
+		data->Set(propertyKey(iso, PROP_DL), Number::New(iso, this->DL));
+		data->Set(propertyKey(iso, PROP_DV), Number::New(iso, this->DV));
+		data->Set(String::NewFromUtf8(iso, "molarMass"), Number::New(iso, this->molarMass));
+
+		for (size_t i = 0; i < transportCount; i++)
+			if (lazy & propertyBit(transportProperties[i]))
+				obj->SetAccessor(propertyKey(iso, transportProperties[i]), lazyTransport, 0, data);
+	}
 
+	Stats::toJs.record(Stats::now() - start);
 	return obj;
 }
 
-void OnePhaseTransport::append(v8::Local<v8::Object> obj, v8::Isolate* iso) {
-	obj->Set(String::NewFromUtf8(iso, "k"), Number::New( iso, this->k ));
-	obj->Set(String::NewFromUtf8(iso, "mu"), Number::New( iso, this->mu ));
+void TransportProps::clear() {
+	this->k = this->mu = NAN;
+	this->kL = this->kV = this->muL = this->muV = NAN;
+	this->CPL = this->CPV = this->CVL = this->CVV = NAN;
+	this->sigma = NAN;
 }
 
-void TwoPhaseTransport::append(v8::Local<v8::Object> obj, v8::Isolate* iso) {
-	obj->Set(String::NewFromUtf8(iso, "kL"), Number::New( iso, this->kL ));
-	obj->Set(String::NewFromUtf8(iso, "muL"), Number::New( iso, this->muL ));
-	obj->Set(String::NewFromUtf8(iso, "kV"), Number::New( iso, this->kV ));
-	obj->Set(String::NewFromUtf8(iso, "muV"), Number::New( iso, this->muV ));
+void Derivatives::clear() {
+	this->dPdD = this->dPdT = this->dDdT = this->dDdP = NAN;
+	this->d2PdD2 = this->d2PdT2 = this->d2PdTdD = NAN;
+	this->JT = this->kappaT = this->beta = this->kappaS = this->isenK = NAN;
+}
 
-	obj->Set(String::NewFromUtf8(iso, "CPL"), Number::New( iso, this->CPL ));
-	obj->Set(String::NewFromUtf8(iso, "CVL"), Number::New( iso, this->CVL ));
-	obj->Set(String::NewFromUtf8(iso, "CPV"), Number::New( iso, this->CPV ));
-	obj->Set(String::NewFromUtf8(iso, "CVV"), Number::New( iso, this->CVV ));
+double Derivatives::property(int idx) {
+	switch (idx) {
+		case PROP_dPdD: return this->dPdD;
+		case PROP_dPdT: return this->dPdT;
+		case PROP_dDdT: return this->dDdT;
+		case PROP_dDdP: return this->dDdP;
+		case PROP_d2PdD2: return this->d2PdD2;
+		case PROP_d2PdT2: return this->d2PdT2;
+		case PROP_d2PdTdD: return this->d2PdTdD;
+		case PROP_JT: return this->JT;
+		case PROP_kappaT: return this->kappaT;
+		case PROP_beta: return this->beta;
+		case PROP_kappaS: return this->kappaS;
+		case PROP_isenK: return this->isenK;
+	}
+	return NAN;
+}
 
-	obj->Set(String::NewFromUtf8(iso, "sigma"), Number::New( iso, this->sigma ));
+double TransportProps::property(int idx) {
+	switch (idx) {
+		case PROP_k: return this->k;
+		case PROP_mu: return this->mu;
+		case PROP_kL: return this->kL;
+		case PROP_kV: return this->kV;
+		case PROP_muL: return this->muL;
+		case PROP_muV: return this->muV;
+		case PROP_CPL: return this->CPL;
+		case PROP_CPV: return this->CPV;
+		case PROP_CVL: return this->CVL;
+		case PROP_CVV: return this->CVV;
+		case PROP_sigma: return this->sigma;
+	}
+	return NAN;
 }
 
+
 // refprop's units:
 /* temperature                     K
  * pressure, fugacity              kPa
@@ -65,14 +314,69 @@ void TwoPhaseTransport::append(v8::Local<v8::Object> obj, v8::Isolate* iso) {
  * surface tension                 N/m
 */
 
-ThermoState* RefpropContext::thermoState() {
-	ThermoState *obj = new ThermoState();
-	// assume pure fluid
-	obj->X = 0; obj->Y = 0;
-	obj->Z = 1;
-	this->WMOLdll(&(obj->X), obj->molarMass);
+// resets a state so it can be (re)used for a flash, at the caller's composition or the fluid's own
+long RefpropContext::initState(ThermoState* obj, const Composition* comp) {
+	obj->trnprp.clear();
+	obj->derivs.clear();
+	obj->computed = 0;
+	this->ierr = 0;
+
+	obj->nc = this->nc;
+	memset(obj->X, 0, sizeof(obj->X));
+	memset(obj->Y, 0, sizeof(obj->Y));
+
+	// the fluid's own composition only needs its molar mass looked up once
+	if (!comp || comp->n == 0) {
+		memcpy(obj->Z, this->composition, sizeof(obj->Z));
+		if (!(this->fluidMolarMass > 0))
+			this->WMOLdll(obj->Z, this->fluidMolarMass);
+		obj->molarMass = this->fluidMolarMass;
+		return 0;
+	}
+	else {
+		if (comp->n != this->nc) {
+			this->ierr = 1;
+			snprintf(this->herr, sizeof(this->herr), "Composition has %ld fractions, but the fluid has %ld components", comp->n, this->nc);
+			return this->ierr;
+		}
 
-	return obj;
+		// fractions that don't quite add up (rounded ones, say) get scaled to add up; refprop won't do it for us
+		double sum = 0;
+		for (long i = 0; i < comp->n; i++) {
+			if (!(comp->x[i] >= 0)) {
+				this->ierr = 1;
+				strcpy(this->herr, "Composition fractions can't be negative");
+				return this->ierr;
+			}
+			sum += comp->x[i];
+		}
+		if (!(sum > 0)) {
+			this->ierr = 1;
+			strcpy(this->herr, "Composition fractions add up to nothing");
+			return this->ierr;
+		}
+
+		double x[ncmax] = {0};
+		for (long i = 0; i < comp->n; i++)
+			x[i] = comp->x[i] / sum;
+
+		// a batch usually has the same composition row after row, so the last one's mole fractions and
+		// molar mass are kept rather than asked for again on every flash, cache hits included
+		if (comp->mass != this->lastMassBasis || memcmp(x, this->lastFractions, sizeof(x)) != 0) {
+			memset(this->lastZ, 0, sizeof(this->lastZ));
+			if (comp->mass)
+				this->XMOLEdll(x, this->lastZ, this->lastMolarMass);
+			else {
+				memcpy(this->lastZ, x, sizeof(this->lastZ));
+				this->WMOLdll(this->lastZ, this->lastMolarMass);
+			}
+			memcpy(this->lastFractions, x, sizeof(x));
+			this->lastMassBasis = comp->mass;
+		}
+		memcpy(obj->Z, this->lastZ, sizeof(obj->Z));
+		obj->molarMass = this->lastMolarMass;
+	}
+	return 0;
 }
 
 // for these, molar mass is g/mol
@@ -90,14 +394,62 @@ void RefpropContext::toMolar(ThermoState *obj) {
 	obj->P /= 1e3;
 }
 
-ThermoState* RefpropContext::doFlash(const char props[2], const double vals[2], Isolate* iso) {
+// flashes into obj, which can live on the caller's stack.  false if it threw
+bool RefpropContext::doFlash(const char props[2], const double vals[2], ThermoState* obj, Isolate* iso, PropertyMask want,
+		const Composition* comp, const FlashGuess* guess) {
 	// look up the provided properties into the lookup table
 	FlashFcn flashFcn = flashFcnLookup(props, iso);
 
 	if (NULL == flashFcn)
-		iso->ThrowException(Exception::TypeError(String::NewFromUtf8(iso, "Property combination not supported!")));
+		return false;
+
+	// a composition that doesn't fit the fluid is the caller's mistake, not refprop's
+	if (this->initState(obj, comp) != 0 || (this->flash(flashFcn, props, vals, obj, want, guess) > 0 && !statusErrors)) {
+		iso->ThrowException(Exception::TypeError(String::NewFromUtf8(iso, this->herr)));
+		return false;
+	}
+	return true;
+}
+
+long RefpropContext::flash(FlashFcn flashFcn, const char props[2], const double vals[2], ThermoState* obj, PropertyMask want, const FlashGuess* guess) {
+	unsigned long long start = Stats::now();
+	this->solved = false;
+	this->solveNs = this->libraryNs = 0;
+	long ierr = this->flashState(flashFcn, props, vals, obj, want, guess);
+
+	if (this->stats) {
+		StatsPhase phase = ierr > 0 ? STATS_FAILED : (obj->Q >= 0 && obj->Q <= 1) ? STATS_TWO_PHASE : STATS_ONE_PHASE;
+		this->stats->recordFlash(Stats::pairSlot(props), phase, this->solved, this->solveNs, this->libraryNs, Stats::now() - start);
+	}
+	if (ierr != 0)
+		Stats::recordError(ierr);
+	return ierr;
+}
+
+long RefpropContext::flashState(FlashFcn flashFcn, const char props[2], const double vals[2], ThermoState* obj, PropertyMask want, const FlashGuess* guess) {
+	// anything the fluid's interpolation table can answer never gets as far as a flash.  derivatives
+	// aren't tabulated, but they're one call away once we have T and D
+	PropertyTable* table = this->propertyTable();
+	if (table && table->lookup(props, vals, obj))
+		return this->completeState(obj, want);
+
+	// nor does a state we've already flashed, though it may have been flashed for fewer optional properties
+	bool keep = !guess || guess->keep;
+	if (this->cache->lookup(props, vals, obj)) {
+		PropertyMask had = obj->computed;
+		if (this->completeState(obj, want) == 0 && obj->computed != had && keep)
+			this->cache->store(props, vals, obj);
+		return this->ierr;
+	}
+
+	// then the disk cache, which earlier runs and other processes fill
+	DiskCache* disk = DiskCache::active;
+	if (disk && disk->lookup(this->signature, props, vals, obj)) {
+		if (this->completeState(obj, want) == 0 && keep)
+			this->cache->store(props, vals, obj);
+		return this->ierr;
+	}
 
-	ThermoState *obj = this->thermoState();
 	// now stuff the provided values into the thermostate structure
 	for (int i=0; i < 2; i++) {
 		switch(props[i]) { // TPDHSEQ
@@ -127,12 +479,191 @@ ThermoState* RefpropContext::doFlash(const char props[2], const double vals[2],
 
 	// convert qtys to molar, call the flash function, then bring the qtys back to specific
 	this->toMolar(obj);
-	(this->*flashFcn)(obj);
-	this->doTransport(obj);
+	unsigned long long start = Stats::now();
+	if (!guess || !this->singlePhaseFlash(props, obj, guess))
+		(this->*flashFcn)(obj);
+	this->solved = true;
+	this->solveNs = Stats::now() - start;
+	this->libraryNs = this->solveNs;
+	// skip transport for a failed flash; it would only overwrite the flash's ierr.  a warning's state is
+	// still good, so it gets its transport properties and keeps the warning unless they fail outright
+	if (this->ierr <= 0) {
+		long warning = this->ierr;
+		char message[errormessagelength+1];
+		if (warning != 0)
+			strcpy(message, this->herr);
+		this->fillState(obj, want);
+		if (warning != 0 && this->ierr == 0) {
+			this->ierr = warning;
+			strcpy(this->herr, message);
+		}
+	}
 	this->toSpecific(obj);
-	if (this->ierr != 0)
-		iso->ThrowException(Exception::TypeError(String::NewFromUtf8(iso, this->herr)));
-	return obj;
+
+	// a hint nobody checked might have been wrong, so it's only good for this one call
+	if (this->ierr == 0 && keep && !(guess && guess->phase != PHASE_UNKNOWN && !guess->check)) {
+		this->cache->store(props, vals, obj);
+		if (disk)
+			disk->store(this->signature, props, vals, obj);
+	}
+	return this->ierr;
+}
+
+// flash() leaves states in specific units, and the densities are all doTransport and doDerivatives need
+// converted.  put the originals back afterwards rather than converting twice, so the flash properties come
+// back bit for bit
+long RefpropContext::completeState(ThermoState* obj, PropertyMask want) {
+	this->ierr = 0;
+	if (!(want & (transportMask | derivativeMask) & ~obj->computed))
+		return 0;
+
+	double D = obj->D, DL = obj->DL, DV = obj->DV;
+	obj->D /= obj->molarMass;
+	obj->DL /= obj->molarMass;
+	obj->DV /= obj->molarMass;
+	this->fillState(obj, want);
+	obj->D = D;
+	obj->DL = DL;
+	obj->DV = DV;
+
+	return this->ierr;
+}
+
+// the input that goes with P in the pairs singlePhaseFlash can solve, or 0 for any other pair
+static char singlePhasePair(const char props[2]) {
+	char other = props[0] == 'P' ? props[1] : props[1] == 'P' ? props[0] : 0;
+	return (other == 'H' || other == 'S' || other == 'D' || other == 'T') ? other : 0;
+}
+
+bool RefpropContext::singlePhaseFlash(const char props[2], ThermoState* obj, const FlashGuess* guess) {
+	char other = singlePhasePair(props);
+
+	// two-phase states have no density worth starting from
+	const ThermoState* near = guess->near;
+	if (near && ((near->Q >= 0 && near->Q <= 1) || !(near->T > 0) || !(near->D > 0)))
+		near = NULL;
+
+	// without a hint, the phase is near's, and that always gets checked.  checking a mixture would need
+	// its bubble and dew points
+	PhaseHint phase = guess->phase;
+	if (phase == PHASE_UNKNOWN && near)
+		phase = near->Q < 0 ? PHASE_LIQUID : PHASE_VAPOR;
+	bool check = guess->check || guess->phase == PHASE_UNKNOWN;
+	if (!other || phase == PHASE_UNKNOWN || (check && this->nc > 1))
+		return false;
+
+	long kph = phase == PHASE_LIQUID ? 1 : 2;  // supercritical takes the vapor root
+	double T = near ? near->T : 0, D = near ? near->D / obj->molarMass : 0, P = obj->P;
+	long ierr = 0;
+	char herr[errormessagelength+1];
+
+	// the FL1 routines and TPRHO start from the T and D they're handed; zeros leave the guess to them
+	switch (other) {
+		case 'H':
+			this->PHFL1dll(P, obj->H, obj->Z, kph, T, D, ierr, herr, errormessagelength);
+			break;
+		case 'S':
+			this->PSFL1dll(P, obj->S, obj->Z, kph, T, D, ierr, herr, errormessagelength);
+			break;
+		case 'D':
+			D = obj->D;
+			this->PDFL1dll(P, D, obj->Z, T, ierr, herr, errormessagelength);
+			break;
+		case 'T': {
+			long kguess = near ? 1 : 0;
+			T = obj->T;
+			this->TPRHOdll(T, P, obj->Z, kph, kguess, D, ierr, herr, errormessagelength);
+			break;
+		}
+	}
+	if (ierr != 0 || !(T > 0) || !(D > 0))
+		return false;
+
+	double Q;
+	if (!check)
+		Q = phase == PHASE_LIQUID ? -998 : phase == PHASE_VAPOR ? 998 : 999;
+	else if (phase == PHASE_SUPERCRITICAL) {
+		// past the critical point is easy to tell without a saturation point
+		if (!this->critical() || (T < this->Tcrit && P < this->Pcrit))
+			return false;
+		Q = T >= this->Tcrit ? 999 : -998;
+	}
+	else {
+		// a wrong hint, or a path that's crossed into the dome, needs the full flash to find out where it is
+		Q = this->singlePhase(T, P, other == 'T' ? 'T' : 'P');
+		if (Q == 0 || (T < this->Tcrit && P < this->Pcrit && (Q < 0) != (kph == 1)))
+			return false;
+	}
+
+	double hjt;
+	this->THERMdll(T, D, obj->Z, P, obj->E, obj->H, obj->S, obj->CV, obj->CP, obj->W, hjt);
+	obj->T = T;
+	obj->P = P;
+	obj->D = obj->DL = obj->DV = D;
+	obj->Q = Q;
+	memcpy(obj->X, obj->Z, sizeof(obj->X));
+	memcpy(obj->Y, obj->Z, sizeof(obj->Y));
+	this->ierr = 0;
+	return true;
+}
+
+bool RefpropContext::critical() {
+	if (this->Tcrit == 0) {
+		double Dcrit;
+		long ierr = 0;
+		char herr[errormessagelength+1];
+		this->CRITPdll(this->composition, this->Tcrit, this->Pcrit, Dcrit, ierr, herr, errormessagelength);
+		if (ierr != 0)
+			this->Tcrit = 0;
+	}
+	return this->Tcrit != 0;
+}
+
+double RefpropContext::singlePhase(double T, double P, char held) {
+	if (!this->critical())
+		return 0;
+	if (T >= this->Tcrit)
+		return 999;
+	if (P >= this->Pcrit)
+		return -998;
+
+	// the saturation point at whichever of T and P the path holds, which a path at constant pressure (or
+	// temperature) only ever needs once
+	double value = held == 'T' ? T : P;
+	if (held != this->satHeld || value != this->satValue) {
+		double z[ncmax] = { 1 }, x[ncmax], y[ncmax], Tsat, Psat, DL, DV;
+		long kph = 1, ierr = 0;
+		char herr[errormessagelength+1];
+		if (held == 'T') {
+			Tsat = T;
+			this->SATTdll(Tsat, z, kph, Psat, DL, DV, x, y, ierr, herr, errormessagelength);
+		}
+		else {
+			Psat = P;
+			this->SATPdll(Psat, z, kph, Tsat, DL, DV, x, y, ierr, herr, errormessagelength);
+		}
+		if (ierr != 0)
+			return 0;
+		this->satHeld = held;
+		this->satValue = value;
+		this->satOther = held == 'T' ? Psat : Tsat;
+	}
+
+	if (held == 'T')
+		return P > this->satOther ? -998 : P < this->satOther ? 998 : 0;
+	return T < this->satOther ? -998 : T > this->satOther ? 998 : 0;
+}
+
+const char* RefpropContext::errorMessage() {
+	return this->herr;
+}
+
+long RefpropContext::errorCode() {
+	return this->ierr;
+}
+
+unsigned long long RefpropContext::lastSolveNs() {
+	return this->solved ? this->solveNs : 0;
 }
 
 void RefpropContext::toSpecific(ThermoState *obj) {
@@ -150,102 +681,195 @@ void RefpropContext::toSpecific(ThermoState *obj) {
 }
 
 void RefpropContext::calcTP(ThermoState* obj) {
-	this->TPFLSHdll(obj->T,obj->P,&(obj->Z),obj->D,obj->DL,obj->DV,&(obj->X),&(obj->Y),obj->Q,obj->E,obj->H,obj->S,obj->CV,obj->CP,obj->W,this->ierr,this->herr,errormessagelength);
+	this->TPFLSHdll(obj->T,obj->P,obj->Z,obj->D,obj->DL,obj->DV,obj->X,obj->Y,obj->Q,obj->E,obj->H,obj->S,obj->CV,obj->CP,obj->W,this->ierr,this->herr,errormessagelength);
 }
 
 void RefpropContext::calcTD(ThermoState* obj) {
-	this->TDFLSHdll(obj->T,obj->D,&(obj->Z),obj->P,obj->DL,obj->DV,&(obj->X),&(obj->Y),obj->Q,obj->E,obj->H,obj->S,obj->CV,obj->CP,obj->W,this->ierr,this->herr,errormessagelength);
+	this->TDFLSHdll(obj->T,obj->D,obj->Z,obj->P,obj->DL,obj->DV,obj->X,obj->Y,obj->Q,obj->E,obj->H,obj->S,obj->CV,obj->CP,obj->W,this->ierr,this->herr,errormessagelength);
 }
 
 void RefpropContext::calcTH(ThermoState* obj) {
 	long kr;
-	this->THFLSHdll(obj->T,obj->H,&(obj->Z),kr,obj->P,obj->D,obj->DL,obj->DV,&(obj->X),&(obj->Y),obj->Q,obj->E,obj->S,obj->CV,obj->CP,obj->W,this->ierr,this->herr,errormessagelength);
+	this->THFLSHdll(obj->T,obj->H,obj->Z,kr,obj->P,obj->D,obj->DL,obj->DV,obj->X,obj->Y,obj->Q,obj->E,obj->S,obj->CV,obj->CP,obj->W,this->ierr,this->herr,errormessagelength);
 }
 
 void RefpropContext::calcTS(ThermoState* obj) {
 	long kr;
-	this->TSFLSHdll(obj->T,obj->S,&(obj->Z),kr,obj->P,obj->D,obj->DL,obj->DV,&(obj->X),&(obj->Y),obj->Q,obj->E,obj->H,obj->CV,obj->CP,obj->W,this->ierr,this->herr,errormessagelength);
+	this->TSFLSHdll(obj->T,obj->S,obj->Z,kr,obj->P,obj->D,obj->DL,obj->DV,obj->X,obj->Y,obj->Q,obj->E,obj->H,obj->CV,obj->CP,obj->W,this->ierr,this->herr,errormessagelength);
 }
 
 void RefpropContext::calcTE(ThermoState* obj) {
 	long kr;
-	this->TEFLSHdll(obj->T,obj->E,&(obj->Z),kr,obj->P,obj->D,obj->DL,obj->DV,&(obj->X),&(obj->Y),obj->Q,obj->H,obj->S,obj->CV,obj->CP,obj->W,this->ierr,this->herr,errormessagelength);
+	this->TEFLSHdll(obj->T,obj->E,obj->Z,kr,obj->P,obj->D,obj->DL,obj->DV,obj->X,obj->Y,obj->Q,obj->H,obj->S,obj->CV,obj->CP,obj->W,this->ierr,this->herr,errormessagelength);
 }
 
 void RefpropContext::calcPD(ThermoState* obj) {
-	this->PDFLSHdll(obj->P,obj->D,&(obj->Z),obj->T,obj->DL,obj->DV,&(obj->X),&(obj->Y),obj->Q,obj->E,obj->H,obj->S,obj->CV,obj->CP,obj->W,this->ierr,this->herr,errormessagelength);
+	this->PDFLSHdll(obj->P,obj->D,obj->Z,obj->T,obj->DL,obj->DV,obj->X,obj->Y,obj->Q,obj->E,obj->H,obj->S,obj->CV,obj->CP,obj->W,this->ierr,this->herr,errormessagelength);
 }
 
 void RefpropContext::calcPH(ThermoState* obj) {
-	this->PHFLSHdll(obj->P,obj->H,&(obj->Z),obj->T,obj->D,obj->DL,obj->DV,&(obj->X),&(obj->Y),obj->Q,obj->E,obj->S,obj->CV,obj->CP,obj->W,this->ierr,this->herr,errormessagelength);
+	this->PHFLSHdll(obj->P,obj->H,obj->Z,obj->T,obj->D,obj->DL,obj->DV,obj->X,obj->Y,obj->Q,obj->E,obj->S,obj->CV,obj->CP,obj->W,this->ierr,this->herr,errormessagelength);
 }
 void RefpropContext::calcPS(ThermoState* obj) {
-	this->PSFLSHdll(obj->P,obj->S,&(obj->Z),obj->T,obj->D,obj->DL,obj->DV,&(obj->X),&(obj->Y),obj->Q,obj->E,obj->H,obj->CV,obj->CP,obj->W,this->ierr,this->herr,errormessagelength);
+	this->PSFLSHdll(obj->P,obj->S,obj->Z,obj->T,obj->D,obj->DL,obj->DV,obj->X,obj->Y,obj->Q,obj->E,obj->H,obj->CV,obj->CP,obj->W,this->ierr,this->herr,errormessagelength);
 }
 
 void RefpropContext::calcPE(ThermoState* obj) {
-	this->PEFLSHdll(obj->P,obj->E,&(obj->Z),obj->T,obj->D,obj->DL,obj->DV,&(obj->X),&(obj->Y),obj->Q,obj->H,obj->S,obj->CV,obj->CP,obj->W,this->ierr,this->herr,errormessagelength);
+	this->PEFLSHdll(obj->P,obj->E,obj->Z,obj->T,obj->D,obj->DL,obj->DV,obj->X,obj->Y,obj->Q,obj->H,obj->S,obj->CV,obj->CP,obj->W,this->ierr,this->herr,errormessagelength);
 }
 
 void RefpropContext::calcHS(ThermoState* obj) {
-	this->HSFLSHdll(obj->H,obj->S,&(obj->Z),obj->T,obj->P,obj->D,obj->DL,obj->DV,&(obj->X),&(obj->Y),obj->Q,obj->E,obj->CV,obj->CP,obj->W,this->ierr,this->herr,errormessagelength);
+	this->HSFLSHdll(obj->H,obj->S,obj->Z,obj->T,obj->P,obj->D,obj->DL,obj->DV,obj->X,obj->Y,obj->Q,obj->E,obj->CV,obj->CP,obj->W,this->ierr,this->herr,errormessagelength);
 }
 
 void RefpropContext::calcES(ThermoState* obj) {
-	this->ESFLSHdll(obj->E,obj->S,&(obj->Z),obj->T,obj->P,obj->D,obj->DL,obj->DV,&(obj->X),&(obj->Y),obj->Q,obj->H,obj->CV,obj->CP,obj->W,this->ierr,this->herr,errormessagelength);
+	this->ESFLSHdll(obj->E,obj->S,obj->Z,obj->T,obj->P,obj->D,obj->DL,obj->DV,obj->X,obj->Y,obj->Q,obj->H,obj->CV,obj->CP,obj->W,this->ierr,this->herr,errormessagelength);
 }
 
 void RefpropContext::calcDH(ThermoState* obj) {
-	this->DHFLSHdll(obj->D,obj->H,&(obj->Z),obj->T,obj->P,obj->DL,obj->DV,&(obj->X),&(obj->Y),obj->Q,obj->E,obj->S,obj->CV,obj->CP,obj->W,this->ierr,this->herr,errormessagelength);
+	this->DHFLSHdll(obj->D,obj->H,obj->Z,obj->T,obj->P,obj->DL,obj->DV,obj->X,obj->Y,obj->Q,obj->E,obj->S,obj->CV,obj->CP,obj->W,this->ierr,this->herr,errormessagelength);
 }
 
 void RefpropContext::calcDS(ThermoState* obj) {
-	this->DSFLSHdll(obj->D,obj->S,&(obj->Z),obj->T,obj->P,obj->DL,obj->DV,&(obj->X),&(obj->Y),obj->Q,obj->E,obj->H,obj->CV,obj->CP,obj->W,this->ierr,this->herr,errormessagelength);
+	this->DSFLSHdll(obj->D,obj->S,obj->Z,obj->T,obj->P,obj->DL,obj->DV,obj->X,obj->Y,obj->Q,obj->E,obj->H,obj->CV,obj->CP,obj->W,this->ierr,this->herr,errormessagelength);
 }
 
 void RefpropContext::calcDE(ThermoState* obj) {
-	this->DEFLSHdll(obj->D,obj->E,&(obj->Z),obj->T,obj->P,obj->DL,obj->DV,&(obj->X),&(obj->Y),obj->Q,obj->H,obj->S,obj->CV,obj->CP,obj->W,this->ierr,this->herr,errormessagelength);
+	this->DEFLSHdll(obj->D,obj->E,obj->Z,obj->T,obj->P,obj->DL,obj->DV,obj->X,obj->Y,obj->Q,obj->H,obj->S,obj->CV,obj->CP,obj->W,this->ierr,this->herr,errormessagelength);
 }
 
 void RefpropContext::calcTQ(ThermoState* obj) {
 	long kq;
-	this->TQFLSHdll(obj->T,obj->Q,&(obj->Z),kq,obj->P,obj->D,obj->DL,obj->DV,&(obj->X),&(obj->Y),obj->E,obj->H,obj->S,obj->CV,obj->CP,obj->W,this->ierr,this->herr,errormessagelength);
+	this->TQFLSHdll(obj->T,obj->Q,obj->Z,kq,obj->P,obj->D,obj->DL,obj->DV,obj->X,obj->Y,obj->E,obj->H,obj->S,obj->CV,obj->CP,obj->W,this->ierr,this->herr,errormessagelength);
 }
 
 void RefpropContext::calcPQ(ThermoState* obj) {
 	long kq;
-	this->PQFLSHdll(obj->P,obj->Q,&(obj->Z),kq,obj->T,obj->D,obj->DL,obj->DV,&(obj->X),&(obj->Y),obj->E,obj->H,obj->S,obj->CV,obj->CP,obj->W,this->ierr,this->herr,errormessagelength);
+	this->PQFLSHdll(obj->P,obj->Q,obj->Z,kq,obj->T,obj->D,obj->DL,obj->DV,obj->X,obj->Y,obj->E,obj->H,obj->S,obj->CV,obj->CP,obj->W,this->ierr,this->herr,errormessagelength);
 }
 
-void RefpropContext::doTransport(ThermoState* state) {
+void RefpropContext::doTransport(ThermoState* state, PropertyMask want) {
 	// relevant refprop units:
 	// viscosity                       microPa.s (10^-6 Pa.s)
-	if (state->Q > 1 || state->Q < 0) {
-		OnePhaseTransport *trns = new OnePhaseTransport();
+	// only makes the refprop calls behind properties in want that the state doesn't have yet.  the ones
+	// that don't apply to the phase are known from the start: they're NaN
+	PropertyMask need = want & ~state->computed;
 
-		this->TRNPRPdll(state->T,state->D,&(state->Z),trns->mu,trns->k,this->ierr,this->herr,errormessagelength);
-		trns->mu *= 1e-6;
+	TransportProps *trns = &state->trnprp;
 
-		state->trnprp = trns;
+	// each side of the dome at its own composition.  refprop only bothers with those for mixtures
+	double* x = state->nc > 1 ? state->X : state->Z;
+	double* y = state->nc > 1 ? state->Y : state->Z;
+
+	if (state->Q > 1 || state->Q < 0) {
+		state->computed |= twoPhaseTransportMask;
+
+		if (need & onePhaseTransportMask) {
+			this->TRNPRPdll(state->T,state->D,state->Z,trns->mu,trns->k,this->ierr,this->herr,errormessagelength);
+			trns->mu *= 1e-6;
+			state->computed |= onePhaseTransportMask;
+		}
 	}
 	else {
-		TwoPhaseTransport *trns = new TwoPhaseTransport();
+		state->computed |= onePhaseTransportMask;
 
-		this->TRNPRPdll(state->T,state->DL,&(state->Z),trns->muL,trns->kL,this->ierr,this->herr,errormessagelength);
-		trns->muL *= 1e-6;
-		this->TRNPRPdll(state->T,state->DV,&(state->Z),trns->muV,trns->kV,this->ierr,this->herr,errormessagelength);
-		trns->muV *= 1e-6;
-		this->SURTENdll(state->T,state->DL,state->DV,&(state->Z),&(state->Z),trns->sigma,this->ierr,this->herr,errormessagelength);
-
-		this->CVCPdll(state->T,state->DL,&(state->Z),trns->CVL,trns->CPL);
-		this->CVCPdll(state->T,state->DV,&(state->Z),trns->CVV,trns->CPV);
+		if (need & (propertyBit(PROP_kL) | propertyBit(PROP_muL))) {
+			this->TRNPRPdll(state->T,state->DL,x,trns->muL,trns->kL,this->ierr,this->herr,errormessagelength);
+			trns->muL *= 1e-6;
+			state->computed |= propertyBit(PROP_kL) | propertyBit(PROP_muL);
+		}
+		if (need & (propertyBit(PROP_kV) | propertyBit(PROP_muV))) {
+			this->TRNPRPdll(state->T,state->DV,y,trns->muV,trns->kV,this->ierr,this->herr,errormessagelength);
+			trns->muV *= 1e-6;
+			state->computed |= propertyBit(PROP_kV) | propertyBit(PROP_muV);
+		}
+		if (need & propertyBit(PROP_sigma)) {
+			this->SURTENdll(state->T,state->DL,state->DV,x,y,trns->sigma,this->ierr,this->herr,errormessagelength);
+			state->computed |= propertyBit(PROP_sigma);
+		}
 
 		// convert from molar-specific to mass-specifc heats
-		trns->CPL /= state->molarMass * 1e-3;
-		trns->CVL /= state->molarMass * 1e-3;
-		trns->CPV /= state->molarMass * 1e-3;
-		trns->CVV /= state->molarMass * 1e-3;
+		if (need & (propertyBit(PROP_CPL) | propertyBit(PROP_CVL))) {
+			this->CVCPdll(state->T,state->DL,x,trns->CVL,trns->CPL);
+			trns->CPL /= state->molarMass * 1e-3;
+			trns->CVL /= state->molarMass * 1e-3;
+			state->computed |= propertyBit(PROP_CPL) | propertyBit(PROP_CVL);
+		}
+		if (need & (propertyBit(PROP_CPV) | propertyBit(PROP_CVV))) {
+			this->CVCPdll(state->T,state->DV,y,trns->CVV,trns->CPV);
+			trns->CPV /= state->molarMass * 1e-3;
+			trns->CVV /= state->molarMass * 1e-3;
+			state->computed |= propertyBit(PROP_CPV) | propertyBit(PROP_CVV);
+		}
+	}
+}
+
+// the transport properties and derivatives in want, with the time it takes counted as the library's
+void RefpropContext::fillState(ThermoState* state, PropertyMask want) {
+	bool needed = (want & (transportMask | derivativeMask) & ~state->computed) != 0;
+	unsigned long long start = Stats::now();
+	this->doTransport(state, want);
+	this->doDerivatives(state, want);
+
+	unsigned long long ns = Stats::now() - start;
+	this->libraryNs += ns;
+	if (needed && this->stats)
+		this->stats->transport.record(ns);
+}
+
+void RefpropContext::doDerivatives(ThermoState* state, PropertyMask want) {
+	// relevant refprop units:
+	// d(p)/d(rho)                     kPa.L/mol
+	// d2(p)/d(rho)2                   kPa.(L/mol)^2
+	// Joule-Thompson coefficient      K/kPa
+	// mol/L times g/mol is kg/m3, which is where all the molar masses below come from
+	PropertyMask need = want & derivativeMask & ~state->computed;
+	if (!need)
+		return;
+	state->computed |= need;
+
+	if (state->Q >= 0 && state->Q <= 1)
+		return;
+
+	Derivatives *d = &state->derivs;
+	double mm = state->molarMass;
+	PropertyMask firstOrder = propertyBit(PROP_dPdD) | propertyBit(PROP_dPdT) | propertyBit(PROP_dDdT);
+
+	// the three first derivatives have cheap routines of their own; anything more is worth one THERM2
+	if (!(need & ~firstOrder & ~(propertyBit(PROP_kappaS) | propertyBit(PROP_isenK)))) {
+		if (need & propertyBit(PROP_dPdD)) {
+			this->DPDDdll(state->T,state->D,state->Z,d->dPdD);
+			d->dPdD *= 1e3 / mm;
+		}
+		if (need & propertyBit(PROP_dPdT)) {
+			this->DPDTdll(state->T,state->D,state->Z,d->dPdT);
+			d->dPdT *= 1e3;
+		}
+		if (need & propertyBit(PROP_dDdT)) {
+			this->DDDTdll(state->T,state->D,state->Z,d->dDdT);
+			d->dDdT *= mm;
+		}
+	}
+	else {
+		double p, e, h, s, cv, cp, w, Z, A, G, spare3, spare4;
+		this->THERM2dll(state->T,state->D,state->Z,p,e,h,s,cv,cp,w,&Z,d->JT,A,G,d->kappaT,d->beta,
+			d->dPdD,d->d2PdD2,d->dPdT,d->dDdT,d->dDdP,d->d2PdT2,d->d2PdTdD,spare3,spare4);
+
+		d->dPdD *= 1e3 / mm;
+		d->d2PdD2 *= 1e3 / (mm * mm);
+		d->dPdT *= 1e3;
+		d->dDdT *= mm;
+		d->dDdP *= mm / 1e3;
+		d->d2PdT2 *= 1e3;
+		d->d2PdTdD *= 1e3 / mm;
+		d->JT /= 1e3;
+		d->kappaT /= 1e3;
+		state->computed |= derivativeMask & ~(propertyBit(PROP_kappaS) | propertyBit(PROP_isenK));
+	}
 
-		state->trnprp = trns;
+	if (need & (propertyBit(PROP_kappaS) | propertyBit(PROP_isenK))) {
+		double kappa, beta, kt, bs, kkt, thrott, pint, spht;
+		this->THERM3dll(state->T,state->D,state->Z,kappa,beta,d->isenK,kt,d->kappaS,bs,kkt,thrott,pint,spht);
+		d->kappaS /= 1e3;
 	}
 }
@@ -1,8 +1,21 @@
 var refprop = require('node-refprop');
 var should = require('should');
 var assert = require('assert');
+var os = require('os');
+var path = require('path');
+var fs = require('fs');
 
 describe('refprop', function() {	
+	// has to come first, while nothing has picked a fluid
+	it('should refuse to flash before a fluid is chosen', function() {
+		(function() {
+			refprop.statePoint({T: 273.15, P: 101.3e3});
+		}).should.throw(/setFluid/);
+		(function() {
+			refprop.statePointBatch('TP', new Float64Array([273.15]), new Float64Array([101.3e3]), {D: new Float64Array(1)});
+		}).should.throw(/setFluid/);
+	});
+
 	it('should load without error', function() {
 		assert.equal(refprop.setFluid('R134A'), undefined);
 	});
@@ -13,6 +26,16 @@ describe('refprop', function() {
 		}).should.throw();
 	});
 	
+	it('should report where the library and fluid files are', function() {
+		var paths = refprop.setPaths();
+		paths.should.have.properties(['library', 'fluids']);
+
+		(function() {
+			refprop.setPaths({library: 'elsewhere'});
+		}).should.throw();
+		refprop.setPaths().should.be.eql(paths);
+	});
+	
 	it('should compute single-phase states for pure fluids', function() {
 		refprop.setFluid('nitrogen');
 		
@@ -44,8 +67,632 @@ describe('refprop', function() {
 		result.kL.should.be.approximately(.12056, .00001);
 		result.kV.should.be.approximately(9.6201e-3, .0001);
 	});
+
+	it('should only compute the transport properties asked for', function() {
+		refprop.setFluid('isobutan');
+
+		var result = refprop.statePoint({T: 220, Q: .5}, ['H', 'kL']);
+		result.H.should.be.approximately(284.90e3, .01e3);
+		result.kL.should.be.approximately(.12056, .00001);
+		result.should.not.have.properties(['kV', 'muV', 'CPL', 'sigma']);
+
+		var lazy = refprop.statePoint({T: 220, Q: .5}, {lazy: true});
+		lazy.CPL.should.be.approximately(2.0413e3, .0001e3);
+		lazy.kV.should.be.approximately(9.6201e-3, .0001);
+
+		(function() {
+			refprop.statePoint({T: 220, Q: .5}, ['enthalpy']);
+		}).should.throw();
+	});
+
+	it('should compute analytic derivatives with the state', function() {
+		refprop.setFluid('nitrogen');
+
+		var result = refprop.statePointWithDerivatives({T: 273.15, P: 101.3e3});
+		result.H.should.be.approximately(283.23e3, .01e3);
+		result.dPdD.should.be.approximately(296.8 * 273.15, 300);
+		result.dDdT.should.be.approximately(-result.dPdT / result.dPdD, 1e-6);
+		result.kappaT.should.be.approximately(1 / (result.D * result.dPdD), 1e-9);
+
+		var T = new Float64Array([273.15]), P = new Float64Array([101.3e3]), dPdT = new Float64Array(1);
+		refprop.statePointBatch('TP', T, P, {dPdT: dPdT});
+		dPdT[0].should.be.approximately(result.dPdT, 1e-6);
+
+		refprop.statePoint({T: 273.15, P: 101.3e3}).should.not.have.property('dPdD');
+	});
+
+	it('should build every result of a phase with the same shape', function() {
+		refprop.setFluid('nitrogen');
+
+		var a = refprop.statePoint({T: 273.15, P: 101.3e3}), b = refprop.statePoint({T: 300, P: 200e3});
+		Object.keys(a).should.be.eql(Object.keys(b));
+		Object.keys(a).should.be.eql(["CP","CV","D","DL","DV","E","H","P","Q","S","T","W","X","Y","Z","k","mu"]);
+	});
+
+	it('should compute batches of states into typed arrays', function() {
+		refprop.setFluid('nitrogen');
+		
+		var T = new Float64Array([273.15, 273.15]), P = new Float64Array([101.3e3, 101.3e3]);
+		var out = {H: new Float64Array(2), D: new Float64Array(2), mu: new Float64Array(2), kL: new Float64Array(2)};
+		refprop.statePointBatch('TP', T, P, out);
+		
+		for (var i = 0; i < 2; i++) {
+			out.H[i].should.be.approximately(283.23e3, .01e3);
+			out.D[i].should.be.approximately(1.2501, .0001);
+			out.kL[i].should.be.NaN;
+		}
+		
+		(function() {
+			refprop.statePointBatch('TP', T, new Float64Array(1), out);
+		}).should.throw();
+	});
+
+	it('should take empty batches as a no-op', function() {
+		refprop.setFluid('nitrogen');
+		
+		var empty = new Float64Array(0), out = {D: new Float64Array(0)};
+		refprop.statePointBatch('TP', empty, empty, out);
+		out.D.length.should.be.eql(0);
+	});
 	
-	it.skip('should compute states for pre-defined mixtures', function() {
+	it('should walk paths starting each state from the last', function() {
+		refprop.setFluid('nitrogen');
+
+		// down an isobar from inside the dome well out into the vapor
+		var liquid = refprop.statePoint({P: 101.3e3, Q: 0}), vapor = refprop.statePoint({P: 101.3e3, Q: 1});
+		var n = 200, P = new Float64Array(n).fill(101.3e3), H = new Float64Array(n);
+		for (var i = 0; i < n; i++)
+			H[i] = (liquid.H + vapor.H) / 2 + i * (vapor.H - liquid.H + 200e3) / n;
+
+		var cold = {T: new Float64Array(n), D: new Float64Array(n), Q: new Float64Array(n)};
+		var warm = {T: new Float64Array(n), D: new Float64Array(n), Q: new Float64Array(n)};
+		refprop.statePointBatch('PH', P, H, cold);
+		refprop.statePointBatch('PH', P, H, warm, {trajectory: true});
+		for (var i = 0; i < n; i++) {
+			warm.T[i].should.be.approximately(cold.T[i], 1e-6 * cold.T[i]);
+			warm.D[i].should.be.approximately(cold.D[i], 1e-6 * cold.D[i]);
+			(warm.Q[i] > 1).should.be.eql(cold.Q[i] > 1);
+		}
+	});
+
+	it('should take a phase hint', function() {
+		refprop.setFluid('nitrogen');
+
+		var full = refprop.statePoint({P: 101.3e3, H: 300e3});
+		var hinted = refprop.statePoint({P: 101.3e3, H: 300e3, phase: 'vapor'});
+		hinted.T.should.be.approximately(full.T, 1e-6 * full.T);
+		hinted.D.should.be.approximately(full.D, 1e-6 * full.D);
+		refprop.statePoint({P: 101.3e3, H: 300e3, phase: 'vapor', checkPhase: false}).T.should.be.approximately(full.T, 1e-6 * full.T);
+
+		// a wrong hint falls back to the full flash
+		refprop.statePoint({T: 300, P: 101.3e3, phase: 'liquid'}).Q.should.be.above(1);
+		(function() { refprop.statePoint({T: 300, P: 101.3e3, phase: 'steam'}); }).should.throw();
+	});
+
+	it('should spread batches over several engines', function() {
+		refprop.setFluid('nitrogen');
+		refprop.setEngines(4).should.be.eql(4);
+		
+		var n = 1000, T = new Float64Array(n), P = new Float64Array(n), H = new Float64Array(n);
+		for (var i = 0; i < n; i++) {
+			T[i] = 273.15;
+			P[i] = 101.3e3;
+		}
+		refprop.statePointBatch('TP', T, P, {H: H});
+		for (var i = 0; i < n; i++)
+			H[i].should.be.approximately(283.23e3, .01e3);
+		
+		refprop.setEngines(1).should.be.eql(1);
+	});
+	
+	it('should answer repeated states from the cache', function() {
+		refprop.setFluid('nitrogen');
+		refprop.setCacheSize(100);
+		
+		var before = refprop.getCacheStats();
+		var first = refprop.statePoint({T: 273.15, P: 101.3e3});
+		var second = refprop.statePoint({P: 101.3e3, T: 273.15});
+		var after = refprop.getCacheStats();
+		
+		second.should.be.eql(first);
+		(after.hits - before.hits).should.be.eql(1);
+		(after.misses - before.misses).should.be.eql(1);
+		
+		refprop.setFluid('isobutan');
+		refprop.getCacheStats().entries.should.be.eql(0);
+		refprop.setCacheSize(0);
+	});
+
+	it('should keep flashes on disk between runs', function() {
+		var file = path.join(os.tmpdir(), 'node-refprop-test.cache');
+		if (fs.existsSync(file))
+			fs.unlinkSync(file);
+		refprop.setFluid('nitrogen');
+
+		refprop.setDiskCache(file, {entries: 1000});
+		var first = refprop.statePoint({T: 250.5, P: 2.5e6});
+		var stats = refprop.getCacheStats().disk;
+		stats.stores.should.be.eql(1);
+		stats.capacity.should.be.eql(1024);
+
+		// a new cache object on the same file, as a restarted process would have
+		refprop.setDiskCache(null);
+		refprop.setDiskCache(file);
+		refprop.statePoint({T: 250.5, P: 2.5e6}).should.be.eql(first);
+		stats = refprop.getCacheStats().disk;
+		stats.hits.should.be.eql(1);
+		stats.stores.should.be.eql(0);
+
+		refprop.setDiskCache(null);
+		should(refprop.getCacheStats().disk).be.eql(undefined);
+		fs.unlinkSync(file);
+	});
+
+	it('should report failed flashes as status codes when asked', function() {
+		refprop.setFluid('nitrogen');
+		refprop.setErrorMode('status').should.be.eql('throw');
+
+		var failed = refprop.statePoint({T: -1, P: 101.3e3});
+		failed.ierr.should.be.above(0);
+		failed.herr.should.be.type('string');
+		should(failed.H).be.eql(undefined);
+		refprop.statePoint({T: 273.15, P: 101.3e3}).ierr.should.be.eql(0);
+
+		var T = new Float64Array([273.15, -1, 300]), P = new Float64Array([101.3e3, 101.3e3, 101.3e3]);
+		var H = new Float64Array(3), status = new Int32Array(3);
+		refprop.statePointBatch('TP', T, P, {H: H}, {status: status});
+		status[0].should.be.eql(0);
+		status[1].should.be.above(0);
+		isNaN(H[1]).should.be.eql(true);
+		H[2].should.be.above(H[0]);
+
+		refprop.setErrorMode('throw').should.be.eql('status');
+		(function() { refprop.statePoint({T: -1, P: 101.3e3}); }).should.throw();
+		(function() { refprop.setErrorMode('quietly'); }).should.throw();
+	});
+
+	it('should keep stats on every flash', function() {
+		refprop.setFluid('nitrogen');
+		refprop.resetStats();
+
+		refprop.statePoint({T: 273.15, P: 101.3e3});
+		refprop.statePoint({T: 77, Q: .5});
+		(function() { refprop.statePoint({T: -1, P: 101.3e3}); }).should.throw();
+
+		var stats = refprop.getStats();
+		var single = stats.flashes.filter(function(f) { return f.fluid == 'nitrogen' && f.pair == 'TP' && f.phase == 'single'; })[0];
+		single.calls.should.be.eql(1);
+		single.solve.count.should.be.eql(1);
+		(single.total.maxNs >= single.solve.maxNs).should.be.eql(true);
+		stats.flashes.some(function(f) { return f.pair == 'TQ' && f.phase == 'two'; }).should.be.eql(true);
+		stats.flashes.some(function(f) { return f.pair == 'TP' && f.phase == 'failed'; }).should.be.eql(true);
+		Object.keys(stats.errors).length.should.be.above(0);
+		stats.toJs.count.should.be.eql(2);
+		stats.libraryNs.should.be.above(0);
+		stats.bindingNs.should.be.above(0);
+
+		refprop.resetStats();
+		refprop.getStats().toJs.count.should.be.eql(0);
+	});
+
+	it('should interpolate states from a property table', function() {
+		refprop.setFluid('nitrogen');
+		var exact = refprop.statePoint({P: 101.3e3, H: 283.23e3});
+		
+		var table = refprop.buildTable({inputs: 'PH', P: [50e3, 200e3, 61], H: [250e3, 320e3, 71]});
+		table.cells.should.be.eql(60 * 70);
+		
+		var result = refprop.statePoint({P: 101.3e3, H: 283.23e3});
+		result.T.should.be.approximately(exact.T, .01);
+		result.D.should.be.approximately(exact.D, .0001);
+		result.mu.should.be.approximately(exact.mu, 1e-8);
+		
+		var T = new Float64Array(1);
+		refprop.statePointBatch('HP', new Float64Array([283.23e3]), new Float64Array([101.3e3]), {T: T});
+		T[0].should.be.approximately(exact.T, .01);
+		
+		refprop.dropTable();
+	});
+	
+	it('should compute states asynchronously', function() {
+		refprop.setFluidAsync('nitrogen');
+		
+		return Promise.all([
+			refprop.statePointAsync({T: 273.15, P: 101.3e3}),
+			refprop.statePointAsync({T: 273.15, P: 101.3e3})
+		]).then(function(results) {
+			results.forEach(function(result) {
+				result.H.should.be.approximately(283.23e3, .01e3);
+				result.D.should.be.approximately(1.2501, .0001);
+			});
+		});
+	});
+	
+	it('should reject failed asynchronous requests', function() {
+		return refprop.setFluidAsync('urine').then(function() {
+			throw new Error('loaded an invalid fluid');
+		}, function(err) {
+			err.should.be.an.Error;
+		});
+	});
+	
+	it('should reject asynchronous flashes in a fluid that won\'t load, even in status mode', function() {
+		refprop.setErrorMode('status');
+		var loading = refprop.setFluidAsync('urine'), flashing = refprop.statePointAsync({T: 273.15, P: 101.3e3});
+		refprop.setErrorMode('throw');
+
+		return Promise.all([loading, flashing].map(function(promise) {
+			return promise.then(function(result) {
+				throw new Error('resolved with ' + JSON.stringify(result));
+			}, function(err) {
+				err.should.be.an.Error;
+			});
+		}));
+	});
+
+	it('should keep flashing in the last fluid that loaded', function() {
+		return refprop.setFluidAsync('nitrogen').then(function() {
+			return refprop.setFluidAsync('urine');
+		}).then(function() {
+			throw new Error('loaded an invalid fluid');
+		}, function() {
+			return refprop.statePointAsync({T: 273.15, P: 101.3e3});
+		}).then(function(result) {
+			result.D.should.be.approximately(1.2501, .0001);
+		});
+	});
+
+	it('should stream rows through in chunks', function(done) {
+		refprop.setFluid('nitrogen');
+		var exact = refprop.statePoint({T: 273.15, P: 101.3e3});
+
+		var flash = refprop.createFlashStream({inputs: 'TP', outputs: ['H', 'D'], chunkRows: 2});
+		var rows = [];
+		flash.on('data', function(row) {
+			rows.push(row);
+		});
+		flash.on('end', function() {
+			rows.length.should.be.eql(5);
+			rows[0].H.should.be.approximately(exact.H, .01);
+			rows[1].D.should.be.approximately(exact.D, 1e-6);
+			rows[2].id.should.be.eql('a');
+			rows[2].H.should.be.approximately(exact.H, .01);
+			rows[3].should.have.property('error');
+			rows[4].should.have.property('error');
+			done();
+		});
+
+		flash.write({T: 273.15, P: 101.3e3});
+		flash.write([273.15, 101.3e3]);
+		flash.write('id,T,P\na,273.15,101300\n');
+		flash.write('b,-1,101300\n');
+		flash.end('c,hot,101300\n');
+	});
+
+	it('should keep a stream to two chunks in flight, however rows arrive', function(done) {
+		(function() {
+			refprop.createFlashStream({inputs: 'TT'});
+		}).should.throw();
+
+		var flash = refprop.createFlashStream({inputs: 'TP', outputs: ['D'], chunkRows: 1});
+		var batch = flash.target.statePointBatchAsync, live = 0, most = 0, rows = 0;
+		flash.target = {statePointBatchAsync: function() {
+			most = Math.max(most, ++live);
+			return batch.apply(refprop, arguments).then(function() {
+				live--;
+			});
+		}};
+		flash.on('data', function() {
+			rows++;
+		});
+		flash.on('end', function() {
+			rows.should.be.eql(6);
+			most.should.be.eql(2);
+			done();
+		});
+
+		refprop.setFluid('nitrogen');
+		flash.end('T,P\n273.15,101300\n280,101300\n290,101300\n300,101300\n310,101300\n320,101300\n');
+	});
+
+	it('should flash for other processes through a shared ring', function() {
+		if (process.platform == 'win32')
+			return;
+
+		var socket = path.join(os.tmpdir(), 'refprop-test-' + process.pid + '.sock');
+		refprop.serve(socket, {slots: 16});
+
+		try {
+			var client = refprop.connect(socket);
+			(function() {
+				client.statePointBatch('TP', new Float64Array(1), new Float64Array(1), {D: new Float64Array(1)});
+			}).should.throw();
+			client.setFluid('nitrogen');
+
+			// more rows than the ring has slots, so they stream through it
+			var n = 100, T = new Float64Array(n), P = new Float64Array(n), D = new Float64Array(n), H = new Float64Array(n);
+			for (var i = 0; i < n; i++) {
+				T[i] = 200 + i;
+				P[i] = 101.3e3;
+			}
+			client.statePointBatch('TP', T, P, {D: D, H: H});
+
+			refprop.setFluid('nitrogen');
+			var local = {D: new Float64Array(n), H: new Float64Array(n)};
+			refprop.statePointBatch('TP', T, P, local);
+			for (var i = 0; i < n; i++) {
+				D[i].should.be.eql(local.D[i]);
+				H[i].should.be.eql(local.H[i]);
+			}
+
+			var errors = [];
+			T[3] = -1;
+			client.statePointBatch('TP', T, P, {D: D}, {errors: errors});
+			errors[3].should.be.a.String;
+			isNaN(D[3]).should.be.eql(true);
+			D[4].should.be.eql(local.D[4]);
+
+			// a client isn't a fluid handle, even though it wraps a pointer the same way
+			var nitrogen = refprop.fluid('nitrogen');
+			(function() {
+				nitrogen.statePoint.call(client, {T: 273.15, P: 101.3e3});
+			}).should.throw();
+
+			client.close();
+			(function() {
+				client.statePointBatch('TP', T, P, {D: D});
+			}).should.throw();
+		}
+		finally {
+			refprop.serve(null);
+		}
+		fs.existsSync(socket).should.be.eql(false);
+
+		// only a dead server's socket gets cleared out of the way, never a file
+		fs.writeFileSync(socket, 'keep');
+		try {
+			(function() {
+				refprop.serve(socket);
+			}).should.throw(/socket/);
+			fs.readFileSync(socket, 'utf8').should.be.eql('keep');
+		}
+		finally {
+			fs.unlinkSync(socket);
+		}
+	});
+
+	it('should load in worker threads, each with its own selected fluid', function() {
+		var threads;
+		try {
+			threads = require('worker_threads');
+		}
+		catch (e) {
+			return;  // nothing to test before node has workers
+		}
+
+		refprop.setFluid('nitrogen');
+		var expected = refprop.statePoint({T: 300, P: 1e6}).D;
+
+		var source = "var threads = require('worker_threads'), refprop = require(threads.workerData.addon);" +
+			"refprop.setFluid('R134A');" +
+			"threads.parentPort.postMessage({fluid: refprop.getFluid(), D: refprop.fluid('nitrogen').statePoint({T: 300, P: 1e6}).D});";
+		var workers = [0, 1].map(function() {
+			return new Promise(function(resolve, reject) {
+				var worker = new threads.Worker(source, {eval: true, workerData: {addon: require.resolve('node-refprop')}});
+				worker.on('message', resolve);
+				worker.on('error', reject);
+			});
+		});
+
+		return Promise.all(workers).then(function(results) {
+			results.forEach(function(result) {
+				result.fluid.should.be.eql('R134A');
+				result.D.should.be.eql(expected);
+			});
+			refprop.getFluid().should.be.eql('nitrogen');
+		});
+	});
+
+	it('should not flash a worker in the main thread\'s fluid', function() {
+		var threads;
+		try {
+			threads = require('worker_threads');
+		}
+		catch (e) {
+			return;
+		}
+
+		refprop.setFluid('nitrogen');
+
+		var source = "var threads = require('worker_threads'), refprop = require(threads.workerData.addon);" +
+			"try { threads.parentPort.postMessage({D: refprop.statePoint({T: 300, P: 1e6}).D}); }" +
+			"catch (e) { threads.parentPort.postMessage({error: e.message}); }";
+		return new Promise(function(resolve, reject) {
+			var worker = new threads.Worker(source, {eval: true, workerData: {addon: require.resolve('node-refprop')}});
+			worker.on('message', resolve);
+			worker.on('error', reject);
+		}).then(function(result) {
+			result.should.not.have.property('D');
+			result.error.should.match(/setFluid/);
+		});
+	});
+
+	it('should keep several fluids resident behind fluid handles', function() {
+		refprop.setEngines(3);
+		var nitrogen = refprop.fluid('nitrogen'), isobutane = refprop.fluid('isobutan');
+		nitrogen.name.should.be.eql('nitrogen');
+
+		var before = refprop.getSchedulerStats();
+		for (var i = 0; i < 10; i++) {
+			nitrogen.statePoint({T: 273.15, P: 101.3e3}).H.should.be.approximately(283.23e3, .01e3);
+			isobutane.statePoint({T: 273.15, P: 101.3e3}).should.have.property('H');
+		}
+		var after = refprop.getSchedulerStats();
+
+		(after.setupCalls - before.setupCalls).should.be.eql(0);
+		after.setupSwitchesAvoided.should.be.above(before.setupSwitchesAvoided);
+
+		(function() {
+			refprop.fluid('urine');
+		}).should.throw();
+		refprop.setEngines(1);
+	});
+
+	it('should evaluate a cycle of states in one call', function() {
+		refprop.setFluid('R134A');
+		var cycle = [
+			{name: 'evap', T: 'Te', Q: 1},
+			{name: 'cond', T: 'Tc', Q: 0},
+			{name: 'isen', P: 'cond.P', S: 'evap.S'},
+			{name: 'comp', P: 'cond.P', H: 'evap.H + (isen.H - evap.H) / eta'},
+			{name: 'valve', P: 'evap.P', H: 'cond.H'}
+		];
+
+		var states = refprop.evaluateGraph(cycle, {Te: 263.15, Tc: 313.15, eta: .7});
+		var evap = refprop.statePoint({T: 263.15, Q: 1}), cond = refprop.statePoint({T: 313.15, Q: 0});
+		var isen = refprop.statePoint({P: cond.P, S: evap.S});
+		states.isen.H.should.be.approximately(isen.H, 1e-6 * isen.H);
+		states.comp.H.should.be.approximately(evap.H + (isen.H - evap.H) / .7, 1e-6 * isen.H);
+		states.valve.Q.should.be.within(0, 1);
+
+		var Tc = new Float64Array([303.15, 313.15]), H = new Float64Array(2);
+		refprop.evaluateGraph(cycle, {Te: 263.15, Tc: Tc, eta: .7}, {comp: {H: H}});
+		H[1].should.be.approximately(states.comp.H, 1e-6 * states.comp.H);
+		H[0].should.be.below(H[1]);
+
+		(function() {
+			refprop.evaluateGraph([{name: 'a', T: 'b.T', Q: 1}], {});
+		}).should.throw();
+	});
+
+	it('should report failed graph nodes as status codes when asked', function() {
+		refprop.setFluid('R134A');
+		var graph = [{name: 'evap', T: 'Te', Q: 1}, {name: 'hot', T: 'Te', P: 'evap.P * k'}];
+
+		var status = new Int32Array(2), H = new Float64Array(2);
+		refprop.evaluateGraph(graph, {Te: 263.15, k: new Float64Array([.5, -1])}, {hot: {H: H}}, {status: status});
+		status[0].should.be.eql(0);
+		status[1].should.be.above(0);
+		H[1].should.be.NaN;
+
+		refprop.setErrorMode('status');
+		try {
+			var failed = refprop.evaluateGraph(graph, {Te: 263.15, k: -1});
+			failed.ierr.should.be.above(0);
+			failed.herr.should.match(/^hot: /);
+		}
+		finally {
+			refprop.setErrorMode('throw');
+		}
+	});
+
+	it('should write a grid and map it back in', function() {
+		refprop.setFluid('nitrogen');
+		var file = path.join(os.tmpdir(), 'node-refprop-test.grid');
+		var written = refprop.writeGrid(file, {inputs: 'TP', T: [80, 300, 12], P: [100e3, 5e6, 10], outputs: ['D', 'H']});
+		written.points.should.be.eql(120);
+		written.bytes.should.be.eql(fs.statSync(file).size);
+
+		var grid = refprop.loadGrid(file);
+		grid.fluid.should.be.eql('nitrogen');
+		grid.inputs.should.be.eql('TP');
+		grid.axes.P.nodes.should.be.eql(10);
+		grid.units.H.should.be.eql('J/kg');
+		grid.columns.D.length.should.be.eql(120);
+		grid.ierr.length.should.be.eql(120);
+
+		// point i is at T node i / 10, P node i % 10
+		var state = refprop.statePoint({T: 80 + 3 * 20, P: 100e3 + 7 * 540e3});
+		grid.columns.H[37].should.be.approximately(state.H, 1e-6 * Math.abs(state.H));
+		grid.columns.D[37].should.be.approximately(state.D, 1e-6 * state.D);
+
+		fs.writeFileSync(file, 'not a grid');
+		(function() {
+			refprop.loadGrid(file);
+		}).should.throw();
+		fs.unlinkSync(file);
+	});
+
+	it('should solve for states from any property', function() {
+		var n2 = refprop.fluid('nitrogen');
+		var state = n2.statePoint({T: 300, P: 2e6}, ['W', 'mu']);
+
+		var byW = n2.solveState({T: 300, W: state.W}, ['mu']);
+		byW.P.should.be.approximately(2e6, 10);
+		byW.mu.should.be.approximately(state.mu, 1e-12);
+		n2.solveState({P: 2e6, mu: state.mu}).T.should.be.approximately(300, 1e-4);
+
+		// a pair statePoint takes is searched too once there's a guess, which picks the root
+		n2.solveState({T: 300, H: state.H}, [], {guess: state.D * 1.1}).D.should.be.approximately(state.D, 1e-4);
+
+		var T = new Float64Array([300, 300]), W = new Float64Array([state.W, 1e5]), P = new Float64Array(2), errors = [];
+		n2.solveStateBatch('T', 'W', T, W, {P: P}, {errors: errors});
+		P[0].should.be.approximately(2e6, 10);
+		isNaN(P[1]).should.be.eql(true);
+		errors[1].should.be.String;
+
+		(function() {
+			n2.solveState({T: 300, W: 1e5});
+		}).should.throw();
+	});
+
+	it('should dedupe and reorder scheduled batches', function() {
+		refprop.setFluid('nitrogen');
+		var P = new Float64Array([2e6, 1e6, 2e6, 1e6, 3e6]), H = new Float64Array([300e3, 310e3, 300e3, 305e3, 300e3]);
+		var plain = new Float64Array(5), T = new Float64Array(5), report = {};
+
+		refprop.statePointBatch('PH', P, H, {T: plain});
+		refprop.statePointBatch('PH', P, H, {T: T}, {schedule: report});
+		for (var i = 0; i < 5; i++)
+			T[i].should.be.approximately(plain[i], 1e-6);
+		report.rows.should.be.eql(5);
+		report.duplicates.should.be.eql(1);
+		report.should.have.properties(['warmStarts', 'solveNs', 'savedNs']);
+	});
+
+	it('should flash through compiled plans', function() {
+		var n2 = refprop.fluid('nitrogen');
+		var state = n2.statePoint({P: 2e6, H: 300e3});
+
+		var plan = n2.compile({inputs: 'PH', outputs: ['T', 'D', 'S']});
+		plan(2e6, 300e3).should.be.eql({T: state.T, D: state.D, S: state.S});
+
+		var celsius = n2.compile({inputs: ['P', 'H'], outputs: 'T', units: {P: 'MPa', H: 'kJ/kg', T: 'C'}});
+		celsius(2, 300).should.be.approximately(state.T - 273.15, 1e-9);
+
+		var T = celsius(new Float64Array([2, 2]), new Float64Array([300, 310]));
+		T.should.be.instanceof(Float64Array);
+		T[0].should.be.approximately(state.T - 273.15, 1e-9);
+		T[1].should.be.above(T[0]);
+
+		(function() {
+			n2.compile({inputs: 'PH', outputs: 'T', units: {T: 'kPa'}});
+		}).should.throw();
+		(function() {
+			n2.compile({inputs: 'AB', outputs: 'T', units: {A: 'C'}});
+		}).should.throw(/TPDHSEQ/);
+	});
+
+	it('should trace the saturation dome and isolines', function() {
+		refprop.setFluid('nitrogen');
+
+		var dome = refprop.saturationDome({points: 20});
+		dome.T.length.should.be.above(19);
+		for (var i = 1; i < dome.T.length; i++) {
+			dome.T[i].should.be.above(dome.T[i - 1]);
+			dome.P[i].should.be.above(dome.P[i - 1]);
+		}
+		dome.T[dome.T.length - 1].should.be.eql(dome.Tc);
+		refprop.saturationDome({points: 20}).should.be.eql(dome);
+
+		var isotherm = refprop.fluid('nitrogen').isoline({T: 100, P: [100e3, 2e6]});
+		var liquid = Array.prototype.indexOf.call(isotherm.Q, 0);
+		liquid.should.be.above(0);
+		isotherm.Q[liquid - 1].should.be.eql(1);
+		isotherm.P[liquid].should.be.eql(isotherm.P[liquid - 1]);
+	});
+
+	it('should compute states for pre-defined mixtures', function() {
 		refprop.setFluid('R410A.ppf');
 		
 		var result = refprop.statePoint({T: 273.15, P: 101.3e3});
@@ -59,6 +706,27 @@ describe('refprop', function() {
 		result.S.should.be.approximately(2.0983e3, .1);
 	});
 	
-	it.skip('should compute states for custom mixtures', function() {
+	it('should compute states for custom mixtures', function() {
+		var blend = refprop.fluid('R32|R125');
+		var equal = blend.statePoint({T: 273.15, P: 101.3e3});
+		equal.Z.should.be.eql([.5, .5]);
+
+		var before = refprop.getSchedulerStats();
+		var mostlyR32 = blend.statePoint({T: 273.15, P: 101.3e3, composition: [.7, .3]});
+		mostlyR32.Z[0].should.be.approximately(.7, 1e-12);
+		mostlyR32.D.should.be.below(equal.D);  // R32 is the lighter of the two
+		(refprop.getSchedulerStats().setupCalls - before.setupCalls).should.be.eql(0);
+
+		// half of the mass is more than half of the moles of the lighter component
+		blend.statePoint({T: 273.15, P: 101.3e3, composition: [.5, .5], basis: 'mass'}).Z[0].should.be.above(.5);
+
+		var T = new Float64Array([273.15, 273.15]), P = new Float64Array([101.3e3, 101.3e3]), D = new Float64Array(2);
+		blend.statePointBatch('TP', T, P, {D: D}, {composition: new Float64Array([.5, .5, .7, .3])});
+		D[0].should.be.approximately(equal.D, 1e-9);
+		D[1].should.be.approximately(mostlyR32.D, 1e-9);
+
+		(function() {
+			blend.statePoint({T: 273.15, P: 101.3e3, composition: [1]});
+		}).should.throw();
 	});
 });
\ No newline at end of file